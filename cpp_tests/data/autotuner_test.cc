@@ -0,0 +1,216 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Unit test for Autotuner and AutotuneNode.
+
+#include "../../lib/data/autotuner.h"
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+#include "gtest/gtest.h"
+#include "tfrt/data/dataset.h"
+#include "tfrt/dtype/dtype.h"
+#include "tfrt/host_context/async_value_ref.h"
+#include "tfrt/host_context/concurrent_work_queue.h"
+#include "tfrt/host_context/diagnostic.h"
+#include "tfrt/host_context/host_allocator.h"
+#include "tfrt/host_context/host_context.h"
+#include "tfrt/tensor/dense_host_tensor.h"
+#include "tfrt/tensor/tensor_metadata.h"
+
+namespace tfrt {
+namespace data {
+namespace {
+
+class AutotunerTest : public ::testing::Test {
+ protected:
+  AutotunerTest()
+      : host_([](const DecodedDiagnostic&) {}, CreateMallocAllocator(),
+              CreateSingleThreadedWorkQueue()) {}
+
+  // Returns a node tuned by `autotuner`.
+  RCReference<AutotuneNode> MakeNode(std::shared_ptr<Autotuner> autotuner,
+                                     int64_t initial_value, int64_t min_value,
+                                     int64_t max_value,
+                                     int64_t elements_per_unit = 1) {
+    IteratorContext context;
+    context.autotuner = std::move(autotuner);
+    return MaybeMakeAutotuneNode(context, "test", kAutotune, initial_value,
+                                 min_value, max_value, elements_per_unit,
+                                 &host_);
+  }
+
+  // Reports an element of `bytes` bytes which was available as soon as it
+  // was requested.
+  void Produce(AutotuneNode* node, int64_t bytes = 0) {
+    auto tensor = DenseHostTensor::CreateUninitialized(
+        TensorMetadata(DType(DType::I8), {bytes}), &host_);
+    ASSERT_TRUE(tensor.hasValue());
+    node->TrackProduction(IterationResult::Values(
+        {MakeAvailableAsyncValueRef<DenseHostTensor>(&host_,
+                                                     std::move(*tensor))},
+        &host_));
+  }
+
+  // Reports an element which the consumer waited for for `wait`.
+  void Consume(AutotuneNode* node, std::chrono::milliseconds wait) {
+    auto value = MakeUnconstructedAsyncValueRef<int64_t>(&host_);
+    node->TrackConsumption(
+        IterationResult::Values({value.CopyRCRef()}, &host_));
+    std::this_thread::sleep_for(wait);
+    value.emplace(0);
+  }
+
+  HostContext host_;
+};
+
+// A period long enough that the autotuner only runs when Tune() is called.
+constexpr auto kLongPeriod = std::chrono::hours(1);
+
+TEST_F(AutotunerTest, OnlyTunesAutotuneParameters) {
+  IteratorContext context;
+  EXPECT_FALSE(
+      MaybeMakeAutotuneNode(context, "test", kAutotune, 1, 1, 8, 1, &host_));
+  context.autotuner = std::make_shared<Autotuner>();
+  EXPECT_FALSE(MaybeMakeAutotuneNode(context, "test", 4, 1, 1, 8, 1, &host_));
+  EXPECT_TRUE(
+      MaybeMakeAutotuneNode(context, "test", kAutotune, 1, 1, 8, 1, &host_));
+}
+
+TEST_F(AutotunerTest, ClampsInitialValue) {
+  auto autotuner = std::make_shared<Autotuner>();
+  EXPECT_EQ(MakeNode(autotuner, /*initial_value=*/0, 2, 8)->value(), 2);
+  EXPECT_EQ(MakeNode(autotuner, /*initial_value=*/20, 2, 8)->value(), 8);
+  EXPECT_EQ(MakeNode(autotuner, /*initial_value=*/5, 2, 8)->value(), 5);
+}
+
+TEST_F(AutotunerTest, GrowsStarvedNodeUpToMax) {
+  auto autotuner = std::make_shared<Autotuner>(
+      Autotuner::kDefaultMemoryBudget, std::chrono::milliseconds(10));
+  auto node = MakeNode(autotuner, /*initial_value=*/2, /*min_value=*/1,
+                       /*max_value=*/5);
+  for (int64_t expected : {3, 4, 5, 5}) {
+    // The consumer waits for at least 1/100 of the tuning period.
+    Consume(node.get(), std::chrono::milliseconds(1));
+    autotuner->Tune();
+    EXPECT_EQ(node->value(), expected);
+  }
+}
+
+TEST_F(AutotunerTest, ShrinksIdleNodeDownToMin) {
+  auto autotuner = std::make_shared<Autotuner>(
+      Autotuner::kDefaultMemoryBudget, kLongPeriod);
+  auto node = MakeNode(autotuner, /*initial_value=*/3, /*min_value=*/2,
+                       /*max_value=*/8);
+  // The node is shrunk by one after 10 periods without consumer waits.
+  for (int i = 0; i < 9; ++i) {
+    Produce(node.get());
+    autotuner->Tune();
+  }
+  EXPECT_EQ(node->value(), 3);
+  Produce(node.get());
+  autotuner->Tune();
+  EXPECT_EQ(node->value(), 2);
+
+  for (int i = 0; i < 20; ++i) {
+    Produce(node.get());
+    autotuner->Tune();
+  }
+  EXPECT_EQ(node->value(), 2);
+}
+
+TEST_F(AutotunerTest, DoesNotShrinkNodeWithoutProduction) {
+  auto autotuner = std::make_shared<Autotuner>(
+      Autotuner::kDefaultMemoryBudget, kLongPeriod);
+  auto node = MakeNode(autotuner, /*initial_value=*/3, /*min_value=*/1,
+                       /*max_value=*/8);
+  for (int i = 0; i < 20; ++i) autotuner->Tune();
+  EXPECT_EQ(node->value(), 3);
+}
+
+TEST_F(AutotunerTest, StaysWithinMemoryBudget) {
+  // The budget holds 10 elements of 1000 bytes.
+  auto autotuner = std::make_shared<Autotuner>(/*memory_budget=*/10000,
+                                               std::chrono::milliseconds(10));
+  auto node = MakeNode(autotuner, /*initial_value=*/12, /*min_value=*/1,
+                       /*max_value=*/100);
+  Produce(node.get(), /*bytes=*/1000);
+
+  // The buffers hold more than the budget, so the node is shrunk until they
+  // fit, even though its consumer waits.
+  for (int i = 0; i < 2; ++i) {
+    Consume(node.get(), std::chrono::milliseconds(1));
+    autotuner->Tune();
+  }
+  EXPECT_EQ(node->value(), 10);
+
+  // Growing the node would exceed the budget.
+  Consume(node.get(), std::chrono::milliseconds(1));
+  autotuner->Tune();
+  EXPECT_EQ(node->value(), 10);
+}
+
+TEST_F(AutotunerTest, CountsElementsHeldPerUnit) {
+  // The budget holds 10 elements of 1000 bytes, and each unit of the parameter
+  // holds 2 elements.
+  auto autotuner = std::make_shared<Autotuner>(/*memory_budget=*/10000,
+                                               std::chrono::milliseconds(10));
+  auto node = MakeNode(autotuner, /*initial_value=*/7, /*min_value=*/1,
+                       /*max_value=*/100, /*elements_per_unit=*/2);
+  Produce(node.get(), /*bytes=*/1000);
+
+  for (int i = 0; i < 2; ++i) {
+    Consume(node.get(), std::chrono::milliseconds(1));
+    autotuner->Tune();
+  }
+  EXPECT_EQ(node->value(), 5);
+}
+
+TEST_F(AutotunerTest, SharesMemoryBudgetAcrossPipelines) {
+  EXPECT_EQ(Autotuner::Default(), Autotuner::Default());
+
+  // The budget holds 10 elements of 1000 bytes, which the nodes of two
+  // pipelines already buffer together.
+  auto autotuner = std::make_shared<Autotuner>(/*memory_budget=*/10000,
+                                               std::chrono::milliseconds(10));
+  auto first = MakeNode(autotuner, /*initial_value=*/6, /*min_value=*/1,
+                        /*max_value=*/100);
+  auto second = MakeNode(autotuner, /*initial_value=*/4, /*min_value=*/1,
+                         /*max_value=*/100);
+  Produce(first.get(), /*bytes=*/1000);
+  Produce(second.get(), /*bytes=*/1000);
+
+  // Growing either node would exceed the budget, even though both consumers
+  // wait.
+  Consume(first.get(), std::chrono::milliseconds(1));
+  Consume(second.get(), std::chrono::milliseconds(1));
+  autotuner->Tune();
+  EXPECT_EQ(first->value(), 6);
+  EXPECT_EQ(second->value(), 4);
+
+  // Once the second pipeline is destroyed, the first one can grow.
+  second.reset();
+  Consume(first.get(), std::chrono::milliseconds(1));
+  autotuner->Tune();
+  EXPECT_EQ(first->value(), 9);
+}
+
+}  // namespace
+}  // namespace data
+}  // namespace tfrt
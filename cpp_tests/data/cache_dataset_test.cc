@@ -0,0 +1,197 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Unit test for CacheDataset.
+
+#include "../../lib/data/cache_dataset.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../../lib/data/map_dataset.h"
+#include "gtest/gtest.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "tfrt/cpp_tests/data_test_util.h"
+#include "tfrt/data/dataset.h"
+#include "tfrt/host_context/async_value_ref.h"
+#include "tfrt/host_context/execution_context.h"
+#include "tfrt/host_context/host_context.h"
+#include "tfrt/support/forward_decls.h"
+#include "tfrt/support/rc_array.h"
+#include "tfrt/tensor/dense_host_tensor.h"
+
+namespace tfrt {
+namespace data {
+namespace {
+
+class CacheDatasetTest : public DatasetTest {
+ protected:
+
+  void SetUp() override {
+    ASSERT_FALSE(
+        llvm::sys::fs::createUniqueDirectory("cache_dataset_test", root_));
+    filename_ = StrCat(root_, "/cache.btf");
+  }
+
+  void TearDown() override { llvm::sys::fs::remove_directories(root_); }
+
+  RCReference<TestInputDataset> MakeInput(int64_t num_elements,
+                                          int64_t error_index = -1) {
+    TestInputDataset::Options options;
+    options.tensors = true;
+    options.error_index = error_index;
+    return TakeRef(
+        host_.Construct<TestInputDataset>(num_elements, options, &host_));
+  }
+
+  // Returns AsyncScale mapped over `input`.
+  RCReference<Dataset> MakeAsyncMap(RCReference<Dataset> input) {
+    const auto& registry = host_.GetKernelRegistry();
+    auto* map_fn =
+        MakeFunction("async_scale", registry.GetType("!t.tensor"),
+                     registry.GetType("!t.tensor"), AsyncScale);
+    return TakeRef(host_.Construct<MapDataset>(
+        std::move(input), RCArray<AsyncValue>(ArrayRef<AsyncValue*>()),
+        FormRef(map_fn), &host_));
+  }
+
+  RCReference<CacheDataset> MakeCache(RCReference<Dataset> input) {
+    return TakeRef(host_.Construct<CacheDataset>(std::move(input), filename_,
+                                                 /*arity=*/1, &host_));
+  }
+
+  // Waits for `result` and returns its value, or -1 at the end of iteration.
+  int64_t Await(const IterationResult& result) {
+    host_.Await({result.values[0], result.eof.CopyRCRef()});
+    if (result.eof.IsError() || result.eof.get()) return -1;
+    return *result.values[0]->get<DenseHostTensor>().data<int64_t>();
+  }
+
+  // Returns the values of `iterator` until the end of iteration or an error.
+  std::vector<int64_t> GetAll(Iterator* iterator) {
+    std::vector<int64_t> values;
+    for (int64_t value; (value = Await(iterator->GetNext(exec_ctx_))) >= 0;)
+      values.push_back(value);
+    return values;
+  }
+
+  // Returns the names of the files in the test directory.
+  std::vector<std::string> ListFiles() {
+    std::vector<std::string> names;
+    std::error_code ec;
+    for (llvm::sys::fs::directory_iterator it(root_, ec), end;
+         !ec && it != end; it.increment(ec)) {
+      names.push_back(llvm::sys::path::filename(it->path()).str());
+    }
+    return names;
+  }
+
+  llvm::SmallString<128> root_;
+  std::string filename_;
+};
+
+TEST_F(CacheDatasetTest, WritesOnFirstPassAndReadsOnSecond) {
+  auto input = MakeInput(5);
+  auto dataset = MakeCache(input.CopyRef());
+  EXPECT_EQ(GetAll(dataset->MakeIterator(IteratorContext()).get()),
+            std::vector<int64_t>({0, 1, 2, 3, 4}));
+  host_.Quiesce();
+  EXPECT_EQ(ListFiles(), std::vector<std::string>({"cache.btf"}));
+  EXPECT_EQ(input->num_requests(), 6);
+
+  // The second pass reads the cache file instead of running the input.
+  EXPECT_EQ(GetAll(dataset->MakeIterator(IteratorContext()).get()),
+            std::vector<int64_t>({0, 1, 2, 3, 4}));
+  EXPECT_EQ(input->num_requests(), 6);
+
+  // Other datasets with the same file read it as well.
+  EXPECT_EQ(GetAll(MakeCache(input.CopyRef())
+                       ->MakeIterator(IteratorContext())
+                       .get()),
+            std::vector<int64_t>({0, 1, 2, 3, 4}));
+  EXPECT_EQ(input->num_requests(), 6);
+}
+
+TEST_F(CacheDatasetTest, CachesOutputOfAsyncMap) {
+  auto input = MakeInput(4);
+  auto dataset = MakeCache(MakeAsyncMap(input.CopyRef()));
+  EXPECT_EQ(GetAll(dataset->MakeIterator(IteratorContext()).get()),
+            std::vector<int64_t>({0, 10, 20, 30}));
+  host_.Quiesce();
+  EXPECT_EQ(ListFiles(), std::vector<std::string>({"cache.btf"}));
+  EXPECT_EQ(input->num_requests(), 5);
+
+  // The second pass reads the mapped elements from the cache file.
+  EXPECT_EQ(GetAll(dataset->MakeIterator(IteratorContext()).get()),
+            std::vector<int64_t>({0, 10, 20, 30}));
+  EXPECT_EQ(input->num_requests(), 5);
+}
+
+TEST_F(CacheDatasetTest, PartialPassLeavesNoCacheFile) {
+  auto input = MakeInput(5);
+  auto dataset = MakeCache(input.CopyRef());
+  {
+    auto iterator = dataset->MakeIterator(IteratorContext());
+    EXPECT_EQ(Await(iterator->GetNext(exec_ctx_)), 0);
+    EXPECT_EQ(Await(iterator->GetNext(exec_ctx_)), 1);
+  }
+  host_.Quiesce();
+  EXPECT_TRUE(ListFiles().empty());
+
+  // The next pass runs the input again and writes the cache.
+  EXPECT_EQ(GetAll(dataset->MakeIterator(IteratorContext()).get()),
+            std::vector<int64_t>({0, 1, 2, 3, 4}));
+  host_.Quiesce();
+  EXPECT_EQ(input->num_requests(), 8);
+  EXPECT_EQ(ListFiles(), std::vector<std::string>({"cache.btf"}));
+}
+
+TEST_F(CacheDatasetTest, ConcurrentWritersLeaveOneCacheFile) {
+  auto input = MakeInput(5);
+  auto dataset = MakeCache(input.CopyRef());
+  auto first = dataset->MakeIterator(IteratorContext());
+  auto second = dataset->MakeIterator(IteratorContext());
+  for (int64_t i = 0; i < 5; ++i) {
+    EXPECT_EQ(Await(first->GetNext(exec_ctx_)), i);
+    EXPECT_EQ(Await(second->GetNext(exec_ctx_)), i);
+  }
+  EXPECT_EQ(Await(first->GetNext(exec_ctx_)), -1);
+  EXPECT_EQ(Await(second->GetNext(exec_ctx_)), -1);
+  host_.Quiesce();
+  EXPECT_EQ(ListFiles(), std::vector<std::string>({"cache.btf"}));
+
+  EXPECT_EQ(GetAll(dataset->MakeIterator(IteratorContext()).get()),
+            std::vector<int64_t>({0, 1, 2, 3, 4}));
+  EXPECT_EQ(input->num_requests(), 12);
+}
+
+TEST_F(CacheDatasetTest, InputErrorLeavesNoCacheFile) {
+  auto input = MakeInput(5, /*error_index=*/2);
+  auto dataset = MakeCache(input.CopyRef());
+  auto iterator = dataset->MakeIterator(IteratorContext());
+  EXPECT_EQ(GetAll(iterator.get()), std::vector<int64_t>({0, 1}));
+  // The elements after the error are still produced, but not cached.
+  EXPECT_EQ(GetAll(iterator.get()), std::vector<int64_t>({3, 4}));
+  host_.Quiesce();
+  EXPECT_TRUE(ListFiles().empty());
+}
+
+}  // namespace
+}  // namespace data
+}  // namespace tfrt
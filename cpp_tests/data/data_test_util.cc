@@ -0,0 +1,154 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// This file implements the utilities for unit tests of datasets.
+
+#include "tfrt/cpp_tests/data_test_util.h"
+
+#include <utility>
+
+#include "tfrt/cpp_tests/test_util.h"
+#include "tfrt/host_context/async_dispatch.h"
+#include "tfrt/host_context/diagnostic.h"
+#include "tfrt/host_context/host_allocator.h"
+#include "tfrt/tensor/dense_host_tensor.h"
+
+namespace tfrt {
+namespace data {
+
+//===----------------------------------------------------------------------===//
+// TestInputIterator
+//===----------------------------------------------------------------------===//
+class TestInputIterator : public Iterator {
+ public:
+  explicit TestInputIterator(RCReference<TestInputDataset> dataset)
+      : dataset_(std::move(dataset)) {}
+
+  IterationResult GetNext(const ExecutionContext& exec_ctx) override;
+
+ private:
+  void Destroy() override {
+    internal::DestroyImpl<TestInputIterator>(this,
+                                             dataset_->host_->allocator());
+  }
+
+  RCReference<TestInputDataset> dataset_;
+  int64_t next_ = 0;
+};
+
+IterationResult TestInputIterator::GetNext(const ExecutionContext& exec_ctx) {
+  ++dataset_->num_requests_;
+  auto* host = exec_ctx.host();
+  const auto& options = dataset_->options_;
+  auto result = IterationResult::Eof(host, 1);
+  if (next_ < dataset_->num_elements_) {
+    auto index = next_++;
+    if (index == options.error_index) {
+      result = IterationResult::Error(
+          MakeErrorAsyncValueRef(host, "input error"), 1);
+    } else if (index == options.pending_index) {
+      return IterationResult::Pending({dataset_->pending_value_},
+                                      dataset_->pending_eof_.CopyRef());
+    } else if (index == options.slow_index) {
+      result = IterationResult::Values({dataset_->slow_value_}, host);
+    } else {
+      result = IterationResult::Values({dataset_->MakeValue(index)}, host);
+    }
+  }
+  if (options.async_eof) {
+    auto eof = MakeUnconstructedAsyncValueRef<bool>(host);
+    EnqueueWork(exec_ctx, [eof = eof.CopyRef(), value = result.eof.CopyRef()] {
+      if (value.IsError()) {
+        eof.SetError(value.GetError());
+      } else {
+        eof.emplace(value.get());
+      }
+    });
+    result.eof = std::move(eof);
+  }
+  return result;
+}
+
+//===----------------------------------------------------------------------===//
+// TestInputDataset
+//===----------------------------------------------------------------------===//
+TestInputDataset::TestInputDataset(int64_t num_elements, Options options,
+                                   HostContext* host)
+    : num_elements_(num_elements),
+      options_(options),
+      host_(host),
+      slow_value_(MakeIndirectAsyncValue()),
+      pending_value_(MakeIndirectAsyncValue()),
+      pending_eof_(MakeUnconstructedAsyncValueRef<bool>(host)) {}
+
+RCReference<Iterator> TestInputDataset::MakeIteratorInternal(
+    const IteratorContext& context) {
+  ++num_iterators_;
+  return TakeRef(host_->Construct<TestInputIterator>(FormRef(this)));
+}
+
+void TestInputDataset::ResolveSlowElement() {
+  slow_value_->ForwardTo(MakeValue(options_.slow_index));
+}
+
+void TestInputDataset::ResolvePendingElement() {
+  pending_value_->ForwardTo(MakeValue(options_.pending_index));
+  pending_eof_.emplace(false);
+}
+
+RCReference<AsyncValue> TestInputDataset::MakeValue(int64_t index) const {
+  if (!options_.tensors)
+    return MakeAvailableAsyncValueRef<int64_t>(host_, index);
+  return MakeAvailableAsyncValueRef<DenseHostTensor>(
+      host_, *DenseHostTensor::CreateScalar<int64_t>(index, host_));
+}
+
+//===----------------------------------------------------------------------===//
+// Functions and fixtures
+//===----------------------------------------------------------------------===//
+void AsyncScale(AsyncValue* const* arguments, int num_arguments,
+                RCReference<AsyncValue>* results, int num_results,
+                HostContext* host) {
+  if (arguments[0]->IsError()) {
+    results[0] = FormRef(arguments[0]);
+    return;
+  }
+  auto result = MakeIndirectAsyncValue();
+  results[0] = result;
+  EnqueueWork(host, [element = FormRef(arguments[0]),
+                     result = std::move(result), host]() mutable {
+    auto value = *element->get<DenseHostTensor>().data<int64_t>();
+    result->ForwardTo(MakeAvailableAsyncValueRef<DenseHostTensor>(
+        host, *DenseHostTensor::CreateScalar<int64_t>(10 * value, host)));
+  });
+}
+
+DatasetTest::DatasetTest(std::unique_ptr<ConcurrentWorkQueue> work_queue)
+    : host_([](const DecodedDiagnostic&) {}, CreateMallocAllocator(),
+            std::move(work_queue)),
+      exec_ctx_(CreateTestExecutionContext(&host_)) {}
+
+NativeFunction* DatasetTest::MakeFunction(string_view name,
+                                          ArrayRef<TypeName> argument_types,
+                                          ArrayRef<TypeName> result_types,
+                                          NativeCallable callable) {
+  functions_.push_back(std::make_unique<NativeFunction>(
+      name, argument_types, result_types, callable));
+  return functions_.back().get();
+}
+
+}  // namespace data
+}  // namespace tfrt
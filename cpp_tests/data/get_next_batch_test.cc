@@ -0,0 +1,297 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Unit test for the GetNextBatch() implementations of the datasets.
+
+#include <cstdint>
+#include <vector>
+
+#include "../../lib/data/batch_dataset.h"
+#include "../../lib/data/filter_dataset.h"
+#include "../../lib/data/map_dataset.h"
+#include "../../lib/data/range_dataset.h"
+#include "../../lib/data/repeat_dataset.h"
+#include "../../lib/data/skip_dataset.h"
+#include "gtest/gtest.h"
+#include "tfrt/cpp_tests/data_test_util.h"
+#include "tfrt/data/dataset.h"
+#include "tfrt/host_context/async_value_ref.h"
+#include "tfrt/host_context/execution_context.h"
+#include "tfrt/host_context/host_context.h"
+#include "tfrt/host_context/kernel_registry.h"
+#include "tfrt/host_context/native_function.h"
+#include "tfrt/support/forward_decls.h"
+#include "tfrt/support/rc_array.h"
+#include "tfrt/tensor/dense_host_tensor.h"
+
+namespace tfrt {
+namespace data {
+namespace {
+
+void Double(AsyncValue* const* arguments, int num_arguments,
+            RCReference<AsyncValue>* results, int num_results,
+            HostContext* host) {
+  if (arguments[0]->IsError()) {
+    results[0] = FormRef(arguments[0]);
+    return;
+  }
+  int64_t value = arguments[0]->get<int64_t>();
+  results[0] = MakeAvailableAsyncValueRef<int64_t>(host, 2 * value);
+}
+
+void IsEven(AsyncValue* const* arguments, int num_arguments,
+            RCReference<AsyncValue>* results, int num_results,
+            HostContext* host) {
+  if (arguments[0]->IsError()) {
+    results[0] = FormRef(arguments[0]);
+    return;
+  }
+  int64_t value = arguments[0]->get<int64_t>();
+  results[0] = MakeAvailableAsyncValueRef<bool>(host, value % 2 == 0);
+}
+
+// The end of iteration and errors in the output of an iterator.
+constexpr int64_t kEof = -1;
+constexpr int64_t kError = -2;
+
+class GetNextBatchTest : public DatasetTest {
+ protected:
+  GetNextBatchTest() {
+    const auto& registry = host_.GetKernelRegistry();
+    double_ = MakeFunction("double", {}, {registry.GetType("i64")}, Double);
+    is_even_ = MakeFunction("is_even", {registry.GetType("i64")},
+                            {registry.GetType("i1")}, IsEven);
+  }
+
+  RCReference<TestInputDataset> MakeInput(int64_t num_elements,
+                                          int64_t error_index = -1,
+                                          int64_t pending_index = -1) {
+    TestInputDataset::Options options;
+    options.error_index = error_index;
+    options.pending_index = pending_index;
+    return TakeRef(
+        host_.Construct<TestInputDataset>(num_elements, options, &host_));
+  }
+
+  RCReference<Dataset> MakeFilter(RCReference<Dataset> input) {
+    return TakeRef(host_.Construct<FilterDataset>(
+        std::move(input), FormRef(is_even_), &host_));
+  }
+
+  RCReference<Dataset> MakeRepeat(RCReference<Dataset> input, int64_t count) {
+    return TakeRef(
+        host_.Construct<RepeatDataset>(std::move(input), count, &host_));
+  }
+
+  // Waits for `result` and returns its value, kEof or kError.
+  int64_t Await(const IterationResult& result) {
+    host_.Await({result.values[0], result.eof.CopyRCRef()});
+    if (result.eof.IsError()) {
+      EXPECT_TRUE(result.values[0]->IsError());
+      return kError;
+    }
+    if (result.eof.get()) return kEof;
+    return result.values[0]->get<int64_t>();
+  }
+
+  std::vector<int64_t> Await(llvm::ArrayRef<IterationResult> results) {
+    std::vector<int64_t> values;
+    for (const auto& result : results) values.push_back(Await(result));
+    return values;
+  }
+
+  int64_t GetNext(Iterator* iterator) {
+    return Await(iterator->GetNext(exec_ctx_));
+  }
+
+  llvm::SmallVector<IterationResult, 4> GetNextBatch(Iterator* iterator,
+                                                     size_t n) {
+    llvm::SmallVector<IterationResult, 4> results;
+    iterator->GetNextBatch(exec_ctx_, n, &results);
+    EXPECT_EQ(results.size(), n);
+    return results;
+  }
+
+  // Returns true if neither the value nor the eof of `result` is available
+  // once all work is done.
+  bool IsPending(const IterationResult& result) {
+    host_.Quiesce();
+    return !result.values[0]->IsAvailable() && !result.eof.IsAvailable();
+  }
+
+  NativeFunction* double_;
+  NativeFunction* is_even_;
+};
+
+using Values = std::vector<int64_t>;
+
+TEST_F(GetNextBatchTest, Range) {
+  auto dataset = TakeRef(host_.Construct<RangeDataset>(
+      /*start=*/0, /*stop=*/10, /*step=*/1, DType(DType::I64), &host_));
+  auto iterator = dataset->MakeIterator(IteratorContext());
+  EXPECT_EQ(GetNext(iterator.get()), 0);
+  EXPECT_EQ(Await(GetNextBatch(iterator.get(), 4)), Values({1, 2, 3, 4}));
+  EXPECT_EQ(GetNext(iterator.get()), 5);
+  EXPECT_EQ(Await(GetNextBatch(iterator.get(), 6)),
+            Values({6, 7, 8, 9, kEof, kEof}));
+  EXPECT_EQ(GetNext(iterator.get()), kEof);
+}
+
+TEST_F(GetNextBatchTest, RangeError) {
+  auto dataset = TakeRef(host_.Construct<RangeDataset>(
+      /*start=*/0, /*stop=*/10, /*step=*/1, DType(DType::String), &host_));
+  auto iterator = dataset->MakeIterator(IteratorContext());
+  EXPECT_EQ(Await(GetNextBatch(iterator.get(), 3)),
+            Values({kError, kError, kError}));
+}
+
+TEST_F(GetNextBatchTest, Skip) {
+  auto dataset = TakeRef(host_.Construct<SkipDataset>(
+      MakeInput(10, /*error_index=*/5), /*count=*/3, &host_));
+  auto iterator = dataset->MakeIterator(IteratorContext());
+  EXPECT_EQ(Await(GetNextBatch(iterator.get(), 4)), Values({3, 4, kError, 6}));
+  EXPECT_EQ(GetNext(iterator.get()), 7);
+  EXPECT_EQ(Await(GetNextBatch(iterator.get(), 4)),
+            Values({8, 9, kEof, kEof}));
+}
+
+TEST_F(GetNextBatchTest, Map) {
+  auto input = MakeInput(6, /*error_index=*/4, /*pending_index=*/2);
+  auto dataset = TakeRef(host_.Construct<MapDataset>(
+      input.CopyRef(), RCArray<AsyncValue>(ArrayRef<AsyncValue*>()),
+      FormRef(double_), &host_));
+  auto iterator = dataset->MakeIterator(IteratorContext());
+  EXPECT_EQ(GetNext(iterator.get()), 0);
+  auto results = GetNextBatch(iterator.get(), 4);
+  EXPECT_TRUE(IsPending(results[1]));
+  input->ResolvePendingElement();
+  EXPECT_EQ(Await(results), Values({2, 4, 6, kError}));
+  EXPECT_EQ(Await(GetNextBatch(iterator.get(), 3)), Values({10, kEof, kEof}));
+}
+
+TEST_F(GetNextBatchTest, Filter) {
+  auto iterator = MakeFilter(MakeInput(12))->MakeIterator(IteratorContext());
+  EXPECT_EQ(Await(GetNextBatch(iterator.get(), 3)), Values({0, 2, 4}));
+  EXPECT_EQ(GetNext(iterator.get()), 6);
+  // The end of iteration is reached in the middle of the batch.
+  EXPECT_EQ(Await(GetNextBatch(iterator.get(), 4)),
+            Values({8, 10, kEof, kEof}));
+  EXPECT_EQ(GetNext(iterator.get()), kEof);
+}
+
+TEST_F(GetNextBatchTest, FilterError) {
+  auto iterator = MakeFilter(MakeInput(8, /*error_index=*/2))
+                      ->MakeIterator(IteratorContext());
+  EXPECT_EQ(Await(GetNextBatch(iterator.get(), 3)), Values({0, kError, 4}));
+  EXPECT_EQ(Await(GetNextBatch(iterator.get(), 3)), Values({6, kEof, kEof}));
+}
+
+TEST_F(GetNextBatchTest, FilterPendingInput) {
+  auto input = MakeInput(10, /*error_index=*/-1, /*pending_index=*/3);
+  auto iterator = MakeFilter(input.CopyRef())->MakeIterator(IteratorContext());
+  auto results = GetNextBatch(iterator.get(), 3);
+  EXPECT_TRUE(IsPending(results[2]));
+  // The calls made while the input is pending are served in order.
+  auto next = iterator->GetNext(exec_ctx_);
+  auto batch = GetNextBatch(iterator.get(), 2);
+  input->ResolvePendingElement();
+  EXPECT_EQ(Await(results), Values({0, 2, 4}));
+  EXPECT_EQ(Await(next), 6);
+  EXPECT_EQ(Await(batch), Values({8, kEof}));
+}
+
+TEST_F(GetNextBatchTest, FilterBatchAfterPendingGetNext) {
+  auto input = MakeInput(6, /*error_index=*/-1, /*pending_index=*/0);
+  auto iterator = MakeFilter(input.CopyRef())->MakeIterator(IteratorContext());
+  auto first = iterator->GetNext(exec_ctx_);
+  auto batch = GetNextBatch(iterator.get(), 3);
+  EXPECT_TRUE(IsPending(first));
+  EXPECT_TRUE(IsPending(batch[0]));
+  input->ResolvePendingElement();
+  EXPECT_EQ(Await(first), 0);
+  EXPECT_EQ(Await(batch), Values({2, 4, kEof}));
+}
+
+TEST_F(GetNextBatchTest, Repeat) {
+  auto input = MakeInput(3);
+  auto iterator =
+      MakeRepeat(input.CopyRef(), /*count=*/3)->MakeIterator(IteratorContext());
+  EXPECT_EQ(GetNext(iterator.get()), 0);
+  EXPECT_EQ(Await(GetNextBatch(iterator.get(), 4)), Values({1, 2, 0, 1}));
+  EXPECT_EQ(input->num_iterators(), 2);
+  EXPECT_EQ(GetNext(iterator.get()), 2);
+  // The end of iteration is reached in the middle of the batch.
+  EXPECT_EQ(Await(GetNextBatch(iterator.get(), 5)),
+            Values({0, 1, 2, kEof, kEof}));
+  EXPECT_EQ(input->num_iterators(), 3);
+  EXPECT_EQ(GetNext(iterator.get()), kEof);
+}
+
+TEST_F(GetNextBatchTest, RepeatBatchBeforeGetNext) {
+  auto iterator =
+      MakeRepeat(MakeInput(2), /*count=*/2)->MakeIterator(IteratorContext());
+  EXPECT_EQ(Await(GetNextBatch(iterator.get(), 3)), Values({0, 1, 0}));
+  EXPECT_EQ(Await(GetNextBatch(iterator.get(), 3)), Values({1, kEof, kEof}));
+}
+
+TEST_F(GetNextBatchTest, RepeatError) {
+  auto iterator = MakeRepeat(MakeInput(3, /*error_index=*/1), /*count=*/2)
+                      ->MakeIterator(IteratorContext());
+  EXPECT_EQ(GetNext(iterator.get()), 0);
+  EXPECT_EQ(Await(GetNextBatch(iterator.get(), 6)),
+            Values({kError, 2, 0, kError, 2, kEof}));
+}
+
+TEST_F(GetNextBatchTest, RepeatPendingInput) {
+  auto input = MakeInput(3, /*error_index=*/-1, /*pending_index=*/1);
+  auto iterator =
+      MakeRepeat(input.CopyRef(), /*count=*/2)->MakeIterator(IteratorContext());
+  EXPECT_EQ(GetNext(iterator.get()), 0);
+  auto results = GetNextBatch(iterator.get(), 4);
+  EXPECT_TRUE(IsPending(results[0]));
+  auto next = iterator->GetNext(exec_ctx_);
+  input->ResolvePendingElement();
+  EXPECT_EQ(Await(results), Values({1, 2, 0, 1}));
+  EXPECT_EQ(Await(next), 2);
+  EXPECT_EQ(input->num_iterators(), 2);
+  EXPECT_EQ(GetNext(iterator.get()), kEof);
+}
+
+TEST_F(GetNextBatchTest, BatchOfFilter) {
+  auto dataset = TakeRef(host_.Construct<BatchDataset<int64_t>>(
+      MakeFilter(MakeInput(10)), /*batch_size=*/4,
+      /*same_input_metadata=*/false, &host_));
+  auto iterator = dataset->MakeIterator(IteratorContext());
+  auto batch_values = [&]() {
+    auto result = iterator->GetNext(exec_ctx_);
+    host_.Await({result.values[0], result.eof.CopyRCRef()});
+    EXPECT_FALSE(result.eof.IsError());
+    Values values;
+    if (result.eof.IsError() || result.eof.get()) return values;
+    const auto& tensor = result.values[0]->get<DenseHostTensor>();
+    const auto* data = tensor.data<int64_t>();
+    values.assign(data, data + tensor.NumElements());
+    return values;
+  };
+  EXPECT_EQ(batch_values(), Values({0, 2, 4, 6}));
+  // The last batch is truncated at the end of iteration.
+  EXPECT_EQ(batch_values(), Values({8}));
+  EXPECT_EQ(batch_values(), Values());
+}
+
+}  // namespace
+}  // namespace data
+}  // namespace tfrt
@@ -0,0 +1,128 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Unit test for PrefetchingIterator.
+
+#include "../../lib/data/io.h"
+
+#include <cstdint>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "tfrt/cpp_tests/data_test_util.h"
+#include "tfrt/data/dataset.h"
+#include "tfrt/host_context/async_value_ref.h"
+#include "tfrt/host_context/concurrent_work_queue.h"
+#include "tfrt/host_context/execution_context.h"
+#include "tfrt/host_context/host_context.h"
+#include "tfrt/support/forward_decls.h"
+
+namespace tfrt {
+namespace data {
+namespace io {
+namespace {
+
+// Reads the integers [0, num_elements) from a fake IO source.
+class RangeIterator : public PrefetchingIterator {
+ public:
+  RangeIterator(int64_t num_elements, int64_t max_prefetch_num,
+                PrefetchBufferAccess access, HostContext* host)
+      : PrefetchingIterator(max_prefetch_num, max_prefetch_num / 2,
+                            IteratorContext(), access),
+        num_elements_(num_elements),
+        host_(host) {}
+
+ protected:
+  IterationResult GetNextElement(const ExecutionContext& exec_ctx) override {
+    if (next_ == num_elements_) return IterationResult::Eof(host_, 1);
+    return IterationResult::Values(
+        {MakeAvailableAsyncValueRef<int64_t>(host_, next_++)}, host_);
+  }
+
+ private:
+  void Destroy() override {
+    internal::DestroyImpl<RangeIterator>(this, host_->allocator());
+  }
+
+  const int64_t num_elements_;
+  HostContext* host_;
+  int64_t next_ = 0;
+};
+
+class PrefetchingIteratorTest : public DatasetTest {
+ protected:
+  PrefetchingIteratorTest()
+      : DatasetTest(CreateMultiThreadedWorkQueue(2, 2)) {}
+
+  RCReference<Iterator> MakeIterator(
+      int64_t num_elements, int64_t max_prefetch_num,
+      PrefetchBufferAccess access = PrefetchBufferAccess::kLockFree) {
+    return TakeRef(host_.Construct<RangeIterator>(
+        num_elements, max_prefetch_num, access, &host_));
+  }
+
+  // Waits for the next element of `iterator` and returns its value, or -1 at
+  // the end of iteration.
+  int64_t GetNext(Iterator* iterator) {
+    auto result = iterator->GetNext(exec_ctx_);
+    host_.Await({result.values[0], result.eof.CopyRCRef()});
+    EXPECT_FALSE(result.eof.IsError()) << result.eof.GetError().message;
+    if (result.eof.IsError() || result.eof.get()) return -1;
+    return result.values[0]->get<int64_t>();
+  }
+};
+
+std::vector<int64_t> Range(int64_t n) {
+  std::vector<int64_t> values(n);
+  std::iota(values.begin(), values.end(), 0);
+  return values;
+}
+
+TEST_F(PrefetchingIteratorTest, KeepsOrder) {
+  for (auto access :
+       {PrefetchBufferAccess::kLockFree, PrefetchBufferAccess::kLocked}) {
+    for (int64_t max_prefetch_num : {1, 3, 16}) {
+      auto iterator = MakeIterator(1000, max_prefetch_num, access);
+      std::vector<int64_t> values;
+      for (int64_t value; (value = GetNext(iterator.get())) >= 0;)
+        values.push_back(value);
+      EXPECT_EQ(values, Range(1000))
+          << "max_prefetch_num=" << max_prefetch_num
+          << " locked=" << (access == PrefetchBufferAccess::kLocked);
+      EXPECT_EQ(GetNext(iterator.get()), -1);
+    }
+  }
+}
+
+TEST_F(PrefetchingIteratorTest, ConsumerCanMoveBetweenThreads) {
+  auto iterator = MakeIterator(1000, 8);
+  std::vector<int64_t> values;
+  // The calls are not concurrent, since each thread is joined before the next
+  // one starts.
+  for (int i = 0; i < 10; ++i) {
+    std::thread([&] {
+      for (int j = 0; j < 100; ++j) values.push_back(GetNext(iterator.get()));
+    }).join();
+  }
+  EXPECT_EQ(values, Range(1000));
+}
+
+}  // namespace
+}  // namespace io
+}  // namespace data
+}  // namespace tfrt
@@ -0,0 +1,109 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Unit test for IteratorStats.
+
+#include "../../lib/data/iterator_stats.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "../../lib/data/map_dataset.h"
+#include "../../lib/data/repeat_dataset.h"
+#include "gtest/gtest.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+#include "tfrt/cpp_tests/data_test_util.h"
+#include "tfrt/data/dataset.h"
+#include "tfrt/host_context/async_value_ref.h"
+#include "tfrt/host_context/execution_context.h"
+#include "tfrt/host_context/host_context.h"
+#include "tfrt/host_context/kernel_registry.h"
+#include "tfrt/support/forward_decls.h"
+#include "tfrt/support/rc_array.h"
+#include "tfrt/tensor/dense_host_tensor.h"
+
+namespace tfrt {
+namespace data {
+namespace {
+
+class IteratorStatsTest : public DatasetTest {
+ protected:
+  // Returns the printed statistics split into lines.
+  llvm::SmallVector<std::string, 4> PrintLines(const IteratorStats& stats) {
+    std::string str;
+    llvm::raw_string_ostream os(str);
+    stats.Print(os);
+    llvm::SmallVector<llvm::StringRef, 4> lines;
+    llvm::StringRef(os.str()).split(lines, '\n', /*MaxSplit=*/-1,
+                                    /*KeepEmpty=*/false);
+    return llvm::SmallVector<std::string, 4>(lines.begin(), lines.end());
+  }
+};
+
+TEST_F(IteratorStatsTest, CountsElementsAndBytesOfAsyncStages) {
+  TestInputDataset::Options options;
+  options.tensors = true;
+  auto input = TakeRef(host_.Construct<TestInputDataset>(4, options, &host_));
+  const auto& registry = host_.GetKernelRegistry();
+  auto* scale = MakeFunction("async_scale", registry.GetType("!t.tensor"),
+                             registry.GetType("!t.tensor"), AsyncScale);
+  auto map = TakeRef(host_.Construct<MapDataset>(
+      std::move(input), RCArray<AsyncValue>(ArrayRef<AsyncValue*>()),
+      FormRef(scale), &host_));
+  auto repeat =
+      TakeRef(host_.Construct<RepeatDataset>(std::move(map), 2, &host_));
+
+  IteratorContext context;
+  context.stats = std::make_shared<IteratorStats>("iterator");
+  context.host = &host_;
+  auto iterator = repeat->MakeIterator(context);
+
+  int64_t sum = 0;
+  for (;;) {
+    auto result = iterator->GetNext(exec_ctx_);
+    host_.Await({result.values[0], result.eof.CopyRCRef()});
+    ASSERT_FALSE(result.eof.IsError());
+    if (result.eof.get()) break;
+    sum += *result.values[0]->get<DenseHostTensor>().data<int64_t>();
+  }
+  EXPECT_EQ(sum, 2 * (0 + 10 + 20 + 30));
+  host_.Quiesce();
+
+  // The values of map and repeat are IndirectAsyncValues, whose tensor bytes
+  // are counted once they are forwarded. Each of the 8 elements is a scalar
+  // i64 tensor of 8 bytes.
+  auto lines = PrintLines(*context.stats);
+  ASSERT_EQ(lines.size(), 4);
+  EXPECT_TRUE(llvm::StringRef(lines[0]).startswith(
+      "iterator: elements=0 bytes=0 input_latency_ms="))
+      << lines[0];
+  EXPECT_TRUE(llvm::StringRef(lines[0]).endswith(" input_requests=9"))
+      << lines[0];
+  EXPECT_TRUE(
+      llvm::StringRef(lines[1]).startswith("  repeat: elements=8 bytes=64 "))
+      << lines[1];
+  EXPECT_TRUE(
+      llvm::StringRef(lines[2]).startswith("    map: elements=8 bytes=64 "))
+      << lines[2];
+  EXPECT_EQ(lines[3], "      test_input: elements=8 bytes=64");
+}
+
+}  // namespace
+}  // namespace data
+}  // namespace tfrt
@@ -0,0 +1,241 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Unit test for MapAndBatchDataset.
+
+#include "../../lib/data/map_and_batch_dataset.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "../../lib/data/range_dataset.h"
+#include "gtest/gtest.h"
+#include "tfrt/cpp_tests/data_test_util.h"
+#include "tfrt/data/dataset.h"
+#include "tfrt/dtype/dtype.h"
+#include "tfrt/host_context/async_dispatch.h"
+#include "tfrt/host_context/async_value_ref.h"
+#include "tfrt/host_context/execution_context.h"
+#include "tfrt/host_context/host_context.h"
+#include "tfrt/host_context/native_function.h"
+#include "tfrt/support/forward_decls.h"
+#include "tfrt/support/rc_array.h"
+#include "tfrt/tensor/dense_host_tensor.h"
+#include "tfrt/tensor/tensor_metadata.h"
+
+namespace tfrt {
+namespace data {
+namespace {
+
+// The map functions below take an i64 element and, if their name says so, the
+// slice of the batch for it. Like BEF functions, they propagate an error
+// input.
+bool PropagateError(AsyncValue* const* arguments,
+                    RCReference<AsyncValue>* results) {
+  if (!arguments[0]->IsError()) return false;
+  results[0] = FormRef(arguments[0]);
+  return true;
+}
+
+// Writes twice the element into its slice and returns the slice.
+void DoubleIntoSlice(AsyncValue* const* arguments, int num_arguments,
+                     RCReference<AsyncValue>* results, int num_results,
+                     HostContext* host) {
+  if (PropagateError(arguments, results)) return;
+  auto& slice = arguments[1]->get<DenseHostTensor>();
+  *slice.data<int64_t>() = 2 * arguments[0]->get<int64_t>();
+  results[0] = FormRef(arguments[1]);
+}
+
+// Returns a new tensor with three times the element, which is copied into
+// the slice.
+void TripleIntoNewTensor(AsyncValue* const* arguments, int num_arguments,
+                         RCReference<AsyncValue>* results, int num_results,
+                         HostContext* host) {
+  if (PropagateError(arguments, results)) return;
+  results[0] = MakeAvailableAsyncValueRef<DenseHostTensor>(
+      host, *DenseHostTensor::CreateScalar<int64_t>(
+                3 * arguments[0]->get<int64_t>(), host));
+}
+
+// Like DoubleIntoSlice, but writes the slice in a task and returns an
+// IndirectAsyncValue which is forwarded to the slice afterwards, like a BEF
+// function completing asynchronously.
+void AsyncDoubleIntoSlice(AsyncValue* const* arguments, int num_arguments,
+                          RCReference<AsyncValue>* results, int num_results,
+                          HostContext* host) {
+  if (PropagateError(arguments, results)) return;
+  auto result = MakeIndirectAsyncValue();
+  results[0] = result;
+  EnqueueWork(host, [element = FormRef(arguments[0]),
+                     slice = FormRef(arguments[1]),
+                     result = std::move(result)]() mutable {
+    *slice->get<DenseHostTensor>().data<int64_t>() =
+        2 * element->get<int64_t>();
+    result->ForwardTo(std::move(slice));
+  });
+}
+
+// Like TripleIntoNewTensor, but returns an IndirectAsyncValue which is
+// forwarded to the new tensor in a task.
+void AsyncTripleIntoNewTensor(AsyncValue* const* arguments, int num_arguments,
+                              RCReference<AsyncValue>* results,
+                              int num_results, HostContext* host) {
+  if (PropagateError(arguments, results)) return;
+  auto result = MakeIndirectAsyncValue();
+  results[0] = result;
+  EnqueueWork(host, [element = FormRef(arguments[0]),
+                     result = std::move(result), host]() mutable {
+    result->ForwardTo(MakeAvailableAsyncValueRef<DenseHostTensor>(
+        host, *DenseHostTensor::CreateScalar<int64_t>(
+                  3 * element->get<int64_t>(), host)));
+  });
+}
+
+// Returns a tensor of shape [2] rather than a scalar.
+void ReturnWrongShape(AsyncValue* const* arguments, int num_arguments,
+                      RCReference<AsyncValue>* results, int num_results,
+                      HostContext* host) {
+  if (PropagateError(arguments, results)) return;
+  results[0] = MakeAvailableAsyncValueRef<DenseHostTensor>(
+      host, *DenseHostTensor::CreateUninitialized(
+                TensorMetadata(DType(DType::I64), {2}), host));
+}
+
+// Returns the element rather than a tensor.
+void ReturnElement(AsyncValue* const* arguments, int num_arguments,
+                   RCReference<AsyncValue>* results, int num_results,
+                   HostContext* host) {
+  results[0] = FormRef(arguments[0]);
+}
+
+class MapAndBatchDatasetTest : public DatasetTest {
+ protected:
+
+  // Returns an iterator over batches of `map_fn` applied to the integers
+  // [0, num_elements). `map_fn` takes the slice of the batch if
+  // `takes_slice` is true.
+  RCReference<Iterator> MakeIterator(NativeCallable map_fn,
+                                     int64_t num_elements, int64_t batch_size,
+                                     bool takes_slice) {
+    const auto& registry = host_.GetKernelRegistry();
+    std::vector<TypeName> argument_types = {registry.GetType("i64")};
+    if (takes_slice) argument_types.push_back(registry.GetType("!t.tensor"));
+    auto* function = MakeFunction("map_fn", argument_types,
+                                  registry.GetType("!t.tensor"), map_fn);
+    auto input = TakeRef(host_.Construct<RangeDataset>(
+        0, num_elements, 1, DType(DType::I64), &host_));
+    auto dataset = TakeRef(host_.Construct<MapAndBatchDataset>(
+        std::move(input), batch_size,
+        RCArray<AsyncValue>(ArrayRef<AsyncValue*>()), FormRef(function),
+        TensorMetadata(DType(DType::I64), {}), &host_));
+    return dataset->MakeIterator(IteratorContext());
+  }
+
+  // Waits for the next batch of `iterator`.
+  IterationResult GetNext(Iterator* iterator) {
+    auto result = iterator->GetNext(exec_ctx_);
+    host_.Await({result.values[0], result.eof.CopyRCRef()});
+    return result;
+  }
+
+  // Returns the values of `batch`, which must be a 1-D i64 tensor.
+  std::vector<int64_t> GetValues(const IterationResult& batch) {
+    EXPECT_FALSE(batch.eof.IsError()) << batch.eof.GetError().message;
+    EXPECT_FALSE(batch.eof.get());
+    EXPECT_FALSE(batch.values[0]->IsError())
+        << batch.values[0]->GetError().message;
+    auto& tensor = batch.values[0]->get<DenseHostTensor>();
+    EXPECT_EQ(tensor.shape().GetRank(), 1);
+    auto* data = tensor.data<int64_t>();
+    return std::vector<int64_t>(data, data + tensor.NumElements());
+  }
+};
+
+TEST_F(MapAndBatchDatasetTest, WritesIntoSlices) {
+  auto iterator =
+      MakeIterator(DoubleIntoSlice, /*num_elements=*/6, /*batch_size=*/3,
+                   /*takes_slice=*/true);
+  EXPECT_EQ(GetValues(GetNext(iterator.get())),
+            std::vector<int64_t>({0, 2, 4}));
+  EXPECT_EQ(GetValues(GetNext(iterator.get())),
+            std::vector<int64_t>({6, 8, 10}));
+  auto eof = GetNext(iterator.get());
+  ASSERT_FALSE(eof.eof.IsError());
+  EXPECT_TRUE(eof.eof.get());
+}
+
+TEST_F(MapAndBatchDatasetTest, CopiesNewTensorIntoSlice) {
+  auto iterator =
+      MakeIterator(TripleIntoNewTensor, /*num_elements=*/4, /*batch_size=*/4,
+                   /*takes_slice=*/false);
+  EXPECT_EQ(GetValues(GetNext(iterator.get())),
+            std::vector<int64_t>({0, 3, 6, 9}));
+}
+
+TEST_F(MapAndBatchDatasetTest, AsyncFunctionWritesIntoSlices) {
+  auto iterator =
+      MakeIterator(AsyncDoubleIntoSlice, /*num_elements=*/6, /*batch_size=*/3,
+                   /*takes_slice=*/true);
+  EXPECT_EQ(GetValues(GetNext(iterator.get())),
+            std::vector<int64_t>({0, 2, 4}));
+  EXPECT_EQ(GetValues(GetNext(iterator.get())),
+            std::vector<int64_t>({6, 8, 10}));
+}
+
+TEST_F(MapAndBatchDatasetTest, CopiesAsyncResultIntoSlice) {
+  auto iterator =
+      MakeIterator(AsyncTripleIntoNewTensor, /*num_elements=*/4,
+                   /*batch_size=*/4, /*takes_slice=*/false);
+  EXPECT_EQ(GetValues(GetNext(iterator.get())),
+            std::vector<int64_t>({0, 3, 6, 9}));
+}
+
+TEST_F(MapAndBatchDatasetTest, TruncatesPartialFinalBatch) {
+  auto iterator =
+      MakeIterator(DoubleIntoSlice, /*num_elements=*/5, /*batch_size=*/3,
+                   /*takes_slice=*/true);
+  EXPECT_EQ(GetValues(GetNext(iterator.get())),
+            std::vector<int64_t>({0, 2, 4}));
+  EXPECT_EQ(GetValues(GetNext(iterator.get())), std::vector<int64_t>({6, 8}));
+  auto eof = GetNext(iterator.get());
+  ASSERT_FALSE(eof.eof.IsError());
+  EXPECT_TRUE(eof.eof.get());
+}
+
+TEST_F(MapAndBatchDatasetTest, MetadataMismatchIsError) {
+  auto iterator =
+      MakeIterator(ReturnWrongShape, /*num_elements=*/4, /*batch_size=*/2,
+                   /*takes_slice=*/false);
+  auto batch = GetNext(iterator.get());
+  ASSERT_TRUE(batch.values[0]->IsError());
+  EXPECT_EQ(batch.values[0]->GetError().message,
+            "map function returned i64 [2], expected i64 []");
+}
+
+TEST_F(MapAndBatchDatasetTest, NonTensorResultIsError) {
+  auto iterator =
+      MakeIterator(ReturnElement, /*num_elements=*/4, /*batch_size=*/2,
+                   /*takes_slice=*/false);
+  auto batch = GetNext(iterator.get());
+  ASSERT_TRUE(batch.values[0]->IsError());
+  EXPECT_EQ(batch.values[0]->GetError().message,
+            "map function must return a DenseHostTensor or a chain");
+}
+
+}  // namespace
+}  // namespace data
+}  // namespace tfrt
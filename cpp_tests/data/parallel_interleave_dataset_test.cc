@@ -0,0 +1,124 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Unit test for ParallelInterleaveDataset.
+
+#include "../../lib/data/parallel_interleave_dataset.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "../../lib/data/range_dataset.h"
+#include "gtest/gtest.h"
+#include "tfrt/cpp_tests/data_test_util.h"
+#include "tfrt/data/dataset.h"
+#include "tfrt/host_context/async_value_ref.h"
+#include "tfrt/host_context/execution_context.h"
+#include "tfrt/host_context/host_context.h"
+#include "tfrt/host_context/native_function.h"
+#include "tfrt/support/forward_decls.h"
+
+namespace tfrt {
+namespace data {
+namespace {
+
+// Returns the dataset of the integers [10 * k, 10 * k + 3) for input k. Like
+// BEF functions, it propagates an error input, e.g. at the end of the input.
+void MakeIntermediateDataset(AsyncValue* const* arguments, int num_arguments,
+                             RCReference<AsyncValue>* results, int num_results,
+                             HostContext* host) {
+  if (arguments[0]->IsError()) {
+    results[0] = FormRef(arguments[0]);
+    return;
+  }
+  int64_t k = arguments[0]->get<int64_t>();
+  results[0] = MakeAvailableAsyncValueRef<RCReference<Dataset>>(
+      host, TakeRef(host->Construct<RangeDataset>(10 * k, 10 * k + 3, 1,
+                                                  DType(DType::I64), host)));
+}
+
+class ParallelInterleaveDatasetTest : public DatasetTest {
+ protected:
+  ParallelInterleaveDatasetTest()
+      : func_(MakeFunction("make_intermediate_dataset", {}, {},
+                           MakeIntermediateDataset)) {}
+
+  // Returns the values of a parallel interleave dataset over the inputs
+  // [0, num_inputs).
+  std::vector<int64_t> Interleave(int64_t num_inputs, int64_t cycle_length,
+                                  int64_t block_length, bool sloppy = false) {
+    auto input = TakeRef(host_.Construct<RangeDataset>(
+        0, num_inputs, 1, DType(DType::I64), &host_));
+    auto dataset = TakeRef(host_.Construct<ParallelInterleaveDataset>(
+        std::move(input), cycle_length, block_length, FormRef(func_),
+        /*arity=*/1, sloppy, /*buffer_output_elements=*/2,
+        /*prefetch_input_elements=*/1, &host_));
+    auto iterator = dataset->MakeIterator(IteratorContext());
+
+    std::vector<int64_t> values;
+    while (true) {
+      auto result = iterator->GetNext(exec_ctx_);
+      host_.Await({result.values[0], result.eof.CopyRCRef()});
+      EXPECT_FALSE(result.eof.IsError()) << result.eof.GetError().message;
+      if (result.eof.IsError() || result.eof.get()) break;
+      values.push_back(result.values[0]->get<int64_t>());
+    }
+    return values;
+  }
+
+  NativeFunction* func_;
+};
+
+TEST_F(ParallelInterleaveDatasetTest, InterleavesBlocksInCycleOrder) {
+  EXPECT_EQ(Interleave(/*num_inputs=*/4, /*cycle_length=*/2,
+                       /*block_length=*/1),
+            std::vector<int64_t>(
+                {0, 10, 1, 11, 2, 12, 20, 30, 21, 31, 22, 32}));
+  EXPECT_EQ(Interleave(/*num_inputs=*/4, /*cycle_length=*/2,
+                       /*block_length=*/2),
+            std::vector<int64_t>(
+                {0, 1, 10, 11, 2, 12, 20, 21, 30, 31, 22, 32}));
+}
+
+TEST_F(ParallelInterleaveDatasetTest, CycleLongerThanInput) {
+  EXPECT_EQ(Interleave(/*num_inputs=*/2, /*cycle_length=*/4,
+                       /*block_length=*/1),
+            std::vector<int64_t>({0, 10, 1, 11, 2, 12}));
+}
+
+TEST_F(ParallelInterleaveDatasetTest, AutotuneBlockLengthIsOne) {
+  EXPECT_EQ(Interleave(/*num_inputs=*/2, /*cycle_length=*/2, kAutotune),
+            std::vector<int64_t>({0, 10, 1, 11, 2, 12}));
+}
+
+TEST_F(ParallelInterleaveDatasetTest, SloppyReturnsAllElements) {
+  auto values = Interleave(/*num_inputs=*/5, /*cycle_length=*/3,
+                           /*block_length=*/2, /*sloppy=*/true);
+  std::sort(values.begin(), values.end());
+  EXPECT_EQ(values, std::vector<int64_t>({0, 1, 2, 10, 11, 12, 20, 21, 22, 30,
+                                          31, 32, 40, 41, 42}));
+}
+
+TEST_F(ParallelInterleaveDatasetTest, EmptyInput) {
+  EXPECT_TRUE(Interleave(/*num_inputs=*/0, /*cycle_length=*/2,
+                         /*block_length=*/1)
+                  .empty());
+}
+
+}  // namespace
+}  // namespace data
+}  // namespace tfrt
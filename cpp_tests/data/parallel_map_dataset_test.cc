@@ -0,0 +1,179 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Unit test for ParallelMapDataset.
+
+#include "../../lib/data/parallel_map_dataset.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "tfrt/cpp_tests/data_test_util.h"
+#include "tfrt/data/dataset.h"
+#include "tfrt/host_context/async_value_ref.h"
+#include "tfrt/host_context/concurrent_work_queue.h"
+#include "tfrt/host_context/execution_context.h"
+#include "tfrt/host_context/host_context.h"
+#include "tfrt/host_context/kernel_registry.h"
+#include "tfrt/host_context/native_function.h"
+#include "tfrt/support/forward_decls.h"
+#include "tfrt/support/rc_array.h"
+
+namespace tfrt {
+namespace data {
+namespace {
+
+void Double(AsyncValue* const* arguments, int num_arguments,
+            RCReference<AsyncValue>* results, int num_results,
+            HostContext* host) {
+  int64_t value = arguments[0]->get<int64_t>();
+  results[0] = MakeAvailableAsyncValueRef<int64_t>(host, 2 * value);
+}
+
+class ParallelMapDatasetTest : public DatasetTest {
+ protected:
+  explicit ParallelMapDatasetTest(
+      std::unique_ptr<ConcurrentWorkQueue> work_queue =
+          CreateSingleThreadedWorkQueue())
+      : DatasetTest(std::move(work_queue)),
+        double_(MakeFunction("double", {},
+                             {host_.GetKernelRegistry().GetType("i64")},
+                             Double)) {}
+
+  RCReference<TestInputDataset> MakeInput(int64_t num_elements,
+                                          int64_t slow_index = -1,
+                                          bool async_eof = false) {
+    TestInputDataset::Options options;
+    options.slow_index = slow_index;
+    options.async_eof = async_eof;
+    return TakeRef(
+        host_.Construct<TestInputDataset>(num_elements, options, &host_));
+  }
+
+  RCReference<Iterator> MakeParallelMapIterator(RCReference<Dataset> input,
+                                                int64_t num_parallel_calls,
+                                                bool is_deterministic) {
+    auto dataset = TakeRef(host_.Construct<ParallelMapDataset>(
+        std::move(input), RCArray<AsyncValue>(ArrayRef<AsyncValue*>()),
+        FormRef(double_), num_parallel_calls, is_deterministic, &host_));
+    return dataset->MakeIterator(IteratorContext());
+  }
+
+  // Waits for `result` and returns its value, or -1 at the end of iteration.
+  int64_t Await(const IterationResult& result) {
+    host_.Await({result.values[0], result.eof.CopyRCRef()});
+    EXPECT_FALSE(result.eof.IsError()) << result.eof.GetError().message;
+    if (result.eof.IsError() || result.eof.get()) return -1;
+    return result.values[0]->get<int64_t>();
+  }
+
+  // Returns the values of `iterator` until the end of iteration.
+  std::vector<int64_t> GetAll(Iterator* iterator) {
+    std::vector<int64_t> values;
+    for (int64_t value; (value = Await(iterator->GetNext(exec_ctx_))) >= 0;)
+      values.push_back(value);
+    return values;
+  }
+
+  NativeFunction* double_;
+};
+
+class MultiThreadedParallelMapDatasetTest : public ParallelMapDatasetTest {
+ protected:
+  MultiThreadedParallelMapDatasetTest()
+      : ParallelMapDatasetTest(CreateMultiThreadedWorkQueue(4, 4)) {}
+};
+
+std::vector<int64_t> Doubled(int64_t n) {
+  std::vector<int64_t> values;
+  for (int64_t i = 0; i < n; ++i) values.push_back(2 * i);
+  return values;
+}
+
+TEST_F(MultiThreadedParallelMapDatasetTest, KeepsOrder) {
+  for (int64_t num_parallel_calls : {1, 4, 16}) {
+    auto iterator = MakeParallelMapIterator(
+        MakeInput(100), num_parallel_calls, /*is_deterministic=*/true);
+    EXPECT_EQ(GetAll(iterator.get()), Doubled(100))
+        << "num_parallel_calls=" << num_parallel_calls;
+  }
+}
+
+TEST_F(MultiThreadedParallelMapDatasetTest, NonDeterministicReturnsAll) {
+  auto iterator = MakeParallelMapIterator(MakeInput(100), 8,
+                                          /*is_deterministic=*/false);
+  auto values = GetAll(iterator.get());
+  std::sort(values.begin(), values.end());
+  EXPECT_EQ(values, Doubled(100));
+}
+
+TEST_F(ParallelMapDatasetTest, DeterministicWaitsForSlowCall) {
+  auto input = MakeInput(10, /*slow_index=*/1);
+  auto iterator =
+      MakeParallelMapIterator(input.CopyRef(), 4, /*is_deterministic=*/true);
+  EXPECT_EQ(Await(iterator->GetNext(exec_ctx_)), 0);
+
+  auto second = iterator->GetNext(exec_ctx_);
+  host_.Quiesce();
+  EXPECT_FALSE(second.values[0]->IsAvailable());
+
+  input->ResolveSlowElement();
+  EXPECT_EQ(Await(second), 2);
+  EXPECT_EQ(GetAll(iterator.get()),
+            std::vector<int64_t>({4, 6, 8, 10, 12, 14, 16, 18}));
+}
+
+TEST_F(ParallelMapDatasetTest, NonDeterministicSkipsSlowCall) {
+  auto input = MakeInput(10, /*slow_index=*/1);
+  auto iterator =
+      MakeParallelMapIterator(input.CopyRef(), 4, /*is_deterministic=*/false);
+  EXPECT_EQ(Await(iterator->GetNext(exec_ctx_)), 0);
+  host_.Quiesce();
+
+  // The call for element 1 waits for its input, while the calls of the next
+  // elements have completed.
+  EXPECT_EQ(Await(iterator->GetNext(exec_ctx_)), 4);
+  EXPECT_EQ(Await(iterator->GetNext(exec_ctx_)), 6);
+
+  input->ResolveSlowElement();
+  auto values = GetAll(iterator.get());
+  std::sort(values.begin(), values.end());
+  EXPECT_EQ(values, std::vector<int64_t>({2, 8, 10, 12, 14, 16, 18}));
+}
+
+TEST_F(ParallelMapDatasetTest, StopsRequestingInputAtPendingEof) {
+  auto input = MakeInput(3, /*slow_index=*/-1, /*async_eof=*/true);
+  auto iterator =
+      MakeParallelMapIterator(input.CopyRef(), 4, /*is_deterministic=*/true);
+  // The calls for the three elements and for the end of iteration are
+  // started before any eof is available.
+  auto first = iterator->GetNext(exec_ctx_);
+  host_.Quiesce();
+  EXPECT_EQ(input->num_requests(), 4);
+
+  EXPECT_EQ(Await(first), 0);
+  EXPECT_EQ(GetAll(iterator.get()), std::vector<int64_t>({2, 4}));
+  for (int i = 0; i < 8; ++i) {
+    EXPECT_EQ(Await(iterator->GetNext(exec_ctx_)), -1);
+  }
+  EXPECT_EQ(input->num_requests(), 4);
+}
+
+}  // namespace
+}  // namespace data
+}  // namespace tfrt
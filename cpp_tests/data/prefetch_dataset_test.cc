@@ -0,0 +1,219 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Unit test for PrefetchDataset.
+
+#include "../../lib/data/prefetch_dataset.h"
+
+#include <atomic>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "tfrt/cpp_tests/data_test_util.h"
+#include "tfrt/data/dataset.h"
+#include "tfrt/host_context/async_dispatch.h"
+#include "tfrt/host_context/async_value_ref.h"
+#include "tfrt/host_context/concurrent_work_queue.h"
+#include "tfrt/host_context/execution_context.h"
+#include "tfrt/host_context/host_context.h"
+#include "tfrt/support/forward_decls.h"
+
+namespace tfrt {
+namespace data {
+namespace {
+
+// Yields the integers in [0, num_elements). The value of each element is
+// resolved when the next element is requested, so that the consumer of an
+// element runs synchronously inside GetNext() of this dataset's iterator.
+class DelayedRangeDataset : public Dataset {
+ public:
+  DelayedRangeDataset(int32_t num_elements, HostContext* host)
+      : num_elements_(num_elements), host_(host) {}
+
+  string_view name() const override { return "delayed_range"; }
+
+  RCReference<Iterator> MakeIteratorInternal(
+      const IteratorContext& context) override;
+
+  // The number of GetNext() calls on the iterators of this dataset.
+  int num_requests() const { return num_requests_.load(); }
+
+ private:
+  friend class DelayedRangeIterator;
+
+  void Destroy() override {
+    internal::DestroyImpl<DelayedRangeDataset>(this, host_->allocator());
+  }
+
+  const int32_t num_elements_;
+  HostContext* host_;
+  std::atomic<int> num_requests_{0};
+};
+
+class DelayedRangeIterator : public Iterator {
+ public:
+  explicit DelayedRangeIterator(RCReference<DelayedRangeDataset> dataset)
+      : dataset_(std::move(dataset)) {}
+
+  IterationResult GetNext(const ExecutionContext& exec_ctx) override {
+    ++dataset_->num_requests_;
+    auto* host = exec_ctx.host();
+    auto previous = std::move(pending_);
+    int32_t previous_value = next_ - 1;
+    auto result = IterationResult::Eof(host, 1);
+    if (next_ < dataset_->num_elements_) {
+      pending_ = MakeUnconstructedAsyncValueRef<int32_t>(host);
+      result = IterationResult::Values({pending_.CopyRCRef()}, host);
+      ++next_;
+    }
+    if (previous) previous.emplace(previous_value);
+    return result;
+  }
+
+ private:
+  void Destroy() override {
+    internal::DestroyImpl<DelayedRangeIterator>(this,
+                                                dataset_->host_->allocator());
+  }
+
+  RCReference<DelayedRangeDataset> dataset_;
+  int32_t next_ = 0;
+  // The value of the last element, which is resolved by the next call.
+  AsyncValueRef<int32_t> pending_;
+};
+
+RCReference<Iterator> DelayedRangeDataset::MakeIteratorInternal(
+    const IteratorContext& context) {
+  return TakeRef(host_->Construct<DelayedRangeIterator>(FormRef(this)));
+}
+
+// Requests the next element of `iterator` and, once it is available, the
+// element after it, until the end of iteration. The values are appended to
+// `values`.
+void GetNextInContinuation(RCReference<Iterator> iterator,
+                           const ExecutionContext& exec_ctx,
+                           std::vector<int32_t>* values) {
+  auto result = iterator->GetNext(exec_ctx);
+  auto async_values = result.AsyncValues();
+  RunWhenReady(async_values, [iterator = std::move(iterator), exec_ctx, values,
+                              result = std::move(result)]() mutable {
+    if (result.eof.IsError() || result.eof.get()) return;
+    values->push_back(result.values[0]->get<int32_t>());
+    GetNextInContinuation(std::move(iterator), exec_ctx, values);
+  });
+}
+
+class PrefetchDatasetTest : public DatasetTest {
+ protected:
+  explicit PrefetchDatasetTest(
+      std::unique_ptr<ConcurrentWorkQueue> work_queue =
+          CreateSingleThreadedWorkQueue())
+      : DatasetTest(std::move(work_queue)) {}
+
+  RCReference<DelayedRangeDataset> MakeInput(int32_t num_elements) {
+    return TakeRef(
+        host_.Construct<DelayedRangeDataset>(num_elements, &host_));
+  }
+
+  RCReference<Iterator> MakePrefetchIterator(RCReference<Dataset> input,
+                                             int64_t prefetch_num) {
+    auto dataset = TakeRef(host_.Construct<PrefetchDataset>(
+        std::move(input), prefetch_num, /*is_deterministic=*/true, &host_));
+    return dataset->MakeIterator(IteratorContext());
+  }
+};
+
+class MultiThreadedPrefetchDatasetTest : public PrefetchDatasetTest {
+ protected:
+  MultiThreadedPrefetchDatasetTest()
+      : PrefetchDatasetTest(CreateMultiThreadedWorkQueue(4, 4)) {}
+};
+
+std::vector<int32_t> Range(int32_t n) {
+  std::vector<int32_t> values(n);
+  std::iota(values.begin(), values.end(), 0);
+  return values;
+}
+
+TEST_F(PrefetchDatasetTest, KeepsOrderWhenInputResolvesSynchronously) {
+  for (int64_t prefetch_num : {1, 2, 8}) {
+    std::vector<int32_t> values;
+    GetNextInContinuation(MakePrefetchIterator(MakeInput(100), prefetch_num),
+                          exec_ctx_, &values);
+    host_.Quiesce();
+    EXPECT_EQ(values, Range(100)) << "prefetch_num=" << prefetch_num;
+  }
+}
+
+TEST_F(MultiThreadedPrefetchDatasetTest,
+       KeepsOrderWhenInputResolvesSynchronously) {
+  std::vector<int32_t> values;
+  GetNextInContinuation(MakePrefetchIterator(MakeInput(1000), 4), exec_ctx_,
+                        &values);
+  host_.Quiesce();
+  EXPECT_EQ(values, Range(1000));
+}
+
+TEST_F(PrefetchDatasetTest, BuffersUpToPrefetchNum) {
+  auto input = MakeInput(100);
+  auto iterator = MakePrefetchIterator(input.CopyRef(), 3);
+  auto first = iterator->GetNext(exec_ctx_);
+  host_.Quiesce();
+  // One element for the caller and three in the buffer.
+  EXPECT_EQ(input->num_requests(), 4);
+
+  auto second = iterator->GetNext(exec_ctx_);
+  host_.Quiesce();
+  EXPECT_EQ(input->num_requests(), 5);
+}
+
+TEST_F(PrefetchDatasetTest, StopsAtEndOfInput) {
+  auto input = MakeInput(2);
+  auto iterator = MakePrefetchIterator(input.CopyRef(), 8);
+  auto first = iterator->GetNext(exec_ctx_);
+  host_.Quiesce();
+  // The third request returns the end of iteration.
+  EXPECT_EQ(input->num_requests(), 3);
+}
+
+TEST_F(PrefetchDatasetTest, DestroyingIteratorResolvesPendingElements) {
+  auto input = MakeInput(100);
+  auto iterator = MakePrefetchIterator(input.CopyRef(), 2);
+  auto first = iterator->GetNext(exec_ctx_);
+
+  // The producer task resolves the first element while it requests the
+  // second one. The consumer then requests the next element, which the task
+  // has not returned yet, and destroys the iterator.
+  Optional<IterationResult> next;
+  first.values[0]->AndThen([&, iterator = std::move(iterator)]() mutable {
+    next = iterator->GetNext(exec_ctx_);
+    iterator.reset();
+  });
+  host_.Quiesce();
+
+  ASSERT_TRUE(next.hasValue());
+  ASSERT_TRUE(next->eof.IsError());
+  EXPECT_EQ(next->eof.GetError().message, "prefetch iterator was destroyed");
+  ASSERT_TRUE(next->values[0]->IsError());
+  // The task stops after the element it was requesting.
+  EXPECT_EQ(input->num_requests(), 2);
+}
+
+}  // namespace
+}  // namespace data
+}  // namespace tfrt
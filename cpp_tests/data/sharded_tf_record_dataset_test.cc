@@ -0,0 +1,172 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Unit test for ShardedTFRecordDataset.
+
+#include "../../lib/data/sharded_tf_record_dataset.h"
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "tfrt/cpp_tests/data_test_util.h"
+#include "tfrt/cpp_tests/tf_record_test_util.h"
+#include "tfrt/data/dataset.h"
+#include "tfrt/host_context/async_value_ref.h"
+#include "tfrt/host_context/execution_context.h"
+#include "tfrt/host_context/host_context.h"
+#include "tfrt/support/forward_decls.h"
+#include "tfrt/support/string_util.h"
+
+namespace tfrt {
+namespace data {
+namespace {
+
+class ShardedTFRecordDatasetTest : public DatasetTest {
+ protected:
+  void SetUp() override {
+    ASSERT_FALSE(llvm::sys::fs::createUniqueDirectory(
+        "sharded_tf_record_dataset_test", root_));
+  }
+
+  void TearDown() override { llvm::sys::fs::remove_directories(root_); }
+
+  std::string Path(string_view name) { return StrCat(root_, "/", name); }
+
+  // Writes records with the given payloads to the file `name` in the test
+  // directory.
+  void WriteFile(string_view name, const std::vector<std::string>& payloads) {
+    std::ofstream file(Path(name), std::ios::binary);
+    for (const auto& payload : payloads) file << MakeRecord(payload);
+  }
+
+  RCReference<Iterator> MakeIterator(std::vector<std::string> patterns,
+                                     int64_t num_parallel_reads,
+                                     int64_t num_shards = 1,
+                                     int64_t shard_index = 0) {
+    auto dataset = TakeRef(host_.Construct<ShardedTFRecordDataset>(
+        std::move(patterns), num_shards, shard_index, num_parallel_reads,
+        /*buffer_size=*/1024, /*max_prefetch_num=*/4,
+        /*prefetch_threshold=*/2, /*compression=*/llvm::None, &host_));
+    return dataset->MakeIterator(IteratorContext());
+  }
+
+  // Waits for `result` and returns its record, "eof" at the end of iteration
+  // or "error: <message>".
+  std::string Await(const IterationResult& result) {
+    host_.Await({result.values[0], result.eof.CopyRCRef()});
+    if (result.eof.IsError())
+      return StrCat("error: ", result.eof.GetError().message);
+    if (result.eof.get()) return "eof";
+    return result.values[0]->get<std::string>();
+  }
+
+  // Returns the records of `iterator` until the end of iteration or the first
+  // error, which is returned as "error: <message>".
+  std::vector<std::string> GetAll(Iterator* iterator) {
+    std::vector<std::string> records;
+    while (true) {
+      auto record = Await(iterator->GetNext(exec_ctx_));
+      if (record == "eof") return records;
+      records.push_back(record);
+      if (record.rfind("error: ", 0) == 0) return records;
+    }
+  }
+  llvm::SmallString<128> root_;
+};
+
+TEST_F(ShardedTFRecordDatasetTest, OutputsRecordsInRoundRobinOrder) {
+  WriteFile("a", {"a0", "a1", "a2"});
+  WriteFile("b", {"b0", "b1"});
+  WriteFile("c", {"c0"});
+  EXPECT_EQ(GetAll(MakeIterator({Path("*")}, /*num_parallel_reads=*/3).get()),
+            std::vector<std::string>({"a0", "b0", "c0", "a1", "b1", "a2"}));
+  // With one file at a time, the files are read one after another.
+  EXPECT_EQ(GetAll(MakeIterator({Path("*")}, /*num_parallel_reads=*/1).get()),
+            std::vector<std::string>({"a0", "a1", "a2", "b0", "b1", "c0"}));
+}
+
+TEST_F(ShardedTFRecordDatasetTest, ReadsFilesInPatternOrder) {
+  WriteFile("a0", {"a0"});
+  WriteFile("a1", {"a1"});
+  WriteFile("b0", {"b0"});
+  EXPECT_EQ(GetAll(MakeIterator({Path("b*"), Path("a*")},
+                                /*num_parallel_reads=*/1)
+                       .get()),
+            std::vector<std::string>({"b0", "a0", "a1"}));
+}
+
+TEST_F(ShardedTFRecordDatasetTest, ReadsFilesOfShard) {
+  for (int i = 0; i < 5; ++i) WriteFile(StrCat("f", i), {StrCat("f", i)});
+  EXPECT_EQ(GetAll(MakeIterator({Path("f*")}, /*num_parallel_reads=*/1,
+                                /*num_shards=*/2, /*shard_index=*/0)
+                       .get()),
+            std::vector<std::string>({"f0", "f2", "f4"}));
+  EXPECT_EQ(GetAll(MakeIterator({Path("f*")}, /*num_parallel_reads=*/1,
+                                /*num_shards=*/2, /*shard_index=*/1)
+                       .get()),
+            std::vector<std::string>({"f1", "f3"}));
+  // A shard can have no files.
+  EXPECT_TRUE(GetAll(MakeIterator({Path("f*")}, /*num_parallel_reads=*/2,
+                                  /*num_shards=*/8, /*shard_index=*/6)
+                         .get())
+                  .empty());
+}
+
+TEST_F(ShardedTFRecordDatasetTest, OpensFileOnceAnotherEnded) {
+  WriteFile("a", {"a0", "a1"});
+  WriteFile("b", {"b0", "b1", "b2", "b3"});
+  WriteFile("c", {"c0", "c1"});
+  auto iterator = MakeIterator({Path("*")}, /*num_parallel_reads=*/2);
+  EXPECT_EQ(Await(iterator->GetNext(exec_ctx_)), "a0");
+  // The third file is only opened once the first one ended, so it is read
+  // with the records written after the iteration started.
+  WriteFile("c", {"c0'", "c1'"});
+  EXPECT_EQ(GetAll(iterator.get()),
+            std::vector<std::string>(
+                {"b0", "a1", "b1", "c0'", "b2", "c1'", "b3"}));
+}
+
+TEST_F(ShardedTFRecordDatasetTest, ReturnsMatchingError) {
+  WriteFile("a", {"a0"});
+  // The dataset is created without matching the patterns, and each GetNext()
+  // call returns the error.
+  auto iterator = MakeIterator({Path("a"), Path("missing*")},
+                               /*num_parallel_reads=*/1);
+  auto expected = StrCat("error: no files match ", Path("missing*"));
+  EXPECT_EQ(Await(iterator->GetNext(exec_ctx_)), expected);
+  EXPECT_EQ(Await(iterator->GetNext(exec_ctx_)), expected);
+}
+
+TEST_F(ShardedTFRecordDatasetTest, ReturnsReadError) {
+  WriteFile("a", {"a0", "a1"});
+  std::string record = MakeRecord("b0");
+  record.back() ^= 1;
+  std::ofstream(Path("b"), std::ios::binary) << record;
+  auto records =
+      GetAll(MakeIterator({Path("*")}, /*num_parallel_reads=*/2).get());
+  ASSERT_EQ(records.size(), 2);
+  EXPECT_EQ(records[0], "a0");
+  EXPECT_EQ(records[1].rfind("error: data corruption", 0), 0) << records[1];
+}
+
+}  // namespace
+}  // namespace data
+}  // namespace tfrt
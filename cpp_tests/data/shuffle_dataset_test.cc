@@ -0,0 +1,156 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Unit test for ShuffleDataset.
+
+#include "../../lib/data/shuffle_dataset.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "tfrt/cpp_tests/data_test_util.h"
+#include "tfrt/data/dataset.h"
+#include "tfrt/host_context/async_value_ref.h"
+#include "tfrt/host_context/execution_context.h"
+#include "tfrt/host_context/host_context.h"
+#include "tfrt/support/forward_decls.h"
+
+namespace tfrt {
+namespace data {
+namespace {
+
+// The end of iteration and errors in the output of a shuffle iterator.
+constexpr int64_t kEof = -1;
+constexpr int64_t kError = -2;
+
+class ShuffleDatasetTest : public DatasetTest {
+ protected:
+  RCReference<Iterator> MakeShuffleIterator(int64_t num_elements,
+                                            int64_t buffer_size,
+                                            int64_t error_index = -1,
+                                            bool async_eof = false) {
+    TestInputDataset::Options options;
+    options.error_index = error_index;
+    options.async_eof = async_eof;
+    auto input = TakeRef(
+        host_.Construct<TestInputDataset>(num_elements, options, &host_));
+    auto dataset = TakeRef(host_.Construct<ShuffleDataset>(
+        std::move(input), buffer_size, /*seed=*/7, /*seed2=*/11, &host_));
+    return dataset->MakeIterator(IteratorContext());
+  }
+
+  // Waits for `result` and returns its value, kEof or kError.
+  int64_t Await(const IterationResult& result) {
+    host_.Await({result.values[0], result.eof.CopyRCRef()});
+    if (result.eof.IsError()) {
+      EXPECT_TRUE(result.values[0]->IsError());
+      return kError;
+    }
+    if (result.eof.get()) return kEof;
+    return result.values[0]->get<int64_t>();
+  }
+
+  // Returns the values and errors of `iterator` until the end of iteration.
+  // All GetNext() calls are made before waiting for the first result.
+  std::vector<int64_t> GetAll(Iterator* iterator, int num_calls) {
+    std::vector<IterationResult> results;
+    for (int i = 0; i < num_calls; ++i)
+      results.push_back(iterator->GetNext(exec_ctx_));
+    std::vector<int64_t> values;
+    for (const auto& result : results) {
+      auto value = Await(result);
+      if (value == kEof) break;
+      values.push_back(value);
+    }
+    return values;
+  }
+};
+
+std::vector<int64_t> Range(int64_t n) {
+  std::vector<int64_t> values(n);
+  std::iota(values.begin(), values.end(), 0);
+  return values;
+}
+
+std::vector<int64_t> Sorted(std::vector<int64_t> values) {
+  std::sort(values.begin(), values.end());
+  return values;
+}
+
+TEST_F(ShuffleDatasetTest, OutputIsPermutationOfInput) {
+  for (int64_t buffer_size : {2, 10, 1000}) {
+    for (bool async_eof : {false, true}) {
+      auto values = GetAll(MakeShuffleIterator(100, buffer_size,
+                                               /*error_index=*/-1, async_eof)
+                               .get(),
+                           /*num_calls=*/101);
+      EXPECT_NE(values, Range(100)) << "buffer_size=" << buffer_size;
+      EXPECT_EQ(Sorted(values), Range(100)) << "buffer_size=" << buffer_size;
+    }
+  }
+}
+
+TEST_F(ShuffleDatasetTest, BufferSizeOneKeepsOrder) {
+  EXPECT_EQ(GetAll(MakeShuffleIterator(10, 1).get(), /*num_calls=*/11),
+            Range(10));
+}
+
+TEST_F(ShuffleDatasetTest, SameSeedGivesSameOrder) {
+  auto first = GetAll(MakeShuffleIterator(10, 10).get(), /*num_calls=*/11);
+  // The order produced by the multiply-shift mapping of the Philox output.
+  EXPECT_EQ(first, std::vector<int64_t>({7, 2, 9, 5, 6, 1, 0, 3, 4, 8}));
+  EXPECT_EQ(GetAll(MakeShuffleIterator(10, 10, /*error_index=*/-1,
+                                       /*async_eof=*/true)
+                       .get(),
+                   /*num_calls=*/11),
+            first);
+}
+
+TEST_F(ShuffleDatasetTest, ErrorsPassThrough) {
+  for (bool async_eof : {false, true}) {
+    // The error is returned once the input reaches it, instead of being
+    // shuffled with the other elements.
+    auto values = GetAll(
+        MakeShuffleIterator(10, 5, /*error_index=*/3, async_eof).get(),
+        /*num_calls=*/11);
+    ASSERT_EQ(values.size(), 10);
+    EXPECT_EQ(values[0], kError);
+    std::vector<int64_t> expected = Range(10);
+    expected.erase(expected.begin() + 3);
+    EXPECT_EQ(Sorted({values.begin() + 1, values.end()}), expected);
+  }
+}
+
+TEST_F(ShuffleDatasetTest, EndsAfterLastElement) {
+  auto iterator = MakeShuffleIterator(3, 10);
+  EXPECT_EQ(Sorted(GetAll(iterator.get(), /*num_calls=*/3)), Range(3));
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(Await(iterator->GetNext(exec_ctx_)), kEof);
+  }
+}
+
+TEST_F(ShuffleDatasetTest, EmptyInput) {
+  auto iterator = MakeShuffleIterator(0, 10);
+  EXPECT_EQ(Await(iterator->GetNext(exec_ctx_)), kEof);
+  EXPECT_EQ(Await(iterator->GetNext(exec_ctx_)), kEof);
+}
+
+}  // namespace
+}  // namespace data
+}  // namespace tfrt
@@ -0,0 +1,350 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Unit test for TFRecordDataset.
+
+#include "../../lib/data/tf_record_dataset.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "tfrt/cpp_tests/data_test_util.h"
+#include "tfrt/cpp_tests/io_test_util.h"
+#include "tfrt/cpp_tests/tf_record_test_util.h"
+#include "tfrt/data/dataset.h"
+#include "tfrt/host_context/async_value_ref.h"
+#include "tfrt/host_context/concurrent_work_queue.h"
+#include "tfrt/host_context/execution_context.h"
+#include "tfrt/host_context/host_buffer.h"
+#include "tfrt/host_context/host_context.h"
+#include "tfrt/io/file_system.h"
+#include "tfrt/io/zlib_input_stream.h"
+#include "tfrt/support/forward_decls.h"
+#include "tfrt/support/mutex.h"
+#include "tfrt/support/string_util.h"
+#include "tfrt/support/thread_annotations.h"
+
+namespace tfrt {
+namespace data {
+namespace {
+
+// Serves the local file at "slow://<path>", and sleeps before each read so that
+// a stream reading it can not keep up with parsing its records. Records the
+// size of each read.
+class SlowFileSystem : public ::tfrt::io::FileSystem {
+ public:
+  static constexpr char kScheme[] = "slow";
+
+  // Returns the file system, which is registered on the first call.
+  static SlowFileSystem* Get() {
+    static SlowFileSystem* file_system = [] {
+      auto file_system = std::make_unique<SlowFileSystem>();
+      auto* ptr = file_system.get();
+      ::tfrt::io::FileSystemRegistry::Default()->Register(
+          kScheme, std::move(file_system));
+      return ptr;
+    }();
+    return file_system;
+  }
+
+  llvm::Error NewRandomAccessFile(
+      const std::string& path,
+      std::unique_ptr<::tfrt::io::RandomAccessFile>* file) override {
+    std::unique_ptr<::tfrt::io::RandomAccessFile> local_file;
+    auto* local = ::tfrt::io::FileSystemRegistry::Default()->Lookup("");
+    if (auto error = local->NewRandomAccessFile(
+            path.substr(strlen(kScheme) + 3), &local_file))
+      return error;
+    *file = std::make_unique<File>(std::move(local_file), this);
+    return llvm::Error::success();
+  }
+
+  std::vector<size_t> TakeReadSizes() {
+    mutex_lock lock(mu_);
+    return std::move(read_sizes_);
+  }
+
+ private:
+  class File : public ::tfrt::io::RandomAccessFile {
+   public:
+    File(std::unique_ptr<::tfrt::io::RandomAccessFile> file,
+         SlowFileSystem* file_system)
+        : file_(std::move(file)), file_system_(file_system) {}
+
+    llvm::Expected<size_t> Read(char* buf, size_t max_count,
+                                size_t offset) const override {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      {
+        mutex_lock lock(file_system_->mu_);
+        file_system_->read_sizes_.push_back(max_count);
+      }
+      return file_->Read(buf, max_count, offset);
+    }
+
+   private:
+    std::unique_ptr<::tfrt::io::RandomAccessFile> file_;
+    SlowFileSystem* file_system_;
+  };
+
+  mutex mu_;
+  std::vector<size_t> read_sizes_ TFRT_GUARDED_BY(mu_);
+};
+
+class TFRecordDatasetTest : public DatasetTest {
+ protected:
+  TFRecordDatasetTest() : DatasetTest(CreateMultiThreadedWorkQueue(2, 2)) {}
+
+  void SetUp() override {
+    ASSERT_FALSE(llvm::sys::fs::createTemporaryFile("tf_record_dataset_test",
+                                                    "", path_));
+  }
+
+  void TearDown() override { llvm::sys::fs::remove(path_); }
+
+  // Writes records with the given payloads to the test file.
+  void WriteFile(const std::vector<std::string>& payloads) {
+    std::ofstream file(path_.str().str(), std::ios::binary);
+    for (const auto& payload : payloads) file << MakeRecord(payload);
+  }
+
+  RCReference<Iterator> MakeStreamIterator(const std::string& path,
+                                           int64_t buffer_size) {
+    auto dataset = TakeRef(host_.Construct<TFRecordDataset>(
+        path, buffer_size, /*max_prefetch_num=*/8,
+        /*prefetch_threshold=*/4, TFRecordReadMode::kStream,
+        /*compression=*/llvm::None, /*direct_io=*/false, &host_));
+    return dataset->MakeIterator(IteratorContext());
+  }
+
+  RCReference<Iterator> MakeCompressedIterator(::tfrt::io::ZlibFormat format,
+                                               int64_t buffer_size) {
+    auto dataset = TakeRef(host_.Construct<TFRecordDataset>(
+        path_.str().str(), buffer_size, /*max_prefetch_num=*/8,
+        /*prefetch_threshold=*/4, TFRecordReadMode::kStream, format,
+        /*direct_io=*/false, &host_));
+    return dataset->MakeIterator(IteratorContext());
+  }
+
+  RCReference<Iterator> MakeChunkedIterator(int64_t chunk_size,
+                                            bool direct_io) {
+    auto dataset = TakeRef(host_.Construct<TFRecordDataset>(
+        path_.str().str(), chunk_size, /*max_prefetch_num=*/8,
+        /*prefetch_threshold=*/4, TFRecordReadMode::kChunked,
+        /*compression=*/llvm::None, direct_io, &host_));
+    return dataset->MakeIterator(IteratorContext());
+  }
+
+  RCReference<Iterator> MakeMappedIterator() {
+    auto dataset = TakeRef(host_.Construct<TFRecordDataset>(
+        path_.str().str(), /*buffer_size=*/0, /*max_prefetch_num=*/8,
+        /*prefetch_threshold=*/4, TFRecordReadMode::kMapped,
+        /*compression=*/llvm::None, /*direct_io=*/false, &host_));
+    return dataset->MakeIterator(IteratorContext());
+  }
+
+  // Returns the records of `iterator` until the end of iteration. An error is
+  // returned as "error: <message>".
+  std::vector<std::string> GetAll(Iterator* iterator) {
+    std::vector<std::string> records;
+    while (true) {
+      auto result = iterator->GetNext(exec_ctx_);
+      host_.Await({result.values[0], result.eof.CopyRCRef()});
+      if (result.eof.IsError()) {
+        records.push_back("error: " + result.eof.GetError().message);
+        continue;
+      }
+      if (result.eof.get()) return records;
+      if (result.values[0]->IsType<std::string>()) {
+        records.push_back(result.values[0]->get<std::string>());
+        continue;
+      }
+      const auto& buffer = result.values[0]->get<RCReference<HostBuffer>>();
+      records.emplace_back(static_cast<const char*>(buffer->data()),
+                           buffer->size());
+    }
+  }
+
+  llvm::SmallString<128> path_;
+};
+
+// Returns payloads whose sizes cycle through [0, max_size).
+std::vector<std::string> MakePayloads(int num_records, int max_size) {
+  std::vector<std::string> payloads;
+  for (int i = 0; i < num_records; ++i) {
+    payloads.emplace_back((i * 97) % max_size, static_cast<char>('a' + i % 26));
+  }
+  return payloads;
+}
+
+TEST_F(TFRecordDatasetTest, ChunkedReadsRecordsAcrossChunks) {
+  auto payloads = MakePayloads(200, 3000);
+  WriteFile(payloads);
+  for (int64_t chunk_size : {16, 1000, 4096, 1 << 20}) {
+    for (bool direct_io : {false, true}) {
+      EXPECT_EQ(GetAll(MakeChunkedIterator(chunk_size, direct_io).get()),
+                payloads)
+          << "chunk_size=" << chunk_size << " direct_io=" << direct_io;
+    }
+  }
+}
+
+TEST_F(TFRecordDatasetTest, ChunkedReadsRecordsLargerThanReadAheadHead) {
+  // The unparsed bytes of these records do not fit before the chunk read
+  // ahead, which is copied after them instead.
+  std::vector<std::string> payloads = {std::string(100, 'a'),
+                                       std::string(200 << 10, 'b'),
+                                       std::string(10, 'c'),
+                                       std::string(300 << 10, 'd')};
+  WriteFile(payloads);
+  for (int64_t chunk_size : {1000, 128 << 10}) {
+    auto iterator = MakeChunkedIterator(chunk_size, /*direct_io=*/false);
+    EXPECT_EQ(GetAll(iterator.get()), payloads) << "chunk_size=" << chunk_size;
+  }
+}
+
+TEST_F(TFRecordDatasetTest, ChunkedReportsTruncatedRecord) {
+  auto payloads = MakePayloads(20, 300);
+  WriteFile(payloads);
+  uint64_t size;
+  ASSERT_FALSE(llvm::sys::fs::file_size(path_, size));
+  ASSERT_EQ(truncate(path_.c_str(), size - 1), 0);
+  auto records = GetAll(MakeChunkedIterator(256, /*direct_io=*/false).get());
+  ASSERT_EQ(records.size(), payloads.size());
+  payloads.pop_back();
+  EXPECT_EQ(std::vector<std::string>(records.begin(), records.end() - 1),
+            payloads);
+  EXPECT_EQ(records.back().rfind("error: truncated record", 0), 0)
+      << records.back();
+}
+
+TEST_F(TFRecordDatasetTest, MappedReadsRecords) {
+  // The records are read in several batches, and include an empty one.
+  auto payloads = MakePayloads(200, 3000);
+  WriteFile(payloads);
+  EXPECT_EQ(GetAll(MakeMappedIterator().get()), payloads);
+}
+
+TEST_F(TFRecordDatasetTest, MappedReportsDataCorruption) {
+  auto payloads = MakePayloads(100, 300);
+  // The position of record 40, which is in the second batch, and the offsets
+  // of a byte in its header and in its body.
+  size_t pos = 0;
+  for (int i = 0; i < 40; ++i) pos += MakeRecord(payloads[i]).size();
+  ASSERT_FALSE(payloads[40].empty());
+  for (size_t offset : {0, 20}) {
+    WriteFile(payloads);
+    {
+      std::fstream file(path_.str().str(),
+                        std::ios::binary | std::ios::in | std::ios::out);
+      file.seekg(pos + offset);
+      const char byte = static_cast<char>(file.get() ^ 1);
+      file.seekp(pos + offset);
+      file.put(byte);
+    }
+    // The records before the corrupted record are returned before the error.
+    // The records after it are not checked, since the reader resynchronizes
+    // by parsing the rest of the corrupted record as headers.
+    auto records = GetAll(MakeMappedIterator().get());
+    ASSERT_GT(records.size(), 40) << "offset=" << offset;
+    EXPECT_EQ(std::vector<std::string>(records.begin(), records.begin() + 40),
+              std::vector<std::string>(payloads.begin(), payloads.begin() + 40))
+        << "offset=" << offset;
+    EXPECT_EQ(records[40], StrCat("error: data corruption at position ", pos))
+        << "offset=" << offset;
+  }
+}
+
+TEST_F(TFRecordDatasetTest, MappedReportsTruncatedRecord) {
+  auto payloads = MakePayloads(20, 300);
+  WriteFile(payloads);
+  uint64_t size;
+  ASSERT_FALSE(llvm::sys::fs::file_size(path_, size));
+  const size_t last_pos = size - MakeRecord(payloads.back()).size();
+  ASSERT_EQ(truncate(path_.c_str(), size - 1), 0);
+  auto records = GetAll(MakeMappedIterator().get());
+  payloads.back() = StrCat("error: truncated record at position ", last_pos);
+  EXPECT_EQ(records, payloads);
+}
+
+TEST_F(TFRecordDatasetTest, MappedReportsTruncatedHeader) {
+  auto payloads = MakePayloads(20, 300);
+  WriteFile(payloads);
+  uint64_t size;
+  ASSERT_FALSE(llvm::sys::fs::file_size(path_, size));
+  {
+    std::ofstream file(path_.str().str(), std::ios::binary | std::ios::app);
+    file << MakeRecord("abc").substr(0, 5);
+  }
+  auto records = GetAll(MakeMappedIterator().get());
+  payloads.push_back(StrCat("error: truncated record at position ", size));
+  EXPECT_EQ(records, payloads);
+  // Chunked mode reports it in the same way.
+  EXPECT_EQ(GetAll(MakeChunkedIterator(256, /*direct_io=*/false).get()),
+            payloads);
+}
+
+TEST_F(TFRecordDatasetTest, ReadsCompressedRecords) {
+  auto payloads = MakePayloads(200, 3000);
+  std::string records;
+  for (const auto& payload : payloads) records += MakeRecord(payload);
+  for (auto format :
+       {::tfrt::io::ZlibFormat::kZlib, ::tfrt::io::ZlibFormat::kGzip}) {
+    {
+      std::ofstream file(path_.str().str(), std::ios::binary);
+      file << ::tfrt::io::Compress(records, format);
+    }
+    for (int64_t buffer_size : {16, 4096}) {
+      EXPECT_EQ(GetAll(MakeCompressedIterator(format, buffer_size).get()),
+                payloads)
+          << "format=" << static_cast<int>(format)
+          << " buffer_size=" << buffer_size;
+    }
+  }
+}
+
+TEST_F(TFRecordDatasetTest, StreamGrowsBufferForSlowFile) {
+  auto payloads = MakePayloads(2000, 300);
+  WriteFile(payloads);
+  auto* file_system = SlowFileSystem::Get();
+  file_system->TakeReadSizes();
+  auto iterator = MakeStreamIterator(StrCat(SlowFileSystem::kScheme, "://",
+                                            path_.str()),
+                                     /*buffer_size=*/1024);
+  EXPECT_EQ(GetAll(iterator.get()), payloads);
+
+  // The chunks read ahead are not ready in time, so the buffer grows up to 16
+  // times its initial size.
+  auto read_sizes = file_system->TakeReadSizes();
+  ASSERT_FALSE(read_sizes.empty());
+  EXPECT_EQ(read_sizes.front(), 1024);
+  EXPECT_EQ(*std::max_element(read_sizes.begin(), read_sizes.end()), 16384);
+}
+
+}  // namespace
+}  // namespace data
+}  // namespace tfrt
@@ -0,0 +1,53 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// This file implements the utilities for writing TFRecord files in tests.
+
+#include "tfrt/cpp_tests/tf_record_test_util.h"
+
+#include <cstdint>
+
+#include "llvm/ADT/StringRef.h"
+#include "tfrt/support/crc32c.h"
+
+namespace tfrt {
+namespace data {
+namespace {
+
+// Appends `value` to `out` in little-endian byte order.
+template <typename T>
+void AppendLittleEndian(T value, std::string* out) {
+  for (size_t i = 0; i < sizeof(T); ++i) {
+    out->push_back(static_cast<char>(value & 0xff));
+    value >>= 8;
+  }
+}
+
+}  // namespace
+
+std::string MakeRecord(string_view payload) {
+  std::string record;
+  AppendLittleEndian<uint64_t>(payload.size(), &record);
+  AppendLittleEndian<uint32_t>(
+      crc32c::Mask(crc32c::Value(record.data(), record.size())), &record);
+  record.append(payload.data(), payload.size());
+  AppendLittleEndian<uint32_t>(
+      crc32c::Mask(crc32c::Value(payload.data(), payload.size())), &record);
+  return record;
+}
+
+}  // namespace data
+}  // namespace tfrt
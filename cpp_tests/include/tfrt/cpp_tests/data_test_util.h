@@ -0,0 +1,127 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// This file defines utilities for unit tests of datasets.
+#ifndef TFRT_CPP_TESTS_DATA_TEST_UTIL_H_
+#define TFRT_CPP_TESTS_DATA_TEST_UTIL_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "tfrt/data/dataset.h"
+#include "tfrt/host_context/async_value.h"
+#include "tfrt/host_context/async_value_ref.h"
+#include "tfrt/host_context/concurrent_work_queue.h"
+#include "tfrt/host_context/execution_context.h"
+#include "tfrt/host_context/host_context.h"
+#include "tfrt/host_context/native_function.h"
+#include "tfrt/support/forward_decls.h"
+
+namespace tfrt {
+namespace data {
+
+// Yields the integers [0, num_elements) as int64_t values, or as scalar i64
+// DenseHostTensors. The options inject errors and delays into the input of the
+// dataset under test.
+class TestInputDataset : public Dataset {
+ public:
+  struct Options {
+    // If true, the elements are scalar tensors rather than int64_t values.
+    bool tensors = false;
+    // The element at this index is an error.
+    int64_t error_index = -1;
+    // The value of the element at this index is only available after
+    // ResolveSlowElement(). Its eof is available right away.
+    int64_t slow_index = -1;
+    // The value and eof of the element at this index are only available after
+    // ResolvePendingElement().
+    int64_t pending_index = -1;
+    // If true, the eof of each element is set by a task on the work queue.
+    bool async_eof = false;
+  };
+
+  TestInputDataset(int64_t num_elements, Options options, HostContext* host);
+
+  string_view name() const override { return "test_input"; }
+
+  RCReference<Iterator> MakeIteratorInternal(
+      const IteratorContext& context) override;
+
+  void ResolveSlowElement();
+  void ResolvePendingElement();
+
+  // The number of iterators created for this dataset.
+  int num_iterators() const { return num_iterators_.load(); }
+
+  // The number of GetNext() calls on the iterators of this dataset.
+  int num_requests() const { return num_requests_.load(); }
+
+ private:
+  friend class TestInputIterator;
+
+  void Destroy() override {
+    internal::DestroyImpl<TestInputDataset>(this, host_->allocator());
+  }
+
+  // Returns the value of the element at `index`.
+  RCReference<AsyncValue> MakeValue(int64_t index) const;
+
+  const int64_t num_elements_;
+  const Options options_;
+  HostContext* host_;
+  // The values of the slow and the pending element, which are shared by all
+  // iterators.
+  RCReference<IndirectAsyncValue> slow_value_;
+  RCReference<IndirectAsyncValue> pending_value_;
+  AsyncValueRef<bool> pending_eof_;
+  std::atomic<int> num_iterators_{0};
+  std::atomic<int> num_requests_{0};
+};
+
+// A map function which returns ten times its scalar i64 tensor argument from a
+// task. Like a BEF function completing asynchronously, it returns an
+// IndirectAsyncValue which is forwarded to the new tensor afterwards. Like BEF
+// functions, it propagates an error argument.
+void AsyncScale(AsyncValue* const* arguments, int num_arguments,
+                RCReference<AsyncValue>* results, int num_results,
+                HostContext* host);
+
+// A fixture for dataset tests, whose host runs tasks on `work_queue`.
+class DatasetTest : public ::testing::Test {
+ protected:
+  explicit DatasetTest(std::unique_ptr<ConcurrentWorkQueue> work_queue =
+                           CreateMultiThreadedWorkQueue(4, 4));
+
+  // Returns a function which calls `callable`.
+  NativeFunction* MakeFunction(string_view name,
+                               ArrayRef<TypeName> argument_types,
+                               ArrayRef<TypeName> result_types,
+                               NativeCallable callable);
+
+  // The functions outlive the host, whose pending tasks may hold references to
+  // them.
+  std::vector<std::unique_ptr<NativeFunction>> functions_;
+  HostContext host_;
+  ExecutionContext exec_ctx_;
+};
+
+}  // namespace data
+}  // namespace tfrt
+
+#endif  // TFRT_CPP_TESTS_DATA_TEST_UTIL_H_
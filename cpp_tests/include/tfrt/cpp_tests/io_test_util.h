@@ -0,0 +1,80 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// This file defines utilities for unit tests of input streams.
+#ifndef TFRT_CPP_TESTS_IO_TEST_UTIL_H_
+#define TFRT_CPP_TESTS_IO_TEST_UTIL_H_
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "llvm/Support/Error.h"
+#include "tfrt/io/input_stream.h"
+#include "tfrt/io/zlib_input_stream.h"
+#include "tfrt/support/mutex.h"
+#include "tfrt/support/thread_annotations.h"
+
+namespace tfrt {
+namespace io {
+
+// An input stream that reads from a string, and records the size of each read.
+// Each read sleeps for `read_delay` first, and FailNextRead() makes the next
+// read return an error.
+class StringInputStream : public InputStream {
+ public:
+  explicit StringInputStream(std::string data,
+                             std::chrono::microseconds read_delay = {})
+      : data_(std::move(data)), read_delay_(read_delay) {}
+
+  llvm::Expected<size_t> Read(char* buf, size_t max_count) override;
+
+  llvm::Expected<size_t> Tell() override { return pos_; }
+
+  void FailNextRead() {
+    mutex_lock lock(mu_);
+    fail_next_read_ = true;
+  }
+
+  std::vector<size_t> read_sizes() {
+    mutex_lock lock(mu_);
+    return read_sizes_;
+  }
+
+ private:
+  std::string data_;
+  size_t pos_ = 0;
+  std::chrono::microseconds read_delay_;
+
+  mutex mu_;
+  bool fail_next_read_ TFRT_GUARDED_BY(mu_) = false;
+  std::vector<size_t> read_sizes_ TFRT_GUARDED_BY(mu_);
+};
+
+// Returns `size` bytes of compressible data.
+std::string MakeData(size_t size);
+
+// Returns `data` compressed in the given format.
+std::string Compress(const std::string& data, ZlibFormat format);
+
+// Reads the whole stream in reads of `read_size` bytes.
+llvm::Expected<std::string> ReadAll(InputStream* stream, size_t read_size);
+
+}  // namespace io
+}  // namespace tfrt
+
+#endif  // TFRT_CPP_TESTS_IO_TEST_UTIL_H_
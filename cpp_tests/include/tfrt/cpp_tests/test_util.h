@@ -18,8 +18,10 @@
 #ifndef TFRT_CPP_TESTS_TEST_UTIL_H_
 #define TFRT_CPP_TESTS_TEST_UTIL_H_
 
+#include "llvm/Support/Error.h"
 #include "tfrt/dtype/dtype.h"
 #include "tfrt/host_context/concurrent_work_queue.h"
+#include "tfrt/host_context/execution_context.h"
 #include "tfrt/host_context/host_allocator.h"
 #include "tfrt/host_context/host_buffer.h"
 #include "tfrt/host_context/host_context.h"
@@ -45,6 +47,12 @@ inline std::unique_ptr<HostContext> CreateHostContext() {
                                        std::move(work_queue));
 }
 
+// Returns an execution context with a new request context on `host`.
+inline ExecutionContext CreateTestExecutionContext(HostContext* host) {
+  return ExecutionContext{llvm::cantFail(
+      RequestContextBuilder(host, /*resource_context=*/nullptr).build())};
+}
+
 template <typename T>
 DenseHostTensor CreateDummyTensor(ArrayRef<Index> dims, HostContext* host_ctx) {
   const TensorMetadata metadata(GetDType<T>(), dims);
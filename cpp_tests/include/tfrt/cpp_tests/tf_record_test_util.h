@@ -0,0 +1,34 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// This file defines utilities for writing TFRecord files in tests.
+#ifndef TFRT_CPP_TESTS_TF_RECORD_TEST_UTIL_H_
+#define TFRT_CPP_TESTS_TF_RECORD_TEST_UTIL_H_
+
+#include <string>
+
+#include "tfrt/support/forward_decls.h"
+
+namespace tfrt {
+namespace data {
+
+// Returns `payload` framed as a TFRecord.
+std::string MakeRecord(string_view payload);
+
+}  // namespace data
+}  // namespace tfrt
+
+#endif  // TFRT_CPP_TESTS_TF_RECORD_TEST_UTIL_H_
@@ -0,0 +1,105 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Unit test for BufferedInputStream.
+
+#include "tfrt/io/buffered_input_stream.h"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+
+#include "gtest/gtest.h"
+#include "tfrt/cpp_tests/io_test_util.h"
+#include "tfrt/cpp_tests/test_util.h"
+#include "tfrt/support/string_util.h"
+
+namespace tfrt {
+namespace io {
+namespace {
+
+TEST(BufferedInputStreamTest, Read) {
+  auto host = CreateHostContext();
+  auto data = MakeData(100000);
+  auto input = std::make_unique<StringInputStream>(data);
+  auto* input_ptr = input.get();
+  BufferedInputStream stream(std::move(input), /*buffer_size=*/4096,
+                             host->allocator());
+  auto result = ReadAll(&stream, 1000);
+  ASSERT_TRUE(!!result) << StrCat(result.takeError());
+  EXPECT_EQ(*result, data);
+  EXPECT_EQ(llvm::cantFail(stream.Tell()), data.size());
+  for (size_t size : input_ptr->read_sizes()) EXPECT_EQ(size, 4096);
+}
+
+TEST(BufferedInputStreamTest, ReadAhead) {
+  auto host = CreateHostContext();
+  auto data = MakeData(1000000);
+  BufferedInputStream stream(std::make_unique<StringInputStream>(data),
+                             /*buffer_size=*/4096, /*max_buffer_size=*/4096,
+                             host->allocator(), host.get());
+  for (size_t read_size : {1, 777, 10000}) {
+    std::string buffer(read_size, '\0');
+    auto count = stream.Read(&buffer[0], buffer.size());
+    ASSERT_TRUE(!!count) << StrCat(count.takeError());
+    EXPECT_EQ(*count, read_size);
+  }
+  auto result = ReadAll(&stream, 1234);
+  ASSERT_TRUE(!!result) << StrCat(result.takeError());
+  EXPECT_EQ(*result, data.substr(1 + 777 + 10000));
+  EXPECT_EQ(llvm::cantFail(stream.Tell()), data.size());
+}
+
+TEST(BufferedInputStreamTest, ReadAheadGrowsBufferForSlowInput) {
+  auto host = CreateHostContext();
+  auto input = std::make_unique<StringInputStream>(
+      MakeData(1000000), std::chrono::microseconds(1000));
+  auto* input_ptr = input.get();
+  BufferedInputStream stream(std::move(input), /*buffer_size=*/1024,
+                             /*max_buffer_size=*/16384, host->allocator(),
+                             host.get());
+  auto result = ReadAll(&stream, 4096);
+  ASSERT_TRUE(!!result) << StrCat(result.takeError());
+  EXPECT_EQ(result->size(), 1000000);
+
+  auto read_sizes = input_ptr->read_sizes();
+  EXPECT_EQ(read_sizes.front(), 1024);
+  EXPECT_EQ(*std::max_element(read_sizes.begin(), read_sizes.end()), 16384);
+  EXPECT_TRUE(std::is_sorted(read_sizes.begin(), read_sizes.end()));
+}
+
+TEST(BufferedInputStreamTest, ReadAfterError) {
+  auto host = CreateHostContext();
+  auto data = MakeData(10000);
+  auto input = std::make_unique<StringInputStream>(data);
+  input->FailNextRead();
+  BufferedInputStream stream(std::move(input), /*buffer_size=*/1000,
+                             /*max_buffer_size=*/1000, host->allocator(),
+                             host.get());
+  char buffer[10];
+  auto count = stream.Read(buffer, sizeof(buffer));
+  ASSERT_FALSE(!!count);
+  EXPECT_EQ(StrCat(count.takeError()), "read failed");
+
+  // The stream is read again after the error.
+  auto result = ReadAll(&stream, 100);
+  ASSERT_TRUE(!!result) << StrCat(result.takeError());
+  EXPECT_EQ(*result, data);
+}
+
+}  // namespace
+}  // namespace io
+}  // namespace tfrt
@@ -0,0 +1,177 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Unit test for EmulatedRemoteFileSystem.
+
+#include "tfrt/io/emulated_remote_file_system.h"
+
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "tfrt/support/string_util.h"
+
+namespace tfrt {
+namespace io {
+namespace {
+
+class EmulatedRemoteFileSystemTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_FALSE(llvm::sys::fs::createUniqueDirectory(
+        "emulated_remote_file_system_test", root_));
+    llvm::SmallString<128> bucket(root_);
+    llvm::sys::path::append(bucket, "bucket");
+    ASSERT_FALSE(llvm::sys::fs::create_directory(bucket));
+    for (int i = 0; i < 10000; ++i) contents_.push_back(static_cast<char>(i));
+    WriteObject("data", contents_);
+  }
+
+  void TearDown() override { llvm::sys::fs::remove_directories(root_); }
+
+  void WriteObject(const char* name, const std::string& contents) {
+    std::ofstream(StrCat(root_, "/bucket/", name), std::ios::binary)
+        << contents;
+  }
+
+  EmulatedRemoteFileSystemOptions Options() {
+    EmulatedRemoteFileSystemOptions options;
+    options.root = root_.str().str();
+    options.block_size = 1024;
+    return options;
+  }
+
+  std::unique_ptr<RandomAccessFile> OpenFile(FileSystem* file_system,
+                                             const std::string& path) {
+    std::unique_ptr<RandomAccessFile> file;
+    EXPECT_FALSE(file_system->NewRandomAccessFile(path, &file));
+    return file;
+  }
+
+  llvm::SmallString<128> root_;
+  std::string contents_;
+};
+
+TEST_F(EmulatedRemoteFileSystemTest, Read) {
+  EmulatedRemoteFileSystem file_system("emu", Options());
+  auto file = OpenFile(&file_system, "emu://bucket/data");
+  for (auto offset_and_size : std::vector<std::pair<size_t, size_t>>{
+           {0, 1024},
+           {500, 1000},
+           {1000, 5000},
+           {9900, 1000},
+           {10000, 1000},
+           {20000, 1000}}) {
+    std::string buffer(offset_and_size.second, '\0');
+    auto count =
+        file->Read(&buffer[0], buffer.size(), offset_and_size.first);
+    ASSERT_TRUE(!!count) << StrCat(count.takeError());
+    buffer.resize(*count);
+    EXPECT_EQ(buffer, offset_and_size.first < contents_.size()
+                          ? contents_.substr(offset_and_size.first,
+                                             offset_and_size.second)
+                          : "");
+  }
+}
+
+TEST_F(EmulatedRemoteFileSystemTest, ReadFromCache) {
+  EmulatedRemoteFileSystem file_system("emu", Options());
+  auto file = OpenFile(&file_system, "emu://bucket/data");
+  std::string buffer(4096, '\0');
+  ASSERT_TRUE(!!file->Read(&buffer[0], buffer.size(), 512));
+  EXPECT_EQ(file_system.num_requests(), 5);
+  EXPECT_EQ(file_system.num_cache_hits(), 0);
+
+  // The blocks are cached, and shared with other files of the object.
+  auto other_file = OpenFile(&file_system, "emu://bucket/data");
+  auto count = other_file->Read(&buffer[0], buffer.size(), 1024);
+  ASSERT_TRUE(!!count);
+  EXPECT_EQ(buffer, contents_.substr(1024, buffer.size()));
+  EXPECT_EQ(file_system.num_requests(), 5);
+  EXPECT_EQ(file_system.num_cache_hits(), 4);
+}
+
+TEST_F(EmulatedRemoteFileSystemTest, ReadWithoutCache) {
+  auto options = Options();
+  options.cache_size = 0;
+  EmulatedRemoteFileSystem file_system("emu", options);
+  auto file = OpenFile(&file_system, "emu://bucket/data");
+  std::string buffer(1024, '\0');
+  ASSERT_TRUE(!!file->Read(&buffer[0], buffer.size(), 0));
+  ASSERT_TRUE(!!file->Read(&buffer[0], buffer.size(), 0));
+  EXPECT_EQ(file_system.num_requests(), 2);
+  EXPECT_EQ(file_system.num_cache_hits(), 0);
+}
+
+TEST_F(EmulatedRemoteFileSystemTest, ReadBlocksInParallel) {
+  auto options = Options();
+  options.latency = std::chrono::milliseconds(50);
+  options.num_parallel_requests = 8;
+  EmulatedRemoteFileSystem file_system("emu", options);
+  auto file = OpenFile(&file_system, "emu://bucket/data");
+
+  std::string buffer(8 * 1024, '\0');
+  auto count = file->Read(&buffer[0], buffer.size(), 0);
+  ASSERT_TRUE(!!count);
+  EXPECT_EQ(buffer, contents_.substr(0, buffer.size()));
+  EXPECT_EQ(file_system.num_requests(), 8);
+  // The requests of the blocks overlap, up to the number of threads.
+  EXPECT_GT(file_system.max_requests_in_flight(), 1);
+  EXPECT_LE(file_system.max_requests_in_flight(), 8);
+}
+
+TEST_F(EmulatedRemoteFileSystemTest, GetMatchingPaths) {
+  WriteObject("a.tfrecord", "a");
+  WriteObject("b.tfrecord", "b");
+  EmulatedRemoteFileSystem file_system("emu", Options());
+  std::vector<std::string> paths;
+  ASSERT_FALSE(
+      file_system.GetMatchingPaths("emu://bucket/*.tfrecord", &paths));
+  EXPECT_EQ(paths, std::vector<std::string>(
+                       {"emu://bucket/a.tfrecord", "emu://bucket/b.tfrecord"}));
+}
+
+TEST_F(EmulatedRemoteFileSystemTest, LookupForPath) {
+  auto* registry = FileSystemRegistry::Default();
+  registry->Register("emu-lookup", std::make_unique<EmulatedRemoteFileSystem>(
+                                       "emu-lookup", Options()));
+  auto* file_system = registry->LookupForPath("emu-lookup://bucket/data");
+  ASSERT_NE(file_system, nullptr);
+  auto file = OpenFile(file_system, "emu-lookup://bucket/data");
+  std::string buffer(100, '\0');
+  auto count = file->Read(&buffer[0], buffer.size(), 0);
+  ASSERT_TRUE(!!count);
+  EXPECT_EQ(buffer, contents_.substr(0, 100));
+}
+
+TEST_F(EmulatedRemoteFileSystemTest, OpenPathWithOtherScheme) {
+  EmulatedRemoteFileSystem file_system("emu", Options());
+  std::unique_ptr<RandomAccessFile> file;
+  auto error = file_system.NewRandomAccessFile("gs://bucket/data", &file);
+  ASSERT_TRUE(!!error);
+  EXPECT_EQ(llvm::toString(std::move(error)),
+            "path gs://bucket/data does not start with emu://");
+  EXPECT_EQ(file, nullptr);
+}
+
+}  // namespace
+}  // namespace io
+}  // namespace tfrt
@@ -0,0 +1,220 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Unit test for the file systems registered for the default scheme.
+
+#include "tfrt/io/file_system.h"
+
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../../lib/io/io_uring_file_system.h"
+#include "gtest/gtest.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "tfrt/cpp_tests/test_util.h"
+#include "tfrt/host_context/host_allocator.h"
+
+namespace tfrt {
+namespace io {
+namespace {
+
+class FileSystemTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_FALSE(
+        llvm::sys::fs::createTemporaryFile("file_system_test", "", path_));
+    for (int i = 0; i < 100000; ++i) contents_.push_back(static_cast<char>(i));
+    std::ofstream(path_.c_str(), std::ios::binary) << contents_;
+  }
+
+  void TearDown() override { llvm::sys::fs::remove(path_); }
+
+  std::unique_ptr<RandomAccessFile> OpenFile(
+      FileSystem* file_system = FileSystemRegistry::Default()->Lookup("")) {
+    EXPECT_NE(file_system, nullptr);
+    std::unique_ptr<RandomAccessFile> file;
+    EXPECT_FALSE(file_system->NewRandomAccessFile(path_.str().str(), &file));
+    return file;
+  }
+
+  void ExpectConcurrentReadAsync(const RandomAccessFile& file) {
+    auto host = CreateHostContext();
+    constexpr size_t kNumReads = 64;
+    constexpr size_t kReadSize = 4096;
+    constexpr size_t kStride = 1500;
+    std::vector<std::string> buffers(kNumReads, std::string(kReadSize, '\0'));
+    std::vector<RCReference<AsyncValue>> results;
+    for (size_t i = 0; i < kNumReads; ++i) {
+      results.push_back(
+          file.ReadAsync(&buffers[i][0], kReadSize, i * kStride, host.get())
+              .ReleaseRCRef());
+    }
+    host->Await(results);
+    for (size_t i = 0; i < kNumReads; ++i) {
+      ASSERT_FALSE(results[i]->IsError()) << results[i]->GetError().message;
+      EXPECT_EQ(results[i]->get<size_t>(), kReadSize);
+      EXPECT_EQ(buffers[i], contents_.substr(i * kStride, kReadSize));
+    }
+  }
+
+  llvm::SmallString<128> path_;
+  std::string contents_;
+};
+
+TEST_F(FileSystemTest, Read) {
+  auto file = OpenFile();
+  std::string buffer(1000, '\0');
+  auto count = file->Read(&buffer[0], buffer.size(), 500);
+  ASSERT_TRUE(!!count);
+  EXPECT_EQ(*count, buffer.size());
+  EXPECT_EQ(buffer, contents_.substr(500, buffer.size()));
+}
+
+TEST_F(FileSystemTest, ReadAsyncConcurrently) {
+  ExpectConcurrentReadAsync(*OpenFile());
+}
+
+TEST_F(FileSystemTest, IoUringReadAsyncConcurrently) {
+  auto file_system = IoUringFileSystem::Create();
+  if (!file_system) GTEST_SKIP() << "io_uring is not available";
+  ExpectConcurrentReadAsync(*OpenFile(file_system.get()));
+}
+
+TEST_F(FileSystemTest, ReadAsyncPastEnd) {
+  auto host = CreateHostContext();
+  auto file = OpenFile();
+  std::string buffer(1000, '\0');
+  auto result = file->ReadAsync(&buffer[0], buffer.size(),
+                                contents_.size() - 100, host.get());
+  host->Await({result.CopyRCRef()});
+  ASSERT_FALSE(result.IsError()) << result.GetError().message;
+  EXPECT_EQ(result.get(), 100);
+  EXPECT_EQ(buffer.substr(0, 100), contents_.substr(contents_.size() - 100));
+}
+
+TEST_F(FileSystemTest, MappedFileReadView) {
+  auto* file_system = FileSystemRegistry::Default()->Lookup("");
+  std::unique_ptr<RandomAccessFile> file;
+  ASSERT_FALSE(
+      file_system->NewMappedRandomAccessFile(path_.str().str(), &file));
+
+  auto view = file->ReadView(500, 1000);
+  ASSERT_TRUE(view);
+  file.reset();
+  // The view keeps the mapping alive.
+  EXPECT_EQ(string_view(static_cast<const char*>(view->data()), view->size()),
+            contents_.substr(500, 1000));
+}
+
+TEST_F(FileSystemTest, MappedFileReadViewPastEnd) {
+  auto* file_system = FileSystemRegistry::Default()->Lookup("");
+  std::unique_ptr<RandomAccessFile> file;
+  ASSERT_FALSE(
+      file_system->NewMappedRandomAccessFile(path_.str().str(), &file));
+
+  EXPECT_EQ(file->ReadView(contents_.size() - 100, 1000)->size(), 100);
+  EXPECT_EQ(file->ReadView(contents_.size() + 100, 1000)->size(), 0);
+
+  std::string buffer(1000, '\0');
+  auto count = file->Read(&buffer[0], buffer.size(), contents_.size() - 100);
+  ASSERT_TRUE(!!count);
+  EXPECT_EQ(*count, 100);
+  EXPECT_EQ(buffer.substr(0, 100), contents_.substr(contents_.size() - 100));
+}
+
+TEST_F(FileSystemTest, DirectFileRead) {
+  auto* file_system = FileSystemRegistry::Default()->Lookup("");
+  auto allocator = CreateMallocAllocator();
+  std::unique_ptr<RandomAccessFile> file;
+  ASSERT_FALSE(file_system->NewDirectRandomAccessFile(
+      path_.str().str(), allocator.get(), &file));
+
+  // An aligned read is read into the buffer directly.
+  const size_t size = 2 * kDirectIOAlignment;
+  auto* buffer = static_cast<char*>(
+      allocator->AllocateBytes(size, kDirectIOAlignment));
+  auto count = file->Read(buffer, size, kDirectIOAlignment);
+  ASSERT_TRUE(!!count);
+  EXPECT_EQ(string_view(buffer, *count),
+            contents_.substr(kDirectIOAlignment, size));
+  allocator->DeallocateBytes(buffer, size);
+
+  // Unaligned reads, including reads past the end of the file.
+  for (auto offset_and_size : std::vector<std::pair<size_t, size_t>>{
+           {500, 1000},
+           {4000, 10000},
+           {0, contents_.size()},
+           {contents_.size() - 100, 1000},
+           {contents_.size() + 100, 1000}}) {
+    std::string unaligned(offset_and_size.second, '\0');
+    auto count =
+        file->Read(&unaligned[0], unaligned.size(), offset_and_size.first);
+    ASSERT_TRUE(!!count);
+    unaligned.resize(*count);
+    EXPECT_EQ(unaligned,
+              offset_and_size.first < contents_.size()
+                  ? contents_.substr(offset_and_size.first,
+                                     offset_and_size.second)
+                  : "");
+  }
+}
+
+TEST_F(FileSystemTest, GetMatchingPaths) {
+  auto* file_system = FileSystemRegistry::Default()->Lookup("");
+  llvm::SmallString<128> dir;
+  ASSERT_FALSE(llvm::sys::fs::createUniqueDirectory("file_system_test", dir));
+  auto path_in_dir = [&dir](const char* name) {
+    llvm::SmallString<128> path = dir;
+    llvm::sys::path::append(path, name);
+    return path.str().str();
+  };
+  for (const char* name : {"b.tfrecord", "a.tfrecord", "c.txt"}) {
+    std::ofstream(path_in_dir(name)) << name;
+  }
+
+  std::vector<std::string> paths;
+  ASSERT_FALSE(
+      file_system->GetMatchingPaths(path_in_dir("*.tfrecord"), &paths));
+  EXPECT_EQ(paths, std::vector<std::string>({path_in_dir("a.tfrecord"),
+                                             path_in_dir("b.tfrecord")}));
+
+  // A path without wildcards matches the file if it exists.
+  ASSERT_FALSE(file_system->GetMatchingPaths(path_in_dir("c.txt"), &paths));
+  EXPECT_EQ(paths, std::vector<std::string>({path_in_dir("c.txt")}));
+  ASSERT_FALSE(
+      file_system->GetMatchingPaths(path_in_dir("missing.tfrecord"), &paths));
+  EXPECT_TRUE(paths.empty());
+
+  llvm::sys::fs::remove_directories(dir);
+}
+
+TEST(GetSchemeTest, ParsesScheme) {
+  EXPECT_EQ(GetScheme("gs://bucket/file"), "gs");
+  EXPECT_EQ(GetScheme("s3://bucket"), "s3");
+  EXPECT_EQ(GetScheme("x-emulated+s3://bucket/file"), "x-emulated+s3");
+  EXPECT_EQ(GetScheme("/tmp/file"), "");
+  EXPECT_EQ(GetScheme("relative/path"), "");
+  EXPECT_EQ(GetScheme("://bucket/file"), "");
+  EXPECT_EQ(GetScheme("/tmp/gs://file"), "");
+}
+
+}  // namespace
+}  // namespace io
+}  // namespace tfrt
@@ -0,0 +1,85 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// This file implements the utilities for unit tests of input streams.
+
+#include "tfrt/cpp_tests/io_test_util.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+#include "gtest/gtest.h"
+#include "tfrt/support/error_util.h"
+#include "zlib.h"
+
+namespace tfrt {
+namespace io {
+
+llvm::Expected<size_t> StringInputStream::Read(char* buf, size_t max_count) {
+  std::this_thread::sleep_for(read_delay_);
+  {
+    mutex_lock lock(mu_);
+    read_sizes_.push_back(max_count);
+    if (fail_next_read_) {
+      fail_next_read_ = false;
+      return MakeStringError("read failed");
+    }
+  }
+  size_t count = std::min(max_count, data_.size() - pos_);
+  std::memcpy(buf, data_.data() + pos_, count);
+  pos_ += count;
+  return count;
+}
+
+std::string MakeData(size_t size) {
+  std::string data;
+  for (size_t i = 0; data.size() < size; ++i) data += std::to_string(i * i);
+  data.resize(size);
+  return data;
+}
+
+std::string Compress(const std::string& data, ZlibFormat format) {
+  z_stream stream;
+  std::memset(&stream, 0, sizeof(stream));
+  int window_bits = format == ZlibFormat::kGzip ? MAX_WBITS + 16 : MAX_WBITS;
+  EXPECT_EQ(deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                         window_bits, 8, Z_DEFAULT_STRATEGY),
+            Z_OK);
+  std::string result(deflateBound(&stream, data.size()), '\0');
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+  stream.avail_in = data.size();
+  stream.next_out = reinterpret_cast<Bytef*>(&result[0]);
+  stream.avail_out = result.size();
+  EXPECT_EQ(deflate(&stream, Z_FINISH), Z_STREAM_END);
+  result.resize(stream.total_out);
+  deflateEnd(&stream);
+  return result;
+}
+
+llvm::Expected<std::string> ReadAll(InputStream* stream, size_t read_size) {
+  std::string result;
+  std::string buffer(read_size, '\0');
+  while (true) {
+    auto count = stream->Read(&buffer[0], buffer.size());
+    if (!count) return count.takeError();
+    result.append(buffer, 0, *count);
+    if (*count < buffer.size()) return result;
+  }
+}
+
+}  // namespace io
+}  // namespace tfrt
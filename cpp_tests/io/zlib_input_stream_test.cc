@@ -0,0 +1,98 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Unit test for ZlibInputStream.
+
+#include "tfrt/io/zlib_input_stream.h"
+
+#include <memory>
+
+#include "gtest/gtest.h"
+#include "tfrt/cpp_tests/io_test_util.h"
+#include "tfrt/cpp_tests/test_util.h"
+#include "tfrt/io/buffered_input_stream.h"
+#include "tfrt/support/string_util.h"
+
+namespace tfrt {
+namespace io {
+namespace {
+
+TEST(ZlibInputStreamTest, ReadZlib) {
+  auto data = MakeData(100000);
+  ZlibInputStream stream(std::make_unique<StringInputStream>(
+                             Compress(data, ZlibFormat::kZlib)),
+                         ZlibFormat::kZlib, /*input_buffer_size=*/1000);
+  auto result = ReadAll(&stream, 1234);
+  ASSERT_TRUE(!!result) << StrCat(result.takeError());
+  EXPECT_EQ(*result, data);
+  EXPECT_EQ(llvm::cantFail(stream.Tell()), data.size());
+}
+
+TEST(ZlibInputStreamTest, ReadGzipAhead) {
+  auto host = CreateHostContext();
+  auto data = MakeData(1000000);
+  BufferedInputStream stream(
+      std::make_unique<ZlibInputStream>(
+          std::make_unique<StringInputStream>(
+              Compress(data, ZlibFormat::kGzip)),
+          ZlibFormat::kGzip, /*input_buffer_size=*/4096),
+      /*buffer_size=*/10000, /*max_buffer_size=*/10000, host->allocator(),
+      host.get());
+  auto result = ReadAll(&stream, 777);
+  ASSERT_TRUE(!!result) << StrCat(result.takeError());
+  EXPECT_EQ(*result, data);
+}
+
+TEST(ZlibInputStreamTest, ReadConcatenatedGzipMembers) {
+  auto first = MakeData(5000);
+  auto second = MakeData(7000);
+  ZlibInputStream stream(
+      std::make_unique<StringInputStream>(Compress(first, ZlibFormat::kGzip) +
+                                          Compress(second, ZlibFormat::kGzip)),
+      ZlibFormat::kGzip, /*input_buffer_size=*/100);
+  auto result = ReadAll(&stream, 4096);
+  ASSERT_TRUE(!!result) << StrCat(result.takeError());
+  EXPECT_EQ(*result, first + second);
+}
+
+TEST(ZlibInputStreamTest, ReadEmpty) {
+  ZlibInputStream stream(std::make_unique<StringInputStream>(""),
+                         ZlibFormat::kGzip, /*input_buffer_size=*/100);
+  char buffer[10];
+  auto count = stream.Read(buffer, sizeof(buffer));
+  ASSERT_TRUE(!!count) << StrCat(count.takeError());
+  EXPECT_EQ(*count, 0);
+}
+
+TEST(ZlibInputStreamTest, ReadTruncated) {
+  auto compressed = Compress(MakeData(100000), ZlibFormat::kGzip);
+  compressed.resize(compressed.size() / 2);
+  ZlibInputStream stream(std::make_unique<StringInputStream>(compressed),
+                         ZlibFormat::kGzip, /*input_buffer_size=*/1000);
+  auto result = ReadAll(&stream, 100);
+  ASSERT_FALSE(!!result);
+  EXPECT_EQ(StrCat(result.takeError()), "unexpected end of compressed stream");
+}
+
+TEST(ZlibInputStreamTest, ParseZlibFormat) {
+  EXPECT_EQ(ParseZlibFormat("ZLIB"), ZlibFormat::kZlib);
+  EXPECT_EQ(ParseZlibFormat("GZIP"), ZlibFormat::kGzip);
+  EXPECT_FALSE(ParseZlibFormat("ZSTD").hasValue());
+}
+
+}  // namespace
+}  // namespace io
+}  // namespace tfrt
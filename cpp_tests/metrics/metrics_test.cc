@@ -0,0 +1,125 @@
+// Copyright 2022 The TensorFlow Runtime Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Unit tests for the in-process metrics registry.
+
+#include "tfrt/metrics/metrics.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "llvm/Support/raw_ostream.h"
+#include "tfrt/host_context/host_allocator.h"
+#include "tfrt/host_context/profiled_allocator.h"
+
+namespace tfrt {
+namespace metrics {
+namespace {
+
+using ::testing::HasSubstr;
+using ::testing::Not;
+
+std::string GetSnapshot() {
+  std::string result;
+  llvm::raw_string_ostream os(result);
+  WriteMetricsSnapshot(os);
+  return os.str();
+}
+
+TEST(MetricsTest, Counter) {
+  auto* counter = NewCounter("/tfrt/test/counter");
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&] {
+      for (int j = 0; j < 1000; ++j) counter->Increment();
+    });
+  }
+  for (auto& thread : threads) thread.join();
+  counter->IncrementBy(5);
+
+  auto snapshot = GetSnapshot();
+  EXPECT_THAT(snapshot, HasSubstr("# TYPE tfrt_test_counter counter\n"
+                                  "tfrt_test_counter 4005\n"));
+}
+
+TEST(MetricsTest, SameNameReturnsSameMetric) {
+  EXPECT_EQ(NewCounter("/tfrt/test/shared"), NewCounter("/tfrt/test/shared"));
+}
+
+TEST(MetricsTest, Gauges) {
+  NewGauge<int64_t>("/tfrt/test/int_gauge")->Set(-42);
+  NewGauge<std::string>("/tfrt/test/string_gauge")->Set("a \"b\"");
+
+  auto snapshot = GetSnapshot();
+  EXPECT_THAT(snapshot, HasSubstr("# TYPE tfrt_test_int_gauge gauge\n"
+                                  "tfrt_test_int_gauge -42\n"));
+  EXPECT_THAT(snapshot,
+              HasSubstr("tfrt_test_string_gauge{value=\"a \\\"b\\\"\"} 1\n"));
+}
+
+TEST(MetricsTest, Histogram) {
+  auto* histogram =
+      NewHistogram("/tfrt/test/histogram", Buckets::Explicit({1.0, 10.0}));
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&] {
+      histogram->Record(0.5);
+      histogram->Record(5);
+      histogram->Record(5);
+      histogram->Record(100);
+    });
+  }
+  for (auto& thread : threads) thread.join();
+
+  auto snapshot = GetSnapshot();
+  EXPECT_THAT(snapshot, HasSubstr("# TYPE tfrt_test_histogram histogram\n"
+                                  "tfrt_test_histogram_bucket{le=\"1\"} 4\n"
+                                  "tfrt_test_histogram_bucket{le=\"10\"} 12\n"
+                                  "tfrt_test_histogram_bucket{le=\"+Inf\"} 16\n"
+                                  "tfrt_test_histogram_sum 442\n"
+                                  "tfrt_test_histogram_count 16\n"));
+}
+
+TEST(MetricsTest, SnapshotIsSortedByName) {
+  NewCounter("/tfrt/test/sorted_b");
+  NewCounter("/tfrt/test/sorted_a");
+
+  auto snapshot = GetSnapshot();
+  auto a = snapshot.find("tfrt_test_sorted_a ");
+  auto b = snapshot.find("tfrt_test_sorted_b ");
+  ASSERT_NE(a, std::string::npos);
+  ASSERT_NE(b, std::string::npos);
+  EXPECT_LT(a, b);
+  EXPECT_THAT(snapshot, Not(HasSubstr("/tfrt")));
+}
+
+TEST(MetricsTest, HotPathMetricsAreOnlyUpdatedWhileEnabled) {
+  EXPECT_FALSE(IsMetricsEnabled());
+  auto allocator = CreateLeakCheckAllocator(CreateMallocAllocator());
+  allocator->DeallocateBytes(allocator->AllocateBytes(16, 8), 16);
+  EXPECT_THAT(GetSnapshot(), HasSubstr("tfrt_allocator_allocated_bytes 0\n"));
+
+  SetMetricsEnabled(true);
+  allocator->DeallocateBytes(allocator->AllocateBytes(16, 8), 16);
+  SetMetricsEnabled(false);
+  allocator->DeallocateBytes(allocator->AllocateBytes(16, 8), 16);
+  EXPECT_THAT(GetSnapshot(), HasSubstr("tfrt_allocator_allocated_bytes 16\n"));
+}
+
+}  // namespace
+}  // namespace metrics
+}  // namespace tfrt
@@ -14,6 +14,10 @@
 
 #include "tfrt/support/crc32c.h"
 
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
 #include "gtest/gtest.h"
 
 namespace tfrt {
@@ -54,6 +58,92 @@ TEST(Crc32cTest, AcceleratedExtend) {
   }
 }
 
+// Returns a buffer of `size` pseudo-random bytes.
+std::string MakeBuffer(size_t size) {
+  std::string buffer(size, '\0');
+  uint32_t state = 1;
+  for (auto& c : buffer) {
+    state = state * 1103515245 + 12345;
+    c = static_cast<char>(state >> 16);
+  }
+  return buffer;
+}
+
+TEST(Crc32cTest, AcceleratedExtendLargeBuffers) {
+  if (!CanAccelerate()) return;
+  // Covers the interleaved long and short blocks, and unaligned starts.
+  std::string buffer = MakeBuffer(100000);
+  for (size_t size : {767, 768, 12287, 12288, 13057, 99990}) {
+    for (size_t offset = 0; offset < 8; ++offset) {
+      EXPECT_EQ(AcceleratedExtend(123, buffer.data() + offset, size),
+                RegularExtend(123, buffer.data() + offset, size))
+          << "size " << size << " offset " << offset;
+    }
+  }
+}
+
+TEST(Crc32cTest, VerifyMasked) {
+  std::string buffer = MakeBuffer(10000);
+  std::vector<MaskedBuffer> buffers;
+  for (size_t i = 0; i < 100; ++i) {
+    const char* data = buffer.data() + i;
+    size_t size = i % 10 == 0 ? 5000 : i;
+    buffers.push_back({data, size, Mask(Value(data, size))});
+  }
+  EXPECT_EQ(VerifyMasked(buffers), buffers.size());
+
+  buffers[70].masked_crc ^= 1;
+  EXPECT_EQ(VerifyMasked(buffers), 70);
+  buffers[4].masked_crc ^= 1;
+  EXPECT_EQ(VerifyMasked(buffers), 4);
+  EXPECT_EQ(VerifyMasked({}), 0);
+}
+
+// -------------------------------------------------------------------------- //
+// Performance benchmarks are below.
+// -------------------------------------------------------------------------- //
+
+static void BM_Value(benchmark::State& state) {
+  std::string buffer = MakeBuffer(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Value(buffer.data(), buffer.size()));
+  }
+  state.SetBytesProcessed(state.iterations() * buffer.size());
+}
+BENCHMARK(BM_Value)->Arg(16)->Arg(256)->Arg(4096)->Arg(65536)->Arg(1 << 20);
+
+// Verifies the header and body of TFRecord-like records one buffer at a time.
+static void BM_VerifyEach(benchmark::State& state) {
+  std::string buffer = MakeBuffer(state.range(0));
+  uint32_t header_crc = Mask(Value(buffer.data(), 8));
+  uint32_t body_crc = Mask(Value(buffer.data(), buffer.size()));
+  for (auto _ : state) {
+    for (int i = 0; i < 64; ++i) {
+      benchmark::DoNotOptimize(Unmask(header_crc) == Value(buffer.data(), 8));
+      benchmark::DoNotOptimize(Unmask(body_crc) ==
+                               Value(buffer.data(), buffer.size()));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * 64);
+}
+BENCHMARK(BM_VerifyEach)->Arg(16)->Arg(256)->Arg(4096);
+
+// Verifies the same records as BM_VerifyEach in one batch.
+static void BM_VerifyMasked(benchmark::State& state) {
+  std::string buffer = MakeBuffer(state.range(0));
+  std::vector<MaskedBuffer> buffers;
+  for (int i = 0; i < 64; ++i) {
+    buffers.push_back({buffer.data(), 8, Mask(Value(buffer.data(), 8))});
+    buffers.push_back({buffer.data(), buffer.size(),
+                       Mask(Value(buffer.data(), buffer.size()))});
+  }
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(VerifyMasked(buffers));
+  }
+  state.SetItemsProcessed(state.iterations() * 64);
+}
+BENCHMARK(BM_VerifyMasked)->Arg(16)->Arg(256)->Arg(4096);
+
 }  // namespace
 }  // namespace crc32c
 }  // namespace tfrt
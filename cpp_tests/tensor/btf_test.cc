@@ -18,6 +18,8 @@
 
 #include "tfrt/tensor/btf.h"
 
+#include <cstring>
+
 #include "gtest/gtest.h"
 #include "llvm/Support/raw_ostream.h"
 #include "tfrt/cpp_tests/test_util.h"
@@ -103,6 +105,50 @@ TEST(BTFTest, BTFWriteAndRead) {
   }
 }
 
+TEST(BTFTest, BTFWriteRecordsAndReadFromBuffer) {
+  auto context = CreateHostContext();
+  const auto a = CreateDummyTensor<float>({2, 5}, context.get());
+  const auto b = CreateDummyTensor<int8_t>({7}, context.get());
+  std::vector<const DenseHostTensor*> tensors{&a, &b};
+
+  // Write the records first and prepend the header once they are known.
+  std::stringstream records;
+  std::vector<uint64_t> offsets;
+  uint64_t offset = sizeof(uint64_t) * (1 + tensors.size());
+  for (const auto* tensor : tensors) {
+    offsets.push_back(offset);
+    auto size = WriteDHTRecordToBTF(&records, *tensor);
+    ASSERT_TRUE(static_cast<bool>(size));
+    offset += *size;
+  }
+  std::string file(sizeof(uint64_t) * (1 + offsets.size()), '\0');
+  const uint64_t num_tensors = offsets.size();
+  std::memcpy(&file[0], &num_tensors, sizeof(num_tensors));
+  std::memcpy(&file[sizeof(num_tensors)], offsets.data(),
+              offsets.size() * sizeof(uint64_t));
+  file += records.str();
+  EXPECT_EQ(file.size(), offset);
+
+  auto buffer = HostBuffer::CreateUninitialized(file.size(), alignof(uint64_t),
+                                                context->allocator());
+  std::memcpy(buffer->data(), file.data(), file.size());
+  auto read_offsets = ReadBTFOffsets(*buffer);
+  ASSERT_TRUE(static_cast<bool>(read_offsets));
+  EXPECT_EQ(*read_offsets, offsets);
+  for (int i = 0; i < tensors.size(); i++) {
+    auto out = ReadDHTFromBTF(buffer, offsets[i]);
+    ASSERT_TRUE(static_cast<bool>(out));
+    EXPECT_EQ(*out, *tensors[i]);
+  }
+
+  // Truncated files are rejected.
+  auto truncated = HostBuffer::CreateFromExternal(buffer.CopyRef(), 0,
+                                                  file.size() - 1);
+  auto out = ReadDHTFromBTF(truncated, offsets.back());
+  EXPECT_FALSE(static_cast<bool>(out));
+  llvm::consumeError(out.takeError());
+}
+
 }  // namespace
 }  // namespace btf
 }  // namespace tfrt
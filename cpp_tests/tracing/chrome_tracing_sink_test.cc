@@ -0,0 +1,122 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Unit test for the chrome tracing sink.
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "tfrt/support/string_util.h"
+#include "tfrt/tracing/tracing.h"
+
+namespace tfrt {
+namespace tracing {
+namespace {
+
+class ChromeTracingSinkTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_FALSE(
+        llvm::sys::fs::createUniqueDirectory("chrome_tracing_sink_test", dir_));
+    setenv("TEST_UNDECLARED_OUTPUTS_DIR", dir_.c_str(), /*overwrite=*/1);
+  }
+
+  void TearDown() override { llvm::sys::fs::remove_directories(dir_); }
+
+  // Returns the number of complete events per name in the trace written when
+  // tracing was last disabled.
+  std::map<std::string, int> ReadCompleteEvents() {
+    std::map<std::string, int> counts;
+    auto buffer = llvm::MemoryBuffer::getFile(StrCat(dir_, "/trace.json"));
+    EXPECT_TRUE(!!buffer);
+    if (!buffer) return counts;
+    auto json = llvm::json::parse((*buffer)->getBuffer());
+    EXPECT_TRUE(!!json) << llvm::toString(json.takeError());
+    if (!json) return counts;
+    const auto* events = json->getAsObject()->getArray("traceEvents");
+    EXPECT_NE(events, nullptr);
+    if (!events) return counts;
+    for (const auto& value : *events) {
+      const auto* event = value.getAsObject();
+      if (event->getString("ph") != llvm::StringRef("X")) continue;
+      ++counts[event->getString("name")->str()];
+    }
+    return counts;
+  }
+
+  llvm::SmallString<128> dir_;
+};
+
+TEST_F(ChromeTracingSinkTest, WritesEventsOfExitedThreads) {
+  RequestTracing(true);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([] {
+      for (int j = 0; j < 100; ++j) {
+        TracingScope scope(TracingLevel::Default, InternTracingName("scope"));
+        RecordTracingEvent(TracingLevel::Default, [] { return "event"; });
+      }
+    });
+  }
+  for (auto& thread : threads) thread.join();
+  RequestTracing(false);
+
+  EXPECT_EQ(ReadCompleteEvents(),
+            (std::map<std::string, int>{{"event", 400}, {"scope", 400}}));
+}
+
+TEST_F(ChromeTracingSinkTest, FlushesWhileThreadsRecord) {
+  auto name_id = InternTracingName("event");
+  std::atomic<bool> done{false};
+  std::atomic<int> num_recorded{0};
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 2; ++i) {
+    threads.emplace_back([&] {
+      while (!done.load()) {
+        RecordTracingEvent(TracingLevel::Default, name_id);
+        ++num_recorded;
+        std::this_thread::yield();
+      }
+    });
+  }
+  // Each session writes a valid trace, although the threads keep recording
+  // while the ring buffers are drained.
+  for (int i = 0; i < 2; ++i) {
+    RequestTracing(true);
+    for (int start = num_recorded.load(); num_recorded.load() < start + 100;)
+      std::this_thread::yield();
+    RequestTracing(false);
+    auto counts = ReadCompleteEvents();
+    EXPECT_EQ(counts.size(), 1);
+    EXPECT_GT(counts["event"], 0);
+  }
+  done = true;
+  for (auto& thread : threads) thread.join();
+}
+
+}  // namespace
+}  // namespace tracing
+}  // namespace tfrt
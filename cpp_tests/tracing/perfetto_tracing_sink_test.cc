@@ -0,0 +1,233 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Unit test for the Perfetto tracing sink.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/FileSystem.h"
+#include "tfrt/support/string_util.h"
+#include "tfrt/tracing/tracing.h"
+
+namespace tfrt {
+namespace tracing {
+namespace {
+
+// A field of a protobuf message in wire format.
+struct ProtoField {
+  uint32_t number;
+  uint64_t value;         // For varint and fixed64 fields.
+  llvm::StringRef bytes;  // For length-delimited fields.
+};
+
+uint64_t ReadVarInt(llvm::StringRef* data) {
+  uint64_t value = 0;
+  for (int shift = 0; !data->empty(); shift += 7) {
+    uint8_t byte = data->front();
+    *data = data->drop_front();
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) break;
+  }
+  return value;
+}
+
+// Decodes the fields of a message with varint, fixed64 and length-delimited
+// fields, which are the ones written by the sink.
+std::vector<ProtoField> ParseMessage(llvm::StringRef data) {
+  std::vector<ProtoField> fields;
+  while (!data.empty()) {
+    uint64_t tag = ReadVarInt(&data);
+    ProtoField field{static_cast<uint32_t>(tag >> 3), 0, {}};
+    switch (tag & 7) {
+      case 0:
+        field.value = ReadVarInt(&data);
+        break;
+      case 1:
+        for (int i = 0; i < 8; ++i)
+          field.value |= static_cast<uint64_t>(uint8_t(data[i])) << (8 * i);
+        data = data.drop_front(8);
+        break;
+      case 2: {
+        auto size = ReadVarInt(&data);
+        field.bytes = data.take_front(size);
+        data = data.drop_front(size);
+        break;
+      }
+      default:
+        ADD_FAILURE() << "unexpected wire type " << (tag & 7);
+        return fields;
+    }
+    fields.push_back(field);
+  }
+  return fields;
+}
+
+// Returns the track events in the trace file at `path`, in the order they
+// were written, as "B <name>" for slice begins, "E" for slice ends,
+// "I <name>" for instant events, "S <id>" for flow steps and "F <id>" for
+// flow finishes.
+std::vector<std::string> ReadTrackEvents(const std::string& path) {
+  std::ifstream ifs(path, std::ios::binary);
+  std::string trace((std::istreambuf_iterator<char>(ifs)),
+                    std::istreambuf_iterator<char>());
+  std::map<uint64_t, std::string> names;
+  std::vector<std::string> events;
+  for (const auto& packet : ParseMessage(trace)) {
+    EXPECT_EQ(packet.number, 1);  // Trace.packet
+    for (const auto& field : ParseMessage(packet.bytes)) {
+      if (field.number == 12) {  // TracePacket.interned_data
+        for (const auto& event_name : ParseMessage(field.bytes)) {
+          uint64_t iid = 0;
+          std::string name;
+          for (const auto& name_field : ParseMessage(event_name.bytes)) {
+            if (name_field.number == 1) iid = name_field.value;
+            if (name_field.number == 2) name = name_field.bytes.str();
+          }
+          names[iid] = name;
+        }
+      }
+    }
+    for (const auto& field : ParseMessage(packet.bytes)) {
+      if (field.number != 11) continue;  // TracePacket.track_event
+      uint64_t type = 0, name_iid = 0;
+      std::string flow;
+      for (const auto& event_field : ParseMessage(field.bytes)) {
+        if (event_field.number == 9) type = event_field.value;
+        if (event_field.number == 10) name_iid = event_field.value;
+        if (event_field.number == 47) flow = StrCat("S ", event_field.value);
+        if (event_field.number == 48) flow = StrCat("F ", event_field.value);
+      }
+      if (!flow.empty())
+        events.push_back(flow);
+      else if (type == 1)
+        events.push_back("B " + names[name_iid]);
+      else if (type == 2)
+        events.push_back("E");
+      else if (type == 3)
+        events.push_back("I " + names[name_iid]);
+    }
+  }
+  return events;
+}
+
+class PerfettoTracingSinkTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_FALSE(llvm::sys::fs::createUniqueDirectory(
+        "perfetto_tracing_sink_test", dir_));
+  }
+
+  void TearDown() override { llvm::sys::fs::remove_directories(dir_); }
+
+  // Enables tracing into the file `name`, and returns its path.
+  std::string StartTracing(const char* name) {
+    auto path = StrCat(dir_, "/", name);
+    setenv("TFRT_PERFETTO_TRACE_PATH", path.c_str(), /*overwrite=*/1);
+    RequestTracing(true);
+    EXPECT_TRUE(IsTracingEnabled(TracingLevel::Default));
+    return path;
+  }
+
+  llvm::SmallString<128> dir_;
+};
+
+TEST_F(PerfettoTracingSinkTest, WritesEvents) {
+  auto path = StartTracing("trace.pftrace");
+  {
+    TracingScope outer(TracingLevel::Default, [] { return "outer"; });
+    RecordTracingEvent(TracingLevel::Default, [] { return "event"; });
+    TracingScope inner(TracingLevel::Default, InternTracingName("inner"));
+    RecordFlowEvent(TracingLevel::Default, 7, FlowPhase::Start);
+    RecordFlowEvent(TracingLevel::Default, 7, FlowPhase::Finish);
+  }
+  RequestTracing(false);
+
+  // Activities after tracing is disabled are not recorded.
+  RecordTracingEvent(TracingLevel::Default, [] { return "ignored"; });
+
+  EXPECT_EQ(ReadTrackEvents(path),
+            std::vector<std::string>(
+                {"B outer", "I event", "B inner", "S 7", "F 7", "E", "E"}));
+}
+
+TEST_F(PerfettoTracingSinkTest, ClosesScopesInTheirSession) {
+  auto first_path = StartTracing("first.pftrace");
+  auto outer = std::make_unique<TracingScope>(TracingLevel::Default,
+                                              [] { return "outer"; });
+  RequestTracing(false);
+
+  // The outer scope is closed while the second session is recording, which
+  // must not end a slice in the second trace.
+  auto second_path = StartTracing("second.pftrace");
+  {
+    TracingScope inner(TracingLevel::Default, [] { return "inner"; });
+    RecordTracingEvent(TracingLevel::Default, [] { return "event"; });
+  }
+  outer.reset();
+  RequestTracing(false);
+
+  EXPECT_EQ(ReadTrackEvents(first_path),
+            std::vector<std::string>({"B outer"}));
+  EXPECT_EQ(ReadTrackEvents(second_path),
+            std::vector<std::string>({"B inner", "I event", "E"}));
+}
+
+TEST_F(PerfettoTracingSinkTest, RecyclesChunksOfExitedThreads) {
+  auto path = StartTracing("trace.pftrace");
+  // Each thread takes a chunk. There are more threads than chunks, so events
+  // are only recorded for all of them if the chunks of exited threads are
+  // reused.
+  constexpr int kNumThreads = 600;
+  for (int i = 0; i < kNumThreads; ++i) {
+    std::thread([] {
+      RecordTracingEvent(TracingLevel::Default, [] { return "event"; });
+    }).join();
+  }
+  RequestTracing(false);
+
+  EXPECT_EQ(ReadTrackEvents(path),
+            std::vector<std::string>(kNumThreads, "I event"));
+}
+
+TEST_F(PerfettoTracingSinkTest, FlushesPartialChunksWhileTracing) {
+  auto path = StartTracing("trace.pftrace");
+  RecordTracingEvent(TracingLevel::Default, [] { return "event"; });
+
+  // The event is written before tracing is disabled.
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (ReadTrackEvents(path).empty() &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  EXPECT_EQ(ReadTrackEvents(path), std::vector<std::string>({"I event"}));
+  RequestTracing(false);
+}
+
+}  // namespace
+}  // namespace tracing
+}  // namespace tfrt
@@ -42,6 +42,12 @@ class BenchmarkTracingSink : TracingSink {
   void RecordTracingEvent(NameGenerator gen_name) override { gen_name(); }
   void PushTracingScope(NameGenerator gen_name) override { gen_name(); }
   void PopTracingScope() override {}
+  void RecordTracingEvent(TracingNameId name_id) override {
+    benchmark::DoNotOptimize(name_id);
+  }
+  void PushTracingScope(TracingNameId name_id) override {
+    benchmark::DoNotOptimize(name_id);
+  }
 
  private:
 };
@@ -84,6 +90,22 @@ BENCHMARK(BM_VerboseTracingEvents);
 BENCHMARK(BM_DefaultTracingEvents);
 BENCHMARK(BM_StrCatTracingEvents);
 
+static const TracingNameId kInternedName = InternTracingName("name");
+
+template <TracingLevel level>
+static void RecordInternedEvent() {
+  RecordTracingEvent(level, kInternedName);
+}
+
+static void BM_DebugInternedTracingEvents(benchmark::State& state) {
+  BenchmarkImpl(state, RecordInternedEvent<TracingLevel::Debug>);
+}
+static void BM_DefaultInternedTracingEvents(benchmark::State& state) {
+  BenchmarkImpl(state, RecordInternedEvent<TracingLevel::Default>);
+}
+BENCHMARK(BM_DebugInternedTracingEvents);
+BENCHMARK(BM_DefaultInternedTracingEvents);
+
 template <TracingLevel level, std::string (*gen_name)()>
 static void RecordScope() {
   TracingScope(level, gen_name);
@@ -106,6 +128,20 @@ BENCHMARK(BM_VerboseTracingScopes);
 BENCHMARK(BM_DefaultTracingScopes);
 BENCHMARK(BM_StrCatTracingScopes);
 
+template <TracingLevel level>
+static void RecordInternedScope() {
+  TracingScope(level, kInternedName);
+}
+
+static void BM_DebugInternedTracingScopes(benchmark::State& state) {
+  BenchmarkImpl(state, RecordInternedScope<TracingLevel::Debug>);
+}
+static void BM_DefaultInternedTracingScopes(benchmark::State& state) {
+  BenchmarkImpl(state, RecordInternedScope<TracingLevel::Default>);
+}
+BENCHMARK(BM_DebugInternedTracingScopes);
+BENCHMARK(BM_DefaultInternedTracingScopes);
+
 }  // namespace
 }  // namespace tracing
 }  // namespace tfrt
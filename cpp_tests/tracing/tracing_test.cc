@@ -38,6 +38,9 @@ MATCHER_P(FunctionReturns, value, "") { return arg() == value; }
 
 class MockTracingSink : TracingSink {
  public:
+  using TracingSink::PushTracingScope;
+  using TracingSink::RecordTracingEvent;
+
   MockTracingSink() { RegisterTracingSink(this); }
 
   MOCK_METHOD(Error, RequestTracing, (bool enable), (override));
@@ -166,6 +169,64 @@ TEST(TracingTest, Scopes) {
   TracingScope(TracingLevel::Default, [] { return "scope3"; });
 }
 
+TEST(TracingTest, InternedNames) {
+  auto foo = InternTracingName("foo");
+  auto bar = InternTracingName("bar");
+  EXPECT_NE(foo.value, bar.value);
+  EXPECT_EQ(InternTracingName("foo").value, foo.value);
+  EXPECT_EQ(GetTracingName(foo), "foo");
+  EXPECT_EQ(GetTracingName(bar), "bar");
+  EXPECT_EQ(GetTracingName(kOverflowTracingNameId), kOverflowTracingName);
+}
+
+TEST(TracingTest, FlowIdsOfReusedAddresses) {
+  int object;
+  auto first = GetFlowId(&object, FlowPhase::Start);
+  EXPECT_EQ(GetFlowId(&object, FlowPhase::Step), first);
+  EXPECT_EQ(GetFlowId(&object, FlowPhase::Finish), first);
+
+  // Starting a flow again, e.g. for a new object at the same address, gives a
+  // new id.
+  auto second = GetFlowId(&object, FlowPhase::Start);
+  EXPECT_NE(second, first);
+  EXPECT_EQ(GetFlowId(&object, FlowPhase::Finish), second);
+
+  int other;
+  EXPECT_NE(GetFlowId(&other, FlowPhase::Start), first);
+}
+
+TEST(TracingTest, FlowIdsOfEvictedAddresses) {
+  // Starts flows for other addresses until one of them takes over the slot of
+  // the first flow, whose remaining events then get a different id.
+  static char buffer[1 << 20];
+  auto first = GetFlowId(buffer, FlowPhase::Start);
+  bool evicted = false;
+  for (size_t offset = 16; offset < sizeof(buffer) && !evicted; offset += 16) {
+    auto other = GetFlowId(buffer + offset, FlowPhase::Start);
+    EXPECT_NE(other, first);
+    evicted = GetFlowId(buffer, FlowPhase::Finish) != first;
+  }
+  ASSERT_TRUE(evicted);
+  EXPECT_EQ(GetFlowId(buffer, FlowPhase::Finish),
+            reinterpret_cast<uintptr_t>(buffer) & ((uint64_t{1} << 48) - 1));
+}
+
+TEST(TracingTest, InternedScopes) {
+  TFRT_SKIP_IF(internal::kMaxTracingLevel < TracingLevel::Default);
+
+  InSequence seq;
+  NiceMock<MockTracingSink> sink;
+  RequestTracing(true);
+
+  // The default implementation forwards to the NameGenerator overload.
+  EXPECT_CALL(sink, PushTracingScope(FunctionReturns("interned"))).Times(1);
+  EXPECT_CALL(sink, PopTracingScope()).Times(1);
+  // NOLINTNEXTLINE(bugprone-unused-raii)
+  TracingScope(TracingLevel::Default, InternTracingName("interned"));
+
+  RequestTracing(false);
+}
+
 }  // namespace
 }  // namespace tracing
 }  // namespace tfrt
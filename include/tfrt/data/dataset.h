@@ -19,6 +19,7 @@
 #ifndef TFRT_LIB_DATA_DATASET_H_
 #define TFRT_LIB_DATA_DATASET_H_
 
+#include <cstdint>
 #include <memory>
 
 #include "tfrt/host_context/execution_context.h"
@@ -122,6 +123,14 @@ void DestroyImpl(SubClass* ptr, HostAllocator* allocator) {
 
 bool IsConcreteAndEmpty(const IterationResult& result);
 
+// Returns true if `result` and all its values are available, and it is not the
+// end of iteration.
+bool IsAvailableAndNotEof(const IterationResult& result);
+
+// Returns the number of bytes held by the values of an available element.
+// Only tensors are accounted for.
+int64_t GetElementBytes(const IterationResult& result);
+
 template <typename... T, size_t... I>
 static void AllocateTupleResult(
     MutableArrayRef<RCReference<AsyncValue>> results, HostContext* host,
@@ -133,8 +142,27 @@ static void AllocateTupleResult(
 
 }  // namespace internal
 
+class Autotuner;
+class IteratorStats;
+
+// Value of dataset parameters (e.g. prefetch_num) which should be tuned at
+// runtime rather than fixed.
+constexpr int64_t kAutotune = -1;
+
 // This struct provides parameters specific to iterator creation.
-struct IteratorContext {};
+struct IteratorContext {
+  // Tunes the parameters of iterators created with kAutotune. Shared by all
+  // iterators of one input pipeline. May be null, in which case such
+  // parameters use a fixed default.
+  std::shared_ptr<Autotuner> autotuner;
+  // Statistics of the iterator being created. The iterators it creates for its
+  // inputs record their statistics as its children. May be null, in which case
+  // no statistics are collected.
+  std::shared_ptr<IteratorStats> stats;
+  // Allocates the iterators which record statistics. Must be set if `stats`
+  // is set.
+  HostContext* host = nullptr;
+};
 
 class Iterator : public ReferenceCounted<Iterator> {
  public:
@@ -144,6 +172,17 @@ class Iterator : public ReferenceCounted<Iterator> {
 
   virtual IterationResult GetNext(const ExecutionContext& exec_ctx) = 0;
 
+  // Appends the results of the next `n` GetNext() calls to `results`. The
+  // default implementation calls GetNext() `n` times. Iterators override it
+  // to amortize the per-element overhead, e.g. by sharing one eof value
+  // between the available elements, and to fetch their input in batches.
+  virtual void GetNextBatch(const ExecutionContext& exec_ctx, size_t n,
+                            llvm::SmallVectorImpl<IterationResult>* results);
+
+  // Returns the statistics of this iterator and its inputs, or null if the
+  // pipeline does not collect statistics.
+  virtual const IteratorStats* stats() const { return nullptr; }
+
  protected:
   // For access to Destroy().
   friend class ReferenceCounted<Iterator>;
@@ -156,9 +195,18 @@ class Dataset : public ReferenceCounted<Dataset> {
  public:
   virtual ~Dataset() {}
 
-  // Creates an iterator that points to the first element of the dataset.
-  // The iterator should keep +1 reference to the parent_dataset.
-  virtual RCReference<Iterator> MakeIterator(
+  // Creates an iterator that points to the first element of the dataset. If
+  // `context` collects statistics, the iterator records them as an input of the
+  // iterator being created with `context`.
+  RCReference<Iterator> MakeIterator(const IteratorContext& context);
+
+  // The name of the dataset in iterator statistics, e.g. "map".
+  virtual string_view name() const = 0;
+
+ protected:
+  // Creates the iterator for MakeIterator(). The iterator should keep +1
+  // reference to the parent_dataset.
+  virtual RCReference<Iterator> MakeIteratorInternal(
       const IteratorContext& context) = 0;
 
  private:
@@ -20,26 +20,41 @@
 #ifndef TFRT_IO_BUFFERED_INPUT_STREAM_H_
 #define TFRT_IO_BUFFERED_INPUT_STREAM_H_
 
+#include <memory>
+#include <string>
+
 #include "tfrt/host_context/host_allocator.h"
 #include "tfrt/io/input_stream.h"
 
 namespace tfrt {
+
+class HostContext;
+
 namespace io {
 
+// BufferedInputStream reads from another input stream in chunks of
+// `buffer_size` bytes, which are buffered.
+//
+// If `host` is not null, the next chunk is read ahead by a blocking work queue
+// thread while the current chunk is read, so that the reads of the input stream
+// overlap with the processing of the bytes read. A chunk whose read has not
+// started when it is needed is read by the reading thread. If a chunk read
+// ahead is not ready when it is needed, the input stream can not keep up, and
+// the size of the following chunks is doubled up to `max_buffer_size` bytes,
+// so that fewer and larger reads amortize the latency of the input stream.
 class BufferedInputStream : public InputStream {
  public:
+  // Reads chunks of `buffer_size` bytes synchronously.
   explicit BufferedInputStream(std::unique_ptr<InputStream> input_stream,
                                size_t buffer_size, HostAllocator* allocator)
-      : input_stream_(std::move(input_stream)),
-        allocator_(allocator),
-        buffer_size_(buffer_size) {
-    assert(buffer_size_ > 0);
-    buffer_ = allocator_->Allocate<char>(buffer_size_);
-  }
+      : BufferedInputStream(std::move(input_stream), buffer_size, buffer_size,
+                            allocator, /*host=*/nullptr) {}
+
+  BufferedInputStream(std::unique_ptr<InputStream> input_stream,
+                      size_t buffer_size, size_t max_buffer_size,
+                      HostAllocator* allocator, HostContext* host);
 
-  ~BufferedInputStream() override {
-    allocator_->Deallocate(buffer_, buffer_size_);
-  }
+  ~BufferedInputStream() override;
 
   // This class is not copyable or movable.
   BufferedInputStream(const BufferedInputStream&) = delete;
@@ -50,18 +65,36 @@ class BufferedInputStream : public InputStream {
   llvm::Expected<size_t> Tell() override;
 
  private:
-  std::unique_ptr<InputStream> input_stream_;
-  HostAllocator* allocator_;
-  // The pointer to the buffer.
-  char* buffer_ = nullptr;
-  // The size of buffer in bytes that is allocated and can be written.
-  size_t buffer_size_ = 0;
-  // The position of the next byte in the buffer to be read.
-  size_t buffer_pos_ = 0;
-  // The range [0, buffer_limit_) of the buffer holds valid bytes that can be
-  // read. It is guaranteed that buffer_limit_ <= buffer_size_. It could contain
-  // error from the last read of the input_stream_.
-  llvm::Expected<size_t> buffer_limit_ = 0;
+  class ReadAhead;
+
+  // A chunk of bytes read from the input stream.
+  struct Chunk {
+    // The buffer, which holds `capacity` bytes allocated by the allocator.
+    char* data = nullptr;
+    size_t capacity = 0;
+    // The number of bytes read into the buffer.
+    size_t size = 0;
+    // Whether the input stream ended with this chunk.
+    bool eof = false;
+    // The error that occurred after the bytes read, if any.
+    std::string error;
+  };
+
+  // Makes the next chunk the current one and schedules the read of the chunk
+  // following it.
+  void AdvanceChunk();
+
+  // Shared with the blocking work queue tasks that read chunks ahead.
+  std::shared_ptr<ReadAhead> read_ahead_;
+  HostContext* host_;
+  // The size of the chunks to read.
+  size_t buffer_size_;
+  const size_t max_buffer_size_;
+  // Whether the read of the next chunk was scheduled.
+  bool next_scheduled_ = false;
+  Chunk current_;
+  // The position of the next byte in current_ to be read.
+  size_t current_pos_ = 0;
   // Current position in this stream.
   size_t stream_pos_ = 0;
 };
@@ -0,0 +1,99 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// This file declares EmulatedRemoteFileSystem, which serves the files of a
+// local directory like a remote object store.
+
+#ifndef TFRT_IO_EMULATED_REMOTE_FILE_SYSTEM_H_
+#define TFRT_IO_EMULATED_REMOTE_FILE_SYSTEM_H_
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tfrt/io/file_system.h"
+
+namespace tfrt {
+namespace io {
+
+class EmulatedRemoteStore;
+
+struct EmulatedRemoteFileSystemOptions {
+  // The local directory that holds the objects. The object at
+  // "<scheme>://bucket/key" is the file at "<root>/bucket/key".
+  std::string root;
+  // The time from sending a request until its first byte arrives.
+  std::chrono::microseconds latency{0};
+  // The bytes per second that each request transfers, or 0 for no limit.
+  int64_t bandwidth = 0;
+  // Reads are split into ranged requests of `block_size` bytes at aligned
+  // offsets, which are sent in parallel.
+  size_t block_size = 1 << 20;
+  // The number of requests that are sent in parallel.
+  int num_parallel_requests = 8;
+  // The bytes of the most recently used blocks that are cached, or 0 to
+  // disable the cache.
+  size_t cache_size = 64 << 20;
+};
+
+// EmulatedRemoteFileSystem is used to develop and benchmark reads from high
+// latency storage without a live service. It is registered for a scheme like
+// "s3" or "gs", and each request for a range of an object sleeps for the
+// configured latency and transfer time before reading the local file.
+//
+// Reads of files are split into blocks, whose requests are sent in parallel
+// by a pool of threads, and the blocks are kept in a cache that is shared by
+// all files of the file system.
+class EmulatedRemoteFileSystem : public FileSystem {
+ public:
+  explicit EmulatedRemoteFileSystem(std::string scheme,
+                                    EmulatedRemoteFileSystemOptions options);
+
+  ~EmulatedRemoteFileSystem() override;
+
+  // This class is not copyable or movable.
+  EmulatedRemoteFileSystem(const EmulatedRemoteFileSystem&) = delete;
+  EmulatedRemoteFileSystem& operator=(const EmulatedRemoteFileSystem&) =
+      delete;
+
+  llvm::Error NewRandomAccessFile(
+      const std::string& path,
+      std::unique_ptr<RandomAccessFile>* file) override;
+
+  // Lists the objects that match `pattern`, which costs one request.
+  llvm::Error GetMatchingPaths(const std::string& pattern,
+                               std::vector<std::string>* paths) override;
+
+  // The number of requests sent so far, including listings.
+  int64_t num_requests() const;
+
+  // The number of block reads that were served from the cache.
+  int64_t num_cache_hits() const;
+
+  // The largest number of requests that were in flight at the same time.
+  int64_t max_requests_in_flight() const;
+
+ private:
+  // Shared with the files, which may outlive the file system.
+  std::shared_ptr<EmulatedRemoteStore> store_;
+};
+
+}  // namespace io
+}  // namespace tfrt
+
+#endif  // TFRT_IO_EMULATED_REMOTE_FILE_SYSTEM_H_
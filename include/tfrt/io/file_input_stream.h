@@ -25,10 +25,14 @@
 namespace tfrt {
 namespace io {
 
+// FileInputStream reads a file from its start to its end, and hints the file
+// to be accessed sequentially.
 class FileInputStream : public InputStream {
  public:
   explicit FileInputStream(std::unique_ptr<RandomAccessFile> file)
-      : file_(std::move(file)) {}
+      : file_(std::move(file)) {
+    file_->HintSequentialAccess();
+  }
 
   // This class is not copyable or movable.
   FileInputStream(const FileInputStream&) = delete;
@@ -19,7 +19,12 @@
 #ifndef TFRT_IO_FILE_SYSTEM_H_
 #define TFRT_IO_FILE_SYSTEM_H_
 
+#include <string>
+#include <vector>
+
 #include "llvm/ADT/StringMap.h"
+#include "tfrt/host_context/async_value_ref.h"
+#include "tfrt/host_context/host_buffer.h"
 #include "tfrt/support/error_util.h"
 #include "tfrt/support/mutex.h"
 #include "tfrt/support/thread_annotations.h"
@@ -32,6 +37,14 @@ namespace io {
 // registered for the same sceheme.
 enum class FileSystemPriority : int { kDefault = 1, kHigh = 2 };
 
+// Returns the scheme of `path`, e.g. "gs" for "gs://bucket/file". Returns the
+// empty default scheme if `path` has no scheme, e.g. for a local path.
+string_view GetScheme(string_view path);
+
+// The alignment of the buffer, offset and size of the reads that files opened
+// for direct IO can read without copying.
+constexpr size_t kDirectIOAlignment = 4096;
+
 // An interface that declares operations to read bytes from a random access
 // file.
 class RandomAccessFile {
@@ -51,6 +64,34 @@ class RandomAccessFile {
   // On error, llvm::Error is returned.
   virtual llvm::Expected<size_t> Read(char* buf, size_t max_count,
                                       size_t offset) const = 0;
+
+  // This method asynchronously reads up to `max_count` bytes starting at
+  // `offset` into the buffer starting at `buf`, with the same semantics as
+  // Read(). The returned value becomes available with the number of bytes
+  // read, or with an error. `buf` and this file must stay alive until then.
+  //
+  // The default implementation runs Read() in a task on the blocking work
+  // queue of `host`.
+  virtual AsyncValueRef<size_t> ReadAsync(char* buf, size_t max_count,
+                                          size_t offset,
+                                          HostContext* host) const;
+
+  // This method returns a buffer that references up to `max_count` bytes of
+  // the underlying IO source starting at `offset`, without copying them. The
+  // buffer is shorter than `max_count` bytes if the IO source ends before. It
+  // stays valid after this file is destroyed.
+  //
+  // Returns a null reference if the file does not support zero-copy reads.
+  virtual RCReference<HostBuffer> ReadView(size_t offset,
+                                           size_t max_count) const {
+    return {};
+  }
+
+  // This method hints that the file will be read sequentially from start to
+  // end, so that the IO source can read ahead more aggressively.
+  //
+  // The default implementation does nothing.
+  virtual void HintSequentialAccess() const {}
 };
 
 // An interface that declares operations to manage files in a file system.
@@ -68,6 +109,41 @@ class FileSystem {
   virtual llvm::Error NewRandomAccessFile(
       const std::string& path, std::unique_ptr<RandomAccessFile>* file) = 0;
 
+  // Creates a read-only random access file at the given `path`, whose contents
+  // are mapped into memory so that ReadView() does not copy them.
+  //
+  // The default implementation calls NewRandomAccessFile(), so ReadView() of
+  // the returned file may return null.
+  virtual llvm::Error NewMappedRandomAccessFile(
+      const std::string& path, std::unique_ptr<RandomAccessFile>* file) {
+    return NewRandomAccessFile(path, file);
+  }
+
+  // Creates a read-only random access file at the given `path`, which is read
+  // with direct IO so that it bypasses the page cache. Reads whose buffer,
+  // offset and size are aligned to kDirectIOAlignment read into the buffer
+  // directly. Other reads are staged in aligned buffers from `allocator` and
+  // copied.
+  //
+  // The default implementation calls NewRandomAccessFile(), so the file may be
+  // read through the page cache.
+  virtual llvm::Error NewDirectRandomAccessFile(
+      const std::string& path, HostAllocator* allocator,
+      std::unique_ptr<RandomAccessFile>* file) {
+    return NewRandomAccessFile(path, file);
+  }
+
+  // Stores the paths of the files that match the glob `pattern` in `paths`, in
+  // sorted order. A pattern without wildcards matches the file at that path,
+  // if it exists.
+  //
+  // The default implementation returns an error.
+  virtual llvm::Error GetMatchingPaths(const std::string& pattern,
+                                       std::vector<std::string>* paths) {
+    paths->clear();
+    return MakeStringError("the file system does not support matching paths");
+  }
+
   // Returns the priority of this file system. The file system with the highest
   // priority will be used if multiple file systems have been registered for the
   // same scheme.
@@ -105,6 +181,11 @@ class FileSystemRegistry {
   // FileSystemRegistry::Register(...).
   FileSystem* Lookup(const std::string& scheme);
 
+  // Returns the file system registered for the scheme of `path`, or null.
+  FileSystem* LookupForPath(string_view path) {
+    return Lookup(GetScheme(path).str());
+  }
+
  private:
   mutex mu_;
   llvm::StringMap<std::unique_ptr<FileSystem>> file_systems_
@@ -0,0 +1,88 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// This file declares the ZlibInputStream class which decompresses data from
+// another input stream.
+
+#ifndef TFRT_IO_ZLIB_INPUT_STREAM_H_
+#define TFRT_IO_ZLIB_INPUT_STREAM_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "llvm/ADT/Optional.h"
+#include "tfrt/io/input_stream.h"
+#include "tfrt/support/forward_decls.h"
+
+struct z_stream_s;
+
+namespace tfrt {
+namespace io {
+
+// The format of a compressed stream read by ZlibInputStream.
+enum class ZlibFormat {
+  // A zlib stream (RFC 1950).
+  kZlib,
+  // A gzip stream (RFC 1952). Concatenated gzip members are read as one
+  // stream.
+  kGzip,
+};
+
+// Returns the format for a TFRecord compression type, which is "ZLIB" or
+// "GZIP", or None if the compression type is not supported.
+llvm::Optional<ZlibFormat> ParseZlibFormat(string_view compression_type);
+
+// ZlibInputStream decompresses the bytes read from another input stream, which
+// are read in chunks of `input_buffer_size` bytes. Bytes are decompressed
+// directly into the buffer passed to Read().
+//
+// To decompress ahead of the reads, wrap the stream in a BufferedInputStream
+// that reads ahead.
+class ZlibInputStream : public InputStream {
+ public:
+  ZlibInputStream(std::unique_ptr<InputStream> input_stream, ZlibFormat format,
+                  size_t input_buffer_size);
+
+  ~ZlibInputStream() override;
+
+  // This class is not copyable or movable.
+  ZlibInputStream(const ZlibInputStream&) = delete;
+  ZlibInputStream& operator=(const ZlibInputStream&) = delete;
+
+  // If an error occurs, returns it even if some bytes were decompressed by this
+  // call. Once an error occurred, it is returned by all calls.
+  llvm::Expected<size_t> Read(char* buf, size_t max_count) override;
+
+  llvm::Expected<size_t> Tell() override;
+
+ private:
+  const std::unique_ptr<InputStream> input_stream_;
+  std::vector<char> input_buffer_;
+  bool input_eof_ = false;
+  std::unique_ptr<z_stream_s> stream_;
+  // Whether a compressed stream is started and not finished yet.
+  bool in_member_ = false;
+  // The error that occurred, if any.
+  std::string error_;
+  // Current position in the decompressed stream.
+  size_t stream_pos_ = 0;
+};
+
+}  // namespace io
+}  // namespace tfrt
+
+#endif  // TFRT_IO_ZLIB_INPUT_STREAM_H_
@@ -19,10 +19,14 @@
 #ifndef TFRT_METRICS_METRICS_H_
 #define TFRT_METRICS_METRICS_H_
 
+#include <atomic>
+#include <cstdint>
 #include <string>
 
+#include "counter.h"
 #include "gauge.h"
 #include "histogram.h"
+#include "tfrt/support/forward_decls.h"
 
 namespace tfrt {
 namespace metrics {
@@ -37,12 +41,50 @@ Gauge<T>* NewGauge(std::string name);
 template <>
 Gauge<std::string>* NewGauge(std::string name);
 
+template <>
+Gauge<int64_t>* NewGauge(std::string name);
+
+//===----------------------------------------------------------------------===//
+// Methods to create Counter metrics
+//===----------------------------------------------------------------------===//
+
+Counter* NewCounter(std::string name);
+
 //===----------------------------------------------------------------------===//
 // Methods to create Histogram metrics
 //===----------------------------------------------------------------------===//
 
 Histogram* NewHistogram(std::string name, const Buckets& buckets);
 
+//===----------------------------------------------------------------------===//
+// Methods to enable metrics on hot paths
+//===----------------------------------------------------------------------===//
+
+namespace internal {
+// Whether metrics which are updated on hot paths are collected.
+extern std::atomic<bool> kMetricsEnabled;
+}  // namespace internal
+
+// Enables or disables the metrics which are updated on hot paths, e.g. once
+// per kernel or per allocation. They are disabled by default, and enabled by
+// RegisterMetricsRegistry().
+void SetMetricsEnabled(bool enabled);
+
+// Returns whether metrics on hot paths should be updated. Check it before
+// updating such a metric, so that runs without metrics only pay for the load.
+inline bool IsMetricsEnabled() {
+  return internal::kMetricsEnabled.load(std::memory_order_relaxed);
+}
+
+//===----------------------------------------------------------------------===//
+// Methods to export metrics
+//===----------------------------------------------------------------------===//
+
+// Writes the current value of all metrics of the in-process registry in the
+// Prometheus text exposition format. Metrics created through an external
+// registry (see RegisterMetricsRegistry) are not included.
+void WriteMetricsSnapshot(raw_ostream& os);
+
 }  // namespace metrics
 }  // namespace tfrt
 
@@ -19,8 +19,10 @@
 #ifndef TFRT_METRICS_METRICS_REGISTRY_H_
 #define TFRT_METRICS_METRICS_REGISTRY_H_
 
+#include <cstdint>
 #include <string>
 
+#include "counter.h"
 #include "gauge.h"
 #include "histogram.h"
 
@@ -34,6 +36,12 @@ class MetricsRegistry {
   virtual Gauge<std::string>* NewStringGauge(std::string name) = 0;
 
   virtual Histogram* NewHistogram(std::string name, const Buckets& buckets) = 0;
+
+  // The metric kinds below are optional. Returning nullptr falls back to the
+  // in-process registry.
+  virtual Gauge<int64_t>* NewIntGauge(std::string name) { return nullptr; }
+
+  virtual Counter* NewCounter(std::string name) { return nullptr; }
 };
 
 namespace internal {
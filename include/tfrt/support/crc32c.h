@@ -23,6 +23,7 @@
 
 #include <stddef.h>
 
+#include "llvm/ADT/ArrayRef.h"
 #include "tfrt/support/forward_decls.h"
 
 namespace tfrt {
@@ -54,6 +55,19 @@ inline uint32_t Unmask(uint32_t masked_crc) {
   return ((rot >> 17) | (rot << 15));
 }
 
+// A buffer together with the masked crc32c it is expected to have.
+struct MaskedBuffer {
+  const char* data;
+  size_t size;
+  uint32_t masked_crc;
+};
+
+// Return the index of the first buffer whose crc32c does not match its masked
+// crc, or buffers.size() if all of them match. The crcs of several buffers are
+// computed at once, which is faster than calling Value() for each buffer when
+// the buffers are small.
+size_t VerifyMasked(ArrayRef<MaskedBuffer> buffers);
+
 }  // namespace crc32c
 }  // namespace tfrt
 
@@ -28,6 +28,7 @@
 #include "llvm/Support/Error.h"
 #include "tfrt/dtype/dtype.h"
 #include "tfrt/host_context/async_dispatch.h"
+#include "tfrt/host_context/host_buffer.h"
 #include "tfrt/host_context/kernel_utils.h"
 #include "tfrt/support/error_util.h"
 #include "tfrt/support/forward_decls.h"
@@ -197,6 +198,21 @@ Expected<DenseHostTensor> ReadDHTFromBTF(std::istream* stream, uint64_t offset,
 // only supports DenseHostTensors.
 Error WriteTensorsToBTF(std::ostream* stream, ArrayRef<const Tensor*> tensors);
 
+// Writes the TENSOR_RECORD of `dht` and returns its size in bytes. This allows
+// writing the records of a BTF-file before the number of tensors is known.
+Expected<uint64_t> WriteDHTRecordToBTF(std::ostream* stream,
+                                       const DenseHostTensor& dht);
+
+// Reads the TENSOR_RECORD_OFFSETs of all tensors from `buffer`, which holds a
+// whole BTF-file.
+Expected<std::vector<uint64_t>> ReadBTFOffsets(const HostBuffer& buffer);
+
+// Returns a DHT for the TENSOR_RECORD at the given offset in `buffer`, which
+// holds a whole BTF-file (e.g. a memory mapped file). The tensor data is not
+// copied: the DHT references `buffer`.
+Expected<DenseHostTensor> ReadDHTFromBTF(const RCReference<HostBuffer>& buffer,
+                                         uint64_t offset);
+
 }  // namespace tfrt
 
 #endif  // TFRT_TENSOR_BTF_UTIL_H_
@@ -34,6 +34,22 @@
 namespace tfrt {
 namespace tracing {
 
+// Phase of a flow event. Flows connect causally related activities, possibly
+// on different threads, e.g. the kernel producing an AsyncValue and the kernel
+// consuming it. A flow is identified by an id that is unique for the duration
+// of the flow and consists of one Start event, optional Step events (e.g. when
+// the AsyncValue becomes available) and one or more Finish events.
+enum class FlowPhase {
+  Start,
+  Step,
+  Finish,
+};
+
+// Id of a name registered with InternTracingName().
+struct TracingNameId {
+  uint32_t value;
+};
+
 class TracingSink {
  public:
   using NameGenerator = llvm::function_ref<std::string()>;
@@ -54,6 +70,18 @@ class TracingSink {
   // Ends the tracing scope from top of the calling thread's stack.
   // May be called after trace recording has been disabled.
   virtual void PopTracingScope() = 0;
+
+  // Overloads taking a pre-interned name. Sinks that store activities should
+  // override these to record the id and resolve the name with GetTracingName()
+  // when exporting. The default implementations forward to the overloads
+  // above.
+  virtual void RecordTracingEvent(TracingNameId name_id);
+  virtual void PushTracingScope(TracingNameId name_id);
+
+  // Records a flow event for the calling thread. The flow is attached to the
+  // innermost tracing scope of the thread. Sinks without flow support ignore
+  // these events.
+  virtual void RecordFlowEvent(uint64_t flow_id, FlowPhase phase) {}
 };
 
 // Enum specifying the verbosity of tracing activities.
@@ -99,6 +127,19 @@ extern TracingLevel kTracingLevel;
 extern std::atomic<TracingLevel> kCurrentTracingLevel;
 }  // namespace internal
 
+// Registers `name` and returns its id. Interning the same name again returns
+// the same id. This takes a lock and is meant to be called once per name
+// outside the hot path, e.g. when a BEF file is loaded. Ids are never released.
+// Once the table of names is full, new names are not registered and
+// kOverflowTracingNameId is returned.
+TracingNameId InternTracingName(string_view name);
+// Id returned for names which could not be registered. GetTracingName()
+// resolves it to kOverflowTracingName.
+constexpr TracingNameId kOverflowTracingNameId{~uint32_t{0}};
+constexpr char kOverflowTracingName[] = "<too many tracing names>";
+// Returns the name registered for `name_id`. This does not take a lock.
+string_view GetTracingName(TracingNameId name_id);
+
 // Registers the tracing sink. Only one sink can be registered at any time.
 // Tracing needs to be disabled during registration.
 void RegisterTracingSink(TracingSink* tracing_sink);
@@ -143,6 +184,37 @@ inline void RecordTracingEvent(TracingLevel level,
   }
 }
 
+inline void RecordTracingEvent(TracingLevel level, TracingNameId name_id) {
+  if (IsTracingEnabled(level)) {
+    internal::kTracingSink->RecordTracingEvent(name_id);
+  }
+}
+
+// Returns the flow id for a flow of the object at `address`, e.g. an
+// AsyncValue. Addresses are reused once an object is destroyed, so the id
+// combines the lower 48 bits of the address with a generation counter in the
+// upper 16 bits. A Start event begins a new generation for the address, the
+// other phases use the current one. The generations are kept in a fixed-size
+// lock-free table indexed by a hash of the address. If another address with
+// the same hash starts a flow before this one finishes, the remaining events
+// of this flow get generation 0, which matches no started flow.
+uint64_t GetFlowId(const void* address, FlowPhase phase);
+
+// Functions to add a flow event.
+inline void RecordFlowEvent(TracingLevel level, uint64_t flow_id,
+                            FlowPhase phase) {
+  if (IsTracingEnabled(level)) {
+    internal::kTracingSink->RecordFlowEvent(flow_id, phase);
+  }
+}
+
+inline void RecordFlowEvent(TracingLevel level, const void* address,
+                            FlowPhase phase) {
+  if (IsTracingEnabled(level)) {
+    internal::kTracingSink->RecordFlowEvent(GetFlowId(address, phase), phase);
+  }
+}
+
 // RAII class that pushes/pops a tracing scope.
 class TracingScope {
   // No copy or assignment.
@@ -155,6 +227,11 @@ class TracingScope {
     if (enabled_) internal::kTracingSink->PushTracingScope(get_name);
   }
 
+  TracingScope(TracingLevel level, TracingNameId name_id)
+      : enabled_(IsTracingEnabled(level)) {
+    if (enabled_) internal::kTracingSink->PushTracingScope(name_id);
+  }
+
   ~TracingScope() {
     if (enabled_) internal::kTracingSink->PopTracingScope();
   }
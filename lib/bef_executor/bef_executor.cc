@@ -30,6 +30,7 @@
 #include "tfrt/host_context/host_context.h"
 #include "tfrt/host_context/kernel_frame.h"
 #include "tfrt/host_context/location.h"
+#include "tfrt/metrics/metrics.h"
 #include "tfrt/support/forward_decls.h"
 #include "tfrt/support/ref_count.h"
 #include "tfrt/tracing/tracing.h"
@@ -302,8 +303,37 @@ struct StackOverflowGuard {
 
   static bool MustEnqueue() { return stack_depth >= kMaxStackDepth; }
 };
+
+metrics::Counter* GetKernelsExecutedCounter() {
+  static auto* counter =
+      metrics::NewCounter("/tfrt/bef_executor/kernels_executed");
+  return counter;
+}
+
+metrics::Counter* GetKernelErrorsPropagatedCounter() {
+  static auto* counter =
+      metrics::NewCounter("/tfrt/bef_executor/kernel_errors_propagated");
+  return counter;
+}
 }  // namespace
 
+static AsyncValue* GetPointer(AsyncValue* value) { return value; }
+static AsyncValue* GetPointer(const RCReference<AsyncValue>& value) {
+  return value.get();
+}
+
+// Records flow events linking the kernel producing an AsyncValue to the
+// kernels consuming it. The flow id is derived from the AsyncValue address, see
+// tracing::GetFlowId().
+template <typename T>
+static void RecordKernelFlows(ArrayRef<T> values, tracing::FlowPhase phase) {
+  if (!tracing::IsTracingEnabled(tracing::TracingLevel::Debug)) return;
+  for (const auto& value : values) {
+    if (AsyncValue* ptr = GetPointer(value))
+      tracing::RecordFlowEvent(tracing::TracingLevel::Debug, ptr, phase);
+  }
+}
+
 // Enqueue the `users` of the `result` for later processing. If the result has
 // no users, it will be skipped. If the result is immediately available, then we
 // push them to `ready_kernel_queue`, otherwise we need to enqueue them into
@@ -351,6 +381,8 @@ LLVM_ATTRIBUTE_ALWAYS_INLINE void BEFExecutor::ProcessUsedBysAndSetRegister(
     auto continuation = [this, stream_id, users, result_register,
                          result = std::move(result)]() mutable {
       ReadyKernelQueue ready_kernel_queue(stream_id, kernel_infos());
+      RecordKernelFlows(ArrayRef<AsyncValue*>(result.get()),
+                        tracing::FlowPhase::Step);
 
       // SetRegisterValue() must be done before
       // DecrementReadyCountAndEnqueue() because as soon as we decrement a
@@ -498,13 +530,21 @@ void BEFExecutor::ProcessReadyKernel(unsigned kernel_id,
 
     // TODO(b/210018544): Move tracing and debugging code to kernel registration
     // so that we don't have extra bookkeeping in bef executor.
-    TFRT_TRACE_SCOPE(Debug, BefFile()->GetKernelName(kernel.kernel_code()));
+    tracing::TracingScope tracing_scope(
+        tracing::TracingLevel::Debug,
+        BefFile()->GetKernelTracingNameId(kernel.kernel_code()));
+    RecordKernelFlows(kernel_frame->GetArguments(), tracing::FlowPhase::Finish);
 
     // kernel_fn should populate results in kernel_frame with pointers to
     // AsyncValue before it returns.
     kernel_fn(kernel_frame);
+
+    RecordKernelFlows(kernel_frame->GetResults(), tracing::FlowPhase::Start);
+    if (metrics::IsMetricsEnabled()) GetKernelsExecutedCounter()->Increment();
   } else {
     // Otherwise, automatically propagate errors to the result values.
+    if (metrics::IsMetricsEnabled())
+      GetKernelErrorsPropagatedCounter()->Increment();
     for (size_t i = 0, e = kernel_frame->GetNumResults(); i != e; ++i) {
       kernel_frame->SetResultAt(i, FormRef(any_error_argument));
     }
@@ -230,6 +230,7 @@ bool BEFFileReader::ReadKernelsSection(HostAllocator* host_allocator) {
 #endif
 
   bef_file_->kernels_.reserve(num_kernels);
+  bef_file_->kernel_tracing_name_ids_.reserve(num_kernels);
   while (num_kernels--) {
     // Each kernel is encoded as an offset into the string table of the
     // kernel name.
@@ -256,6 +257,8 @@ bool BEFFileReader::ReadKernelsSection(HostAllocator* host_allocator) {
 
     // Otherwise remember it.
     bef_file_->kernels_.push_back(kernel);
+    bef_file_->kernel_tracing_name_ids_.push_back(
+        tracing::InternTracingName(kernel_name));
   }
 
   return true;
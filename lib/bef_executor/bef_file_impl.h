@@ -32,6 +32,7 @@
 #include "tfrt/host_context/location.h"
 #include "tfrt/host_context/native_function.h"
 #include "tfrt/support/forward_decls.h"
+#include "tfrt/tracing/tracing.h"
 
 namespace tfrt {
 
@@ -310,6 +311,13 @@ class BEFFileImpl : public BEFFile {
   // returns "unknown".
   const char* GetKernelName(size_t kernel_id) const;
 
+  // Returns the tracing name id of the kernel, interned when the BEF file was
+  // loaded.
+  tracing::TracingNameId GetKernelTracingNameId(uint32_t kernel_code) const {
+    assert(kernel_code < kernel_tracing_name_ids_.size());
+    return kernel_tracing_name_ids_[kernel_code];
+  }
+
   AsyncKernelImplementation GetAsyncKernel(uint32_t kernel_code) const {
     assert(kernel_code < kernels_.size());
     const KernelImplementation& kernel_impl = kernels_[kernel_code];
@@ -335,6 +343,7 @@ class BEFFileImpl : public BEFFile {
   ArrayRef<uint8_t> function_section_;
   ArrayRef<uint8_t> function_index_section_;
   llvm::SmallVector<KernelImplementation, 8> kernels_;
+  llvm::SmallVector<tracing::TracingNameId, 8> kernel_tracing_name_ids_;
   llvm::SmallVector<TypeName, 8> type_names_;
   llvm::StringMap<size_t> function_symbol_table_;
   llvm::SmallVector<std::unique_ptr<Function>, 8> functions_;
@@ -0,0 +1,221 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// This file implements the Autotuner class.
+
+#include "autotuner.h"
+
+#include <algorithm>
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "tfrt/host_context/async_dispatch.h"
+
+namespace tfrt {
+namespace data {
+namespace {
+
+// The consumer of a node is considered starved if it waited for at least
+// 1/kStarvedFraction of the tuning period.
+constexpr int64_t kStarvedFraction = 100;
+// Number of tuning periods without consumer waits before a node is shrunk.
+constexpr int kIdlePeriodsBeforeShrink = 10;
+
+int64_t NowNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+}  // namespace
+
+//===----------------------------------------------------------------------===//
+// AutotuneNode methods
+//===----------------------------------------------------------------------===//
+AutotuneNode::AutotuneNode(std::string name, int64_t initial_value,
+                           int64_t min_value, int64_t max_value,
+                           int64_t elements_per_unit,
+                           std::shared_ptr<Autotuner> autotuner,
+                           HostContext* host)
+    : name_(std::move(name)),
+      min_value_(min_value),
+      max_value_(max_value),
+      elements_per_unit_(elements_per_unit),
+      autotuner_(std::move(autotuner)),
+      allocator_(host->allocator()),
+      value_(std::min(std::max(initial_value, min_value), max_value)) {
+  assert(elements_per_unit_ > 0);
+  autotuner_->Register(this);
+}
+
+AutotuneNode::~AutotuneNode() { autotuner_->Unregister(this); }
+
+template <typename F>
+void AutotuneNode::WhenAvailable(const IterationResult& result, F&& callback) {
+  auto values = result.AsyncValues();
+  bool is_available = llvm::all_of(
+      values, [](const AsyncValue* value) { return value->IsAvailable(); });
+  if (is_available) {
+    callback(0, result);
+    return;
+  }
+  RunWhenReady(values, [start = NowNanos(), result = result.CopyRef(),
+                        callback = std::forward<F>(callback)]() mutable {
+    callback(NowNanos() - start, result);
+  });
+}
+
+void AutotuneNode::TrackProduction(const IterationResult& result) {
+  WhenAvailable(result, [node = FormRef(this)](int64_t nanos,
+                                               const IterationResult& result) {
+    if (result.eof.IsError() || result.eof.get()) return;
+    node->RecordProduction(nanos, internal::GetElementBytes(result));
+  });
+}
+
+void AutotuneNode::TrackConsumption(const IterationResult& result) {
+  WhenAvailable(result,
+                [node = FormRef(this)](int64_t nanos, const IterationResult&) {
+                  if (nanos > 0) node->RecordConsumerWait(nanos);
+                });
+}
+
+void AutotuneNode::RecordProduction(int64_t nanos, int64_t bytes) {
+  num_produced_.fetch_add(1, std::memory_order_relaxed);
+  production_nanos_.fetch_add(nanos, std::memory_order_relaxed);
+  produced_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+  autotuner_->MaybeTune();
+}
+
+void AutotuneNode::RecordConsumerWait(int64_t nanos) {
+  consumer_wait_nanos_.fetch_add(nanos, std::memory_order_relaxed);
+}
+
+//===----------------------------------------------------------------------===//
+// Autotuner methods
+//===----------------------------------------------------------------------===//
+Autotuner::Autotuner(int64_t memory_budget, std::chrono::milliseconds period)
+    : memory_budget_(memory_budget),
+      period_(period),
+      next_tune_nanos_(NowNanos() + period_.count()) {}
+
+std::shared_ptr<Autotuner> Autotuner::Default() {
+  // Leaked, since iterators may outlive static destruction.
+  static auto* autotuner =
+      new std::shared_ptr<Autotuner>(std::make_shared<Autotuner>());
+  return *autotuner;
+}
+
+void Autotuner::MaybeTune() {
+  auto now = NowNanos();
+  auto next = next_tune_nanos_.load(std::memory_order_relaxed);
+  if (now < next) return;
+  // Only the thread which advances the deadline tunes.
+  if (!next_tune_nanos_.compare_exchange_strong(next, now + period_.count(),
+                                                std::memory_order_relaxed))
+    return;
+  Tune();
+}
+
+void Autotuner::Tune() {
+  mutex_lock lock(mu_);
+
+  struct Candidate {
+    AutotuneNode* node;
+    int64_t wait_nanos;
+    int64_t bytes_per_unit;
+  };
+  llvm::SmallVector<Candidate, 8> starved;
+  int64_t memory = 0;
+
+  for (auto* node : nodes_) {
+    auto num_produced = node->num_produced_.load(std::memory_order_relaxed);
+    auto wait_nanos =
+        node->consumer_wait_nanos_.load(std::memory_order_relaxed);
+    auto bytes_per_unit =
+        num_produced == 0
+            ? 0
+            : node->produced_bytes_.load(std::memory_order_relaxed) /
+                  num_produced * node->elements_per_unit_;
+    auto period_wait_nanos = wait_nanos - node->last_consumer_wait_nanos_;
+    auto period_produced = num_produced - node->last_num_produced_;
+    node->last_consumer_wait_nanos_ = wait_nanos;
+    node->last_num_produced_ = num_produced;
+    memory += node->value() * bytes_per_unit;
+
+    if (period_wait_nanos * kStarvedFraction >= period_.count()) {
+      node->num_idle_periods_ = 0;
+      starved.push_back({node, period_wait_nanos, bytes_per_unit});
+    } else if (period_wait_nanos == 0 && period_produced > 0 &&
+               ++node->num_idle_periods_ >= kIdlePeriodsBeforeShrink) {
+      node->num_idle_periods_ = 0;
+      auto value = node->value();
+      if (value > node->min_value_) {
+        node->value_.store(value - 1, std::memory_order_relaxed);
+        memory -= bytes_per_unit;
+      }
+    }
+  }
+
+  // Element sizes may have grown since the parameters were last adjusted.
+  if (memory > memory_budget_) {
+    for (auto* node : nodes_) {
+      auto value = node->value();
+      if (value > node->min_value_)
+        node->value_.store(value - 1, std::memory_order_relaxed);
+    }
+    return;
+  }
+
+  // Grow the nodes whose consumers waited longest first.
+  std::sort(starved.begin(), starved.end(),
+            [](const Candidate& lhs, const Candidate& rhs) {
+              return lhs.wait_nanos > rhs.wait_nanos;
+            });
+  for (const auto& candidate : starved) {
+    auto* node = candidate.node;
+    auto value = node->value();
+    auto new_value =
+        std::min(node->max_value_, value + std::max<int64_t>(1, value / 2));
+    auto extra_memory = (new_value - value) * candidate.bytes_per_unit;
+    if (new_value == value || memory + extra_memory > memory_budget_) continue;
+    memory += extra_memory;
+    node->value_.store(new_value, std::memory_order_relaxed);
+  }
+}
+
+void Autotuner::Register(AutotuneNode* node) {
+  mutex_lock lock(mu_);
+  nodes_.push_back(node);
+}
+
+void Autotuner::Unregister(AutotuneNode* node) {
+  mutex_lock lock(mu_);
+  nodes_.erase(std::find(nodes_.begin(), nodes_.end(), node));
+}
+
+RCReference<AutotuneNode> MaybeMakeAutotuneNode(
+    const IteratorContext& context, std::string name, int64_t value,
+    int64_t initial_value, int64_t min_value, int64_t max_value,
+    int64_t elements_per_unit, HostContext* host) {
+  if (value != kAutotune || !context.autotuner) return {};
+  return TakeRef(host->Construct<AutotuneNode>(
+      std::move(name), initial_value, min_value, max_value, elements_per_unit,
+      context.autotuner, host));
+}
+
+}  // namespace data
+}  // namespace tfrt
@@ -0,0 +1,171 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// This file declares the Autotuner class, which adjusts buffer sizes and
+// parallelism of dataset iterators at runtime.
+
+#ifndef TFRT_LIB_DATA_AUTOTUNER_H_
+#define TFRT_LIB_DATA_AUTOTUNER_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tfrt/data/dataset.h"
+#include "tfrt/support/mutex.h"
+#include "tfrt/support/ref_count.h"
+#include "tfrt/support/thread_annotations.h"
+
+namespace tfrt {
+namespace data {
+
+class Autotuner;
+
+// Statistics and the tunable parameter (e.g. prefetch depth) of one dataset
+// iterator. The iterator reads value() whenever it decides how much work to
+// have in flight, and reports:
+//  - the production time of each element it requested from its input, i.e.
+//    the time from calling GetNext() on the input until the element became
+//    available, and
+//  - the consumer wait time of each element it returned, i.e. the time from
+//    returning the element from GetNext() until it became available.
+//
+// Each unit of the parameter holds `elements_per_unit` elements of the size
+// reported by TrackProduction(), e.g. an intermediate iterator of an interleave
+// holds its prefetched element and the elements queued from it.
+//
+// Recording is lock-free. The statistics are consumed by the Autotuner.
+class AutotuneNode : public ReferenceCounted<AutotuneNode> {
+ public:
+  AutotuneNode(std::string name, int64_t initial_value, int64_t min_value,
+               int64_t max_value, int64_t elements_per_unit,
+               std::shared_ptr<Autotuner> autotuner, HostContext* host);
+  ~AutotuneNode();
+
+  // This class is not copyable or movable.
+  AutotuneNode(const AutotuneNode&) = delete;
+  AutotuneNode& operator=(const AutotuneNode&) = delete;
+
+  const std::string& name() const { return name_; }
+
+  int64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+  // Records the production time of `result`, which was just returned by the
+  // input iterator.
+  void TrackProduction(const IterationResult& result);
+
+  // Records the consumer wait time of `result`, which is about to be returned
+  // to the consumer.
+  void TrackConsumption(const IterationResult& result);
+
+ private:
+  friend class Autotuner;
+  friend class ReferenceCounted<AutotuneNode>;
+  using Clock = std::chrono::steady_clock;
+
+  void Destroy() { internal::DestroyImpl<AutotuneNode>(this, allocator_); }
+
+  // Calls `callback` with the time it took `result` to become available.
+  template <typename F>
+  static void WhenAvailable(const IterationResult& result, F&& callback);
+
+  void RecordProduction(int64_t nanos, int64_t bytes);
+  void RecordConsumerWait(int64_t nanos);
+
+  const std::string name_;
+  const int64_t min_value_;
+  const int64_t max_value_;
+  const int64_t elements_per_unit_;
+  const std::shared_ptr<Autotuner> autotuner_;
+  HostAllocator* allocator_;
+  std::atomic<int64_t> value_;
+
+  // Totals since the iterator was created.
+  std::atomic<int64_t> num_produced_{0};
+  std::atomic<int64_t> production_nanos_{0};
+  std::atomic<int64_t> produced_bytes_{0};
+  std::atomic<int64_t> consumer_wait_nanos_{0};
+
+  // State of the Autotuner, guarded by its mutex.
+  int64_t last_num_produced_ = 0;
+  int64_t last_consumer_wait_nanos_ = 0;
+  int num_idle_periods_ = 0;
+};
+
+// Periodically adjusts the parameters of all AutotuneNodes of the input
+// pipelines sharing it, similar to tf.data's AUTOTUNE:
+//  - If the consumer of a node waited for elements during the last period,
+//    the node's parameter is grown, as long as the estimated memory held by
+//    all buffers stays within the memory budget.
+//  - If the consumer did not wait for several periods, the parameter is
+//    shrunk by one to release memory.
+//
+// There is no background thread. Tuning piggybacks on the threads that
+// produce elements once the tuning period has elapsed.
+class Autotuner {
+ public:
+  // Default memory budget for buffered elements of all pipelines sharing an
+  // autotuner.
+  static constexpr int64_t kDefaultMemoryBudget = int64_t{1} << 30;
+
+  // Returns the autotuner shared by the input pipelines of the process, so
+  // that their buffers stay within one memory budget.
+  static std::shared_ptr<Autotuner> Default();
+
+  explicit Autotuner(int64_t memory_budget = kDefaultMemoryBudget,
+                     std::chrono::milliseconds period =
+                         std::chrono::milliseconds(100));
+
+  // This class is not copyable or movable.
+  Autotuner(const Autotuner&) = delete;
+  Autotuner& operator=(const Autotuner&) = delete;
+
+  // Runs Tune() if the tuning period has elapsed.
+  void MaybeTune();
+
+  // Adjusts the parameters of all nodes based on their statistics since the
+  // last call.
+  void Tune() TFRT_EXCLUDES(mu_);
+
+ private:
+  friend class AutotuneNode;
+
+  void Register(AutotuneNode* node) TFRT_EXCLUDES(mu_);
+  void Unregister(AutotuneNode* node) TFRT_EXCLUDES(mu_);
+
+  const int64_t memory_budget_;
+  const std::chrono::nanoseconds period_;
+  std::atomic<int64_t> next_tune_nanos_;
+
+  mutex mu_;
+  std::vector<AutotuneNode*> nodes_ TFRT_GUARDED_BY(mu_);
+};
+
+// Returns the node tuning the parameter of an iterator, or an empty reference
+// if the parameter is fixed or the iterator is not tuned. `value` is the
+// parameter value passed to the dataset, which is tuned if it is kAutotune.
+RCReference<AutotuneNode> MaybeMakeAutotuneNode(
+    const IteratorContext& context, std::string name, int64_t value,
+    int64_t initial_value, int64_t min_value, int64_t max_value,
+    int64_t elements_per_unit, HostContext* host);
+
+}  // namespace data
+}  // namespace tfrt
+
+#endif  // TFRT_LIB_DATA_AUTOTUNER_H_
@@ -21,9 +21,15 @@
 #ifndef TFRT_DATA_BATCH_DATASET_H_
 #define TFRT_DATA_BATCH_DATASET_H_
 
+#include <algorithm>
+#include <cstring>
+
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallVector.h"
 #include "tfrt/data/dataset.h"
 #include "tfrt/host_context/execution_context.h"
+#include "tfrt/host_context/host_buffer.h"
+#include "tfrt/host_context/parallel_for.h"
 #include "tfrt/support/error_util.h"
 #include "tfrt/support/forward_decls.h"
 #include "tfrt/support/ref_count.h"
@@ -33,9 +39,59 @@
 #include "tfrt/tensor/dense_host_tensor_view.h"
 #include "tfrt/tensor/tensor_metadata.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 namespace tfrt {
 namespace data {
 
+// Batches of at least this many bytes are written with non-temporal stores.
+// Such a batch does not fit in the cache alongside its inputs, and it is not
+// read again before GetNext() returns it.
+constexpr size_t kNonTemporalCopyThreshold = 4 << 20;
+
+// Batches of at least this many bytes whose inputs are all available are
+// copied in parallel, in blocks of at least kParallelCopyMinBlockSize bytes.
+constexpr size_t kParallelCopyThreshold = 1 << 20;
+constexpr size_t kParallelCopyMinBlockSize = 256 << 10;
+
+namespace internal {
+
+// Copies `size` bytes from `src` to `dst` with non-temporal stores if
+// supported by the target, and with std::memcpy otherwise.
+inline void CopyNonTemporal(void* dst, const void* src, size_t size) {
+#if defined(__SSE2__)
+  auto* dst_ptr = static_cast<char*>(dst);
+  auto* src_ptr = static_cast<const char*>(src);
+  // Streaming stores require 16-byte aligned destinations.
+  size_t head = std::min(size, -reinterpret_cast<uintptr_t>(dst_ptr) & 15);
+  std::memcpy(dst_ptr, src_ptr, head);
+  dst_ptr += head;
+  src_ptr += head;
+  size -= head;
+  for (; size >= 64; dst_ptr += 64, src_ptr += 64, size -= 64) {
+    auto* from = reinterpret_cast<const __m128i*>(src_ptr);
+    auto* to = reinterpret_cast<__m128i*>(dst_ptr);
+    __m128i v0 = _mm_loadu_si128(from);
+    __m128i v1 = _mm_loadu_si128(from + 1);
+    __m128i v2 = _mm_loadu_si128(from + 2);
+    __m128i v3 = _mm_loadu_si128(from + 3);
+    _mm_stream_si128(to, v0);
+    _mm_stream_si128(to + 1, v1);
+    _mm_stream_si128(to + 2, v2);
+    _mm_stream_si128(to + 3, v3);
+  }
+  // Order the streaming stores before the stores which publish the batch.
+  _mm_sfence();
+  std::memcpy(dst_ptr, src_ptr, size);
+#else
+  std::memcpy(dst, src, size);
+#endif
+}
+
+}  // namespace internal
+
 template <typename... T>
 class BatchDatasetIterator;
 
@@ -103,9 +159,13 @@ void CopyDataHelper(T* src, DenseHostTensor* dst, int index) {
 template <>
 inline void CopyDataHelper<DenseHostTensor>(DenseHostTensor* src,
                                             DenseHostTensor* dst, int index) {
-  int data_size = src->DataSizeInBytes();
+  size_t data_size = src->DataSizeInBytes();
   char* dst_ptr = static_cast<char*>(dst->data()) + index * data_size;
-  std::memcpy(dst_ptr, src->data(), data_size);
+  if (dst->DataSizeInBytes() >= kNonTemporalCopyThreshold) {
+    internal::CopyNonTemporal(dst_ptr, src->data(), data_size);
+  } else {
+    std::memcpy(dst_ptr, src->data(), data_size);
+  }
 }
 
 struct CounterAndError {
@@ -121,28 +181,22 @@ struct CounterAndError {
 };
 
 // Truncate the `input_tensor` to reduce its outermost dimension to
-// `batch_size`. The content of the buffer of the `input_tensor` that
-// corresponds the outermost `batch_size` rows will be copied to the output
-// tensor.
-static llvm::Expected<DenseHostTensor> TruncateTensor(
-    const DenseHostTensor& input_tensor, Index batch_size,
-    const ExecutionContext& exec_ctx) {
+// `batch_size`. The output tensor shares the buffer of the `input_tensor`, so
+// nothing is copied, but the whole buffer stays alive until the output tensor
+// is destroyed.
+inline DenseHostTensor TruncateTensor(const DenseHostTensor& input_tensor,
+                                      Index batch_size) {
   auto& input_metadata = input_tensor.metadata();
   llvm::SmallVector<Index, 4> output_dims;
   input_metadata.shape.GetDimensions(&output_dims);
+  size_t row_size = input_tensor.DataSizeInBytes() / output_dims[0];
   output_dims[0] = batch_size;
 
   TensorMetadata output_metadata(input_metadata.dtype, output_dims);
-  auto dht =
-      DenseHostTensor::CreateUninitialized(output_metadata, exec_ctx.host());
-  if (!dht) {
-    return MakeStringError("out of memory");
-  }
-
-  auto output_tensor = std::move(dht.getValue());
-  std::memcpy(output_tensor.data(), input_tensor.data(),
-              output_tensor.DataSizeInBytes());
-  return std::move(output_tensor);
+  auto buffer = HostBuffer::CreateFromExternal(input_tensor.buffer().CopyRef(),
+                                               /*offset=*/0,
+                                               row_size * batch_size);
+  return DenseHostTensor(output_metadata, std::move(buffer));
 }
 
 // Copies buffer from `input_value` (which is a DenseHostTensor) into
@@ -217,14 +271,8 @@ void CopySlice(RCReference<AsyncValue> input_value,
       } else if (eof_num == 0) {
         result->emplace<DenseHostTensor>(std::move(result_buffer.get()));
       } else {
-        auto output_tensor =
-            TruncateTensor(result_buffer.get(), batch_size, exec_ctx);
-        if (!output_tensor) {
-          auto error = EmitError(exec_ctx, StrCat(output_tensor.takeError()));
-          result->SetError(error);
-        } else {
-          result->emplace<DenseHostTensor>(std::move(*output_tensor));
-        }
+        result->emplace<DenseHostTensor>(
+            TruncateTensor(result_buffer.get(), batch_size));
       }
       delete counter_and_error;
     }
@@ -251,6 +299,39 @@ void CopyComponent(llvm::SmallVector<RCReference<AsyncValue>, 4> input_values,
       return;
     }
     auto* counter_and_error = new CounterAndError(input_values.size());
+
+    // If all inputs are already available, the loop below would copy them one
+    // after the other on this thread. Copy large batches in parallel instead.
+    size_t num_slices = input_values.size();
+    size_t batch_bytes = result_buffer->DataSizeInBytes();
+    bool all_available =
+        llvm::all_of(input_values,
+                     [](const auto& value) { return value->IsAvailable(); }) &&
+        llvm::all_of(input_eofs,
+                     [](const auto& eof) { return eof.IsAvailable(); });
+    if (num_slices > 1 && batch_bytes >= kParallelCopyThreshold &&
+        all_available) {
+      size_t slice_bytes = std::max<size_t>(batch_bytes / num_slices, 1);
+      auto min_block_slices =
+          std::max<size_t>(kParallelCopyMinBlockSize / slice_bytes, 1);
+      ParallelFor(exec_ctx).Execute(
+          num_slices, ParallelFor::BlockSizes::Min(min_block_slices),
+          [input_values = std::move(input_values),
+           input_eofs = std::move(input_eofs),
+           expected_metadata = std::move(expected_metadata),
+           result_buffer = result_buffer.CopyRef(), result = std::move(result),
+           counter_and_error, exec_ctx](size_t begin, size_t end) mutable {
+            for (size_t i = begin; i < end; ++i) {
+              CopySlice<T>(std::move(input_values[i]), std::move(input_eofs[i]),
+                           expected_metadata.CopyRef(), result_buffer.CopyRef(),
+                           result, counter_and_error, /*slice_index=*/i,
+                           exec_ctx);
+            }
+          },
+          [] {});
+      return;
+    }
+
     // Otherwise, when each input is ready, copy it to `result_buffer`. When all
     // inputs are copied, move `result_buffer` to `result`.
     for (size_t i = 0, e = input_values.size(); i < e; ++i) {
@@ -371,7 +452,10 @@ class BatchDataset : public Dataset {
   BatchDataset(const BatchDataset&) = delete;
   BatchDataset& operator=(const BatchDataset&) = delete;
 
-  RCReference<Iterator> MakeIterator(const IteratorContext& context) override;
+  string_view name() const override { return "batch"; }
+
+  RCReference<Iterator> MakeIteratorInternal(
+      const IteratorContext& context) override;
 
  private:
   // Allow iterator to rely on private data members of this dataset.
@@ -421,7 +505,7 @@ class BatchDatasetIterator : public Iterator {
 };
 
 template <typename... T>
-RCReference<Iterator> BatchDataset<T...>::MakeIterator(
+RCReference<Iterator> BatchDataset<T...>::MakeIteratorInternal(
     const IteratorContext& context) {
   return TakeRef(
       host_->Construct<BatchDatasetIterator<T...>>(FormRef(this), context));
@@ -436,10 +520,8 @@ IterationResult BatchDatasetIterator<T...>::GetNext(
   HostContext* host = exec_ctx.host();
   llvm::SmallVector<IterationResult, 4> inputs;
   // Get up to batch_size values from the underlying iterator.
-  for (int i = 0; i < parent_dataset_->batch_size_; ++i) {
-    auto input = input_iterator_->GetNext(exec_ctx);
-    inputs.push_back(std::move(input));
-  }
+  input_iterator_->GetNextBatch(exec_ctx, parent_dataset_->batch_size_,
+                                &inputs);
 
   llvm::SmallVector<AsyncValueRef<TensorMetadata>, 4> metadata;
   if (parent_dataset_->same_input_metadata_) {
@@ -0,0 +1,268 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// This file implements CacheDataset class which caches the elements of another
+// Dataset instance in a local file.
+
+#include "cache_dataset.h"
+
+#include <cstring>
+#include <memory>
+
+#include "llvm/Support/FileSystem.h"
+#include "tfrt/host_context/async_dispatch.h"
+#include "tfrt/host_context/diagnostic.h"
+#include "tfrt/support/error_util.h"
+#include "tfrt/tensor/btf_util.h"
+#include "tfrt/tensor/dense_host_tensor.h"
+
+namespace tfrt {
+namespace data {
+namespace {
+
+// Memory maps `filename` into a HostBuffer, which unmaps the file when it is
+// destroyed.
+Expected<RCReference<HostBuffer>> MapFile(const std::string& filename) {
+  uint64_t size;
+  if (auto ec = llvm::sys::fs::file_size(filename, size)) {
+    return MakeStringError("failed to stat ", filename, ": ", ec.message());
+  }
+  auto fd = llvm::sys::fs::openNativeFileForRead(filename);
+  if (!fd) {
+    return MakeStringError("failed to open ", filename, ": ", fd.takeError());
+  }
+  std::error_code ec;
+  auto region = std::make_unique<llvm::sys::fs::mapped_file_region>(
+      *fd, llvm::sys::fs::mapped_file_region::readonly, size, /*offset=*/0,
+      ec);
+  llvm::sys::fs::closeFile(*fd);
+  if (ec) {
+    return MakeStringError("failed to map ", filename, ": ", ec.message());
+  }
+  auto* data = const_cast<char*>(region->const_data());
+  return HostBuffer::CreateFromExternal(
+      data, size, [region = std::move(region)](void*, size_t) {});
+}
+
+}  // namespace
+
+//===----------------------------------------------------------------------===//
+// CacheDataset methods
+//===----------------------------------------------------------------------===//
+RCReference<Iterator> CacheDataset::MakeIteratorInternal(
+    const IteratorContext& context) {
+  {
+    mutex_lock lock(mu_);
+    if (!cache_ && llvm::sys::fs::exists(filename_)) {
+      auto cache = MapFile(filename_);
+      auto offsets = cache ? ReadBTFOffsets(**cache)
+                           : Expected<std::vector<uint64_t>>(cache.takeError());
+      if (offsets && offsets->size() % arity_ == 0) {
+        cache_ = std::move(*cache);
+        offsets_ = std::move(*offsets);
+      } else {
+        // Ignore the unusable file, it is replaced once the input has been
+        // iterated again.
+        if (!offsets) llvm::consumeError(offsets.takeError());
+      }
+    }
+    if (cache_) {
+      return TakeRef(host_->Construct<CacheDatasetReaderIterator>(
+          FormRef(this), cache_.CopyRef()));
+    }
+  }
+  return TakeRef(
+      host_->Construct<CacheDatasetWriterIterator>(FormRef(this), context));
+}
+
+//===----------------------------------------------------------------------===//
+// CacheWriter methods
+//===----------------------------------------------------------------------===//
+namespace internal {
+
+CacheWriter::~CacheWriter() { Abandon(); }
+
+Error CacheWriter::Open() {
+  llvm::sys::fs::createUniquePath(filename_ + ".%%%%%%.records", records_path_,
+                                  /*MakeAbsolute=*/false);
+  records_.open(records_path_.str().str(), std::ios::binary);
+  if (!records_) {
+    return MakeStringError("failed to open ", records_path_.str());
+  }
+  return Error::success();
+}
+
+Error CacheWriter::Write(ArrayRef<AsyncValue*> values) {
+  if (!IsActive()) return Error::success();
+  for (const auto& value : values) {
+    // The values of map and other asynchronous datasets are
+    // IndirectAsyncValues. Once forwarded, they have the type id of the
+    // concrete value.
+    if (!value->IsType<DenseHostTensor>()) {
+      return MakeStringError("cache_dataset only supports DenseHostTensor");
+    }
+    auto size = WriteDHTRecordToBTF(&records_, value->get<DenseHostTensor>());
+    if (!size) return size.takeError();
+    record_sizes_.push_back(*size);
+  }
+  return Error::success();
+}
+
+Error CacheWriter::Finish() {
+  if (!IsActive()) return Error::success();
+  records_.close();
+  if (!records_) {
+    return MakeStringError("failed to write ", records_path_.str());
+  }
+
+  // Concurrent writers of the same cache each write their own file, and the
+  // last rename wins.
+  llvm::SmallString<128> tmp_path;
+  llvm::sys::fs::createUniquePath(filename_ + ".%%%%%%.tmp", tmp_path,
+                                  /*MakeAbsolute=*/false);
+  {
+    std::ofstream file(tmp_path.str().str(), std::ios::binary);
+    const uint64_t num_tensors = record_sizes_.size();
+    file.write(reinterpret_cast<const char*>(&num_tensors),
+               sizeof(num_tensors));
+    uint64_t offset = sizeof(uint64_t) * (1 + num_tensors);
+    for (uint64_t size : record_sizes_) {
+      file.write(reinterpret_cast<const char*>(&offset), sizeof(offset));
+      offset += size;
+    }
+    std::ifstream records(records_path_.str().str(), std::ios::binary);
+    if (num_tensors > 0) file << records.rdbuf();
+    if (!file || !records) {
+      llvm::sys::fs::remove(tmp_path);
+      return MakeStringError("failed to write ", tmp_path.str());
+    }
+  }
+  llvm::sys::fs::remove(records_path_);
+  records_path_.clear();
+  if (auto ec = llvm::sys::fs::rename(tmp_path, filename_)) {
+    llvm::sys::fs::remove(tmp_path);
+    return MakeStringError("failed to rename ", tmp_path.str(), " to ",
+                           filename_, ": ", ec.message());
+  }
+  return Error::success();
+}
+
+void CacheWriter::Abandon() {
+  if (records_.is_open()) records_.close();
+  if (!records_path_.empty()) {
+    llvm::sys::fs::remove(records_path_);
+    records_path_.clear();
+  }
+}
+
+}  // namespace internal
+
+//===----------------------------------------------------------------------===//
+// CacheDatasetWriterIterator methods
+//===----------------------------------------------------------------------===//
+CacheDatasetWriterIterator::CacheDatasetWriterIterator(
+    RCReference<CacheDataset> dataset, const IteratorContext& context)
+    : Iterator(),
+      parent_dataset_(std::move(dataset)),
+      input_iterator_(parent_dataset_->input_dataset_->MakeIterator(context)),
+      last_write_(MakeAvailableAsyncValueRef<Chain>(parent_dataset_->host_)) {
+  auto* host = parent_dataset_->host_;
+  auto writer = TakeRef(host->Construct<internal::CacheWriter>(
+      parent_dataset_->filename_, parent_dataset_->allocator_));
+  if (auto error = writer->Open()) {
+    // Caching is best effort: produce the input elements without caching them.
+    host->EmitError(DecodedDiagnostic(StrCat("cache_dataset: ", error)));
+    return;
+  }
+  writer_ = std::move(writer);
+}
+
+IterationResult CacheDatasetWriterIterator::GetNext(
+    const ExecutionContext& exec_ctx) {
+  auto input = input_iterator_->GetNext(exec_ctx);
+  if (!writer_) return input;
+
+  llvm::SmallVector<AsyncValue*, 4> deps;
+  for (const auto& value : input.values) deps.push_back(value.get());
+  deps.push_back(input.eof.GetAsyncValue());
+  deps.push_back(last_write_.GetAsyncValue());
+
+  auto write = MakeUnconstructedAsyncValueRef<Chain>(exec_ctx.host());
+  RunWhenReady(deps, [exec_ctx, writer = writer_.CopyRef(),
+                      values = RCArray<AsyncValue>(input.values),
+                      eof = input.eof.CopyRef(), write = write.CopyRef()]() {
+    // Elements with errors cannot be cached, so the cache is not committed.
+    // The errors are reported to the consumer of the elements. The values at
+    // the end of iteration are errors as well, and are not checked.
+    bool has_error =
+        eof.IsError() ||
+        (!eof.get() && llvm::any_of(values.values(), [](AsyncValue* value) {
+          return value->IsError();
+        }));
+    if (has_error || !writer->IsActive()) {
+      writer->Abandon();
+      write.emplace();
+      return;
+    }
+    bool enqueued = EnqueueBlockingWork(
+        exec_ctx.host(), [exec_ctx, writer = writer.CopyRef(),
+                          values = values.CopyRef(), is_eof = eof.get(),
+                          write = write.CopyRef()]() {
+          auto error =
+              is_eof ? writer->Finish() : writer->Write(values.values());
+          if (error) {
+            writer->Abandon();
+            EmitError(exec_ctx, "cache_dataset: ", error);
+          }
+          write.emplace();
+        });
+    if (!enqueued) {
+      writer->Abandon();
+      EmitError(exec_ctx, "cache_dataset: failed to enqueue blocking work");
+      write.emplace();
+    }
+  });
+  last_write_ = std::move(write);
+  return input;
+}
+
+//===----------------------------------------------------------------------===//
+// CacheDatasetReaderIterator methods
+//===----------------------------------------------------------------------===//
+IterationResult CacheDatasetReaderIterator::GetNext(
+    const ExecutionContext& exec_ctx) {
+  auto* host = exec_ctx.host();
+  const auto arity = parent_dataset_->arity_;
+  const auto& offsets = parent_dataset_->offsets_;
+  if (next_record_ >= offsets.size()) {
+    return IterationResult::Eof(host, arity);
+  }
+
+  llvm::SmallVector<RCReference<AsyncValue>, 4> values;
+  for (int64_t i = 0; i < arity; ++i) {
+    auto tensor = ReadDHTFromBTF(cache_, offsets[next_record_++]);
+    if (!tensor) {
+      return IterationResult::Error(
+          EmitErrorAsync(exec_ctx, tensor.takeError()), arity);
+    }
+    values.push_back(
+        MakeAvailableAsyncValueRef<DenseHostTensor>(host, std::move(*tensor)));
+  }
+  return IterationResult::Values(std::move(values), host);
+}
+
+}  // namespace data
+}  // namespace tfrt
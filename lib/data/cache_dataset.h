@@ -0,0 +1,195 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// This file declares CacheDataset class which caches the elements of another
+// Dataset instance in a local file.
+
+#ifndef TFRT_LIB_DATA_CACHE_DATASET_H_
+#define TFRT_LIB_DATA_CACHE_DATASET_H_
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "llvm/ADT/SmallString.h"
+#include "tfrt/data/dataset.h"
+#include "tfrt/host_context/chain.h"
+#include "tfrt/host_context/host_buffer.h"
+#include "tfrt/support/forward_decls.h"
+#include "tfrt/support/mutex.h"
+#include "tfrt/support/thread_annotations.h"
+
+namespace tfrt {
+namespace data {
+
+// CacheDataset caches the elements of its input dataset in `filename`.
+//
+// The first iterator created while `filename` does not exist writes the
+// elements it produces to the file in the BTF format (see tfrt/tensor/btf.h),
+// one TENSOR_RECORD per component. The file is only committed when the
+// iterator reaches the end of its input. Iterators created afterwards memory
+// map the file and produce the cached elements without running the input
+// dataset. The BTF header holds the offsets of all records, which gives random
+// access to each element.
+//
+// Only DenseHostTensor components are supported.
+class CacheDataset : public Dataset {
+ public:
+  explicit CacheDataset(RCReference<Dataset> input_dataset,
+                        std::string filename, int64_t arity, HostContext* host)
+      : input_dataset_(std::move(input_dataset)),
+        filename_(std::move(filename)),
+        arity_(arity),
+        host_(host),
+        allocator_(host->allocator()) {
+    assert(arity_ > 0);
+  }
+
+  // This class is not copyable or movable.
+  CacheDataset(const CacheDataset&) = delete;
+  CacheDataset& operator=(const CacheDataset&) = delete;
+
+  string_view name() const override { return "cache"; }
+
+  RCReference<Iterator> MakeIteratorInternal(
+      const IteratorContext& context) override;
+
+ private:
+  friend class CacheDatasetWriterIterator;
+  friend class CacheDatasetReaderIterator;
+
+  void Destroy() override {
+    internal::DestroyImpl<CacheDataset>(this, allocator_);
+  }
+
+  RCReference<Dataset> input_dataset_;
+  const std::string filename_;
+  const int64_t arity_;
+  HostContext* host_;
+  HostAllocator* allocator_;
+
+  mutex mu_;
+  // The memory mapped cache file, once it has been written.
+  RCReference<HostBuffer> cache_ TFRT_GUARDED_BY(mu_);
+  // The offsets of the tensor records in `cache_`. Not modified after `cache_`
+  // is set.
+  std::vector<uint64_t> offsets_;
+};
+
+namespace internal {
+
+// Writes the tensor records of a cache file. The records are appended to a
+// temporary file as they arrive, because the BTF header can only be written
+// once the number of tensors is known. The file is renamed to its final name
+// in Finish(), so that readers never observe a partially written cache.
+class CacheWriter : public ReferenceCounted<CacheWriter> {
+ public:
+  CacheWriter(std::string filename, HostAllocator* allocator)
+      : filename_(std::move(filename)), allocator_(allocator) {}
+  ~CacheWriter();
+
+  // Opens the temporary records file.
+  Error Open();
+
+  // Appends the records of one element.
+  Error Write(ArrayRef<AsyncValue*> values);
+
+  // Writes the header followed by the records to `filename`.
+  Error Finish();
+
+  // Discards the records written so far. Later calls to Write() and Finish()
+  // are ignored.
+  void Abandon();
+
+  bool IsActive() const { return records_.is_open(); }
+
+ private:
+  friend class ReferenceCounted<CacheWriter>;
+
+  void Destroy() { internal::DestroyImpl<CacheWriter>(this, allocator_); }
+
+  const std::string filename_;
+  HostAllocator* allocator_;
+  llvm::SmallString<128> records_path_;
+  std::ofstream records_;
+  // The sizes of the records written to `records_`.
+  std::vector<uint64_t> record_sizes_;
+};
+
+}  // namespace internal
+
+// Produces the elements of the input dataset, and writes them to the cache file
+// once they are available. The writes are chained so that the records are
+// written in order.
+class CacheDatasetWriterIterator : public Iterator {
+ public:
+  explicit CacheDatasetWriterIterator(RCReference<CacheDataset> dataset,
+                                      const IteratorContext& context);
+
+  // This class is not copyable or movable.
+  CacheDatasetWriterIterator(const CacheDatasetWriterIterator&) = delete;
+  CacheDatasetWriterIterator& operator=(const CacheDatasetWriterIterator&) =
+      delete;
+
+  IterationResult GetNext(const ExecutionContext& exec_ctx) override;
+
+ private:
+  void Destroy() override {
+    internal::DestroyImpl<CacheDatasetWriterIterator>(
+        this, parent_dataset_->allocator_);
+  }
+
+  RCReference<CacheDataset> parent_dataset_;
+  RCReference<Iterator> input_iterator_;
+  // Null if the cache file could not be opened.
+  RCReference<internal::CacheWriter> writer_;
+  // Becomes available when the element returned by the last GetNext() call has
+  // been written.
+  AsyncValueRef<Chain> last_write_;
+};
+
+// Produces the elements stored in the memory mapped cache file. The tensors
+// reference the mapping instead of copying their data.
+class CacheDatasetReaderIterator : public Iterator {
+ public:
+  explicit CacheDatasetReaderIterator(RCReference<CacheDataset> dataset,
+                                      RCReference<HostBuffer> cache)
+      : Iterator(),
+        parent_dataset_(std::move(dataset)),
+        cache_(std::move(cache)) {}
+
+  // This class is not copyable or movable.
+  CacheDatasetReaderIterator(const CacheDatasetReaderIterator&) = delete;
+  CacheDatasetReaderIterator& operator=(const CacheDatasetReaderIterator&) =
+      delete;
+
+  IterationResult GetNext(const ExecutionContext& exec_ctx) override;
+
+ private:
+  void Destroy() override {
+    internal::DestroyImpl<CacheDatasetReaderIterator>(
+        this, parent_dataset_->allocator_);
+  }
+
+  RCReference<CacheDataset> parent_dataset_;
+  RCReference<HostBuffer> cache_;
+  size_t next_record_ = 0;
+};
+
+}  // namespace data
+}  // namespace tfrt
+
+#endif  // TFRT_LIB_DATA_CACHE_DATASET_H_
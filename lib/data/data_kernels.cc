@@ -14,19 +14,27 @@
 
 // This file implements data kernels.
 
+#include "autotuner.h"
 #include "batch_dataset.h"
+#include "cache_dataset.h"
 #include "filter_dataset.h"
 #include "interleave_dataset.h"
+#include "iterator_stats.h"
 #include "log_dataset.h"
+#include "map_and_batch_dataset.h"
 #include "map_dataset.h"
 #include "memory_dataset.h"
+#include "parallel_interleave_dataset.h"
+#include "parallel_map_dataset.h"
 #include "prefetch_dataset.h"
 #include "range_dataset.h"
 #include "repeat_dataset.h"
+#include "sharded_tf_record_dataset.h"
 #include "shuffle_dataset.h"
 #include "skip_dataset.h"
 #include "slice_dataset.h"
 #include "tf_record_dataset.h"
+#include "llvm_derived/Support/raw_ostream.h"
 #include "tfrt/host_context/function.h"
 #include "tfrt/host_context/kernel_utils.h"
 #include "tfrt/support/error_util.h"
@@ -87,6 +95,25 @@ RCReference<RangeDataset> MakeRangeDataset(int64_t start, int64_t stop,
       start, stop, step, DType(element_type.get()), exec_ctx.host()));
 }
 
+//===----------------------------------------------------------------------===//
+// ParallelInterleaveDataset
+//===----------------------------------------------------------------------===//
+
+RCReference<ParallelInterleaveDataset> MakeParallelInterleaveDataset(
+    RCReference<Dataset>* dataset, int64_t cycle_length, int64_t block_length,
+    Attribute<int64_t> arity, Attribute<int64_t> buffer_output_elements,
+    Attribute<int64_t> prefetch_input_elements, Attribute<bool> sloppy,
+    Attribute<Function> fn, const ExecutionContext& exec_ctx) {
+  assert(fn->result_types().size() == 1 &&
+         "ParallelInterleave expects only one function output, which must be "
+         "a dataset.");
+
+  return TakeRef(exec_ctx.host()->Construct<ParallelInterleaveDataset>(
+      *dataset, cycle_length, block_length, FormRef(&fn.get()), arity.get(),
+      sloppy.get(), buffer_output_elements.get(), prefetch_input_elements.get(),
+      exec_ctx.host()));
+}
+
 //===----------------------------------------------------------------------===//
 // MapDataset
 //===----------------------------------------------------------------------===//
@@ -100,6 +127,34 @@ RCReference<MapDataset> MakeMapDataset(RCReference<Dataset>* dataset,
       exec_ctx.host()));
 }
 
+//===----------------------------------------------------------------------===//
+// MapAndBatchDataset
+//===----------------------------------------------------------------------===//
+
+RCReference<MapAndBatchDataset> MakeMapAndBatchDataset(
+    RCReference<Dataset>* dataset, int64_t batch_size, RemainingArguments args,
+    ArrayAttribute<Index> element_shape, Attribute<DType> element_type,
+    Attribute<Function> fn, const ExecutionContext& exec_ctx) {
+  return TakeRef(exec_ctx.host()->Construct<MapAndBatchDataset>(
+      *dataset, batch_size, RCArray<AsyncValue>(args.values()),
+      FormRef(&fn.get()),
+      TensorMetadata(DType(element_type.get()), element_shape.data()),
+      exec_ctx.host()));
+}
+
+//===----------------------------------------------------------------------===//
+// ParallelMapDataset
+//===----------------------------------------------------------------------===//
+
+RCReference<ParallelMapDataset> MakeParallelMapDataset(
+    RCReference<Dataset>* dataset, RemainingArguments args,
+    Attribute<bool> is_deterministic, Attribute<int64_t> num_parallel_calls,
+    Attribute<Function> fn, const ExecutionContext& exec_ctx) {
+  return TakeRef(exec_ctx.host()->Construct<ParallelMapDataset>(
+      *dataset, RCArray<AsyncValue>(args.values()), FormRef(&fn.get()),
+      num_parallel_calls.get(), is_deterministic.get(), exec_ctx.host()));
+}
+
 //===----------------------------------------------------------------------===//
 // FilterDataset
 //===----------------------------------------------------------------------===//
@@ -133,17 +188,97 @@ RCReference<InterleaveDataset> MakeInterleaveDataset(
 // TFRecordDataset
 //===----------------------------------------------------------------------===//
 
+// The optional attribute is the compression type of the file.
 RCReference<TFRecordDataset> MakeTFRecordDataset(
-    std::string path, const ExecutionContext& exec_ctx) {
+    std::string path, RemainingAttributes attributes,
+    const ExecutionContext& exec_ctx) {
   // Default buffer size to 256 KB.
   int64_t buffer_size = 256 * 1024;
   int64_t max_prefetch_num = 80;
   int64_t prefetch_threshold = 20;
+  llvm::Optional<::tfrt::io::ZlibFormat> compression;
+  if (attributes.size() > 0) {
+    auto compression_type = attributes.GetStringAttribute(0).get();
+    // The op verifier only accepts supported compression types.
+    if (!compression_type.empty()) {
+      compression = ::tfrt::io::ParseZlibFormat(compression_type);
+      assert(compression.hasValue());
+    }
+  }
   return TakeRef(exec_ctx.host()->Construct<TFRecordDataset>(
       std::move(path), buffer_size, max_prefetch_num, prefetch_threshold,
+      TFRecordReadMode::kStream, compression, /*direct_io=*/false,
+      exec_ctx.host()));
+}
+
+RCReference<TFRecordDataset> MakeMappedTFRecordDataset(
+    std::string path, const ExecutionContext& exec_ctx) {
+  int64_t max_prefetch_num = 80;
+  int64_t prefetch_threshold = 20;
+  return TakeRef(exec_ctx.host()->Construct<TFRecordDataset>(
+      std::move(path), /*buffer_size=*/0, max_prefetch_num, prefetch_threshold,
+      TFRecordReadMode::kMapped, /*compression=*/llvm::None,
+      /*direct_io=*/false, exec_ctx.host()));
+}
+
+// The optional attribute is whether the file is read with direct IO.
+RCReference<TFRecordDataset> MakeChunkedTFRecordDataset(
+    std::string path, Attribute<int64_t> chunk_size,
+    RemainingAttributes attributes, const ExecutionContext& exec_ctx) {
+  int64_t max_prefetch_num = 80;
+  int64_t prefetch_threshold = 20;
+  const bool direct_io = attributes.size() > 0 && *attributes.Get<bool>(0);
+  return TakeRef(exec_ctx.host()->Construct<TFRecordDataset>(
+      std::move(path), *chunk_size, max_prefetch_num, prefetch_threshold,
+      TFRecordReadMode::kChunked, /*compression=*/llvm::None, direct_io,
+      exec_ctx.host()));
+}
+
+//===----------------------------------------------------------------------===//
+// ShardedTFRecordDataset
+//===----------------------------------------------------------------------===//
+
+// The files matching the glob `patterns` are read, in the order of the
+// patterns and sorted by path for each pattern. If the files are read by
+// several workers, each worker reads every `num_shards`-th file starting at
+// `shard_index`. The patterns are matched by the iterators of the dataset in a
+// blocking task.
+RCReference<ShardedTFRecordDataset> MakeShardedTFRecordDataset(
+    RepeatedArguments<std::string> patterns, StringAttribute compression_type,
+    Attribute<int64_t> num_parallel_reads, Attribute<int64_t> num_shards,
+    Attribute<int64_t> shard_index, const ExecutionContext& exec_ctx) {
+  std::vector<std::string> pattern_list;
+  for (const auto& pattern : patterns) pattern_list.push_back(pattern);
+
+  // Default buffer size to 256 KB.
+  int64_t buffer_size = 256 * 1024;
+  int64_t max_prefetch_num = 80;
+  int64_t prefetch_threshold = 20;
+  llvm::Optional<::tfrt::io::ZlibFormat> compression;
+  // The op verifier only accepts supported compression types.
+  if (!compression_type.get().empty()) {
+    compression = ::tfrt::io::ParseZlibFormat(compression_type.get());
+    assert(compression.hasValue());
+  }
+  return TakeRef(exec_ctx.host()->Construct<ShardedTFRecordDataset>(
+      std::move(pattern_list), *num_shards, *shard_index, *num_parallel_reads,
+      buffer_size, max_prefetch_num, prefetch_threshold, compression,
       exec_ctx.host()));
 }
 
+//===----------------------------------------------------------------------===//
+// CacheDataset
+//===----------------------------------------------------------------------===//
+
+RCReference<CacheDataset> MakeCacheDataset(RCReference<Dataset>* dataset,
+                                           std::string filename,
+                                           Attribute<int64_t> arity,
+                                           const ExecutionContext& exec_ctx) {
+  HostContext* host = exec_ctx.host();
+  return TakeRef(host->Construct<CacheDataset>(*dataset, std::move(filename),
+                                               arity.get(), host));
+}
+
 //===----------------------------------------------------------------------===//
 // ShuffleDataset
 //===----------------------------------------------------------------------===//
@@ -209,9 +344,7 @@ RCReference<PrefetchDataset> MakePrefetchDataset(
     RCReference<Dataset>* dataset, int64_t prefetch_num,
     Attribute<bool> is_deterministic, const ExecutionContext& exec_ctx) {
   HostContext* host = exec_ctx.host();
-  if (prefetch_num == -1) {
-    prefetch_num = host->GetNumWorkerThreads();
-  }
+  assert(prefetch_num >= 0 || prefetch_num == kAutotune);
   return TakeRef(host->Construct<PrefetchDataset>(
       *dataset, prefetch_num, is_deterministic.get(), host));
 }
@@ -223,9 +356,30 @@ RCReference<PrefetchDataset> MakePrefetchDataset(
 // Create an iterator that points to the first element in the dataset.
 RCReference<Iterator> MakeIteratorFromDataset(RCReference<Dataset>* dataset) {
   IteratorContext context;
+  context.autotuner = Autotuner::Default();
   return (*dataset)->MakeIterator(context);
 }
 
+// Create an iterator which records the statistics of each iterator in the
+// input pipeline.
+RCReference<Iterator> MakeIteratorWithStats(RCReference<Dataset>* dataset,
+                                            const ExecutionContext& exec_ctx) {
+  IteratorContext context;
+  context.autotuner = Autotuner::Default();
+  context.stats = std::make_shared<IteratorStats>("iterator");
+  context.host = exec_ctx.host();
+  return (*dataset)->MakeIterator(context);
+}
+
+// Print the statistics recorded by the iterator, if any.
+static Chain PrintIteratorStats(RCReference<Iterator>* iterator, Chain chain) {
+  if (const auto* stats = (*iterator)->stats()) {
+    stats->Print(tfrt::outs());
+    tfrt::outs().flush();
+  }
+  return Chain();
+}
+
 // Get the next element from the iterator and advance iterator.
 // The returned AsyncValueRef will contain error if the iterator has reached
 // end prior to the method invocation.
@@ -457,6 +611,10 @@ RCReference<LogDataset> MakeLogDataset(RCReference<Dataset>* dataset,
 void RegisterDataKernels(KernelRegistry* registry) {
   registry->AddKernel("tfrt_data.make_iterator",
                       TFRT_KERNEL(MakeIteratorFromDataset));
+  registry->AddKernel("tfrt_data.make_iterator_with_stats",
+                      TFRT_KERNEL(MakeIteratorWithStats));
+  registry->AddKernel("tfrt_data.print_iterator_stats",
+                      TFRT_KERNEL(PrintIteratorStats));
   registry->AddKernel("tfrt_data.iterator_get_next",
                       TFRT_KERNEL(IteratorGetNext));
   registry->AddKernel("tfrt_data.enumerate.iterator",
@@ -490,11 +648,19 @@ void RegisterDataKernels(KernelRegistry* registry) {
   registry->AddKernel("tfrt_data.memory_dataset.str",
                       TFRT_KERNEL(MakeMemoryDataset<std::string>));
 
+  registry->AddKernel("tfrt_data.cache_dataset",
+                      TFRT_KERNEL(MakeCacheDataset));
   registry->AddKernel("tfrt_data.filter_dataset",
                       TFRT_KERNEL(MakeFilterDataset));
   registry->AddKernel("tfrt_data.interleave_dataset",
                       TFRT_KERNEL(MakeInterleaveDataset));
   registry->AddKernel("tfrt_data.map_dataset", TFRT_KERNEL(MakeMapDataset));
+  registry->AddKernel("tfrt_data.parallel_interleave_dataset",
+                      TFRT_KERNEL(MakeParallelInterleaveDataset));
+  registry->AddKernel("tfrt_data.map_and_batch_dataset",
+                      TFRT_KERNEL(MakeMapAndBatchDataset));
+  registry->AddKernel("tfrt_data.parallel_map_dataset",
+                      TFRT_KERNEL(MakeParallelMapDataset));
   registry->AddKernel("tfrt_data.prefetch_dataset",
                       TFRT_KERNEL(MakePrefetchDataset));
   registry->AddKernel("tfrt_data.repeat_dataset",
@@ -502,6 +668,12 @@ void RegisterDataKernels(KernelRegistry* registry) {
   registry->AddKernel("tfrt_data.skip_dataset", TFRT_KERNEL(MakeSkipDataset));
   registry->AddKernel("tfrt_data.tf_record_dataset",
                       TFRT_KERNEL(MakeTFRecordDataset));
+  registry->AddKernel("tfrt_data.tf_record_dataset.host_buffer",
+                      TFRT_KERNEL(MakeMappedTFRecordDataset));
+  registry->AddKernel("tfrt_data.tf_record_dataset.chunked",
+                      TFRT_KERNEL(MakeChunkedTFRecordDataset));
+  registry->AddKernel("tfrt_data.sharded_tf_record_dataset",
+                      TFRT_KERNEL(MakeShardedTFRecordDataset));
   registry->AddKernel("tfrt_data.shuffle_dataset",
                       TFRT_KERNEL(MakeShuffleDataset));
   registry->AddKernel("tfrt_data.log_dataset", TFRT_KERNEL(MakeLogDataset));
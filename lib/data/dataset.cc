@@ -16,6 +16,9 @@
 
 #include "tfrt/data/dataset.h"
 
+#include "iterator_stats.h"
+#include "tfrt/tensor/dense_host_tensor.h"
+
 namespace tfrt {
 namespace data {
 namespace internal {
@@ -24,6 +27,42 @@ bool IsConcreteAndEmpty(const IterationResult& result) {
   return result.eof.IsConcrete() && result.eof.get();
 }
 
+bool IsAvailableAndNotEof(const IterationResult& result) {
+  if (result.eof.IsConcrete() && result.eof.get()) return false;
+  if (!result.eof.IsAvailable()) return false;
+  for (auto& value : result.values) {
+    if (!value->IsAvailable()) return false;
+  }
+  return true;
+}
+
+int64_t GetElementBytes(const IterationResult& result) {
+  int64_t bytes = 0;
+  for (const auto& value : result.values) {
+    // A forwarded IndirectAsyncValue is concrete and has the type id of the
+    // value it forwards to.
+    if (value->IsConcrete() && value->IsType<DenseHostTensor>())
+      bytes += value->get<DenseHostTensor>().DataSizeInBytes();
+  }
+  return bytes;
+}
+
 }  // namespace internal
+
+RCReference<Iterator> Dataset::MakeIterator(const IteratorContext& context) {
+  if (!context.stats) return MakeIteratorInternal(context);
+  assert(context.host && "iterators with statistics need a host");
+  IteratorContext input_context = context;
+  input_context.stats = context.stats->GetOrAddInput(name());
+  auto iterator = MakeIteratorInternal(input_context);
+  return TakeRef(context.host->Construct<StatsIterator>(
+      std::move(iterator), input_context.stats, context.stats, context.host));
+}
+
+void Iterator::GetNextBatch(const ExecutionContext& exec_ctx, size_t n,
+                            llvm::SmallVectorImpl<IterationResult>* results) {
+  results->reserve(results->size() + n);
+  for (size_t i = 0; i < n; ++i) results->push_back(GetNext(exec_ctx));
+}
 }  // namespace data
 }  // namespace tfrt
@@ -28,7 +28,7 @@ namespace data {
 //===----------------------------------------------------------------------===//
 // FilterDataset methods
 //===----------------------------------------------------------------------===//
-RCReference<Iterator> FilterDataset::MakeIterator(
+RCReference<Iterator> FilterDataset::MakeIteratorInternal(
     const IteratorContext& context) {
   return TakeRef(
       host_->Construct<FilterDatasetIterator>(FormRef(this), context));
@@ -40,22 +40,119 @@ RCReference<Iterator> FilterDataset::MakeIterator(
 
 IterationResult FilterDatasetIterator::GetNext(
     const ExecutionContext& exec_ctx) {
+  auto result = MakePendingResult(exec_ctx.host());
+  {
+    mutex_lock lock(mu_);
+    output_buffer_.push(result.CopyRef());
+  }
+  MaybeScheduleBackgroundTask(exec_ctx, false, 0);
+  return result;
+}
+
+void FilterDatasetIterator::GetNextBatch(
+    const ExecutionContext& exec_ctx, size_t n,
+    llvm::SmallVectorImpl<IterationResult>* results) {
   auto* host = exec_ctx.host();
+  bool is_token_owner = false;
+  {
+    mutex_lock lock(mu_);
+    if (!token_owned_ && output_buffer_.empty()) {
+      token_owned_ = true;
+      is_token_owner = true;
+    }
+  }
+  if (!is_token_owner) {
+    Iterator::GetNextBatch(exec_ctx, n, results);
+    return;
+  }
+
+  const auto arity = parent_dataset_->arity_;
+  const Function* filter_fn = parent_dataset_->filter_fn_.get();
+  results->reserve(results->size() + n);
+  // The available elements of the batch share one eof value.
+  auto not_eof = MakeAvailableAsyncValueRef<bool>(host, false);
+  llvm::SmallVector<IterationResult, 4> inputs;
+  // Inputs fetched by earlier calls must be handled first, which is left to
+  // MaybeScheduleBackgroundTask().
+  bool is_pending = !input_and_predicate_buffer_.empty();
+  while (n > 0 && !is_pending) {
+    inputs.clear();
+    input_iterator_->GetNextBatch(exec_ctx, n, &inputs);
+    for (auto& input : inputs) {
+      if (is_pending) {
+        auto predicate = RunFunctionWhenReady(filter_fn, input.CopyRef().values,
+                                              exec_ctx);
+        BufferInput(std::move(input), std::move(predicate));
+        continue;
+      }
+      auto& eof = input.eof;
+      if (eof.IsAvailable() && !eof.IsError() && eof.get()) {
+        // The remaining inputs are at the end as well.
+        auto end = IterationResult::Eof(host, arity);
+        for (; n > 0; --n) results->push_back(end.CopyRef());
+        break;
+      }
+      if (eof.IsError()) {
+        results->push_back(
+            IterationResult::Error(FormRef(eof.GetAsyncValue()), arity));
+        --n;
+        continue;
+      }
+      auto predicate =
+          RunFunctionWhenReady(filter_fn, input.CopyRef().values, exec_ctx);
+      assert(predicate.size() == 1);
+      if (!eof.IsAvailable() || !predicate[0]->IsAvailable()) {
+        is_pending = true;
+        BufferInput(std::move(input), std::move(predicate));
+      } else if (predicate[0]->IsError()) {
+        results->push_back(
+            IterationResult::Error(std::move(predicate[0]), arity));
+        --n;
+      } else if (predicate[0]->get<bool>()) {
+        results->push_back(IterationResult::Pending(std::move(input.values),
+                                                    not_eof.CopyRef()));
+        --n;
+      }
+    }
+  }
+
+  if (n > 0) {
+    mutex_lock lock(mu_);
+    for (; n > 0; --n) {
+      results->push_back(MakePendingResult(host));
+      output_buffer_.push(results->back().CopyRef());
+    }
+  }
+  // Produce the pending results, and pass the token on to serve the
+  // GetNext(...) calls made meanwhile.
+  MaybeScheduleBackgroundTask(exec_ctx, true, 0);
+}
 
+IterationResult FilterDatasetIterator::MakePendingResult(HostContext* host) {
   llvm::SmallVector<RCReference<AsyncValue>, 4> result_values;
   result_values.resize(parent_dataset_->arity_);
   for (size_t i = 0; i < parent_dataset_->arity_; ++i) {
     result_values[i] = MakeIndirectAsyncValue(host);
   }
   auto result_eof = MakeUnconstructedAsyncValueRef<bool>(host);
-  auto result =
-      IterationResult::Pending(std::move(result_values), std::move(result_eof));
-  {
-    mutex_lock lock(mu_);
-    output_buffer_.push(result.CopyRef());
-  }
-  MaybeScheduleBackgroundTask(exec_ctx, false, 0);
-  return result;
+  return IterationResult::Pending(std::move(result_values),
+                                  std::move(result_eof));
+}
+
+void FilterDatasetIterator::BufferInput(
+    IterationResult input,
+    llvm::SmallVector<RCReference<AsyncValue>, 4> predicate_values) {
+  assert(predicate_values.size() == 1);
+  predicate_values[0]->AndThen([predicate_values = predicate_values[0],
+                                iterator = FormRef(this)]() mutable {
+    if (!predicate_values->IsError() && !predicate_values->get<bool>()) {
+      iterator->num_false_predicate_.fetch_add(1);
+    }
+  });
+  auto predicate = IterationResult::Pending(std::move(predicate_values),
+                                            input.eof.CopyRef());
+  input_and_predicate_buffer_.push(
+      std::make_pair(std::move(input), std::move(predicate)));
 }
 
 void FilterDatasetIterator::MaybeScheduleBackgroundTask(
@@ -89,22 +186,14 @@ void FilterDatasetIterator::MaybeScheduleBackgroundTask(
                         input_and_predicate_buffer_.size() +
                         std::max(num_false_predicate_.load(), 0);
   const Function* filter_fn = parent_dataset_->filter_fn_.get();
-  for (int i = 0; i < input_fetch_num; i++) {
-    auto input = input_iterator_->GetNext(exec_ctx);
-    auto predicate_values =
-        RunFunctionWhenReady(filter_fn, input.CopyRef().values, exec_ctx);
-    assert(predicate_values.size() == 1);
-
-    predicate_values[0]->AndThen([predicate_values = predicate_values[0],
-                                  iterator = FormRef(this)]() mutable {
-      if (!predicate_values->IsError() && !predicate_values->get<bool>()) {
-        iterator->num_false_predicate_.fetch_add(1);
-      }
-    });
-    auto predicate = IterationResult::Pending(std::move(predicate_values),
-                                              input.eof.CopyRef());
-    input_and_predicate_buffer_.push(
-        std::make_pair(std::move(input), std::move(predicate)));
+  if (input_fetch_num > 0) {
+    llvm::SmallVector<IterationResult, 4> inputs;
+    input_iterator_->GetNextBatch(exec_ctx, input_fetch_num, &inputs);
+    for (auto& input : inputs) {
+      auto predicate_values =
+          RunFunctionWhenReady(filter_fn, input.CopyRef().values, exec_ctx);
+      BufferInput(std::move(input), std::move(predicate_values));
+    }
   }
   // After the first value in the `input_and_predicate_buffer_` becomes
   // available, the token owner should update `output_buffer` as appropriate,
@@ -52,7 +52,10 @@ class FilterDataset : public Dataset {
   FilterDataset(const FilterDataset&) = delete;
   FilterDataset& operator=(const FilterDataset&) = delete;
 
-  RCReference<Iterator> MakeIterator(const IteratorContext& context) override;
+  string_view name() const override { return "filter"; }
+
+  RCReference<Iterator> MakeIteratorInternal(
+      const IteratorContext& context) override;
 
  private:
   // Allow iterator to rely on private data members of this dataset.
@@ -83,6 +86,11 @@ class FilterDatasetIterator : public Iterator {
 
   IterationResult GetNext(const ExecutionContext& exec_ctx) override;
 
+  // If no other call is in flight, fetches the input in batches and produces
+  // the results of available inputs whose predicate is available directly.
+  void GetNextBatch(const ExecutionContext& exec_ctx, size_t n,
+                    llvm::SmallVectorImpl<IterationResult>* results) override;
+
  private:
   // This class is not copyable or movable.
   FilterDatasetIterator(const FilterDatasetIterator&) = delete;
@@ -107,6 +115,13 @@ class FilterDatasetIterator : public Iterator {
                                    bool is_token_owner, int callback_count)
       TFRT_EXCLUDES(mu_);
 
+  // Appends `input` and the result of the predicate to the
+  // `input_and_predicate_buffer_`. Must only be called by the token owner.
+  void BufferInput(IterationResult input,
+                   llvm::SmallVector<RCReference<AsyncValue>, 4> predicate);
+
+  IterationResult MakePendingResult(HostContext* host);
+
   int OutputBufferSize() TFRT_EXCLUDES(mu_) {
     mutex_lock lock(mu_);
     return output_buffer_.size();
@@ -28,7 +28,7 @@ namespace data {
 //===----------------------------------------------------------------------===//
 // InterleaveDataset methods
 //===----------------------------------------------------------------------===//
-RCReference<Iterator> InterleaveDataset::MakeIterator(
+RCReference<Iterator> InterleaveDataset::MakeIteratorInternal(
     const IteratorContext& context) {
   return TakeRef(
       host_->Construct<InterleaveDatasetIterator>(FormRef(this), context));
@@ -62,6 +62,7 @@ IterationResult InterleaveDatasetIterator::GetNext(
   }
 
   MaybeScheduleBackgroundTask(exec_ctx, false, 0);
+  if (autotune_node_) autotune_node_->TrackConsumption(result);
   return result;
 }
 
@@ -70,9 +71,12 @@ void InterleaveDatasetIterator::PreInitializeIntermediateIterators(
   if (is_input_iterator_eof_) return;
   auto* host = exec_ctx.host();
 
-  auto fetch_num = parent_dataset_->cycle_length_ +
-                   parent_dataset_->prefetch_iterator_num_ -
-                   num_open_iterators_;
+  // The tuned number of pre-initialized iterators may have shrunk below the
+  // number of open iterators.
+  int64_t fetch_num =
+      parent_dataset_->cycle_length_ +
+      parent_dataset_->GetPrefetchIteratorNum(autotune_node_.get()) -
+      static_cast<int64_t>(num_open_iterators_);
   for (int i = 0; i < fetch_num; i++) {
     // Read value from the input iterator.
     auto input_value = input_iterator_->GetNext(exec_ctx);
@@ -207,6 +211,7 @@ AsyncValue* InterleaveDatasetIterator::FetchInputValues(
         continue;
       }
       queue.push(iterator.get()->GetNext(exec_ctx));
+      if (autotune_node_) autotune_node_->TrackProduction(queue.back());
     }
     iterator_and_queue.fetched_num_in_block += fetch_num;
     total_queues_size_ += fetch_num;
@@ -23,6 +23,7 @@
 
 #include <queue>
 
+#include "autotuner.h"
 #include "tfrt/data/dataset.h"
 #include "tfrt/host_context/function.h"
 #include "tfrt/support/forward_decls.h"
@@ -51,6 +52,10 @@ class InterleaveDatasetIterator;
 // returned Dataset objects, and cycle through them, producing `block_length`
 // consecutive elements from each iterator, and consuming the next input
 // element each time it reaches the end of an iterator.
+//
+// If `cycle_length` is kAutotune, it is set to the number of worker threads
+// and the number of intermediate iterators initialized ahead of the cycle is
+// tuned at runtime. If `block_length` is kAutotune, it is set to 1.
 class InterleaveDataset : public Dataset {
  public:
   explicit InterleaveDataset(RCReference<Dataset> input_dataset,
@@ -58,9 +63,11 @@ class InterleaveDataset : public Dataset {
                              RCReference<const Function> func, int64_t arity,
                              HostContext* host)
       : input_dataset_(std::move(input_dataset)),
-        cycle_length_(cycle_length),
-        block_length_(block_length),
-        prefetch_iterator_num_(cycle_length),
+        cycle_length_(cycle_length == kAutotune ? host->GetNumWorkerThreads()
+                                                : cycle_length),
+        block_length_(block_length == kAutotune ? 1 : block_length),
+        prefetch_iterator_num_(cycle_length == kAutotune ? kAutotune
+                                                         : cycle_length),
         arity_(arity),
         host_(host),
         allocator_(host->allocator()),
@@ -73,7 +80,10 @@ class InterleaveDataset : public Dataset {
   InterleaveDataset(const InterleaveDataset&) = delete;
   InterleaveDataset& operator=(const InterleaveDataset&) = delete;
 
-  RCReference<Iterator> MakeIterator(const IteratorContext& context) override;
+  string_view name() const override { return "interleave"; }
+
+  RCReference<Iterator> MakeIteratorInternal(
+      const IteratorContext& context) override;
 
  private:
   // Allow iterator to rely on private data members of this dataset.
@@ -83,12 +93,29 @@ class InterleaveDataset : public Dataset {
     internal::DestroyImpl<InterleaveDataset>(this, allocator_);
   }
 
+  // Returns the node tuning the number of pre-initialized intermediate
+  // iterators of a new iterator, or an empty reference if it is fixed. Each
+  // intermediate iterator holds its prefetched element and up to a block of
+  // elements queued from it.
+  RCReference<AutotuneNode> MakeAutotuneNode(const IteratorContext& context) {
+    return MaybeMakeAutotuneNode(context, "interleave", prefetch_iterator_num_,
+                                 cycle_length_, 0, 4 * cycle_length_,
+                                 /*elements_per_unit=*/block_length_ + 1,
+                                 host_);
+  }
+
+  int64_t GetPrefetchIteratorNum(const AutotuneNode* autotune_node) const {
+    if (autotune_node) return autotune_node->value();
+    if (prefetch_iterator_num_ == kAutotune) return cycle_length_;
+    return prefetch_iterator_num_;
+  }
+
   RCReference<Dataset> input_dataset_;
   const int64_t cycle_length_;
   const int64_t block_length_;
-  // Pre-initialize up to `cycle_length` intermediate iterators, in addition to
-  // initializing the intermediate iterators already requested by the current
-  // cycle.
+  // Pre-initialize up to `cycle_length` (or a tuned number of) intermediate
+  // iterators, in addition to initializing the intermediate iterators already
+  // requested by the current cycle.
   const int64_t prefetch_iterator_num_;
   const int64_t arity_;
   HostContext* host_;
@@ -105,6 +132,7 @@ class InterleaveDatasetIterator : public Iterator {
         parent_dataset_(std::move(parent_dataset)),
         input_iterator_(parent_dataset_->input_dataset_->MakeIterator(context)),
         context_(context),
+        autotune_node_(parent_dataset_->MakeAutotuneNode(context)),
         token_owned_(false) {
     for (int i = 0; i < parent_dataset_->cycle_length_; ++i) {
       iterator_and_queues_.push_back(
@@ -244,6 +272,7 @@ class InterleaveDatasetIterator : public Iterator {
   RCReference<InterleaveDataset> parent_dataset_;
   RCReference<Iterator> input_iterator_;
   const IteratorContext context_;
+  RCReference<AutotuneNode> autotune_node_;
   bool is_input_iterator_eof_ = false;
 
   // List of intermediate iterators and their states. The positions of those
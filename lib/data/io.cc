@@ -19,6 +19,7 @@
 
 #include "io.h"
 
+#include "iterator_stats.h"
 #include "tfrt/host_context/async_dispatch.h"
 #include "tfrt/tracing/tracing.h"
 
@@ -26,50 +27,77 @@ namespace tfrt {
 namespace data {
 namespace io {
 
+#ifndef NDEBUG
+// Asserts that no other thread is in GetNext(). Nested calls on the same
+// thread are allowed, e.g. from the waiter of a value forwarded by GetNext().
+class PrefetchingIterator::ConsumerCheck {
+ public:
+  explicit ConsumerCheck(PrefetchingIterator* iterator) : iterator_(iterator) {
+    auto self = std::this_thread::get_id();
+    auto owner = std::thread::id();
+    if (!iterator_->consumer_.compare_exchange_strong(
+            owner, self, std::memory_order_acquire)) {
+      assert(owner == self && "GetNext() must not be called concurrently");
+    }
+    ++iterator_->consumer_depth_;
+  }
+
+  ~ConsumerCheck() {
+    if (--iterator_->consumer_depth_ == 0)
+      iterator_->consumer_.store(std::thread::id(), std::memory_order_release);
+  }
+
+ private:
+  PrefetchingIterator* iterator_;
+};
+#endif
+
 IterationResult PrefetchingIterator::GetNext(const ExecutionContext& exec_ctx) {
-  auto* host = exec_ctx.host();
-  {
+#ifndef NDEBUG
+  ConsumerCheck consumer_check(this);
+#endif
+  if (stats_) stats_->RecordBufferSize(prefetch_buffer_.size());
+  // Fast path: return a prefetched value without taking the lock. The prefetch
+  // buffer is only non-empty while there is no pending output value, so the
+  // value is the next one in order.
+  llvm::Optional<IterationResult> input;
+  if (access_ == PrefetchBufferAccess::kLockFree) {
+    input = prefetch_buffer_.Pop();
+  } else {
     mutex_lock lock(mu_);
-    // Schedule a blocking thread to fetch data if the number of prefetched
-    // values has dropped below the threshold.
-    if (!token_owned_ && !reached_eof_ &&
-        prefetch_buffer_.size() <
-            prefetch_threshold_ + output_buffer_.size() + 1) {
-      auto task = [iterator = FormRef(this), exec_ctx]() {
-        TFRT_TRACE_SCOPE(Default, "ReadIOSource");
-        iterator->ReadIOSource(exec_ctx);
-      };
-      // This call can fail if the work queue is full.
-      if (EnqueueBlockingWork(exec_ctx.host(), std::move(task))) {
-        // The task which is successfully scheduled in the blocking threadpool
-        // should own the token.
-        token_owned_ = true;
-      }
-    }
-    // Optimize the fast path. Return the first value from prefetched buffer if
-    // there is no other pending output value and there is prefetched value
-    // available.
-    //
-    // IDEA(donglin): we can further optimize the fast path by not having
-    // GetNext() grab lock in the common case. This can be achieved by moving
-    // values from the prefetch_buffer to another buffer that can only be
-    // accessed by the caller of GetNext(), so that the GetNext() can return
-    // value from this buffer directly if it is non-empty.
-    if (!prefetch_buffer_.empty() && output_buffer_.empty()) {
-      auto input = std::move(prefetch_buffer_.front());
-      prefetch_buffer_.pop();
-      // An IterationResult from GetNextElement() should only contain available
-      // AsyncValues.
-      assert(input.eof.IsAvailable());
-      if (input.eof.IsError()) {
-        input.eof.GetAsyncValue()->SetErrorLocationIfUnset(
-            exec_ctx.location().Decode());
-        host->EmitError(input.eof.GetError());
-      }
-      return input;
-    }
+    input = prefetch_buffer_.Pop();
   }
+  if (input) return ReturnPrefetched(std::move(*input), exec_ctx);
+  return GetNextPending(exec_ctx);
+}
+
+IterationResult PrefetchingIterator::ReturnPrefetched(
+    IterationResult input, const ExecutionContext& exec_ctx) {
+  // Schedule a blocking thread to fetch data if the number of prefetched
+  // values has dropped below the threshold. While a task runs, the token is
+  // owned and the lock is not taken.
+  if (!token_owned_.load(std::memory_order_relaxed) &&
+      !reached_eof_.load(std::memory_order_relaxed) &&
+      prefetch_buffer_.size() <= prefetch_threshold_) {
+    mutex_lock lock(mu_);
+    // If the task can not be enqueued, a later GetNext(...) call reads from
+    // the IO source directly once the prefetch buffer is empty.
+    (void)MaybeStartReading(exec_ctx);
+  }
+  // An IterationResult from GetNextElement() should only contain available
+  // AsyncValues.
+  assert(input.eof.IsAvailable());
+  if (input.eof.IsError()) {
+    input.eof.GetAsyncValue()->SetErrorLocationIfUnset(
+        exec_ctx.location().Decode());
+    exec_ctx.host()->EmitError(input.eof.GetError());
+  }
+  return input;
+}
 
+IterationResult PrefetchingIterator::GetNextPending(
+    const ExecutionContext& exec_ctx) {
+  auto* host = exec_ctx.host();
   llvm::SmallVector<RCReference<AsyncValue>, 1> result_values;
   result_values.resize(1);
   // The IndirectAsyncValue might be filled later by the background blocking
@@ -78,77 +106,121 @@ IterationResult PrefetchingIterator::GetNext(const ExecutionContext& exec_ctx) {
   auto result_eof = MakeUnconstructedAsyncValueRef<bool>(host);
   auto result =
       IterationResult::Pending(std::move(result_values), std::move(result_eof));
+
+  llvm::Optional<IterationResult> input;
+  bool read_directly = false;
   {
     mutex_lock lock(mu_);
-    output_buffer_.push(result.CopyRef());
-    // Caller thread has to read data from the underlying IO source because it
-    // fails to enqueue a blocking task to read the data.
-    if (!reached_eof_ && !token_owned_ && prefetch_buffer_.empty()) {
-      // If output buffer size is not 1, it must be at least 2. Since the
-      // prefetch buffer is empty, it follows that at the end of the previous
-      // GetNext(...) call, output_buffer_size > prefetch_buffer_size. According
-      // to the document of GetNext(...), the last GetNext(...) call should
-      // have successfully enqueued a blocking task and the token should be
-      // owned. This contradicts the condition here that token_owned_ == false.
-      assert(output_buffer_.size() == 1);
-      // Read the next element from IO source directly so that
-      // output_buffer_size == prefetch_buffer_size.
-      auto input = GetNextElement(exec_ctx);
-      prefetch_buffer_.push(std::move(input));
+    // The token owner pushes values and sets reached_eof_ while holding mu_,
+    // so check the prefetch buffer again.
+    input = prefetch_buffer_.Pop();
+    if (!input && error_) input = IterationResult::Error(error_, 1);
+    if (!input) {
+      if (reached_eof_.load(std::memory_order_relaxed))
+        return IterationResult::Eof(host, 1);
+      output_buffer_.push(result.CopyRef());
+      // Caller thread has to read data from the underlying IO source if it
+      // fails to enqueue a blocking task to read the data.
+      if (!MaybeStartReading(exec_ctx)) {
+        token_owned_.store(true, std::memory_order_relaxed);
+        read_directly = true;
+      }
     }
   }
+  if (input) return ReturnPrefetched(std::move(*input), exec_ctx);
 
-  MaterializeOutputs(exec_ctx);
+  if (read_directly) {
+    // The output buffer only holds `result`, which the element is forwarded
+    // to.
+    PushInput(GetNextElement(exec_ctx), exec_ctx);
+    mutex_lock lock(mu_);
+    token_owned_.store(false, std::memory_order_relaxed);
+  }
   return result;
 }
 
+bool PrefetchingIterator::MaybeStartReading(const ExecutionContext& exec_ctx) {
+  if (token_owned_.load(std::memory_order_relaxed) ||
+      reached_eof_.load(std::memory_order_relaxed))
+    return true;
+  auto task = [iterator = FormRef(this), exec_ctx]() {
+    TFRT_TRACE_SCOPE(Default, "ReadIOSource");
+    iterator->ReadIOSource(exec_ctx);
+  };
+  // This call can fail if the work queue is full.
+  if (!EnqueueBlockingWork(exec_ctx.host(), std::move(task))) return false;
+  // The task which is successfully scheduled in the blocking threadpool
+  // should own the token.
+  token_owned_.store(true, std::memory_order_relaxed);
+  return true;
+}
+
 void PrefetchingIterator::ReadIOSource(const ExecutionContext& exec_ctx) {
   while (true) {
     int64_t fetch_num;
     {
       mutex_lock lock(mu_);
-      assert(token_owned_);
+      assert(token_owned_.load(std::memory_order_relaxed));
       // The caller is the token owner, there are enough prefetched values and
       // there is no output value to update. Release the token and return.
       if (output_buffer_.empty() &&
-          (prefetch_buffer_.size() >= prefetch_threshold_ || reached_eof_)) {
-        token_owned_ = false;
+          (prefetch_buffer_.size() >= prefetch_threshold_ ||
+           reached_eof_.load(std::memory_order_relaxed))) {
+        token_owned_.store(false, std::memory_order_relaxed);
         return;
       }
-      fetch_num =
-          max_prefetch_num_ + output_buffer_.size() - prefetch_buffer_.size();
+      fetch_num = max_prefetch_num_ + output_buffer_.size() -
+                  prefetch_buffer_.size();
     }
-    for (int32_t i = 0; i < fetch_num; ++i) {
+    for (int64_t i = 0; i < fetch_num; ++i) {
       if (exec_ctx.IsCancelled()) return;
       // Since only one thread can own the token, we can access the underlying
       // IO source without a lock.
-      auto input = GetNextElement(exec_ctx);
-      if (input.eof.IsConcrete() && input.eof.get()) {
-        mutex_lock lock(mu_);
-        reached_eof_ = true;
-        break;
-      }
-      bool need_to_materialize_output = false;
-      {
-        mutex_lock lock(mu_);
-        need_to_materialize_output =
-            prefetch_buffer_.empty() && !output_buffer_.empty();
-        prefetch_buffer_.push(std::move(input));
+      if (!PushInput(GetNextElement(exec_ctx), exec_ctx)) break;
+    }
+  }
+}
+
+bool PrefetchingIterator::PushInput(IterationResult input,
+                                    const ExecutionContext& exec_ctx) {
+  bool eof = input.eof.IsConcrete() && input.eof.get();
+  llvm::SmallVector<IterationResult, 4> outputs;
+  {
+    mutex_lock lock(mu_);
+    if (eof) {
+      reached_eof_.store(true, std::memory_order_relaxed);
+      while (!output_buffer_.empty()) {
+        outputs.push_back(std::move(output_buffer_.front()));
+        output_buffer_.pop();
       }
-      // If prefetch_buffer was empty and output_buffer is not empty, it is
-      // possible that data pipeline's control flow is blocked waiting for the
-      // value in the output_buffer to be updated. For example, the
-      // InterleaveDatasetIterator might be waiting for the EOF of the first
-      // IterationResult in the output_buffer to be available before it can
-      // decide whether to propagate this IterationResult to its caller.
-      // Therefore we should immediately update values in the output_buffer to
-      // unblock the control flow. Otherwise, the control flow is not blocked on
-      // the current iterator's output and it is preferred to let the control
-      // flow thread update values in the output_buffer.
-      if (need_to_materialize_output) MaterializeOutputs(exec_ctx);
+    } else if (output_buffer_.empty()) {
+      // The token owner never pushes more than max_prefetch_num_ values, so
+      // this only fails if the prefetch bookkeeping is broken. Fail the
+      // iterator rather than drop the element.
+      if (prefetch_buffer_.Push(std::move(input))) return true;
+      error_ = MakeErrorAsyncValueRef(
+          exec_ctx.host(), "prefetch buffer is full, an element was lost");
+      reached_eof_.store(true, std::memory_order_relaxed);
+      return false;
+    } else {
+      outputs.push_back(std::move(output_buffer_.front()));
+      output_buffer_.pop();
+    }
+  }
+  // Forward the values outside of the lock, since it runs the waiters of the
+  // outputs. The data pipeline's control flow may be blocked waiting for them,
+  // e.g. the InterleaveDatasetIterator might be waiting for the EOF of the
+  // first output to be available before it can decide whether to propagate it
+  // to its caller.
+  if (eof) {
+    IterationResult eof_result = IterationResult::Eof(exec_ctx.host(), 1);
+    for (auto& output : outputs) {
+      ForwardInputToOutput(eof_result.CopyRef(), std::move(output), exec_ctx);
     }
-    MaterializeOutputs(exec_ctx);
+    return false;
   }
+  ForwardInputToOutput(std::move(input), std::move(outputs.front()), exec_ctx);
+  return true;
 }
 
 void PrefetchingIterator::ForwardInputToOutput(
@@ -176,41 +248,6 @@ void PrefetchingIterator::ForwardInputToOutput(
   }
 }
 
-void PrefetchingIterator::MaterializeOutputs(const ExecutionContext& exec_ctx) {
-  llvm::SmallVector<std::pair<IterationResult, IterationResult>, 4> pairs;
-  bool reached_eof;
-  size_t prefetch_buffer_size;
-  while (true) {
-    {
-      mutex_lock lock(mu_);
-      while (!prefetch_buffer_.empty() && !output_buffer_.empty()) {
-        auto input = std::move(prefetch_buffer_.front());
-        auto output = std::move(output_buffer_.front());
-        prefetch_buffer_.pop();
-        output_buffer_.pop();
-        pairs.push_back(std::make_pair(std::move(input), std::move(output)));
-      }
-      reached_eof = reached_eof_;
-      prefetch_buffer_size = prefetch_buffer_.size();
-    }
-    if (pairs.empty()) break;
-    // Materialize outputs in reverse order in order to reduce the number of
-    // AndThen(...) calls in the upstream datasets.
-    for (int i = pairs.size() - 1; i >= 0; --i) {
-      ForwardInputToOutput(std::move(pairs[i].first),
-                           std::move(pairs[i].second), exec_ctx);
-    }
-    pairs.clear();
-  }
-  if (reached_eof && prefetch_buffer_size == 0) {
-    IterationResult eof_result = IterationResult::Eof(exec_ctx.host(), 1);
-    while (auto output = DequeueOutputBuffer()) {
-      ForwardInputToOutput(eof_result.CopyRef(), std::move(output.getValue()),
-                           exec_ctx);
-    }
-  }
-}
-
 }  // namespace io
 }  // namespace data
 }  // namespace tfrt
@@ -19,10 +19,15 @@
 #ifndef TFRT_LIB_DATA_IO_H_
 #define TFRT_LIB_DATA_IO_H_
 
+#include <algorithm>
 #include <atomic>
 #include <memory>
 #include <queue>
+#include <thread>
+#include <vector>
 
+#include "llvm/ADT/Optional.h"
+#include "llvm/Support/MathExtras.h"
 #include "tfrt/data/dataset.h"
 #include "tfrt/host_context/execution_context.h"
 #include "tfrt/support/forward_decls.h"
@@ -34,6 +39,69 @@ namespace tfrt {
 namespace data {
 namespace io {
 
+// A bounded single-producer single-consumer queue. One producer thread can
+// call Push() concurrently with one consumer thread calling Pop() without
+// locking. The producer and consumer roles can move to other threads if the
+// hand-off synchronizes, e.g. through a mutex.
+template <typename T>
+class SpscRing {
+ public:
+  explicit SpscRing(size_t capacity)
+      : slots_(llvm::PowerOf2Ceil(std::max<size_t>(capacity, 1))),
+        mask_(slots_.size() - 1) {}
+
+  // This class is not copyable or movable.
+  SpscRing(const SpscRing&) = delete;
+  SpscRing& operator=(const SpscRing&) = delete;
+
+  // Appends `value`. Returns false if the ring is full. Must only be called by
+  // the producer.
+  bool Push(T value) {
+    auto tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) == slots_.size())
+      return false;
+    slots_[tail & mask_].emplace(std::move(value));
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Removes the oldest value, if any. Must only be called by the consumer.
+  llvm::Optional<T> Pop() {
+    auto head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) return llvm::None;
+    auto& slot = slots_[head & mask_];
+    llvm::Optional<T> value = std::move(slot);
+    slot.reset();
+    head_.store(head + 1, std::memory_order_release);
+    return value;
+  }
+
+  // Returns the number of values. It is a snapshot if called concurrently with
+  // Push() or Pop().
+  size_t size() const {
+    auto head = head_.load(std::memory_order_acquire);
+    return tail_.load(std::memory_order_acquire) - head;
+  }
+
+ private:
+  std::vector<llvm::Optional<T>> slots_;
+  const size_t mask_;
+  // The indices are on separate cache lines to avoid false sharing between
+  // the producer and the consumer.
+  alignas(64) std::atomic<size_t> head_{0};
+  alignas(64) std::atomic<size_t> tail_{0};
+};
+
+// How PrefetchingIterator::GetNext() takes elements from the prefetch buffer.
+enum class PrefetchBufferAccess {
+  // Pops elements without taking the lock.
+  kLockFree,
+  // Pops elements while holding the lock that the token owner pushes them
+  // with, like the prefetching iterator did before the lock-free path. Only
+  // used to benchmark the contention between GetNext() and the token owner.
+  kLocked,
+};
+
 // The goal of a prefetching iterator is to move all slow and potentially
 // blocking IO operations out of the Iterator::GetNext() execution path.
 //
@@ -43,12 +111,17 @@ namespace io {
 // launches asynchronous tasks, that read elements into the memory buffer ahead
 // of the calls to GetNext().
 //
-// Prefetching iterator uses locks to guarantee that access to the IO source
+// Prefetching iterator uses a token to guarantee that access to the IO source
 // is properly synchronized. Derived iterators do not need any additional
 // synchronization.
 //
 // In the common case asynchronous prefetch tasks should run ahead of GetNext(),
 // and all calls to get the next element should produce results instantaneously.
+// The prefetched elements are passed to GetNext() through a single-producer
+// single-consumer ring, so that GetNext() takes no lock while the ring is
+// above the prefetch threshold. The lock is only taken to start a prefetch
+// task, about once per batch of elements read by the task, and to return a
+// pending result when the ring is empty.
 //
 // This is an internal implementation detail, and it is not exposed to the end
 // user as a dataset type.
@@ -57,24 +130,24 @@ namespace io {
 // of prefetched records, but also on the memory consumption.
 class PrefetchingIterator : public Iterator {
  public:
-  explicit PrefetchingIterator(int64_t max_prefetch_num,
-                               int64_t prefetch_threshold,
-                               const IteratorContext& context)
+  explicit PrefetchingIterator(
+      int64_t max_prefetch_num, int64_t prefetch_threshold,
+      const IteratorContext& context,
+      PrefetchBufferAccess access = PrefetchBufferAccess::kLockFree)
       : Iterator(),
+        prefetch_buffer_(max_prefetch_num),
         max_prefetch_num_(max_prefetch_num),
         prefetch_threshold_(prefetch_threshold),
-        token_owned_(false),
-        reached_eof_(false) {}
+        access_(access),
+        stats_(context.stats) {}
 
-  // Gets the next element from a prefetch buffer, and may be enqueue an
+  // Gets the next element from the prefetch buffer, and may enqueue an
   // asynchronous blocking task to fill up the buffer. If the prefetch buffer is
-  // empty and the blocking task can not be enqueued, reads the next element
-  // from the IO source directly.
+  // empty, returns a pending result which is filled by the task. If the task
+  // can not be enqueued, reads the next element from the IO source directly.
   //
-  // After this method returns, either a blocking task is launched, or
-  // output_buffer_size <= prefetch_buffer_size. The blocking
-  // task should guarantee that output_buffer_size <= prefetch_buffer_size
-  // before it completes.
+  // GetNext() must not be called concurrently, since the prefetch buffer has a
+  // single consumer. Debug builds check it.
   IterationResult GetNext(const ExecutionContext& exec_ctx) final;
 
  protected:
@@ -90,50 +163,82 @@ class PrefetchingIterator : public Iterator {
   virtual IterationResult GetNextElement(const ExecutionContext& exec_cxt) = 0;
 
  private:
-  // Read data from IO source if there is more data to fetch. And it forwards
-  // values from the prefetch_buffer_ to those values in the output_buffer_.
+#ifndef NDEBUG
+  class ConsumerCheck;
+#endif
+
+  // Returns an element popped from the prefetch buffer, and starts a task to
+  // refill the buffer if it dropped below the threshold.
+  IterationResult ReturnPrefetched(IterationResult input,
+                                   const ExecutionContext& exec_ctx)
+      TFRT_EXCLUDES(mu_);
+
+  // Returns the end of iteration, or a pending result if the next element has
+  // not been read yet. Called when the prefetch buffer was empty.
+  IterationResult GetNextPending(const ExecutionContext& exec_ctx)
+      TFRT_EXCLUDES(mu_);
+
+  // Enqueues a blocking task to read from the IO source unless the token is
+  // owned or the IO source reached eof. Returns false if the task could not be
+  // enqueued.
+  bool MaybeStartReading(const ExecutionContext& exec_ctx) TFRT_REQUIRES(mu_);
+
+  // Reads data from the IO source until the prefetch buffer is full and there
+  // is no pending result. Must be called by the token owner.
   void ReadIOSource(const ExecutionContext& exec_ctx) TFRT_EXCLUDES(mu_);
 
+  // Forwards `input`, which was read by the token owner, to the oldest pending
+  // result, or pushes it to the prefetch buffer if there is none. Returns
+  // false if `input` is the end of iteration, or if the prefetch buffer is
+  // full, in which case the iterator fails with an error.
+  bool PushInput(IterationResult input, const ExecutionContext& exec_ctx)
+      TFRT_EXCLUDES(mu_);
+
   // Forward eof and values from the given input to the given output.
   void ForwardInputToOutput(IterationResult input, IterationResult output,
                             const ExecutionContext& exec_ctx);
 
-  // Forward values from the prefetch_buffer_ to those values in the
-  // output_buffer_.
-  void MaterializeOutputs(const ExecutionContext& exec_ctx);
-
-  llvm::Optional<IterationResult> DequeueOutputBuffer() TFRT_EXCLUDES(mu_) {
-    mutex_lock lock(mu_);
-    if (output_buffer_.empty()) return llvm::None;
-    auto value = std::move(output_buffer_.front());
-    output_buffer_.pop();
-    return value;
-  }
-
-  mutex mu_;
-  // A queue of IterationResult returned by GetNextElement(...).
-  std::queue<IterationResult> prefetch_buffer_ TFRT_GUARDED_BY(mu_);
-  // A queue of IterationResult that have already been returned to the
-  // GetNext(...) caller.
-  std::queue<IterationResult> output_buffer_ TFRT_GUARDED_BY(mu_);
+  // Values returned by GetNextElement(). Pushed by the token owner while
+  // holding mu_, and popped by GetNext() without the lock. It is only
+  // non-empty while output_buffer_ is empty, which keeps the elements in
+  // order.
+  SpscRing<IterationResult> prefetch_buffer_;
 
   // Maximum number of values to prefetch from the underlying IO source
   // in addition to meeting the number of output values already requested in the
-  // output_buffer_. The total number of values in the queues of the open
-  // iterators is upper bounded by max_prefetch_num_ + output_buffer_size.
+  // output_buffer_.
   const size_t max_prefetch_num_;
   // Schedule background blocking thread to prefetch from the underlying IO
   // source if the number of prefetched values dropped below this threadhold.
   const size_t prefetch_threshold_;
+  const PrefetchBufferAccess access_;
+  const std::shared_ptr<IteratorStats> stats_;
+
+  mutex mu_;
+  // A queue of IterationResult that have already been returned to the
+  // GetNext(...) caller and are not filled yet.
+  std::queue<IterationResult> output_buffer_ TFRT_GUARDED_BY(mu_);
+  // The error returned after the prefetched values if an input could not be
+  // pushed to the prefetch buffer. reached_eof_ is set with it.
+  RCReference<AsyncValue> error_ TFRT_GUARDED_BY(mu_);
 
   // This is a unique logical token for this iterator instance. It effectively
   // acts as a lock to ensure in-order delivery of results by guaranteeing that
   // at most one thread can call GetNextElement() to access the underlying IO
-  // source. And a blocking task is enqueued/running if and only if
-  // token_owned_ == true.
-  bool token_owned_ TFRT_GUARDED_BY(mu_);
+  // source. A blocking task is enqueued/running or GetNext() is reading
+  // directly if and only if token_owned_ == true.
+  //
+  // token_owned_ and reached_eof_ are only written while holding mu_. GetNext()
+  // reads them without the lock to decide whether to start a task.
+  std::atomic<bool> token_owned_{false};
   // Whether the iterator has reached eof.
-  bool reached_eof_ TFRT_GUARDED_BY(mu_);
+  std::atomic<bool> reached_eof_{false};
+
+#ifndef NDEBUG
+  // The thread calling GetNext(), and the depth of its nested calls.
+  std::atomic<std::thread::id> consumer_{};
+  int consumer_depth_ = 0;
+#endif
 };
 
 }  // namespace io
@@ -0,0 +1,135 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// This file implements the IteratorStats class.
+
+#include "iterator_stats.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+#include "tfrt/host_context/async_dispatch.h"
+
+namespace tfrt {
+namespace data {
+namespace {
+
+int64_t NowNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+}  // namespace
+
+//===----------------------------------------------------------------------===//
+// IteratorStats methods
+//===----------------------------------------------------------------------===//
+std::shared_ptr<IteratorStats> IteratorStats::GetOrAddInput(string_view name) {
+  mutex_lock lock(mu_);
+  auto it = llvm::find_if(inputs_, [&](const auto& input) {
+    return input->name() == name;
+  });
+  if (it != inputs_.end()) return *it;
+  inputs_.push_back(std::make_shared<IteratorStats>(name.str()));
+  return inputs_.back();
+}
+
+void IteratorStats::RecordElement(int64_t bytes) {
+  num_elements_.fetch_add(1, std::memory_order_relaxed);
+  num_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void IteratorStats::RecordInputLatency(int64_t nanos) {
+  num_input_requests_.fetch_add(1, std::memory_order_relaxed);
+  input_latency_nanos_.fetch_add(nanos, std::memory_order_relaxed);
+}
+
+void IteratorStats::RecordBufferSize(int64_t size) {
+  num_buffer_samples_.fetch_add(1, std::memory_order_relaxed);
+  buffer_size_sum_.fetch_add(size, std::memory_order_relaxed);
+  auto max_size = max_buffer_size_.load(std::memory_order_relaxed);
+  while (size > max_size &&
+         !max_buffer_size_.compare_exchange_weak(max_size, size,
+                                                 std::memory_order_relaxed)) {
+  }
+}
+
+void IteratorStats::Print(raw_ostream& os, int indent) const {
+  os.indent(indent) << name_
+                    << ": elements=" << num_elements_.load()
+                    << " bytes=" << num_bytes_.load();
+  if (auto num_requests = num_input_requests_.load()) {
+    os << " input_latency_ms="
+       << llvm::format("%.3f", input_latency_nanos_.load() * 1e-6)
+       << " input_requests=" << num_requests;
+  }
+  if (auto num_samples = num_buffer_samples_.load()) {
+    os << " buffer_avg="
+       << llvm::format("%.1f",
+                       static_cast<double>(buffer_size_sum_.load()) /
+                           num_samples)
+       << " buffer_max=" << max_buffer_size_.load();
+  }
+  os << '\n';
+  mutex_lock lock(mu_);
+  for (const auto& input : inputs_) input->Print(os, indent + 2);
+}
+
+//===----------------------------------------------------------------------===//
+// StatsIterator methods
+//===----------------------------------------------------------------------===//
+IterationResult StatsIterator::GetNext(const ExecutionContext& exec_ctx) {
+  auto result = iterator_->GetNext(exec_ctx);
+  Track(result);
+  return result;
+}
+
+void StatsIterator::GetNextBatch(
+    const ExecutionContext& exec_ctx, size_t n,
+    llvm::SmallVectorImpl<IterationResult>* results) {
+  const size_t begin = results->size();
+  iterator_->GetNextBatch(exec_ctx, n, results);
+  for (size_t i = begin, e = results->size(); i < e; ++i) {
+    Track((*results)[i]);
+  }
+}
+
+void StatsIterator::Track(const IterationResult& result) {
+  auto record = [stats = stats_, consumer_stats = consumer_stats_](
+                    int64_t nanos, const IterationResult& result) {
+    if (consumer_stats) consumer_stats->RecordInputLatency(nanos);
+    if (result.eof.IsError() || result.eof.get()) return;
+    stats->RecordElement(internal::GetElementBytes(result));
+  };
+  auto values = result.AsyncValues();
+  if (llvm::all_of(values, [](AsyncValue* value) {
+        return value->IsAvailable();
+      })) {
+    record(0, result);
+    return;
+  }
+  RunWhenReady(values, [start = NowNanos(), result = result.CopyRef(),
+                        record = std::move(record)]() {
+    record(NowNanos() - start, result);
+  });
+}
+
+}  // namespace data
+}  // namespace tfrt
@@ -0,0 +1,134 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// This file declares the IteratorStats class, which records performance
+// statistics of the iterators of an input pipeline.
+
+#ifndef TFRT_LIB_DATA_ITERATOR_STATS_H_
+#define TFRT_LIB_DATA_ITERATOR_STATS_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tfrt/data/dataset.h"
+#include "tfrt/support/forward_decls.h"
+#include "tfrt/support/mutex.h"
+#include "tfrt/support/thread_annotations.h"
+
+namespace tfrt {
+namespace data {
+
+// Statistics of the iterators of one dataset in an input pipeline. The
+// statistics form a tree which mirrors the dataset graph: the statistics of
+// the iterators created for the inputs of a dataset are its children. The
+// iterators of one input (e.g. one per repetition of a RepeatDataset) share
+// one child.
+//
+// Recording is lock-free. The tree can be printed at any time to find the
+// stage of the pipeline which is the bottleneck: a stage whose input latency
+// is small relative to that of its consumer is producing elements too slowly.
+class IteratorStats {
+ public:
+  explicit IteratorStats(std::string name) : name_(std::move(name)) {}
+
+  // This class is not copyable or movable.
+  IteratorStats(const IteratorStats&) = delete;
+  IteratorStats& operator=(const IteratorStats&) = delete;
+
+  const std::string& name() const { return name_; }
+
+  // Returns the child for the iterators of an input dataset named `name`.
+  std::shared_ptr<IteratorStats> GetOrAddInput(string_view name)
+      TFRT_EXCLUDES(mu_);
+
+  // Records an element with `bytes` bytes of tensor data returned by the
+  // iterator.
+  void RecordElement(int64_t bytes);
+
+  // Records that an element requested from an input of the iterator took
+  // `nanos` nanoseconds from the GetNext() call to become available. This is
+  // the latency of the input, not the time the iterator was blocked on it:
+  // iterators do not block, and may do other work while an element is
+  // pending.
+  void RecordInputLatency(int64_t nanos);
+
+  // Records the number of elements buffered by the iterator. Iterators with
+  // buffers record it whenever an element is requested from them.
+  void RecordBufferSize(int64_t size);
+
+  // Prints the statistics of this iterator and its inputs, one line per
+  // iterator indented by depth.
+  void Print(raw_ostream& os, int indent = 0) const TFRT_EXCLUDES(mu_);
+
+ private:
+  const std::string name_;
+
+  std::atomic<int64_t> num_elements_{0};
+  std::atomic<int64_t> num_bytes_{0};
+  std::atomic<int64_t> num_input_requests_{0};
+  std::atomic<int64_t> input_latency_nanos_{0};
+  std::atomic<int64_t> num_buffer_samples_{0};
+  std::atomic<int64_t> buffer_size_sum_{0};
+  std::atomic<int64_t> max_buffer_size_{0};
+
+  mutable mutex mu_;
+  std::vector<std::shared_ptr<IteratorStats>> inputs_ TFRT_GUARDED_BY(mu_);
+};
+
+// Wraps an iterator and records the elements it returns in `stats`, and the
+// time they take from GetNext() to become available in `consumer_stats`.
+class StatsIterator : public Iterator {
+ public:
+  StatsIterator(RCReference<Iterator> iterator,
+                std::shared_ptr<IteratorStats> stats,
+                std::shared_ptr<IteratorStats> consumer_stats,
+                HostContext* host)
+      : iterator_(std::move(iterator)),
+        stats_(std::move(stats)),
+        consumer_stats_(std::move(consumer_stats)),
+        allocator_(host->allocator()) {}
+
+  // This class is not copyable or movable.
+  StatsIterator(const StatsIterator&) = delete;
+  StatsIterator& operator=(const StatsIterator&) = delete;
+
+  IterationResult GetNext(const ExecutionContext& exec_ctx) override;
+
+  void GetNextBatch(const ExecutionContext& exec_ctx, size_t n,
+                    llvm::SmallVectorImpl<IterationResult>* results) override;
+
+  const IteratorStats* stats() const override { return stats_.get(); }
+
+ private:
+  void Destroy() override {
+    internal::DestroyImpl<StatsIterator>(this, allocator_);
+  }
+
+  void Track(const IterationResult& result);
+
+  RCReference<Iterator> iterator_;
+  const std::shared_ptr<IteratorStats> stats_;
+  const std::shared_ptr<IteratorStats> consumer_stats_;
+  HostAllocator* allocator_;
+};
+
+}  // namespace data
+}  // namespace tfrt
+
+#endif  // TFRT_LIB_DATA_ITERATOR_STATS_H_
@@ -42,7 +42,10 @@ class LogDataset : public Dataset {
   LogDataset(const LogDataset&) = delete;
   LogDataset& operator=(const LogDataset&) = delete;
 
-  RCReference<Iterator> MakeIterator(const IteratorContext& context) override;
+  string_view name() const override { return "log"; }
+
+  RCReference<Iterator> MakeIteratorInternal(
+      const IteratorContext& context) override;
 
  private:
   // Allow iterator to rely on private data members of this dataset.
@@ -85,7 +88,7 @@ class LogDatasetIterator : public Iterator {
   std::queue<IterationResult> buffer_;
 };
 
-inline RCReference<Iterator> LogDataset::MakeIterator(
+inline RCReference<Iterator> LogDataset::MakeIteratorInternal(
     const IteratorContext& context) {
   return TakeRef(host_->Construct<LogDatasetIterator>(FormRef(this), context));
 }
@@ -0,0 +1,241 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// This file implements MapAndBatchDataset class which maps a function over the
+// elements of another Dataset instance and batches the results, writing each
+// result directly into its slice of the batched tensor.
+
+#include "map_and_batch_dataset.h"
+
+#include <atomic>
+#include <cstring>
+#include <memory>
+
+#include "batch_dataset.h"
+#include "tfrt/host_context/async_dispatch.h"
+#include "tfrt/host_context/chain.h"
+#include "tfrt/host_context/host_buffer.h"
+#include "tfrt/support/error_util.h"
+
+namespace tfrt {
+namespace data {
+
+// State shared by the map function invocations of one batch. It is deleted by
+// the invocation which finishes last.
+struct MapAndBatchState {
+  MapAndBatchState(DenseHostTensor batch, uint32_t batch_size,
+                   AsyncValueRef<DenseHostTensor> result)
+      : batch(std::move(batch)),
+        result(std::move(result)),
+        batch_size(batch_size),
+        pending_num(batch_size) {}
+
+  ~MapAndBatchState() {
+    if (auto* error_value = error.load(std::memory_order_relaxed))
+      error_value->DropRef();
+  }
+
+  DenseHostTensor batch;
+  AsyncValueRef<DenseHostTensor> result;
+  const uint32_t batch_size;
+  // The number of slices which are not written yet.
+  std::atomic<uint32_t> pending_num;
+  // The number of inputs in the batch whose eof is true.
+  std::atomic<uint32_t> eof_num{0};
+  // The first error, if any. Holds a reference.
+  std::atomic<AsyncValue*> error{nullptr};
+};
+
+// Records `error_value` as the error of the batch unless an error has already
+// been recorded.
+static void SetBatchError(MapAndBatchState* state,
+                          RCReference<AsyncValue> error_value) {
+  AsyncValue* null_value = nullptr;
+  if (state->error.compare_exchange_strong(null_value, error_value.get(),
+                                           std::memory_order_relaxed)) {
+    error_value.release();
+  }
+}
+
+// Marks one slice as done. When all slices are done, the batch (truncated to
+// the elements before the end of iteration) or the first error is moved to the
+// result, and `state` is deleted.
+static void FinishSlice(MapAndBatchState* state,
+                        const ExecutionContext& exec_ctx) {
+  // The acquire-release ordering makes the writes of all other slices visible
+  // to the thread which finishes last.
+  if (state->pending_num.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+  std::unique_ptr<MapAndBatchState> owned_state(state);
+
+  auto* error_value = state->error.load(std::memory_order_relaxed);
+  auto batch_size =
+      state->batch_size - state->eof_num.load(std::memory_order_relaxed);
+  if (error_value != nullptr) {
+    state->result.SetError(error_value->GetError());
+  } else if (batch_size == 0) {
+    auto error =
+        MakeErrorAsyncValueRef(exec_ctx.host(), "iterator reached end");
+    state->result.SetError(error->GetError());
+  } else if (batch_size == state->batch_size) {
+    state->result.emplace(std::move(state->batch));
+  } else {
+    state->result.emplace(TruncateTensor(state->batch, batch_size));
+  }
+}
+
+//===----------------------------------------------------------------------===//
+// MapAndBatchDataset methods
+//===----------------------------------------------------------------------===//
+RCReference<Iterator> MapAndBatchDataset::MakeIteratorInternal(
+    const IteratorContext& context) {
+  return TakeRef(
+      host_->Construct<MapAndBatchDatasetIterator>(FormRef(this), context));
+}
+
+//===----------------------------------------------------------------------===//
+// MapAndBatchDatasetIterator methods
+//===----------------------------------------------------------------------===//
+IterationResult MapAndBatchDatasetIterator::GetNext(
+    const ExecutionContext& exec_ctx) {
+  HostContext* host = exec_ctx.host();
+  const auto& element_metadata = parent_dataset_->element_metadata_;
+  auto batch_size = parent_dataset_->batch_size_;
+
+  llvm::SmallVector<Index, 4> batch_dims;
+  batch_dims.push_back(batch_size);
+  for (int i = 0, e = element_metadata.shape.GetRank(); i < e; ++i)
+    batch_dims.push_back(element_metadata.shape.GetDimensionSize(i));
+  auto batch = DenseHostTensor::CreateUninitialized(
+      TensorMetadata(element_metadata.dtype, batch_dims), host);
+  if (!batch) {
+    return IterationResult::Error(
+        EmitErrorAsync(exec_ctx, "failed to create uninitialized tensor"), 1);
+  }
+
+  auto result = MakeUnconstructedAsyncValueRef<DenseHostTensor>(host);
+  auto* state =
+      new MapAndBatchState(std::move(*batch), batch_size, result.CopyRef());
+
+  // result's eof should be exactly the same as the eof of the first input.
+  llvm::SmallVector<IterationResult, 4> inputs;
+  input_iterator_->GetNextBatch(exec_ctx, batch_size, &inputs);
+  auto eof = inputs[0].eof.CopyRef();
+  for (int64_t i = 0; i < batch_size; ++i) {
+    MapIntoSlice(std::move(inputs[i]), i, state, exec_ctx);
+  }
+
+  llvm::SmallVector<RCReference<AsyncValue>, 4> result_values;
+  result_values.push_back(std::move(result));
+  return IterationResult::Pending(std::move(result_values), std::move(eof));
+}
+
+void MapAndBatchDatasetIterator::MapIntoSlice(
+    IterationResult input, size_t slice_index, MapAndBatchState* state,
+    const ExecutionContext& exec_ctx) {
+  HostContext* host = exec_ctx.host();
+  size_t slice_size = state->batch.DataSizeInBytes() / state->batch_size;
+  auto slice = MakeAvailableAsyncValueRef<DenseHostTensor>(
+      host, parent_dataset_->element_metadata_,
+      HostBuffer::CreateFromExternal(state->batch.buffer().CopyRef(),
+                                     slice_index * slice_size, slice_size));
+
+  llvm::SmallVector<RCReference<AsyncValue>, 4> arguments;
+  for (auto* value : parent_dataset_->additional_fn_args_.values())
+    arguments.push_back(FormRef(value));
+  for (auto& value : input.values) arguments.push_back(std::move(value));
+  // The slice is only passed to a function which takes one more argument than
+  // the additional arguments and the components of the element.
+  if (parent_dataset_->map_fn_->num_arguments() == arguments.size() + 1)
+    arguments.push_back(slice.CopyRCRef());
+
+  llvm::SmallVector<AsyncValue*, 4> async_value_ptrs;
+  for (const auto& argument : arguments)
+    async_value_ptrs.push_back(argument.get());
+  async_value_ptrs.push_back(input.eof.GetAsyncValue());
+
+  RunWhenReady(async_value_ptrs, [dataset = parent_dataset_.CopyRef(),
+                                  arguments = std::move(arguments),
+                                  slice = std::move(slice),
+                                  eof = std::move(input.eof), state,
+                                  exec_ctx]() mutable {
+    if (!eof.IsError() && eof.get()) {
+      state->eof_num.fetch_add(1, std::memory_order_relaxed);
+      FinishSlice(state, exec_ctx);
+      return;
+    }
+    if (eof.IsError()) {
+      SetBatchError(state, FormRef(eof.GetAsyncValue()));
+      FinishSlice(state, exec_ctx);
+      return;
+    }
+    for (const auto& argument : arguments) {
+      if (!argument->IsError()) continue;
+      SetBatchError(state, argument.CopyRef());
+      FinishSlice(state, exec_ctx);
+      return;
+    }
+
+    // Enqueue the invocation so that the slices of a batch are computed in
+    // parallel rather than by the thread which resolves the last input.
+    EnqueueWork(exec_ctx, [dataset = std::move(dataset),
+                           arguments = std::move(arguments),
+                           slice = std::move(slice), state,
+                           exec_ctx]() mutable {
+      llvm::SmallVector<AsyncValue*, 4> argument_ptrs;
+      for (const auto& argument : arguments)
+        argument_ptrs.push_back(argument.get());
+      llvm::SmallVector<RCReference<AsyncValue>, 1> results;
+      results.resize(1);
+      dataset->map_fn_->Execute(exec_ctx, argument_ptrs, results);
+
+      // The result of a function which completes asynchronously is an
+      // IndirectAsyncValue. Once it is forwarded, it has the type id of the
+      // concrete value, so IsType() below checks the type of the latter.
+      auto* result = results[0].get();
+      result->AndThen([result = std::move(results[0]),
+                       slice = std::move(slice), state, exec_ctx]() {
+        if (result->IsError()) {
+          SetBatchError(state, result.CopyRef());
+        } else if (result->IsType<DenseHostTensor>()) {
+          // Copy the result unless the function wrote it into the slice.
+          auto& tensor = result->get<DenseHostTensor>();
+          auto& slice_tensor = slice.get();
+          if (tensor.data() != slice_tensor.data()) {
+            if (tensor.metadata() != slice_tensor.metadata()) {
+              SetBatchError(
+                  state, EmitErrorAsync(
+                             exec_ctx, StrCat("map function returned ",
+                                              tensor.metadata(), ", expected ",
+                                              slice_tensor.metadata())));
+            } else {
+              std::memcpy(slice_tensor.data(), tensor.data(),
+                          slice_tensor.DataSizeInBytes());
+            }
+          }
+        } else if (!result->IsType<Chain>()) {
+          SetBatchError(
+              state, EmitErrorAsync(exec_ctx,
+                                    "map function must return a "
+                                    "DenseHostTensor or a chain"));
+        }
+        FinishSlice(state, exec_ctx);
+      });
+    });
+  });
+}
+
+}  // namespace data
+}  // namespace tfrt
@@ -0,0 +1,128 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// This file declares MapAndBatchDataset class which maps a function over the
+// elements of another Dataset instance and batches the results, writing each
+// result directly into its slice of the batched tensor.
+
+#ifndef TFRT_LIB_DATA_MAP_AND_BATCH_DATASET_H_
+#define TFRT_LIB_DATA_MAP_AND_BATCH_DATASET_H_
+
+#include "tfrt/data/dataset.h"
+#include "tfrt/host_context/function.h"
+#include "tfrt/support/forward_decls.h"
+#include "tfrt/tensor/dense_host_tensor.h"
+#include "tfrt/tensor/tensor_metadata.h"
+
+namespace tfrt {
+namespace data {
+
+class MapAndBatchDatasetIterator;
+struct MapAndBatchState;
+
+// MapAndBatchDataset is equivalent to a MapDataset followed by a
+// BatchDataset<DenseHostTensor>, for a map function with a single result whose
+// dtype and shape are known up front.
+//
+// GetNext() allocates the batched tensor before any input is available. If the
+// map function takes one more argument than the additional arguments and the
+// components of the element, each invocation gets a DenseHostTensor aliasing
+// the slice of its element as that last argument. The function can write its
+// result into that tensor and return it (or a chain), in which case nothing
+// is copied. Any other DenseHostTensor result, e.g. from a function which
+// does not take the slice, is copied into the slice.
+class MapAndBatchDataset : public Dataset {
+ public:
+  explicit MapAndBatchDataset(RCReference<Dataset> input_dataset,
+                              int64_t batch_size,
+                              RCArray<AsyncValue> additional_fn_args,
+                              RCReference<const Function> map_fn,
+                              TensorMetadata element_metadata,
+                              HostContext* host)
+      : input_dataset_(std::move(input_dataset)),
+        batch_size_(batch_size),
+        element_metadata_(std::move(element_metadata)),
+        host_(host),
+        allocator_(host->allocator()),
+        additional_fn_args_(std::move(additional_fn_args)),
+        map_fn_(std::move(map_fn)) {
+    assert(batch_size_ > 0);
+    assert(map_fn_->result_types().size() == 1);
+  }
+
+  // This class is not copyable or movable.
+  MapAndBatchDataset(const MapAndBatchDataset&) = delete;
+  MapAndBatchDataset& operator=(const MapAndBatchDataset&) = delete;
+
+  string_view name() const override { return "map_and_batch"; }
+
+  RCReference<Iterator> MakeIteratorInternal(
+      const IteratorContext& context) override;
+
+ private:
+  // Allow iterator to rely on private data members of this dataset.
+  friend class MapAndBatchDatasetIterator;
+
+  void Destroy() override {
+    internal::DestroyImpl<MapAndBatchDataset>(this, allocator_);
+  }
+
+  RCReference<Dataset> input_dataset_;
+  const int64_t batch_size_;
+  // Metadata of the result of the map function for a single element.
+  const TensorMetadata element_metadata_;
+  HostContext* host_;
+  HostAllocator* allocator_;
+  RCArray<AsyncValue> additional_fn_args_;
+  RCReference<const Function> map_fn_;
+};
+
+class MapAndBatchDatasetIterator : public Iterator {
+ public:
+  explicit MapAndBatchDatasetIterator(
+      RCReference<MapAndBatchDataset> parent_dataset,
+      const IteratorContext& context)
+      : Iterator(),
+        parent_dataset_(std::move(parent_dataset)),
+        input_iterator_(
+            parent_dataset_->input_dataset_->MakeIterator(context)) {}
+
+  // This class is not copyable or movable.
+  MapAndBatchDatasetIterator(const MapAndBatchDatasetIterator&) = delete;
+  MapAndBatchDatasetIterator& operator=(const MapAndBatchDatasetIterator&) =
+      delete;
+
+  IterationResult GetNext(const ExecutionContext& exec_ctx) override;
+
+ private:
+  void Destroy() override {
+    internal::DestroyImpl<MapAndBatchDatasetIterator>(
+        this, parent_dataset_->allocator_);
+  }
+
+  // Runs the map function on `input` once it is available, writing the result
+  // into the `slice_index`-th slice of the batch owned by `state`.
+  void MapIntoSlice(IterationResult input, size_t slice_index,
+                    MapAndBatchState* state, const ExecutionContext& exec_ctx);
+
+  RCReference<MapAndBatchDataset> parent_dataset_;
+  RCReference<Iterator> input_iterator_;
+};
+
+}  // namespace data
+}  // namespace tfrt
+
+#endif  // TFRT_LIB_DATA_MAP_AND_BATCH_DATASET_H_
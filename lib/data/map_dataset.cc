@@ -25,7 +25,8 @@ namespace data {
 //===----------------------------------------------------------------------===//
 // MapDataset methods
 //===----------------------------------------------------------------------===//
-RCReference<Iterator> MapDataset::MakeIterator(const IteratorContext& context) {
+RCReference<Iterator> MapDataset::MakeIteratorInternal(
+    const IteratorContext& context) {
   return TakeRef(host_->Construct<MapDatasetIterator>(FormRef(this), context));
 }
 
@@ -33,7 +34,21 @@ RCReference<Iterator> MapDataset::MakeIterator(const IteratorContext& context) {
 // MapDatasetIterator methods
 //===----------------------------------------------------------------------===//
 IterationResult MapDatasetIterator::GetNext(const ExecutionContext& exec_ctx) {
-  auto input = input_iterator_->GetNext(exec_ctx);
+  return Map(input_iterator_->GetNext(exec_ctx), exec_ctx);
+}
+
+void MapDatasetIterator::GetNextBatch(
+    const ExecutionContext& exec_ctx, size_t n,
+    llvm::SmallVectorImpl<IterationResult>* results) {
+  const size_t begin = results->size();
+  input_iterator_->GetNextBatch(exec_ctx, n, results);
+  for (size_t i = begin, e = results->size(); i < e; ++i) {
+    (*results)[i] = Map(std::move((*results)[i]), exec_ctx);
+  }
+}
+
+IterationResult MapDatasetIterator::Map(IterationResult input,
+                                        const ExecutionContext& exec_ctx) {
   const Function* map_fn = parent_dataset_->map_fn_.get();
 
   auto values = std::move(input.values);
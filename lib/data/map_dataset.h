@@ -47,7 +47,10 @@ class MapDataset : public Dataset {
   MapDataset(const MapDataset&) = delete;
   MapDataset& operator=(const MapDataset&) = delete;
 
-  RCReference<Iterator> MakeIterator(const IteratorContext& context) override;
+  string_view name() const override { return "map"; }
+
+  RCReference<Iterator> MakeIteratorInternal(
+      const IteratorContext& context) override;
 
  private:
   // Allow iterator to rely on private data members of this dataset.
@@ -136,11 +139,17 @@ class MapDatasetIterator : public Iterator {
 
   IterationResult GetNext(const ExecutionContext& exec_ctx) override;
 
+  void GetNextBatch(const ExecutionContext& exec_ctx, size_t n,
+                    llvm::SmallVectorImpl<IterationResult>* results) override;
+
  private:
   // This class is not copyable or movable.
   MapDatasetIterator(const MapDatasetIterator&) = delete;
   MapDatasetIterator& operator=(const MapDatasetIterator&) = delete;
 
+  // Applies the map function to `input` once it is available.
+  IterationResult Map(IterationResult input, const ExecutionContext& exec_ctx);
+
   void Destroy() override {
     internal::DestroyImpl<MapDatasetIterator>(this,
                                               parent_dataset_->allocator_);
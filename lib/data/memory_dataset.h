@@ -78,7 +78,10 @@ class MemoryDataset : public Dataset {
   MemoryDataset(const MemoryDataset&) = delete;
   MemoryDataset& operator=(const MemoryDataset&) = delete;
 
-  RCReference<Iterator> MakeIterator(const IteratorContext& context) override;
+  string_view name() const override { return "memory"; }
+
+  RCReference<Iterator> MakeIteratorInternal(
+      const IteratorContext& context) override;
 
  private:
   friend class MemoryDatasetIterator<T...>;
@@ -158,7 +161,7 @@ class MemoryDatasetIterator : public Iterator {
 };
 
 template <typename... T>
-RCReference<Iterator> MemoryDataset<T...>::MakeIterator(
+RCReference<Iterator> MemoryDataset<T...>::MakeIteratorInternal(
     const IteratorContext& context) {
   return TakeRef(
       host_->Construct<MemoryDatasetIterator<T...>>(FormRef(this), context));
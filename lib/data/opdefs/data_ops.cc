@@ -217,6 +217,41 @@ LogicalResult RangeDatasetOp::verify() {
   return success();
 }
 
+// Verifies that `compression_type` is a supported TFRecord compression type.
+static LogicalResult VerifyCompressionType(Operation *op,
+                                           StringRef compression_type) {
+  if (!compression_type.empty() && compression_type != "ZLIB" &&
+      compression_type != "GZIP")
+    return op->emitOpError("unsupported compression_type: ")
+           << compression_type;
+  return success();
+}
+
+LogicalResult TFRecordDatasetOp::verify() {
+  TFRecordDatasetOp op = *this;
+  auto compression_type = op.compression_type();
+  if (!compression_type) return success();
+  return VerifyCompressionType(op, *compression_type);
+}
+
+LogicalResult TFRecordDatasetChunkedOp::verify() {
+  TFRecordDatasetChunkedOp op = *this;
+  if (op.chunk_size() <= 0)
+    return op.emitOpError("requires a positive chunk_size");
+  return success();
+}
+
+LogicalResult ShardedTFRecordDatasetOp::verify() {
+  ShardedTFRecordDatasetOp op = *this;
+  if (op.num_parallel_reads() <= 0)
+    return op.emitOpError("requires a positive num_parallel_reads");
+  if (op.num_shards() <= 0)
+    return op.emitOpError("requires a positive num_shards");
+  if (op.shard_index() < 0 || op.shard_index() >= op.num_shards())
+    return op.emitOpError("requires shard_index to be in [0, num_shards)");
+  return VerifyCompressionType(op, op.compression_type());
+}
+
 }  // namespace data
 }  // namespace tfrt
 
@@ -0,0 +1,241 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// This file implements ParallelInterleaveDataset class, which applies a
+// function to its input to create a dataset per input element, and interleaves
+// the results of these datasets while fetching from them ahead of demand.
+
+#include "parallel_interleave_dataset.h"
+
+#include "iterator_stats.h"
+#include "llvm/ADT/STLExtras.h"
+#include "tfrt/host_context/async_dispatch.h"
+
+namespace tfrt {
+namespace data {
+
+//===----------------------------------------------------------------------===//
+// ParallelInterleaveDataset methods
+//===----------------------------------------------------------------------===//
+RCReference<Iterator> ParallelInterleaveDataset::MakeIteratorInternal(
+    const IteratorContext& context) {
+  return TakeRef(host_->Construct<ParallelInterleaveDatasetIterator>(
+      FormRef(this), context));
+}
+
+//===----------------------------------------------------------------------===//
+// ParallelInterleaveDatasetIterator methods
+//===----------------------------------------------------------------------===//
+IterationResult ParallelInterleaveDatasetIterator::GetNext(
+    const ExecutionContext& exec_ctx) {
+  auto* host = exec_ctx.host();
+
+  llvm::SmallVector<RCReference<AsyncValue>, 4> result_values;
+  result_values.resize(parent_dataset_->arity_);
+  for (size_t i = 0; i < parent_dataset_->arity_; ++i) {
+    result_values[i] = MakeIndirectAsyncValue(host);
+  }
+  auto result_eof = MakeUnconstructedAsyncValueRef<bool>(host);
+  auto result =
+      IterationResult::Pending(std::move(result_values), std::move(result_eof));
+  requests_.Push(result.CopyRef());
+  MaybeRun(exec_ctx);
+  return result;
+}
+
+void ParallelInterleaveDatasetIterator::MaybeRun(
+    const ExecutionContext& exec_ctx) {
+  requests_.Run([this, &exec_ctx]() { Process(exec_ctx); });
+}
+
+void ParallelInterleaveDatasetIterator::Process(
+    const ExecutionContext& exec_ctx) {
+  if (context_.stats) {
+    size_t num_buffered = 0;
+    for (const auto& slot : cycle_) {
+      if (slot.hasValue()) num_buffered += slot->buffer.size();
+    }
+    context_.stats->RecordBufferSize(num_buffered);
+  }
+  do {
+    FillCycle(exec_ctx);
+    FetchIntermediateResults(exec_ctx);
+  } while (requests_.HasRequest() && OutputNext(exec_ctx));
+}
+
+void ParallelInterleaveDatasetIterator::ProcessWhenAvailable(
+    ArrayRef<AsyncValue*> values, const ExecutionContext& exec_ctx) {
+  RunWhenReady(values, [exec_ctx, iterator = FormRef(this)]() {
+    iterator->MaybeRun(exec_ctx);
+  });
+}
+
+void ParallelInterleaveDatasetIterator::FillCycle(
+    const ExecutionContext& exec_ctx) {
+  for (auto& slot : cycle_) {
+    if (slot.hasValue()) continue;
+    if (future_elements_.empty() && !is_input_iterator_eof_)
+      future_elements_.push_back(OpenElement(exec_ctx));
+    if (future_elements_.empty()) break;
+    slot = std::move(future_elements_.front());
+    future_elements_.pop_front();
+  }
+  auto prefetch_num =
+      static_cast<size_t>(parent_dataset_->prefetch_input_elements_);
+  while (!is_input_iterator_eof_ && future_elements_.size() < prefetch_num) {
+    future_elements_.push_back(OpenElement(exec_ctx));
+  }
+}
+
+ParallelInterleaveDatasetIterator::CycleElement
+ParallelInterleaveDatasetIterator::OpenElement(
+    const ExecutionContext& exec_ctx) {
+  auto input = input_iterator_->GetNext(exec_ctx);
+  llvm::SmallVector<AsyncValue*, 4> fn_args;
+  for (const auto& value : input.values) {
+    fn_args.push_back(value.get());
+  }
+  llvm::SmallVector<RCReference<AsyncValue>, 1> fn_results;
+  fn_results.resize(1);
+  parent_dataset_->func_->Execute(exec_ctx, fn_args, fn_results);
+
+  CycleElement element(std::move(input), std::move(fn_results[0]));
+  ProcessWhenAvailable(
+      {element.input.eof.GetAsyncValue(), element.dataset.get()}, exec_ctx);
+  return element;
+}
+
+void ParallelInterleaveDatasetIterator::FetchIntermediateResults(
+    const ExecutionContext& exec_ctx) {
+  auto buffer_size =
+      static_cast<size_t>(parent_dataset_->buffer_output_elements_);
+  for (auto& slot : cycle_) {
+    if (!slot.hasValue() || CheckElement(*slot) == ElementState::kEnd) continue;
+    // The element is not opened yet, or could not be opened.
+    if (!slot->iterator) continue;
+    auto& buffer = slot->buffer;
+    while (buffer.size() < buffer_size) {
+      buffer.push_back(slot->iterator->GetNext(exec_ctx));
+      ProcessWhenAvailable(buffer.back().eof.GetAsyncValue(), exec_ctx);
+    }
+  }
+}
+
+ParallelInterleaveDatasetIterator::ElementState
+ParallelInterleaveDatasetIterator::CheckElement(CycleElement& element) {
+  auto& input_eof = element.input.eof;
+  if (!input_eof.IsAvailable() || !element.dataset->IsAvailable())
+    return ElementState::kPending;
+  // The error is output as the only result of the element.
+  if (input_eof.IsError()) return ElementState::kReady;
+  // At the end of the input, the dataset is the error of the input values.
+  if (input_eof.get()) {
+    is_input_iterator_eof_ = true;
+    return ElementState::kEnd;
+  }
+  if (element.dataset->IsError()) return ElementState::kReady;
+
+  if (!element.iterator) {
+    element.iterator =
+        element.dataset->get<RCReference<Dataset>>()->MakeIterator(context_);
+  }
+  if (element.buffer.empty()) return ElementState::kPending;
+  auto& next_eof = element.buffer.front().eof;
+  if (!next_eof.IsAvailable()) return ElementState::kPending;
+  if (!next_eof.IsError() && next_eof.get()) return ElementState::kEnd;
+  return ElementState::kReady;
+}
+
+bool ParallelInterleaveDatasetIterator::OutputNext(
+    const ExecutionContext& exec_ctx) {
+  size_t cycle_length = cycle_.size();
+  bool sloppy = parent_dataset_->sloppy_;
+  for (size_t i = 0; i < cycle_length; ++i) {
+    size_t position = (cycle_index_ + i) % cycle_length;
+    auto& slot = cycle_[position];
+    if (!slot.hasValue()) continue;
+    switch (CheckElement(*slot)) {
+      case ElementState::kPending:
+        // Unless sloppy, results are output in the cycle order.
+        if (!sloppy) return false;
+        continue;
+      case ElementState::kEnd:
+        slot.reset();
+        cycle_index_ = (position + 1) % cycle_length;
+        return true;
+      case ElementState::kReady:
+        OutputFrom(position);
+        return true;
+    }
+  }
+
+  // Either all elements in the cycle are pending, or the cycle is empty
+  // because the input iterator has reached end.
+  if (!is_input_iterator_eof_ || !future_elements_.empty() ||
+      llvm::any_of(cycle_, [](const auto& slot) { return slot.hasValue(); }))
+    return false;
+  auto request = requests_.Pop();
+  auto error = MakeErrorAsyncValueRef(exec_ctx.host(), "iterator reached end");
+  for (auto& value : request.values) {
+    value->SetError(error->GetError());
+  }
+  request.eof.emplace(true);
+  return true;
+}
+
+void ParallelInterleaveDatasetIterator::OutputFrom(size_t position) {
+  auto& element = *cycle_[position];
+  auto request = requests_.Pop();
+  auto set_error = [&request](const DecodedDiagnostic& error) {
+    request.eof.SetError(error);
+    for (auto& value : request.values) {
+      value->SetError(error);
+    }
+  };
+
+  // The element could not be opened. Output the error and close it.
+  auto& input_eof = element.input.eof;
+  if (input_eof.IsError() || element.dataset->IsError()) {
+    set_error(input_eof.IsError() ? input_eof.GetError()
+                                  : element.dataset->GetError());
+    cycle_[position].reset();
+    cycle_index_ = (position + 1) % cycle_.size();
+    return;
+  }
+
+  auto result = std::move(element.buffer.front());
+  element.buffer.pop_front();
+  if (result.eof.IsError()) {
+    set_error(result.eof.GetError());
+  } else {
+    request.eof.emplace(false);
+    for (int i = 0; i < parent_dataset_->arity_; ++i) {
+      auto* value = cast<IndirectAsyncValue>(request.values[i].get());
+      value->ForwardTo(std::move(result.values[i]));
+    }
+  }
+
+  // Move to the next element in the cycle at the end of a block.
+  if (++element.output_num_in_block == parent_dataset_->block_length_) {
+    element.output_num_in_block = 0;
+    cycle_index_ = (position + 1) % cycle_.size();
+  } else {
+    cycle_index_ = position;
+  }
+}
+
+}  // namespace data
+}  // namespace tfrt
@@ -0,0 +1,229 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// This file declares ParallelInterleaveDataset class, which applies a function
+// to its input to create a dataset per input element, and interleaves the
+// results of these datasets while fetching from them ahead of demand.
+
+#ifndef TFRT_LIB_DATA_PARALLEL_INTERLEAVE_DATASET_H_
+#define TFRT_LIB_DATA_PARALLEL_INTERLEAVE_DATASET_H_
+
+#include <deque>
+#include <vector>
+
+#include "request_queue.h"
+#include "tfrt/data/dataset.h"
+#include "tfrt/host_context/function.h"
+#include "tfrt/support/forward_decls.h"
+
+namespace tfrt {
+namespace data {
+
+class ParallelInterleaveDatasetIterator;
+
+// ParallelInterleaveDataset interleaves the intermediate datasets returned by
+// `func` like InterleaveDataset, with the same `cycle_length` and
+// `block_length` semantics. In addition:
+//
+// - Each open intermediate iterator is fetched from ahead of demand, with up
+//   to `buffer_output_elements` results buffered per iterator, so that the
+//   intermediate iterators make progress in parallel.
+// - Up to `prefetch_input_elements` intermediate iterators are opened ahead of
+//   the cycle.
+// - If `sloppy` is true, GetNext() returns the first available result of any
+//   intermediate iterator in the cycle instead of following the cycle order,
+//   so that a slow intermediate iterator does not stall the output.
+//
+// The intermediate iterators are fetched from by the thread that runs the
+// iterator's state machine, i.e. the caller of GetNext() or the continuation
+// of a result that became available, rather than by a task per element on the
+// worker threads. GetNext() of an intermediate iterator does not wait for its
+// result: the file readers read on the blocking work queue and asynchronous
+// kernels run on the work queue, so fetching ahead of demand is enough for the
+// elements to make progress in parallel. Synchronous work of the intermediate
+// pipelines, e.g. a map function of synchronous kernels, runs on that thread;
+// a prefetch dataset at the end of `func` moves it to the worker threads. A
+// task per element would add a thread hop per result and require locking the
+// state of each element.
+//
+// If `cycle_length` is kAutotune, it is set to the number of worker threads.
+// If `block_length` is kAutotune, it is set to 1.
+class ParallelInterleaveDataset : public Dataset {
+ public:
+  explicit ParallelInterleaveDataset(RCReference<Dataset> input_dataset,
+                                     int64_t cycle_length, int64_t block_length,
+                                     RCReference<const Function> func,
+                                     int64_t arity, bool sloppy,
+                                     int64_t buffer_output_elements,
+                                     int64_t prefetch_input_elements,
+                                     HostContext* host)
+      : input_dataset_(std::move(input_dataset)),
+        cycle_length_(cycle_length == kAutotune ? host->GetNumWorkerThreads()
+                                                : cycle_length),
+        block_length_(block_length == kAutotune ? 1 : block_length),
+        arity_(arity),
+        sloppy_(sloppy),
+        buffer_output_elements_(buffer_output_elements),
+        prefetch_input_elements_(prefetch_input_elements),
+        host_(host),
+        allocator_(host->allocator()),
+        func_(std::move(func)) {
+    assert(cycle_length_ > 0);
+    assert(block_length_ > 0);
+    assert(buffer_output_elements_ > 0);
+    assert(prefetch_input_elements_ >= 0);
+  }
+
+  // This class is not copyable or movable.
+  ParallelInterleaveDataset(const ParallelInterleaveDataset&) = delete;
+  ParallelInterleaveDataset& operator=(const ParallelInterleaveDataset&) =
+      delete;
+
+  string_view name() const override { return "parallel_interleave"; }
+
+  RCReference<Iterator> MakeIteratorInternal(
+      const IteratorContext& context) override;
+
+ private:
+  // Allow iterator to rely on private data members of this dataset.
+  friend class ParallelInterleaveDatasetIterator;
+
+  void Destroy() override {
+    internal::DestroyImpl<ParallelInterleaveDataset>(this, allocator_);
+  }
+
+  RCReference<Dataset> input_dataset_;
+  const int64_t cycle_length_;
+  const int64_t block_length_;
+  const int64_t arity_;
+  const bool sloppy_;
+  const int64_t buffer_output_elements_;
+  const int64_t prefetch_input_elements_;
+  HostContext* host_;
+  HostAllocator* allocator_;
+  RCReference<const Function> func_;
+};
+
+class ParallelInterleaveDatasetIterator : public Iterator {
+ public:
+  explicit ParallelInterleaveDatasetIterator(
+      RCReference<ParallelInterleaveDataset> parent_dataset,
+      const IteratorContext& context)
+      : Iterator(),
+        parent_dataset_(std::move(parent_dataset)),
+        input_iterator_(parent_dataset_->input_dataset_->MakeIterator(context)),
+        context_(context),
+        cycle_(parent_dataset_->cycle_length_) {}
+
+  // This class is not copyable or movable.
+  ParallelInterleaveDatasetIterator(const ParallelInterleaveDatasetIterator&) =
+      delete;
+  ParallelInterleaveDatasetIterator& operator=(
+      const ParallelInterleaveDatasetIterator&) = delete;
+
+  IterationResult GetNext(const ExecutionContext& exec_ctx) override;
+
+ private:
+  // The state of an element of the input iterator and of the intermediate
+  // iterator created from it.
+  struct CycleElement {
+    CycleElement(IterationResult input, RCReference<AsyncValue> dataset)
+        : input(std::move(input)), dataset(std::move(dataset)) {}
+
+    // The value from the input_iterator_ used to create the dataset.
+    IterationResult input;
+    // The dataset returned by func_(input).
+    RCReference<AsyncValue> dataset;
+    // The intermediate iterator, created once the dataset is available.
+    RCReference<Iterator> iterator;
+    // Results fetched from the intermediate iterator, in order.
+    std::deque<IterationResult> buffer;
+    // The number of results output from the current block.
+    int64_t output_num_in_block = 0;
+  };
+
+  enum class ElementState {
+    // The next result of the element is not available yet.
+    kPending,
+    // The next result of the element (a value or an error) can be output.
+    kReady,
+    // The element has no more results.
+    kEnd,
+  };
+
+  void Destroy() override {
+    internal::DestroyImpl<ParallelInterleaveDatasetIterator>(
+        this, parent_dataset_->allocator_);
+  }
+
+  // Runs Process() on one thread at a time, see RequestQueue::Run(). The
+  // state below is only accessed by that thread.
+  void MaybeRun(const ExecutionContext& exec_ctx);
+
+  // Opens intermediate iterators, fetches from them, and fills the requested
+  // results until no more progress can be made.
+  void Process(const ExecutionContext& exec_ctx);
+
+  // Moves elements opened ahead into the free positions of the cycle, and
+  // opens elements ahead of the cycle up to prefetch_input_elements_.
+  void FillCycle(const ExecutionContext& exec_ctx);
+
+  // Fetches the next element from the input iterator and calls func_ on it.
+  CycleElement OpenElement(const ExecutionContext& exec_ctx);
+
+  // Calls MaybeRun() when all `values` are available.
+  void ProcessWhenAvailable(ArrayRef<AsyncValue*> values,
+                            const ExecutionContext& exec_ctx);
+
+  // Tops up the buffers of the intermediate iterators in the cycle.
+  void FetchIntermediateResults(const ExecutionContext& exec_ctx);
+
+  // Returns the state of `element`, creating its intermediate iterator if
+  // possible.
+  ElementState CheckElement(CycleElement& element);
+
+  // Fills the next requested result, or marks an ended element in the cycle as
+  // closed. Returns false if neither is possible yet.
+  bool OutputNext(const ExecutionContext& exec_ctx);
+
+  // Fills the next requested result from the `position`-th element of the
+  // cycle, whose state must be kReady.
+  void OutputFrom(size_t position);
+
+  RCReference<ParallelInterleaveDataset> parent_dataset_;
+  RCReference<Iterator> input_iterator_;
+  const IteratorContext context_;
+
+  // The members below are only accessed by the thread running Process().
+  //
+  // True once an element with eof=true was returned by the input iterator.
+  bool is_input_iterator_eof_ = false;
+  // The elements in the cycle. A position is empty once its element ended,
+  // until the next element is moved to it.
+  std::vector<Optional<CycleElement>> cycle_;
+  // Elements opened ahead of the cycle.
+  std::deque<CycleElement> future_elements_;
+  // The position in the cycle to output the next result from.
+  size_t cycle_index_ = 0;
+
+  // Results returned by GetNext() which are not filled yet.
+  RequestQueue requests_;
+};
+
+}  // namespace data
+}  // namespace tfrt
+
+#endif  // TFRT_LIB_DATA_PARALLEL_INTERLEAVE_DATASET_H_
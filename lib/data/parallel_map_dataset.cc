@@ -0,0 +1,181 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// This file implements ParallelMapDataset class which wraps around another
+// Dataset instance and transforms its elements with concurrent invocations of
+// a function.
+
+#include "parallel_map_dataset.h"
+
+#include <algorithm>
+
+#include "iterator_stats.h"
+#include "tfrt/host_context/async_dispatch.h"
+
+namespace tfrt {
+namespace data {
+
+//===----------------------------------------------------------------------===//
+// ParallelMapDataset methods
+//===----------------------------------------------------------------------===//
+RCReference<Iterator> ParallelMapDataset::MakeIteratorInternal(
+    const IteratorContext& context) {
+  return TakeRef(
+      host_->Construct<ParallelMapDatasetIterator>(FormRef(this), context));
+}
+
+int64_t ParallelMapDataset::GetMaxParallelCalls() const {
+  if (num_parallel_calls_ == kAutotune) return 4 * host_->GetNumWorkerThreads();
+  return num_parallel_calls_;
+}
+
+//===----------------------------------------------------------------------===//
+// ParallelMapDatasetIterator methods
+//===----------------------------------------------------------------------===//
+ParallelMapDatasetIterator::ParallelMapDatasetIterator(
+    RCReference<ParallelMapDataset> parent_dataset,
+    const IteratorContext& context)
+    : Iterator(),
+      parent_dataset_(std::move(parent_dataset)),
+      input_iterator_(parent_dataset_->input_dataset_->MakeIterator(context)),
+      autotune_node_(MaybeMakeAutotuneNode(
+          context, "parallel_map", parent_dataset_->num_parallel_calls_,
+          parent_dataset_->host_->GetNumWorkerThreads(), 1,
+          parent_dataset_->GetMaxParallelCalls(), /*elements_per_unit=*/1,
+          parent_dataset_->host_)),
+      stats_(context.stats),
+      results_(parent_dataset_->GetMaxParallelCalls()) {}
+
+IterationResult ParallelMapDatasetIterator::GetNext(
+    const ExecutionContext& exec_ctx) {
+  if (stats_) stats_->RecordBufferSize(num_results_);
+  int64_t num_parallel_calls = results_.size();
+  if (autotune_node_) {
+    num_parallel_calls = autotune_node_->value();
+  } else if (parent_dataset_->num_parallel_calls_ == kAutotune) {
+    num_parallel_calls = exec_ctx.host()->GetNumWorkerThreads();
+  }
+
+  // Keep num_parallel_calls invocations in flight, including the one whose
+  // result is returned below.
+  while (num_results_ < num_parallel_calls &&
+         !input_eof_.load(std::memory_order_relaxed)) {
+    ResultAt(num_results_) = StartCall(exec_ctx);
+    ++num_results_;
+  }
+  if (num_results_ == 0) {
+    return IterationResult::Eof(
+        exec_ctx.host(), parent_dataset_->map_fn_->result_types().size());
+  }
+
+  size_t offset = 0;
+  if (!parent_dataset_->is_deterministic_) {
+    // Return the first completed invocation. The end of iteration is only
+    // returned after all earlier invocations.
+    for (size_t i = 0; i < num_results_; ++i) {
+      if (internal::IsAvailableAndNotEof(*ResultAt(i))) {
+        offset = i;
+        break;
+      }
+    }
+  }
+  auto result = TakeResult(offset);
+  if (autotune_node_) autotune_node_->TrackConsumption(result);
+  return result;
+}
+
+IterationResult ParallelMapDatasetIterator::StartCall(
+    const ExecutionContext& exec_ctx) {
+  auto* host = exec_ctx.host();
+  const Function* map_fn = parent_dataset_->map_fn_.get();
+  auto num_results = map_fn->result_types().size();
+
+  auto input = input_iterator_->GetNext(exec_ctx);
+  if (internal::IsConcreteAndEmpty(input)) {
+    input_eof_.store(true, std::memory_order_relaxed);
+    return IterationResult::Eof(host, num_results);
+  }
+  if (!input.eof.IsAvailable()) {
+    // Stop starting calls once the input turns out to have ended, rather than
+    // requesting elements past the end until one has an available eof.
+    input.eof.AndThen([iterator = FormRef(this), eof = input.eof.CopyRef()] {
+      if (eof.IsConcrete() && eof.get())
+        iterator->input_eof_.store(true, std::memory_order_relaxed);
+    });
+  }
+
+  llvm::SmallVector<RCReference<AsyncValue>, 4> arguments;
+  for (auto* value : parent_dataset_->additional_fn_args_.values())
+    arguments.push_back(FormRef(value));
+  for (auto& value : input.values) arguments.push_back(std::move(value));
+  llvm::SmallVector<AsyncValue*, 4> argument_ptrs;
+  for (const auto& argument : arguments)
+    argument_ptrs.push_back(argument.get());
+
+  llvm::SmallVector<RCReference<IndirectAsyncValue>, 4> results;
+  llvm::SmallVector<RCReference<AsyncValue>, 4> result_values;
+  for (size_t i = 0; i < num_results; ++i) {
+    results.push_back(MakeIndirectAsyncValue(host));
+    result_values.push_back(results.back());
+  }
+
+  // The invocation is enqueued rather than run by the thread which resolves
+  // the last argument, so that invocations run in parallel. The task keeps
+  // the dataset, and therefore the function, alive.
+  RunWhenReady(argument_ptrs, [dataset = parent_dataset_.CopyRef(),
+                               arguments = std::move(arguments),
+                               results = std::move(results),
+                               exec_ctx]() mutable {
+    // Propagate errors (including the end of iteration) without invoking the
+    // function.
+    for (const auto& argument : arguments) {
+      if (!argument->IsError()) continue;
+      for (auto& result : results) result->ForwardTo(argument);
+      return;
+    }
+    EnqueueWork(exec_ctx, [dataset = std::move(dataset),
+                           arguments = std::move(arguments),
+                           results = std::move(results), exec_ctx]() mutable {
+      llvm::SmallVector<AsyncValue*, 4> argument_ptrs;
+      for (const auto& argument : arguments)
+        argument_ptrs.push_back(argument.get());
+      llvm::SmallVector<RCReference<AsyncValue>, 4> fn_results;
+      fn_results.resize(results.size());
+      dataset->map_fn_->Execute(exec_ctx, argument_ptrs, fn_results);
+      for (size_t i = 0; i < results.size(); ++i)
+        results[i]->ForwardTo(std::move(fn_results[i]));
+    });
+  });
+
+  auto result =
+      IterationResult::Pending(std::move(result_values), std::move(input.eof));
+  if (autotune_node_) autotune_node_->TrackProduction(result);
+  return result;
+}
+
+IterationResult ParallelMapDatasetIterator::TakeResult(size_t offset) {
+  assert(offset < num_results_);
+  auto result = std::move(*ResultAt(offset));
+  // Move the results in front of it back by one slot.
+  for (size_t i = offset; i > 0; --i) ResultAt(i) = std::move(ResultAt(i - 1));
+  ResultAt(0).reset();
+  head_ = (head_ + 1) % results_.size();
+  --num_results_;
+  return result;
+}
+
+}  // namespace data
+}  // namespace tfrt
@@ -0,0 +1,142 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// This file declares ParallelMapDataset class which wraps around another
+// Dataset instance and transforms its elements with concurrent invocations of
+// a function.
+
+#ifndef TFRT_LIB_DATA_PARALLEL_MAP_DATASET_H_
+#define TFRT_LIB_DATA_PARALLEL_MAP_DATASET_H_
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "autotuner.h"
+#include "tfrt/data/dataset.h"
+#include "tfrt/host_context/function.h"
+#include "tfrt/support/forward_decls.h"
+
+namespace tfrt {
+namespace data {
+
+class ParallelMapDatasetIterator;
+
+// ParallelMapDataset maps a user-defined function over the elements in its
+// input dataset, like MapDataset. Each invocation of the function is run as a
+// task on the work queue, and up to `num_parallel_calls` invocations are in
+// flight at any time. If `num_parallel_calls` is kAutotune, it is tuned at
+// runtime.
+//
+// If `is_deterministic` is false, GetNext() may return an element whose
+// function invocation has completed before those of earlier elements.
+class ParallelMapDataset : public Dataset {
+ public:
+  explicit ParallelMapDataset(RCReference<Dataset> input_dataset,
+                              RCArray<AsyncValue> additional_fn_args,
+                              RCReference<const Function> map_fn,
+                              int64_t num_parallel_calls, bool is_deterministic,
+                              HostContext* host)
+      : input_dataset_(std::move(input_dataset)),
+        num_parallel_calls_(num_parallel_calls),
+        is_deterministic_(is_deterministic),
+        host_(host),
+        allocator_(host->allocator()),
+        additional_fn_args_(std::move(additional_fn_args)),
+        map_fn_(std::move(map_fn)) {
+    assert(num_parallel_calls_ > 0 || num_parallel_calls_ == kAutotune);
+  }
+
+  // This class is not copyable or movable.
+  ParallelMapDataset(const ParallelMapDataset&) = delete;
+  ParallelMapDataset& operator=(const ParallelMapDataset&) = delete;
+
+  string_view name() const override { return "parallel_map"; }
+
+  RCReference<Iterator> MakeIteratorInternal(
+      const IteratorContext& context) override;
+
+ private:
+  // Allow iterator to rely on private data members of this dataset.
+  friend class ParallelMapDatasetIterator;
+
+  void Destroy() override {
+    internal::DestroyImpl<ParallelMapDataset>(this, allocator_);
+  }
+
+  // Returns the maximum number of invocations in flight.
+  int64_t GetMaxParallelCalls() const;
+
+  RCReference<Dataset> input_dataset_;
+  // The number of invocations in flight, or kAutotune.
+  const int64_t num_parallel_calls_;
+  const bool is_deterministic_;
+  HostContext* host_;
+  HostAllocator* allocator_;
+  RCArray<AsyncValue> additional_fn_args_;
+  RCReference<const Function> map_fn_;
+};
+
+class ParallelMapDatasetIterator : public Iterator {
+ public:
+  explicit ParallelMapDatasetIterator(
+      RCReference<ParallelMapDataset> parent_dataset,
+      const IteratorContext& context);
+
+  // This class is not copyable or movable.
+  ParallelMapDatasetIterator(const ParallelMapDatasetIterator&) = delete;
+  ParallelMapDatasetIterator& operator=(const ParallelMapDatasetIterator&) =
+      delete;
+
+  IterationResult GetNext(const ExecutionContext& exec_ctx) override;
+
+ private:
+  void Destroy() override {
+    internal::DestroyImpl<ParallelMapDatasetIterator>(
+        this, parent_dataset_->allocator_);
+  }
+
+  // Requests the next input element and starts the function invocation for
+  // it once it is available. Returns the pending result of the invocation.
+  IterationResult StartCall(const ExecutionContext& exec_ctx);
+
+  // Removes and returns the result at `offset` from the front of the ring
+  // buffer. The order of the other results is preserved.
+  IterationResult TakeResult(size_t offset);
+
+  Optional<IterationResult>& ResultAt(size_t offset) {
+    return results_[(head_ + offset) % results_.size()];
+  }
+
+  RCReference<ParallelMapDataset> parent_dataset_;
+  RCReference<Iterator> input_iterator_;
+  RCReference<AutotuneNode> autotune_node_;
+  const std::shared_ptr<IteratorStats> stats_;
+  // Ring buffer of the results of the invocations in flight, in the order of
+  // their input elements. Its capacity is the maximum number of parallel
+  // calls.
+  std::vector<Optional<IterationResult>> results_;
+  size_t head_ = 0;
+  size_t num_results_ = 0;
+  // True once an element of the input iterator has resolved to eof=true. It is
+  // set by the continuation of a pending eof, which may run on another thread.
+  std::atomic<bool> input_eof_{false};
+};
+
+}  // namespace data
+}  // namespace tfrt
+
+#endif  // TFRT_LIB_DATA_PARALLEL_MAP_DATASET_H_
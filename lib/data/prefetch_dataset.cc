@@ -19,13 +19,15 @@
 // buffer.
 #include "prefetch_dataset.h"
 
+#include "tfrt/host_context/async_dispatch.h"
+
 namespace tfrt {
 namespace data {
 
 //===----------------------------------------------------------------------===//
 // PrefetchDataset methods
 //===----------------------------------------------------------------------===//
-RCReference<Iterator> PrefetchDataset::MakeIterator(
+RCReference<Iterator> PrefetchDataset::MakeIteratorInternal(
     const IteratorContext& context) {
   if (is_deterministic_)
     return TakeRef(
@@ -34,16 +36,187 @@ RCReference<Iterator> PrefetchDataset::MakeIterator(
       FormRef(this), context));
 }
 
+RCReference<AutotuneNode> PrefetchDataset::MakeAutotuneNode(
+    const IteratorContext& context) {
+  // Buffering more elements than this rarely helps and risks running out of
+  // memory if the element sizes are unknown.
+  static constexpr int64_t kMaxAutotunePrefetchNum = 1024;
+  return MaybeMakeAutotuneNode(context, "prefetch", prefetch_num_,
+                               host_->GetNumWorkerThreads(), 1,
+                               kMaxAutotunePrefetchNum,
+                               /*elements_per_unit=*/1, host_);
+}
+
+int64_t PrefetchDataset::GetPrefetchNum(
+    const AutotuneNode* autotune_node) const {
+  if (autotune_node) return autotune_node->value();
+  if (prefetch_num_ == kAutotune) return host_->GetNumWorkerThreads();
+  return prefetch_num_;
+}
+
 //===----------------------------------------------------------------------===//
-// PrefetchDatasetIterator methods
+// PrefetchProducer methods
 //===----------------------------------------------------------------------===//
-IterationResult PrefetchDatasetIterator::GetNext(
-    const ExecutionContext& exec_ctx) {
-  while (buffer_.size() < parent_dataset_->prefetch_num_ + 1) {
-    buffer_.push(input_iterator_->GetNext(exec_ctx));
+// The producer that is requesting an element from its input iterator on this
+// thread. The input iterator may resolve earlier elements synchronously, which
+// can run the consumer's continuation and call GetNext() again on the same
+// thread.
+static thread_local const PrefetchProducer* producing_on_this_thread = nullptr;
+
+// Resolves the unavailable element `waiter` with `result`.
+static void ForwardToWaiter(IterationResult result, IterationResult waiter) {
+  assert(result.values.size() == waiter.values.size());
+  for (int i = 0, e = waiter.values.size(); i < e; ++i) {
+    cast<IndirectAsyncValue>(waiter.values[i].get())
+        ->ForwardTo(std::move(result.values[i]));
   }
+  auto* input_eof = result.eof.GetAsyncValue();
+  input_eof->AndThen([eof = std::move(result.eof),
+                      waiter_eof = std::move(waiter.eof)] {
+    if (eof.IsError()) {
+      waiter_eof.SetError(eof.GetError());
+    } else {
+      waiter_eof.emplace(eof.get());
+    }
+  });
+}
+
+IterationResult PrefetchProducer::GetNext(const ExecutionContext& exec_ctx) {
+  if (stats_) {
+    mutex_lock lock(mu_);
+    stats_->RecordBufferSize(buffer_.size());
+  }
+  auto result = PopBuffer();
+  if (!result) {
+    if (producing_on_this_thread == this) {
+      // input_mu_ is held further up this thread's stack, while an earlier
+      // element is requested. Only the holder of input_mu_ adds to the buffer,
+      // so it is still empty.
+      mutex_lock lock(mu_);
+      result = AddWaiter();
+    } else {
+      // Wait for the producer task to finish requesting its current element
+      // and check again, to keep the elements in order.
+      mutex_lock input_lock(input_mu_);
+      result = PopBuffer();
+      if (!result) {
+        mutex_lock lock(mu_);
+        if (!waiters_.empty()) result = AddWaiter();
+      }
+      if (!result) result = GetNextFromInput(exec_ctx);
+    }
+  }
+  if (autotune_node_) autotune_node_->TrackConsumption(*result);
+  MaybeStartProducing(exec_ctx);
+  return std::move(*result);
+}
+
+void PrefetchProducer::Cancel() {
+  cancelled_.store(true, std::memory_order_relaxed);
+  std::queue<IterationResult> buffer;
+  {
+    mutex_lock lock(mu_);
+    std::swap(buffer, buffer_);
+  }
+  FailWaiters("prefetch iterator was destroyed");
+}
+
+void PrefetchProducer::MaybeStartProducing(const ExecutionContext& exec_ctx) {
+  {
+    mutex_lock lock(mu_);
+    if (producing_ || !ShouldProduce()) return;
+    producing_ = true;
+  }
+  EnqueueWork(exec_ctx, [producer = FormRef(this), exec_ctx] {
+    producer->Produce(exec_ctx);
+  });
+}
+
+void PrefetchProducer::Produce(const ExecutionContext& exec_ctx) {
+  while (true) {
+    Optional<IterationResult> result;
+    Optional<IterationResult> waiter;
+    {
+      mutex_lock input_lock(input_mu_);
+      {
+        mutex_lock lock(mu_);
+        if (cancelled_.load(std::memory_order_relaxed) ||
+            exec_ctx.IsCancelled() || !ShouldProduce()) {
+          producing_ = false;
+          break;
+        }
+      }
+      result = GetNextFromInput(exec_ctx);
+      bool eof = result->eof.IsConcrete() && result->eof.get();
+      mutex_lock lock(mu_);
+      input_eof_ |= eof;
+      if (waiters_.empty()) {
+        buffer_.push(std::move(*result));
+        continue;
+      }
+      waiter = std::move(waiters_.front());
+      waiters_.pop();
+    }
+    // Resolve the waiter after releasing input_mu_, because its continuations
+    // may call GetNext() on this thread.
+    ForwardToWaiter(std::move(*result), std::move(*waiter));
+  }
+  if (cancelled_.load(std::memory_order_relaxed) || exec_ctx.IsCancelled())
+    FailWaiters("prefetch was cancelled");
+}
+
+bool PrefetchProducer::ShouldProduce() const {
+  if (!waiters_.empty()) return true;
+  return !input_eof_ &&
+         buffer_.size() < parent_dataset_->GetPrefetchNum(autotune_node_.get());
+}
+
+Optional<IterationResult> PrefetchProducer::PopBuffer() {
+  mutex_lock lock(mu_);
+  if (buffer_.empty()) return llvm::None;
   auto result = std::move(buffer_.front());
   buffer_.pop();
+  return {std::move(result)};
+}
+
+IterationResult PrefetchProducer::AddWaiter() {
+  assert(buffer_.empty());
+  assert(arity_ >= 0 && "an element is returned before it is requested");
+  auto* host = parent_dataset_->host_;
+  llvm::SmallVector<RCReference<AsyncValue>, 4> values;
+  values.reserve(arity_);
+  for (int i = 0; i < arity_; ++i)
+    values.push_back(MakeIndirectAsyncValue(host));
+  auto result = IterationResult::Pending(
+      std::move(values), MakeUnconstructedAsyncValueRef<bool>(host));
+  waiters_.push(result.CopyRef());
+  return result;
+}
+
+void PrefetchProducer::FailWaiters(string_view message) {
+  std::queue<IterationResult> waiters;
+  {
+    mutex_lock lock(mu_);
+    std::swap(waiters, waiters_);
+  }
+  if (waiters.empty()) return;
+  auto error = MakeErrorAsyncValueRef(message);
+  for (; !waiters.empty(); waiters.pop()) {
+    auto& waiter = waiters.front();
+    for (auto& value : waiter.values)
+      cast<IndirectAsyncValue>(value.get())->ForwardTo(error);
+    waiter.eof.SetError(error->GetError());
+  }
+}
+
+IterationResult PrefetchProducer::GetNextFromInput(
+    const ExecutionContext& exec_ctx) {
+  auto* outer_producer = producing_on_this_thread;
+  producing_on_this_thread = this;
+  auto result = input_iterator_->GetNext(exec_ctx);
+  producing_on_this_thread = outer_producer;
+  arity_ = result.values.size();
+  if (autotune_node_) autotune_node_->TrackProduction(result);
   return result;
 }
 
@@ -51,22 +224,16 @@ IterationResult PrefetchDatasetIterator::GetNext(
 // NonDeterministicPrefetchDatasetIterator methods
 //===----------------------------------------------------------------------===//
 
-static bool AvailableAndNotEof(const IterationResult& result) {
-  if (result.eof.IsConcrete() && result.eof.get()) return false;
-  if (!result.eof.IsAvailable()) return false;
-  for (auto& value : result.values) {
-    if (!value->IsAvailable()) return false;
-  }
-  return true;
-}
-
 IterationResult NonDeterministicPrefetchDatasetIterator::GetNext(
     const ExecutionContext& exec_ctx) {
-  while (buffer_.size() < parent_dataset_->prefetch_num_ + 1) {
+  if (stats_) stats_->RecordBufferSize(buffer_.size());
+  auto prefetch_num = parent_dataset_->GetPrefetchNum(autotune_node_.get());
+  while (buffer_.size() < prefetch_num + 1) {
     buffer_.push_back(input_iterator_->GetNext(exec_ctx));
+    if (autotune_node_) autotune_node_->TrackProduction(buffer_.back());
   }
   for (auto it = buffer_.begin(), e = buffer_.end(); it != e; ++it) {
-    if (AvailableAndNotEof(*it)) {
+    if (internal::IsAvailableAndNotEof(*it)) {
       auto value = std::move(*it);
       buffer_.erase(it);
       return value;
@@ -75,6 +242,7 @@ IterationResult NonDeterministicPrefetchDatasetIterator::GetNext(
 
   auto result = std::move(buffer_.front());
   buffer_.pop_front();
+  if (autotune_node_) autotune_node_->TrackConsumption(result);
   return result;
 }
 
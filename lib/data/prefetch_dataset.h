@@ -21,19 +21,31 @@
 #ifndef TFRT_LIB_DATA_PREFETCH_DATASET_H_
 #define TFRT_LIB_DATA_PREFETCH_DATASET_H_
 
+#include <atomic>
 #include <list>
+#include <memory>
 #include <queue>
 
+#include "autotuner.h"
+#include "iterator_stats.h"
 #include "tfrt/data/dataset.h"
 #include "tfrt/support/forward_decls.h"
+#include "tfrt/support/mutex.h"
+#include "tfrt/support/thread_annotations.h"
 
 namespace tfrt {
 namespace data {
 
 class PrefetchDatasetIterator;
+class PrefetchProducer;
 
 // PrefetchDataset class which wraps around another dataset instance and
 // prefetches elements from the underlying dataset in an internal buffer.
+//
+// The deterministic iterator requests elements from the underlying dataset in
+// a task on the work queue, so that input latency overlaps with the work of
+// the consumer. The non-deterministic iterator requests elements when the
+// consumer calls GetNext().
 class PrefetchDataset : public Dataset {
  public:
   explicit PrefetchDataset(RCReference<Dataset> input_dataset,
@@ -48,18 +60,30 @@ class PrefetchDataset : public Dataset {
   PrefetchDataset(const PrefetchDataset&) = delete;
   PrefetchDataset& operator=(const PrefetchDataset&) = delete;
 
-  RCReference<Iterator> MakeIterator(const IteratorContext& context) override;
+  string_view name() const override { return "prefetch"; }
+
+  RCReference<Iterator> MakeIteratorInternal(
+      const IteratorContext& context) override;
 
  private:
   // Allow iterator to rely on private data members of this dataset.
   friend class PrefetchDatasetIterator;
+  friend class PrefetchProducer;
   friend class NonDeterministicPrefetchDatasetIterator;
 
   void Destroy() override {
     internal::DestroyImpl<PrefetchDataset>(this, host_->allocator());
   }
 
+  // Returns the node tuning the prefetch depth of a new iterator, or an empty
+  // reference if prefetch_num_ is fixed.
+  RCReference<AutotuneNode> MakeAutotuneNode(const IteratorContext& context);
+
+  // Returns the number of elements to prefetch.
+  int64_t GetPrefetchNum(const AutotuneNode* autotune_node) const;
+
   RCReference<Dataset> input_dataset_;
+  // The number of elements to prefetch, or kAutotune.
   int64_t prefetch_num_;
   // If this is set to true, the dataset returns values in a deterministic
   // order. Otherwise, it might return values in a non-deterministic as long as
@@ -68,6 +92,96 @@ class PrefetchDataset : public Dataset {
   HostContext* host_;
 };
 
+// Requests elements from the input iterator ahead of the consumer, in a task
+// on the work queue, until prefetch_num elements are buffered. The producer is
+// shared by the PrefetchDatasetIterator and its task, so that the task can
+// observe the destruction of the iterator and stop early.
+//
+// The input iterator may resolve an earlier element synchronously while it is
+// requested for the next one, which can run the consumer's continuation and
+// call GetNext() again on the same thread. Such a call never requests from the
+// input iterator itself. It returns a pending element instead, which the
+// producer task resolves in order.
+class PrefetchProducer : public ReferenceCounted<PrefetchProducer> {
+ public:
+  PrefetchProducer(RCReference<PrefetchDataset> parent_dataset,
+                   const IteratorContext& context)
+      : parent_dataset_(std::move(parent_dataset)),
+        input_iterator_(parent_dataset_->input_dataset_->MakeIterator(context)),
+        autotune_node_(parent_dataset_->MakeAutotuneNode(context)),
+        stats_(context.stats) {}
+
+  // This class is not copyable or movable.
+  PrefetchProducer(const PrefetchProducer&) = delete;
+  PrefetchProducer& operator=(const PrefetchProducer&) = delete;
+
+  // Returns the next element and starts the producer task if the buffer is
+  // not full. If the task has not produced the next element yet, it is
+  // requested from the input iterator on the caller's thread, unless earlier
+  // calls are still waiting for the task.
+  IterationResult GetNext(const ExecutionContext& exec_ctx)
+      TFRT_EXCLUDES(input_mu_, mu_);
+
+  // Stops the producer task, releases the buffered elements and resolves the
+  // pending elements to errors.
+  void Cancel() TFRT_EXCLUDES(mu_);
+
+ private:
+  friend class ReferenceCounted<PrefetchProducer>;
+
+  void Destroy() {
+    internal::DestroyImpl<PrefetchProducer>(
+        this, parent_dataset_->host_->allocator());
+  }
+
+  void MaybeStartProducing(const ExecutionContext& exec_ctx) TFRT_EXCLUDES(mu_);
+
+  // Body of the producer task.
+  void Produce(const ExecutionContext& exec_ctx) TFRT_EXCLUDES(input_mu_, mu_);
+
+  // Returns whether the producer should request another element.
+  bool ShouldProduce() const TFRT_REQUIRES(mu_);
+
+  // Pops the front of the buffer, if any.
+  Optional<IterationResult> PopBuffer() TFRT_EXCLUDES(mu_);
+
+  // Returns an unavailable element that the producer task resolves with the
+  // next element it requests from the input iterator.
+  IterationResult AddWaiter() TFRT_REQUIRES(mu_);
+
+  // Resolves the pending elements to errors.
+  void FailWaiters(string_view message) TFRT_EXCLUDES(mu_);
+
+  IterationResult GetNextFromInput(const ExecutionContext& exec_ctx)
+      TFRT_REQUIRES(input_mu_);
+
+  RCReference<PrefetchDataset> parent_dataset_;
+  RCReference<Iterator> input_iterator_;
+  RCReference<AutotuneNode> autotune_node_;
+  const std::shared_ptr<IteratorStats> stats_;
+  std::atomic<bool> cancelled_{false};
+
+  // Serializes the calls to input_iterator_->GetNext(), which keeps the
+  // elements in order. It is held while moving an element into the buffer.
+  mutex input_mu_;
+  // The number of values of each element, or -1 until the input iterator
+  // returned an element. Accessed with input_mu_ held, or on the thread that
+  // holds it.
+  int arity_ = -1;
+
+  mutex mu_;
+  // Elements requested from the input iterator but not returned yet.
+  std::queue<IterationResult> buffer_ TFRT_GUARDED_BY(mu_);
+  // Elements returned by GetNext() before they were requested from the input
+  // iterator, in the order of the calls. The buffer is empty while there are
+  // waiters.
+  std::queue<IterationResult> waiters_ TFRT_GUARDED_BY(mu_);
+  // True while the producer task is running.
+  bool producing_ TFRT_GUARDED_BY(mu_) = false;
+  // True once the input iterator returned an element with eof=true.
+  bool input_eof_ TFRT_GUARDED_BY(mu_) = false;
+};
+
 // This iterator returns values in a deterministic order.
 class PrefetchDatasetIterator : public Iterator {
  public:
@@ -75,14 +189,18 @@ class PrefetchDatasetIterator : public Iterator {
                                    const IteratorContext& context)
       : Iterator(),
         parent_dataset_(std::move(parent_dataset)),
-        input_iterator_(
-            parent_dataset_->input_dataset_->MakeIterator(context)) {}
+        producer_(TakeRef(parent_dataset_->host_->Construct<PrefetchProducer>(
+            parent_dataset_.CopyRef(), context))) {}
 
   // This class is not copyable or movable.
   PrefetchDatasetIterator(const PrefetchDatasetIterator&) = delete;
   PrefetchDatasetIterator& operator=(const PrefetchDatasetIterator&) = delete;
 
-  IterationResult GetNext(const ExecutionContext& exec_ctx) override;
+  ~PrefetchDatasetIterator() override { producer_->Cancel(); }
+
+  IterationResult GetNext(const ExecutionContext& exec_ctx) override {
+    return producer_->GetNext(exec_ctx);
+  }
 
  private:
   void Destroy() override {
@@ -91,8 +209,7 @@ class PrefetchDatasetIterator : public Iterator {
   }
 
   RCReference<PrefetchDataset> parent_dataset_;
-  RCReference<Iterator> input_iterator_;
-  std::queue<IterationResult> buffer_;
+  RCReference<PrefetchProducer> producer_;
 };
 
 // This iterator might return values in a non-deterministic order.
@@ -103,8 +220,9 @@ class NonDeterministicPrefetchDatasetIterator : public Iterator {
       const IteratorContext& context)
       : Iterator(),
         parent_dataset_(std::move(parent_dataset)),
-        input_iterator_(
-            parent_dataset_->input_dataset_->MakeIterator(context)) {}
+        input_iterator_(parent_dataset_->input_dataset_->MakeIterator(context)),
+        autotune_node_(parent_dataset_->MakeAutotuneNode(context)),
+        stats_(context.stats) {}
 
   // This class is not copyable or movable.
   NonDeterministicPrefetchDatasetIterator(const PrefetchDatasetIterator&) =
@@ -122,6 +240,8 @@ class NonDeterministicPrefetchDatasetIterator : public Iterator {
 
   RCReference<PrefetchDataset> parent_dataset_;
   RCReference<Iterator> input_iterator_;
+  RCReference<AutotuneNode> autotune_node_;
+  const std::shared_ptr<IteratorStats> stats_;
   std::list<IterationResult> buffer_;
 };
 
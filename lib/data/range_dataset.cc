@@ -28,37 +28,65 @@ namespace data {
 IterationResult RangeDatasetIterator::GetNext(
     const ExecutionContext& exec_ctx) {
   HostContext* host = exec_ctx.host();
-  bool has_next = (dataset_->step_ > 0 && next_ < dataset_->stop_) ||
-                  (dataset_->step_ < 0 && next_ > dataset_->stop_);
-  if (!has_next) {
+  if (!HasNext()) {
     return IterationResult::Eof(host, 1);
   }
 
+  auto value = MakeValue(host);
+  if (value->IsError()) {
+    return IterationResult::Error(std::move(value), 1);
+  }
+
+  next_ += dataset_->step_;
+
   llvm::SmallVector<RCReference<AsyncValue>, 4> values;
+  values.push_back(std::move(value));
+  return IterationResult::Values(std::move(values), host);
+}
+
+void RangeDatasetIterator::GetNextBatch(
+    const ExecutionContext& exec_ctx, size_t n,
+    llvm::SmallVectorImpl<IterationResult>* results) {
+  HostContext* host = exec_ctx.host();
+  results->reserve(results->size() + n);
+  // All elements of the batch share one eof value.
+  auto not_eof = MakeAvailableAsyncValueRef<bool>(host, false);
+  for (; n > 0 && HasNext(); --n) {
+    auto value = MakeValue(host);
+    if (value->IsError()) break;
+    next_ += dataset_->step_;
+    llvm::SmallVector<RCReference<AsyncValue>, 4> values;
+    values.push_back(std::move(value));
+    results->push_back(
+        IterationResult::Pending(std::move(values), not_eof.CopyRef()));
+  }
+  if (n == 0) return;
+
+  // The remaining results are all the same end of iteration or error.
+  auto last = GetNext(exec_ctx);
+  for (; n > 1; --n) results->push_back(last.CopyRef());
+  results->push_back(std::move(last));
+}
+
+RCReference<AsyncValue> RangeDatasetIterator::MakeValue(
+    HostContext* host) const {
   switch (dataset_->element_type_) {
-#define DTYPE_NUMERIC(ENUM)                                            \
-  case DType::ENUM:                                                    \
-    values.push_back(                                                  \
-        MakeAvailableAsyncValueRef<TypeForDTypeKind<DType::ENUM>>(     \
-            host, static_cast<TypeForDTypeKind<DType::ENUM>>(next_))); \
-    break;
+#define DTYPE_NUMERIC(ENUM)                                           \
+  case DType::ENUM:                                                   \
+    return MakeAvailableAsyncValueRef<TypeForDTypeKind<DType::ENUM>>( \
+        host, static_cast<TypeForDTypeKind<DType::ENUM>>(next_));
 
 #include "tfrt/dtype/dtype.def"  // NOLINT
 #undef DTYPE_NUMERIC
     default:
-      return IterationResult::Error(
-          MakeErrorAsyncValueRef(host, "Unsupported data type"), 1);
+      return MakeErrorAsyncValueRef(host, "Unsupported data type");
   }
-
-  next_ += dataset_->step_;
-
-  return IterationResult::Values(std::move(values), host);
 }
 
 //===----------------------------------------------------------------------===//
 // RangeDataset methods
 //===----------------------------------------------------------------------===//
-RCReference<Iterator> RangeDataset::MakeIterator(
+RCReference<Iterator> RangeDataset::MakeIteratorInternal(
     const IteratorContext& context) {
   return TakeRef(host_->Construct<RangeDatasetIterator>(FormRef(this)));
 }
@@ -46,7 +46,10 @@ class RangeDataset : public Dataset {
   RangeDataset(const RangeDataset&) = delete;
   RangeDataset& operator=(const RangeDataset&) = delete;
 
-  RCReference<Iterator> MakeIterator(const IteratorContext& context) override;
+  string_view name() const override { return "range"; }
+
+  RCReference<Iterator> MakeIteratorInternal(
+      const IteratorContext& context) override;
 
  private:
   friend class RangeDatasetIterator;
@@ -74,11 +77,23 @@ class RangeDatasetIterator : public Iterator {
 
   IterationResult GetNext(const ExecutionContext& exec_ctx) override;
 
+  void GetNextBatch(const ExecutionContext& exec_ctx, size_t n,
+                    llvm::SmallVectorImpl<IterationResult>* results) override;
+
  private:
   void Destroy() override {
     internal::DestroyImpl<RangeDatasetIterator>(this, dataset_->allocator_);
   }
 
+  bool HasNext() const {
+    return (dataset_->step_ > 0 && next_ < dataset_->stop_) ||
+           (dataset_->step_ < 0 && next_ > dataset_->stop_);
+  }
+
+  // Returns `next_` as an available value of the element type, or an error
+  // value if the element type is not supported.
+  RCReference<AsyncValue> MakeValue(HostContext* host) const;
+
   RCReference<RangeDataset> dataset_;
   int64_t next_;
 };
@@ -27,7 +27,7 @@ namespace data {
 //===----------------------------------------------------------------------===//
 // RepeatDataset methods
 //===----------------------------------------------------------------------===//
-RCReference<Iterator> RepeatDataset::MakeIterator(
+RCReference<Iterator> RepeatDataset::MakeIteratorInternal(
     const IteratorContext& context) {
   return TakeRef(
       host_->Construct<RepeatDatasetIterator>(FormRef(this), context));
@@ -51,14 +51,7 @@ IterationResult RepeatDatasetIterator::GetNext(
     return IterationResult::Eof(host, arity_);
   }
 
-  llvm::SmallVector<RCReference<AsyncValue>, 4> result_values;
-  result_values.resize(arity_);
-  for (size_t i = 0; i < arity_; ++i) {
-    result_values[i] = MakeIndirectAsyncValue(host);
-  }
-  auto result_eof = MakeUnconstructedAsyncValueRef<bool>(host);
-  auto result =
-      IterationResult::Pending(std::move(result_values), std::move(result_eof));
+  auto result = MakePendingResult(host);
   {
     mutex_lock lock(mu_);
     output_buffer_.push(result.CopyRef());
@@ -68,6 +61,81 @@ IterationResult RepeatDatasetIterator::GetNext(
   return result;
 }
 
+void RepeatDatasetIterator::GetNextBatch(
+    const ExecutionContext& exec_ctx, size_t n,
+    llvm::SmallVectorImpl<IterationResult>* results) {
+  auto* host = exec_ctx.host();
+  bool is_token_owner = false;
+  // The first GetNext() call initializes arity_.
+  if (arity_ >= 0 && parent_dataset_->count_ != 0) {
+    mutex_lock lock(mu_);
+    if (!token_owned_ && output_buffer_.empty()) {
+      token_owned_ = true;
+      is_token_owner = true;
+    }
+  }
+  if (!is_token_owner) {
+    Iterator::GetNextBatch(exec_ctx, n, results);
+    return;
+  }
+
+  results->reserve(results->size() + n);
+  llvm::SmallVector<IterationResult, 4> inputs;
+  // Inputs fetched by earlier calls must be handled first, which is left to
+  // MaybeScheduleBackgroundTask().
+  bool is_pending = !input_buffer_.empty();
+  while (n > 0 && !is_pending) {
+    inputs.clear();
+    input_iterator_->GetNextBatch(exec_ctx, n, &inputs);
+    for (auto& input : inputs) {
+      assert(arity_ == input.values.size());
+      if (is_pending || input.eof.IsUnavailable()) {
+        is_pending = true;
+        input_buffer_.push(std::move(input));
+        continue;
+      }
+      if (input.eof.IsError() || !input.eof.get()) {
+        results->push_back(std::move(input));
+        --n;
+        continue;
+      }
+      // The remaining inputs come from the exhausted iterator and are
+      // dropped.
+      if (CanRepeat()) {
+        current_count_++;
+        input_iterator_ =
+            parent_dataset_->input_dataset_->MakeIterator(context_);
+      } else {
+        auto end = IterationResult::Eof(host, arity_);
+        for (; n > 0; --n) results->push_back(end.CopyRef());
+      }
+      break;
+    }
+  }
+
+  if (n > 0) {
+    mutex_lock lock(mu_);
+    for (; n > 0; --n) {
+      results->push_back(MakePendingResult(host));
+      output_buffer_.push(results->back().CopyRef());
+    }
+  }
+  // Produce the pending results, and pass the token on to serve the
+  // GetNext(...) calls made meanwhile.
+  MaybeScheduleBackgroundTask(exec_ctx, true, 0);
+}
+
+IterationResult RepeatDatasetIterator::MakePendingResult(HostContext* host) {
+  llvm::SmallVector<RCReference<AsyncValue>, 4> result_values;
+  result_values.resize(arity_);
+  for (size_t i = 0; i < arity_; ++i) {
+    result_values[i] = MakeIndirectAsyncValue(host);
+  }
+  auto result_eof = MakeUnconstructedAsyncValueRef<bool>(host);
+  return IterationResult::Pending(std::move(result_values),
+                                  std::move(result_eof));
+}
+
 void RepeatDatasetIterator::MaybeScheduleBackgroundTask(
     const ExecutionContext& exec_ctx, bool is_token_owner, int callback_count) {
   {
@@ -108,10 +176,13 @@ void RepeatDatasetIterator::MaybeScheduleBackgroundTask(
   };
 
   int input_fetch_num = OutputBufferSize() - input_buffer_.size();
-  for (int i = 0; i < input_fetch_num; i++) {
-    auto input = input_iterator_->GetNext(exec_ctx);
-    assert(arity_ == input.values.size());
-    input_buffer_.push(std::move(input));
+  if (input_fetch_num > 0) {
+    llvm::SmallVector<IterationResult, 4> inputs;
+    input_iterator_->GetNextBatch(exec_ctx, input_fetch_num, &inputs);
+    for (auto& input : inputs) {
+      assert(arity_ == input.values.size());
+      input_buffer_.push(std::move(input));
+    }
   }
   // If there are multiple available values, handle them immediately to reduce
   // the number of recursive function calls and the mutex grab/release.
@@ -152,10 +223,7 @@ void RepeatDatasetIterator::HandleEofAvailableInput(IterationResult input,
     }
     return;
   }
-  bool can_repeat = (parent_dataset_->count_ > 0 &&
-                     current_count_ + 1 < parent_dataset_->count_) ||
-                    parent_dataset_->count_ < 0;
-  if (can_repeat) {
+  if (CanRepeat()) {
     // The input_iterator_ has been exhausted and there is remaining count.
     current_count_++;
     input_iterator_ = parent_dataset_->input_dataset_->MakeIterator(context_);
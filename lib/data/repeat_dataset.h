@@ -46,7 +46,10 @@ class RepeatDataset : public Dataset {
   RepeatDataset(const RepeatDataset&) = delete;
   RepeatDataset& operator=(const RepeatDataset&) = delete;
 
-  RCReference<Iterator> MakeIterator(const IteratorContext& context) override;
+  string_view name() const override { return "repeat"; }
+
+  RCReference<Iterator> MakeIteratorInternal(
+      const IteratorContext& context) override;
 
  private:
   friend class RepeatDatasetIterator;
@@ -77,6 +80,11 @@ class RepeatDatasetIterator : public Iterator {
 
   IterationResult GetNext(const ExecutionContext& exec_ctx) override;
 
+  // If no other call is in flight, fetches the input in batches and returns
+  // the inputs with available eof directly.
+  void GetNextBatch(const ExecutionContext& exec_ctx, size_t n,
+                    llvm::SmallVectorImpl<IterationResult>* results) override;
+
  private:
   void Destroy() override {
     internal::DestroyImpl<RepeatDatasetIterator>(this,
@@ -99,6 +107,15 @@ class RepeatDatasetIterator : public Iterator {
 
   void HandleEofAvailableInput(IterationResult input, HostContext* host);
 
+  // Returns true if the input should be iterated again once it is exhausted.
+  bool CanRepeat() const {
+    return (parent_dataset_->count_ > 0 &&
+            current_count_ + 1 < parent_dataset_->count_) ||
+           parent_dataset_->count_ < 0;
+  }
+
+  IterationResult MakePendingResult(HostContext* host);
+
   int OutputBufferSize() TFRT_EXCLUDES(mu_) {
     mutex_lock lock(mu_);
     return output_buffer_.size();
@@ -0,0 +1,46 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// This file implements RequestQueue class, which holds the pending results of
+// an iterator that fills them from a state machine run by one thread at a time.
+
+#include "request_queue.h"
+
+namespace tfrt {
+namespace data {
+
+void RequestQueue::Run(llvm::function_ref<void()> process) {
+  {
+    mutex_lock lock(mu_);
+    if (running_) {
+      rerun_ = true;
+      return;
+    }
+    running_ = true;
+  }
+  while (true) {
+    process();
+    mutex_lock lock(mu_);
+    if (!rerun_) {
+      running_ = false;
+      return;
+    }
+    rerun_ = false;
+  }
+}
+
+}  // namespace data
+}  // namespace tfrt
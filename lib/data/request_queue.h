@@ -0,0 +1,82 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// This file declares RequestQueue class, which holds the pending results of an
+// iterator that fills them from a state machine run by one thread at a time.
+
+#ifndef TFRT_LIB_DATA_REQUEST_QUEUE_H_
+#define TFRT_LIB_DATA_REQUEST_QUEUE_H_
+
+#include <cassert>
+#include <queue>
+
+#include "llvm/ADT/STLExtras.h"
+#include "tfrt/data/dataset.h"
+#include "tfrt/support/mutex.h"
+#include "tfrt/support/thread_annotations.h"
+
+namespace tfrt {
+namespace data {
+
+// RequestQueue holds the results returned by GetNext() of an iterator which
+// are not filled yet, and runs the function that fills them on one thread at a
+// time. The iterator pushes each result it returns and calls Run(), and calls
+// Run() again whenever a value it waits for becomes available. The state of
+// the iterator that is only accessed by the running function needs no lock, so
+// that the lock is not held while calling into other iterators.
+class RequestQueue {
+ public:
+  RequestQueue() = default;
+
+  // This class is not copyable or movable.
+  RequestQueue(const RequestQueue&) = delete;
+  RequestQueue& operator=(const RequestQueue&) = delete;
+
+  void Push(IterationResult request) TFRT_EXCLUDES(mu_) {
+    mutex_lock lock(mu_);
+    requests_.push(std::move(request));
+  }
+
+  bool HasRequest() TFRT_EXCLUDES(mu_) {
+    mutex_lock lock(mu_);
+    return !requests_.empty();
+  }
+
+  IterationResult Pop() TFRT_EXCLUDES(mu_) {
+    mutex_lock lock(mu_);
+    assert(!requests_.empty());
+    auto request = std::move(requests_.front());
+    requests_.pop();
+    return request;
+  }
+
+  // Runs `process` unless another thread is running it, in which case that
+  // thread runs it once more.
+  void Run(llvm::function_ref<void()> process) TFRT_EXCLUDES(mu_);
+
+ private:
+  mutex mu_;
+  std::queue<IterationResult> requests_ TFRT_GUARDED_BY(mu_);
+  // Whether a thread is running `process`, and whether it should run it once
+  // more because the state changed in the meantime.
+  bool running_ TFRT_GUARDED_BY(mu_) = false;
+  bool rerun_ TFRT_GUARDED_BY(mu_) = false;
+};
+
+}  // namespace data
+}  // namespace tfrt
+
+#endif  // TFRT_LIB_DATA_REQUEST_QUEUE_H_
@@ -0,0 +1,198 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// This file implements ShardedTFRecordDataset class, which reads the records
+// of several TFRecord files in parallel and interleaves them.
+
+#include "sharded_tf_record_dataset.h"
+
+#include <algorithm>
+#include <iterator>
+
+#include "tf_record_dataset.h"
+#include "tfrt/host_context/async_dispatch.h"
+#include "tfrt/io/file_system.h"
+#include "tfrt/support/error_util.h"
+
+namespace tfrt {
+namespace data {
+
+//===----------------------------------------------------------------------===//
+// ShardedTFRecordDataset methods
+//===----------------------------------------------------------------------===//
+RCReference<Iterator> ShardedTFRecordDataset::MakeIteratorInternal(
+    const IteratorContext& context) {
+  return TakeRef(host_->Construct<ShardedTFRecordDatasetIterator>(
+      FormRef(this), context));
+}
+
+llvm::Expected<std::vector<std::string>> ShardedTFRecordDataset::MatchPaths()
+    const {
+  auto* fs_registry = ::tfrt::io::FileSystemRegistry::Default();
+  std::vector<std::string> paths;
+  for (const auto& pattern : patterns_) {
+    auto* file_system = fs_registry->LookupForPath(pattern);
+    if (!file_system) {
+      return MakeStringError("No file system is found for the scheme of ",
+                             pattern);
+    }
+    std::vector<std::string> matches;
+    if (auto error = file_system->GetMatchingPaths(pattern, &matches))
+      return std::move(error);
+    if (matches.empty()) return MakeStringError("no files match ", pattern);
+    paths.insert(paths.end(), std::make_move_iterator(matches.begin()),
+                 std::make_move_iterator(matches.end()));
+  }
+  std::vector<std::string> shard_paths;
+  for (size_t i = shard_index_; i < paths.size(); i += num_shards_) {
+    shard_paths.push_back(std::move(paths[i]));
+  }
+  return std::move(shard_paths);
+}
+
+//===----------------------------------------------------------------------===//
+// ShardedTFRecordDatasetIterator methods
+//===----------------------------------------------------------------------===//
+IterationResult ShardedTFRecordDatasetIterator::GetNext(
+    const ExecutionContext& exec_ctx) {
+  auto* host = exec_ctx.host();
+
+  llvm::SmallVector<RCReference<AsyncValue>, 1> result_values;
+  result_values.push_back(MakeIndirectAsyncValue(host));
+  auto result_eof = MakeUnconstructedAsyncValueRef<bool>(host);
+  auto result =
+      IterationResult::Pending(std::move(result_values), std::move(result_eof));
+  requests_.Push(result.CopyRef());
+  MaybeRun(exec_ctx);
+  return result;
+}
+
+void ShardedTFRecordDatasetIterator::MaybeRun(
+    const ExecutionContext& exec_ctx) {
+  requests_.Run([this, &exec_ctx]() { Process(exec_ctx); });
+}
+
+void ShardedTFRecordDatasetIterator::Process(const ExecutionContext& exec_ctx) {
+  if (!paths_) StartMatchingPaths(exec_ctx);
+  if (!paths_.IsAvailable()) return;
+  if (paths_.IsError()) {
+    while (requests_.HasRequest()) {
+      auto request = requests_.Pop();
+      request.eof.SetError(paths_.GetError());
+      request.values[0]->SetError(paths_.GetError());
+    }
+    return;
+  }
+  // Open the first files at once, so that they are read in parallel from the
+  // start.
+  if (!started_) {
+    readers_ = std::vector<Optional<Reader>>(std::min<size_t>(
+        parent_dataset_->num_parallel_reads_, paths_->size()));
+    for (auto& reader : readers_) reader = OpenReader(exec_ctx);
+    started_ = true;
+  }
+  while (requests_.HasRequest() && OutputNext(exec_ctx)) {
+  }
+}
+
+void ShardedTFRecordDatasetIterator::StartMatchingPaths(
+    const ExecutionContext& exec_ctx) {
+  auto* host = exec_ctx.host();
+  paths_ = MakeUnconstructedAsyncValueRef<std::vector<std::string>>(host);
+  bool enqueued = EnqueueBlockingWork(
+      host, [dataset = parent_dataset_.CopyRef(), paths = paths_.CopyRef()]() {
+        paths.emplace(dataset->MatchPaths());
+      });
+  if (!enqueued) paths_.emplace(parent_dataset_->MatchPaths());
+  // Process() is running, so if the paths were matched already, this only
+  // makes it run once more.
+  paths_.AndThen([exec_ctx, iterator = FormRef(this)]() {
+    iterator->MaybeRun(exec_ctx);
+  });
+}
+
+Optional<ShardedTFRecordDatasetIterator::Reader>
+ShardedTFRecordDatasetIterator::OpenReader(const ExecutionContext& exec_ctx) {
+  const auto& paths = *paths_;
+  if (next_path_index_ == paths.size()) return llvm::None;
+
+  // The file itself is opened by the first read of the iterator, which runs
+  // in a blocking task.
+  auto* host = exec_ctx.host();
+  auto dataset = TakeRef(host->Construct<TFRecordDataset>(
+      paths[next_path_index_++], parent_dataset_->buffer_size_,
+      parent_dataset_->max_prefetch_num_, parent_dataset_->prefetch_threshold_,
+      TFRecordReadMode::kStream, parent_dataset_->compression_,
+      /*direct_io=*/false, host));
+  auto iterator = dataset->MakeIterator(context_);
+  auto next = iterator->GetNext(exec_ctx);
+  return Reader{std::move(iterator), std::move(next)};
+}
+
+bool ShardedTFRecordDatasetIterator::OutputNext(
+    const ExecutionContext& exec_ctx) {
+  // The number of consecutive readers whose files ended, with no more files
+  // to open in their place.
+  size_t num_ended = 0;
+  while (num_ended < readers_.size()) {
+    auto& reader = readers_[reader_index_];
+    if (!reader.hasValue()) reader = OpenReader(exec_ctx);
+    if (!reader.hasValue()) {
+      ++num_ended;
+      reader_index_ = (reader_index_ + 1) % readers_.size();
+      continue;
+    }
+
+    // Records are output in order, so wait for the next result of this reader
+    // even if other readers have results available.
+    auto& next_eof = reader->next.eof;
+    if (!next_eof.IsAvailable()) {
+      RunWhenReady({next_eof.GetAsyncValue()},
+                   [exec_ctx, iterator = FormRef(this)]() {
+                     iterator->MaybeRun(exec_ctx);
+                   });
+      return false;
+    }
+    // Read the next file in place of the file that ended.
+    if (!next_eof.IsError() && next_eof.get()) {
+      reader.reset();
+      continue;
+    }
+
+    auto request = requests_.Pop();
+    if (next_eof.IsError()) {
+      request.eof.SetError(next_eof.GetError());
+      request.values[0]->SetError(next_eof.GetError());
+    } else {
+      request.eof.emplace(false);
+      auto* value = cast<IndirectAsyncValue>(request.values[0].get());
+      value->ForwardTo(std::move(reader->next.values[0]));
+    }
+    reader->next = reader->iterator->GetNext(exec_ctx);
+    reader_index_ = (reader_index_ + 1) % readers_.size();
+    return true;
+  }
+
+  // All files ended.
+  auto request = requests_.Pop();
+  auto error = MakeErrorAsyncValueRef(exec_ctx.host(), "iterator reached end");
+  request.values[0]->SetError(error->GetError());
+  request.eof.emplace(true);
+  return true;
+}
+
+}  // namespace data
+}  // namespace tfrt
@@ -0,0 +1,190 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// This file declares ShardedTFRecordDataset class, which reads the records of
+// several TFRecord files in parallel and interleaves them.
+
+#ifndef TFRT_LIB_DATA_SHARDED_TF_RECORD_DATASET_H_
+#define TFRT_LIB_DATA_SHARDED_TF_RECORD_DATASET_H_
+
+#include <string>
+#include <vector>
+
+#include "llvm/ADT/Optional.h"
+#include "request_queue.h"
+#include "tfrt/data/dataset.h"
+#include "tfrt/host_context/async_value_ref.h"
+#include "tfrt/io/zlib_input_stream.h"
+#include "tfrt/support/forward_decls.h"
+
+namespace tfrt {
+namespace data {
+
+class ShardedTFRecordDatasetIterator;
+
+// ShardedTFRecordDataset reads the records of the TFRecord files that match the
+// glob `patterns`, in the order of the patterns and sorted by path for each
+// pattern. If the files are read by several workers, each worker reads every
+// `num_shards`-th file starting at `shard_index`.
+//
+// The patterns are matched by each iterator in a blocking task started by its
+// first GetNext() call, since matching may list remote directories. An error
+// while matching, e.g. a pattern that matches no files, is returned by every
+// GetNext() call.
+//
+// Up to `num_parallel_reads` files are read at a time. Each of them is read by
+// a TFRecordDataset iterator, which prefetches its records in a blocking task,
+// so that the files are read in parallel. The records are output in
+// round-robin order across the files being read, and a file is only opened
+// once a previous one ended.
+//
+// The files are read as a stream with `buffer_size` bytes, and decompressed if
+// `compression` is set.
+class ShardedTFRecordDataset : public Dataset {
+ public:
+  explicit ShardedTFRecordDataset(
+      std::vector<std::string> patterns, int64_t num_shards,
+      int64_t shard_index, int64_t num_parallel_reads, int64_t buffer_size,
+      int64_t max_prefetch_num, int64_t prefetch_threshold,
+      llvm::Optional<::tfrt::io::ZlibFormat> compression, HostContext* host)
+      : patterns_(std::move(patterns)),
+        num_shards_(num_shards),
+        shard_index_(shard_index),
+        num_parallel_reads_(num_parallel_reads),
+        buffer_size_(buffer_size),
+        max_prefetch_num_(max_prefetch_num),
+        prefetch_threshold_(prefetch_threshold),
+        compression_(compression),
+        host_(host),
+        allocator_(host->allocator()) {
+    assert(num_shards_ > 0);
+    assert(shard_index_ >= 0 && shard_index_ < num_shards_);
+    assert(num_parallel_reads_ > 0);
+    assert(buffer_size_ >= 0);
+  }
+
+  // This class is not copyable or movable.
+  ShardedTFRecordDataset(const ShardedTFRecordDataset&) = delete;
+  ShardedTFRecordDataset& operator=(const ShardedTFRecordDataset&) = delete;
+
+  string_view name() const override { return "sharded_tf_record"; }
+
+  RCReference<Iterator> MakeIteratorInternal(
+      const IteratorContext& context) override;
+
+ private:
+  // Allow iterator to rely on private data members of this dataset.
+  friend class ShardedTFRecordDatasetIterator;
+
+  void Destroy() override {
+    internal::DestroyImpl<ShardedTFRecordDataset>(this, allocator_);
+  }
+
+  // Returns the paths of the files of this shard. Blocks while the patterns
+  // are matched.
+  llvm::Expected<std::vector<std::string>> MatchPaths() const;
+
+  const std::vector<std::string> patterns_;
+  const int64_t num_shards_;
+  const int64_t shard_index_;
+  const int64_t num_parallel_reads_;
+  const int64_t buffer_size_;
+  const int64_t max_prefetch_num_;
+  const int64_t prefetch_threshold_;
+  const llvm::Optional<::tfrt::io::ZlibFormat> compression_;
+  HostContext* host_;
+  HostAllocator* allocator_;
+};
+
+class ShardedTFRecordDatasetIterator : public Iterator {
+ public:
+  explicit ShardedTFRecordDatasetIterator(
+      RCReference<ShardedTFRecordDataset> parent_dataset,
+      const IteratorContext& context)
+      : Iterator(),
+        parent_dataset_(std::move(parent_dataset)),
+        context_(context) {}
+
+  // This class is not copyable or movable.
+  ShardedTFRecordDatasetIterator(const ShardedTFRecordDatasetIterator&) =
+      delete;
+  ShardedTFRecordDatasetIterator& operator=(
+      const ShardedTFRecordDatasetIterator&) = delete;
+
+  IterationResult GetNext(const ExecutionContext& exec_ctx) override;
+
+ private:
+  // The iterator of a file that is being read.
+  struct Reader {
+    RCReference<Iterator> iterator;
+    // The next result of the iterator. It is requested as soon as the previous
+    // one is output, so that the file is read ahead while the records of the
+    // other files are output.
+    IterationResult next;
+  };
+
+  void Destroy() override {
+    internal::DestroyImpl<ShardedTFRecordDatasetIterator>(
+        this, parent_dataset_->allocator_);
+  }
+
+  // Runs Process() on one thread at a time, see RequestQueue::Run(). The
+  // state below is only accessed by that thread.
+  void MaybeRun(const ExecutionContext& exec_ctx);
+
+  // Fills the requested results until no more progress can be made.
+  void Process(const ExecutionContext& exec_ctx);
+
+  // Starts a blocking task to match the patterns of the dataset into paths_,
+  // and runs Process() again once they are matched. Matches them on the
+  // calling thread if the task can not be enqueued.
+  void StartMatchingPaths(const ExecutionContext& exec_ctx);
+
+  // Opens an iterator for the next file that has not been read, if any.
+  Optional<Reader> OpenReader(const ExecutionContext& exec_ctx);
+
+  // Fills the next requested result from the reader at reader_index_, or with
+  // the end of iteration if all files ended. Returns false if the next result
+  // of the reader is not available yet, in which case Process() runs again
+  // once it is.
+  bool OutputNext(const ExecutionContext& exec_ctx);
+
+  RCReference<ShardedTFRecordDataset> parent_dataset_;
+  const IteratorContext context_;
+
+  // The members below are only accessed by the thread running Process().
+  //
+  // The paths of the files to read. Null until the first call to GetNext().
+  AsyncValueRef<std::vector<std::string>> paths_;
+  // Whether the first files were opened. The files are opened once paths_ is
+  // available.
+  bool started_ = false;
+  // The index in paths_ of the next file to open.
+  size_t next_path_index_ = 0;
+  // The files being read. A reader is empty once its file ended and all files
+  // were opened.
+  std::vector<Optional<Reader>> readers_;
+  // The reader to output the next record from.
+  size_t reader_index_ = 0;
+
+  // Results returned by GetNext() which are not filled yet.
+  RequestQueue requests_;
+};
+
+}  // namespace data
+}  // namespace tfrt
+
+#endif  // TFRT_LIB_DATA_SHARDED_TF_RECORD_DATASET_H_
@@ -18,6 +18,9 @@
 
 #include "shuffle_dataset.h"
 
+#include <algorithm>
+
+#include "iterator_stats.h"
 #include "tfrt/host_context/async_dispatch.h"
 #include "tfrt/support/philox_random.h"
 
@@ -27,7 +30,7 @@ namespace data {
 //===----------------------------------------------------------------------===//
 // ShuffleDataset methods
 //===----------------------------------------------------------------------===//
-RCReference<Iterator> ShuffleDataset::MakeIterator(
+RCReference<Iterator> ShuffleDataset::MakeIteratorInternal(
     const IteratorContext& context) {
   return TakeRef(
       host_->Construct<ShuffleDatasetIterator>(FormRef(this), context));
@@ -45,27 +48,51 @@ IterationResult ShuffleDatasetIterator::GetNext(
     assert(!token_owned_);
     auto input = input_iterator_->GetNext(exec_ctx);
     arity_ = input.values.size();
-    shuffle_buffer_.push_back(std::move(input));
-    num_shuffled_values_++;
+    shuffle_buffer_.reserve(
+        std::min(parent_dataset_->buffer_size_, kMaxPreallocatedElements) *
+        arity_);
+    pending_input_.emplace(std::move(input));
   }
 
-  llvm::SmallVector<RCReference<AsyncValue>, 4> result_values;
-  result_values.resize(arity_);
-  for (size_t i = 0; i < arity_; ++i) {
-    result_values[i] = MakeIndirectAsyncValue(host);
+  bool is_token_owner = false;
+  {
+    mutex_lock lock(mu_);
+    if (!token_owned_ && output_buffer_.empty()) {
+      token_owned_ = true;
+      is_token_owner = true;
+    }
   }
-  auto result_eof = MakeUnconstructedAsyncValueRef<bool>(host);
-  auto result =
-      IterationResult::Pending(std::move(result_values), std::move(result_eof));
+  // Fast path: no other thread produces values, so the next value can be
+  // returned directly if the input is available.
+  if (is_token_owner) {
+    if (auto next = ProduceNext(exec_ctx)) {
+      // Pass the token on to serve the GetNext(...) calls made meanwhile.
+      MaybeScheduleBackgroundTask(exec_ctx, true, 0);
+      return std::move(*next);
+    }
+  }
+
+  auto result = MakePendingResult(host);
   {
     mutex_lock lock(mu_);
     output_buffer_.push(result.CopyRef());
   }
 
-  MaybeScheduleBackgroundTask(exec_ctx, false, 0);
+  MaybeScheduleBackgroundTask(exec_ctx, is_token_owner, 0);
   return result;
 }
 
+IterationResult ShuffleDatasetIterator::MakePendingResult(HostContext* host) {
+  llvm::SmallVector<RCReference<AsyncValue>, 4> result_values;
+  result_values.resize(arity_);
+  for (size_t i = 0; i < arity_; ++i) {
+    result_values[i] = MakeIndirectAsyncValue(host);
+  }
+  auto result_eof = MakeUnconstructedAsyncValueRef<bool>(host);
+  return IterationResult::Pending(std::move(result_values),
+                                  std::move(result_eof));
+}
+
 void ShuffleDatasetIterator::MaybeScheduleBackgroundTask(
     const ExecutionContext& exec_ctx, bool is_token_owner, int callback_count) {
   {
@@ -88,7 +115,6 @@ void ShuffleDatasetIterator::MaybeScheduleBackgroundTask(
   // Only the thread that owns the token can execute the code below. This
   // ensures in-order delivery since at most one thread can take value from the
   // input_iterator_ and update the output value in the output_buffer_.
-  auto host = exec_ctx.host();
   auto callback = [exec_ctx, callback_count,
                    iterator = FormRef(this)]() mutable {
     if (callback_count >= MAX_RECURSIVE_CALLS) {
@@ -100,90 +126,70 @@ void ShuffleDatasetIterator::MaybeScheduleBackgroundTask(
     }
   };
 
-  auto max_buffer_size = parent_dataset_->buffer_size_;
-  // This optimizes the perform by skipping filling the shuffle_buffer_ if the
-  // input iterator has reached end.
-  CheckEof();
-
   while (OutputBufferSize() > 0) {
-    // Fills shuffle_buffer_ with up to buffer_size_ values. It can have less
-    // than buffer_size_ values only if the input_iterator_ has reached end.
-    while (num_shuffled_values_ < max_buffer_size && !reached_eof_) {
-      auto input = input_iterator_->GetNext(exec_ctx);
-      auto* eof_async = input.eof.GetAsyncValue();
-      num_shuffled_values_++;
-      auto index = (start_index_ + num_shuffled_values_ - 1) % max_buffer_size;
-      if (index < shuffle_buffer_.size()) {
-        shuffle_buffer_[index] = std::move(input);
-      } else {
-        shuffle_buffer_.push_back(std::move(input));
-      }
-      if (eof_async->IsUnavailable()) {
-        eof_async->AndThen(std::move(callback));
-        return;
-      }
-      CheckEof();
+    auto input = ProduceNext(exec_ctx);
+    if (!input) {
+      pending_input_->eof.AndThen(std::move(callback));
+      return;
     }
-
-    if (num_shuffled_values_ > 0) {
-      auto random_index =
-          (random_() % num_shuffled_values_ + start_index_) % max_buffer_size;
-      assert(random_index < shuffle_buffer_.size());
-      auto input = std::move(shuffle_buffer_[random_index]);
-      shuffle_buffer_[random_index] = std::move(shuffle_buffer_[start_index_]);
-      start_index_ = (start_index_ + 1) % max_buffer_size;
-      num_shuffled_values_--;
-      HandleEofAvailableInput(std::move(input), host);
+    auto output = DequeueOutputBuffer();
+    for (int i = 0; i < arity_; ++i) {
+      auto* output_value = cast<IndirectAsyncValue>(output.values[i].get());
+      output_value->ForwardTo(std::move(input->values[i]));
+    }
+    if (input->eof.IsError()) {
+      output.eof.SetError(input->eof.GetError());
     } else {
-      auto input = IterationResult::Eof(host, arity_);
-      HandleEofAvailableInput(std::move(input), host);
+      output.eof.emplace(input->eof.get());
     }
   }
   MaybeScheduleBackgroundTask(exec_ctx, true, callback_count);
 }
 
-void ShuffleDatasetIterator::HandleEofAvailableInput(IterationResult input,
-                                                     HostContext* host) {
-  auto input_eof = std::move(input.eof);
-  auto input_values = std::move(input.values);
-  if (input_eof.IsError() || !input_eof.get()) {
-    auto output = DequeueOutputBuffer();
-    for (int i = 0; i < arity_; ++i) {
-      auto* output_value = cast<IndirectAsyncValue>(output.values[i].get());
-      output_value->ForwardTo(std::move(input_values[i]));
+Optional<IterationResult> ShuffleDatasetIterator::ProduceNext(
+    const ExecutionContext& exec_ctx) {
+  // Fills shuffle_buffer_ with up to buffer_size_ values. It can have less
+  // than buffer_size_ values only if the input_iterator_ has reached end.
+  const auto buffer_size = static_cast<size_t>(parent_dataset_->buffer_size_);
+  while (num_shuffled_values_ < buffer_size && !reached_eof_) {
+    if (!pending_input_) {
+      pending_input_.emplace(input_iterator_->GetNext(exec_ctx));
     }
-    if (input_eof.IsError()) {
-      output.eof.SetError(input_eof.GetError());
-    } else {
-      output.eof.emplace(false);
+    if (pending_input_->eof.IsUnavailable()) return llvm::None;
+    auto input = std::move(*pending_input_);
+    pending_input_.reset();
+    if (input.eof.IsError()) return std::move(input);
+    if (input.eof.get()) {
+      reached_eof_ = true;
+      break;
     }
-    return;
-  }
-  // The input_iterator_ has been exhausted and there is no remaining count.
-  auto error = MakeErrorAsyncValueRef(host, "iterator reached end");
-  auto output_buffer_size = OutputBufferSize();
-  for (; output_buffer_size > 0; --output_buffer_size) {
-    auto output = DequeueOutputBuffer();
-    for (auto& value : output.values) {
-      value->SetError(error->GetError());
+    for (auto& value : input.values) {
+      shuffle_buffer_.push_back(std::move(value));
     }
-    output.eof.emplace(true);
+    num_shuffled_values_++;
+  }
+
+  if (stats_) stats_->RecordBufferSize(num_shuffled_values_);
+  if (num_shuffled_values_ == 0) {
+    return IterationResult::Eof(exec_ctx.host(), arity_);
   }
-}
 
-inline void ShuffleDatasetIterator::CheckEof() {
-  auto max_buffer_size = parent_dataset_->buffer_size_;
-  if (reached_eof_ || num_shuffled_values_ == 0) return;
-
-  auto index = (start_index_ + num_shuffled_values_ - 1) % max_buffer_size;
-  assert(index < shuffle_buffer_.size());
-  auto& eof = shuffle_buffer_[index].eof;
-  if (eof.IsConcrete() && eof.get()) {
-    reached_eof_ = true;
-    auto removed_value = std::move(shuffle_buffer_[index]);
-    (void)removed_value;
-    num_shuffled_values_--;
+  // Map the 32 random bits to [0, num_shuffled_values_) with a multiplication
+  // instead of a (slower) modulo.
+  auto random_index = static_cast<size_t>(
+      (static_cast<uint64_t>(random_()) * num_shuffled_values_) >> 32);
+  // Move the selected element out, and the last element into its slot.
+  auto* selected = &shuffle_buffer_[random_index * arity_];
+  auto* last = &shuffle_buffer_[(num_shuffled_values_ - 1) * arity_];
+  llvm::SmallVector<RCReference<AsyncValue>, 4> values;
+  values.reserve(arity_);
+  for (int i = 0; i < arity_; ++i) {
+    values.push_back(std::move(selected[i]));
+    if (selected != last) selected[i] = std::move(last[i]);
   }
+  num_shuffled_values_--;
+  shuffle_buffer_.resize(num_shuffled_values_ * arity_);
+  return IterationResult::Pending(std::move(values), not_eof_.CopyRef());
 }
 
 }  // namespace data
@@ -20,6 +20,10 @@
 #ifndef TFRT_DATA_SHUFFLE_DATASET_H_
 #define TFRT_DATA_SHUFFLE_DATASET_H_
 
+#include <memory>
+#include <queue>
+#include <vector>
+
 #include "tfrt/data/dataset.h"
 #include "tfrt/support/mutex.h"
 #include "tfrt/support/philox_random.h"
@@ -50,7 +54,10 @@ class ShuffleDataset : public Dataset {
   ShuffleDataset(const ShuffleDataset&) = delete;
   ShuffleDataset& operator=(const ShuffleDataset&) = delete;
 
-  RCReference<Iterator> MakeIterator(const IteratorContext& context) override;
+  string_view name() const override { return "shuffle"; }
+
+  RCReference<Iterator> MakeIteratorInternal(
+      const IteratorContext& context) override;
 
  private:
   friend class ShuffleDatasetIterator;
@@ -74,7 +81,10 @@ class ShuffleDatasetIterator : public Iterator {
       : Iterator(),
         parent_dataset_(std::move(dataset)),
         input_iterator_(parent_dataset_->input_dataset_->MakeIterator(context)),
-        random_(parent_dataset_->seed_, parent_dataset_->seed2_) {}
+        random_(parent_dataset_->seed_, parent_dataset_->seed2_),
+        not_eof_(
+            MakeAvailableAsyncValueRef<bool>(parent_dataset_->host_, false)),
+        stats_(context.stats) {}
 
   // This class is not copyable or movable.
   ShuffleDatasetIterator(const ShuffleDatasetIterator&) = delete;
@@ -83,6 +93,11 @@ class ShuffleDatasetIterator : public Iterator {
   IterationResult GetNext(const ExecutionContext& exec_ctx) override;
 
  private:
+  // The number of elements for which storage is reserved up front. Larger
+  // shuffle buffers grow as they are filled, so that a large `buffer_size` over
+  // a small input does not waste memory.
+  static constexpr int64_t kMaxPreallocatedElements = 1 << 16;
+
   void Destroy() override {
     internal::DestroyImpl<ShuffleDatasetIterator>(this,
                                                   parent_dataset_->allocator_);
@@ -96,7 +111,13 @@ class ShuffleDatasetIterator : public Iterator {
                                    bool is_token_owner, int callback_count)
       TFRT_EXCLUDES(mu_);
 
-  void HandleEofAvailableInput(IterationResult input, HostContext* host);
+  // Fills the shuffle buffer and removes a random element from it. Returns
+  // None if the next input is not available yet. Input errors are returned
+  // as they arrive instead of being shuffled. Must only be called by the token
+  // owner.
+  Optional<IterationResult> ProduceNext(const ExecutionContext& exec_ctx);
+
+  IterationResult MakePendingResult(HostContext* host);
 
   int OutputBufferSize() TFRT_EXCLUDES(mu_) {
     mutex_lock lock(mu_);
@@ -111,26 +132,28 @@ class ShuffleDatasetIterator : public Iterator {
     return value;
   }
 
-  // If the last non-empty value in the circular buffer `num_shuffled_values_`
-  // has reached EOF, remove this value from the circular buffer and set
-  // `reached_eof_` to true.
-  void CheckEof();
-
   RCReference<ShuffleDataset> parent_dataset_;
   RCReference<Iterator> input_iterator_;
   random::PhiloxRandom random_;
+  // Shared by all elements returned from the shuffle buffer, which are
+  // available and not at the end.
+  AsyncValueRef<bool> not_eof_;
+  const std::shared_ptr<IteratorStats> stats_;
 
   mutex mu_;
   // The number of values in the IterationResult returned by this iterator.
   int arity_ = -1;
   // True iff the input_iterator_ has reached EOF.
   bool reached_eof_ = false;
-  // A circular buffer of IterationResult from the `input_iterator_`.
-  std::vector<IterationResult> shuffle_buffer_;
-  // Number of non-empty values in the circular shuffle_buffer_.
+  // The input whose eof is not available yet. At most one input is requested
+  // ahead of time.
+  Optional<IterationResult> pending_input_;
+  // The values of the shuffled elements, `arity_` consecutive values per
+  // element. Only elements whose eof was available and false are stored, so
+  // the eof flags are dropped.
+  std::vector<RCReference<AsyncValue>> shuffle_buffer_;
+  // Number of elements in the shuffle_buffer_.
   size_t num_shuffled_values_ = 0;
-  // The index of the first value in the circular shuffle_buffer_.
-  size_t start_index_ = 0;
   // A queue of IterationResult that have already been returned to the
   // GetNext(...) caller.
   std::queue<IterationResult> output_buffer_ TFRT_GUARDED_BY(mu_);
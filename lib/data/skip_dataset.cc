@@ -19,13 +19,15 @@
 
 #include "skip_dataset.h"
 
+#include <algorithm>
+
 namespace tfrt {
 namespace data {
 
 //===----------------------------------------------------------------------===//
 // SkipDataset methods
 //===----------------------------------------------------------------------===//
-RCReference<Iterator> SkipDataset::MakeIterator(
+RCReference<Iterator> SkipDataset::MakeIteratorInternal(
     const IteratorContext& context) {
   return TakeRef(host_->Construct<SkipDatasetIterator>(FormRef(this), context));
 }
@@ -34,16 +36,30 @@ RCReference<Iterator> SkipDataset::MakeIterator(
 // SkipDatasetIterator methods
 //===----------------------------------------------------------------------===//
 IterationResult SkipDatasetIterator::GetNext(const ExecutionContext& exec_ctx) {
-  if (!is_skip_done_) {
-    is_skip_done_ = true;
-    for (int i = 0, e = parent_dataset_->count_; i < e; ++i) {
-      // Skip the first `count` values. The IterationResult returned to the
-      // caller will provide the correct EOF information.
-      input_iterator_->GetNext(exec_ctx);
-    }
-  }
+  MaybeSkip(exec_ctx);
   return input_iterator_->GetNext(exec_ctx);
 }
 
+void SkipDatasetIterator::GetNextBatch(
+    const ExecutionContext& exec_ctx, size_t n,
+    llvm::SmallVectorImpl<IterationResult>* results) {
+  MaybeSkip(exec_ctx);
+  input_iterator_->GetNextBatch(exec_ctx, n, results);
+}
+
+void SkipDatasetIterator::MaybeSkip(const ExecutionContext& exec_ctx) {
+  if (is_skip_done_) return;
+  is_skip_done_ = true;
+  // Skip the first `count` values. The IterationResult returned to the caller
+  // will provide the correct EOF information.
+  llvm::SmallVector<IterationResult, 4> skipped;
+  for (int64_t remaining = parent_dataset_->count_; remaining > 0;
+       remaining -= kSkipBatchSize) {
+    skipped.clear();
+    input_iterator_->GetNextBatch(
+        exec_ctx, std::min(remaining, kSkipBatchSize), &skipped);
+  }
+}
+
 }  // namespace data
 }  // namespace tfrt
@@ -42,7 +42,10 @@ class SkipDataset : public Dataset {
   SkipDataset(const SkipDataset&) = delete;
   SkipDataset& operator=(const SkipDataset&) = delete;
 
-  RCReference<Iterator> MakeIterator(const IteratorContext& context) override;
+  string_view name() const override { return "skip"; }
+
+  RCReference<Iterator> MakeIteratorInternal(
+      const IteratorContext& context) override;
 
  private:
   friend class SkipDatasetIterator;
@@ -72,7 +75,15 @@ class SkipDatasetIterator : public Iterator {
 
   IterationResult GetNext(const ExecutionContext& exec_ctx) override;
 
+  void GetNextBatch(const ExecutionContext& exec_ctx, size_t n,
+                    llvm::SmallVectorImpl<IterationResult>* results) override;
+
  private:
+  // The number of values requested at a time while skipping.
+  static constexpr int64_t kSkipBatchSize = 256;
+
+  void MaybeSkip(const ExecutionContext& exec_ctx);
+
   void Destroy() override {
     internal::DestroyImpl<SkipDatasetIterator>(this,
                                                parent_dataset_->allocator_);
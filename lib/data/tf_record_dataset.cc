@@ -17,9 +17,16 @@
 
 #include "tf_record_dataset.h"
 
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+#include "llvm/Support/MathExtras.h"
+#include "tfrt/host_context/async_dispatch.h"
 #include "tfrt/io/buffered_input_stream.h"
 #include "tfrt/io/file_input_stream.h"
 #include "tfrt/io/file_system.h"
+#include "tfrt/io/zlib_input_stream.h"
 #include "tfrt/support/crc32c.h"
 #include "tfrt/support/error_util.h"
 #include "tfrt/support/raw_coding.h"
@@ -31,7 +38,7 @@ namespace data {
 // Implementation for TFRecordDataset member functions
 //===----------------------------------------------------------------------===//
 
-RCReference<Iterator> TFRecordDataset::MakeIterator(
+RCReference<Iterator> TFRecordDataset::MakeIteratorInternal(
     const IteratorContext& context) {
   return TakeRef(
       host_->Construct<TFRecordDatasetIterator>(FormRef(this), context));
@@ -40,33 +47,87 @@ RCReference<Iterator> TFRecordDataset::MakeIterator(
 //===----------------------------------------------------------------------===//
 // Implementation for TFRecordDatasetIterator member functions
 //===----------------------------------------------------------------------===//
-IterationResult TFRecordDatasetIterator::GetNextElement(
-    const ExecutionContext& exec_ctx) {
-  HostContext* host = exec_ctx.host();
-  if (auto error = MaybeInitializeStream()) {
-    auto async_error = MakeErrorAsyncValueRef(host, StrCat(error));
-    return IterationResult::Error(std::move(async_error), 1);
-  }
-
-  bool eof = false;
-  auto result = ReadRecord(&eof);
+TFRecordDatasetIterator::~TFRecordDatasetIterator() {
+  if (chunk_ahead_count_) Await(parent_dataset_->host_, chunk_ahead_count_);
+}
 
+// Returns the element holding `record`, or the end of iteration if `eof` is
+// true.
+template <typename T>
+static IterationResult MakeRecordResult(llvm::Expected<T> record, bool eof,
+                                        HostContext* host) {
   if (eof) {
+    llvm::consumeError(record.takeError());
     return IterationResult::Eof(host, 1);
   }
-  if (!result) {
+  if (!record) {
     // Do not decode location or emit error because the local handler might have
     // been freed.
-    auto error = MakeErrorAsyncValueRef(host, StrCat(result.takeError()));
+    auto error = MakeErrorAsyncValueRef(host, StrCat(record.takeError()));
     return IterationResult::Error(std::move(error), 1);
   }
 
   llvm::SmallVector<RCReference<AsyncValue>, 4> values;
-  values.push_back(
-      MakeAvailableAsyncValueRef<std::string>(host, std::move(*result)));
+  values.push_back(MakeAvailableAsyncValueRef<T>(host, std::move(*record)));
   return IterationResult::Values(std::move(values), host);
 }
 
+IterationResult TFRecordDatasetIterator::GetNextElement(
+    const ExecutionContext& exec_ctx) {
+  HostContext* host = exec_ctx.host();
+  if (auto error = MaybeInitializeStream()) {
+    auto async_error = MakeErrorAsyncValueRef(host, StrCat(error));
+    return IterationResult::Error(std::move(async_error), 1);
+  }
+
+  bool eof = false;
+  switch (parent_dataset_->mode_) {
+    case TFRecordReadMode::kStream: {
+      auto result = ReadRecord(&eof);
+      return MakeRecordResult(std::move(result), eof, host);
+    }
+    case TFRecordReadMode::kMapped: {
+      auto result = ReadRecordView(&eof);
+      return MakeRecordResult(std::move(result), eof, host);
+    }
+    case TFRecordReadMode::kChunked: {
+      auto result = ReadRecordFromChunk(&eof);
+      return MakeRecordResult(std::move(result), eof, host);
+    }
+  }
+  llvm_unreachable("unknown TFRecordReadMode");
+}
+
+// The size of the chunks that compressed files are decompressed in.
+static constexpr size_t kDecompressedChunkSize = 1 << 20;
+
+// The buffer of a stream grows up to kMaxStreamBufferGrowth times its initial
+// size, but not beyond kMaxStreamBufferSize bytes, if the chunks it reads ahead
+// are not ready when they are needed.
+static constexpr size_t kMaxStreamBufferGrowth = 16;
+static constexpr size_t kMaxStreamBufferSize = 16 << 20;
+
+// Returns the size up to which a stream buffer of `buffer_size` bytes grows.
+static size_t GetMaxStreamBufferSize(size_t buffer_size) {
+  return std::max(buffer_size, std::min(kMaxStreamBufferGrowth * buffer_size,
+                                        kMaxStreamBufferSize));
+}
+
+// The size of a record header, which holds the length of the record and its
+// masked crc32c.
+static constexpr size_t kHeaderSize = sizeof(uint64_t) + sizeof(uint32_t);
+
+// The maximum number of bytes reserved before a chunk read ahead, for the
+// bytes of the current chunk that are not parsed yet. If there are more, the
+// chunk read ahead is copied after them.
+static constexpr size_t kMaxChunkAheadHead = 64 << 10;
+
+// Returns whether the masked crc32c stored at `masked_crc` matches the first
+// `n` bytes of `data`.
+static bool VerifyChecksum(const char* data, size_t n, const char* masked_crc) {
+  return crc32c::Unmask(DecodeFixed32(masked_crc)) == crc32c::Value(data, n);
+}
+
 // Logic based on tensorflow/core/io/record_reader.*
 // Note: RecordReader maintains the offset. For now, we're relying on
 // ifstream reading sequentially.
@@ -88,8 +149,7 @@ llvm::Expected<std::string> TFRecordDatasetIterator::ReadChecksummed(
     *eof = true;
     return MakeStringError("end of file");
   }
-  const uint32_t masked_crc = DecodeFixed32(result.data() + n);
-  if (crc32c::Unmask(masked_crc) != crc32c::Value(result.data(), n)) {
+  if (!VerifyChecksum(result.data(), n, result.data() + n)) {
     return MakeStringError("data corruption at position ", pos);
   }
 
@@ -116,21 +176,323 @@ llvm::Expected<std::string> TFRecordDatasetIterator::ReadRecord(bool* eof) {
   return body;
 }
 
+llvm::Expected<RCReference<HostBuffer>>
+TFRecordDatasetIterator::ReadUnverifiedView(size_t n, uint32_t* masked_crc,
+                                            bool* eof) {
+  *eof = false;
+  auto view = file_->ReadView(file_offset_, n);
+  if (!view) {
+    view = HostBuffer::CreateUninitialized(n, alignof(std::max_align_t),
+                                           parent_dataset_->allocator_);
+    if (!view) return MakeStringError("failed to allocate ", n, " bytes");
+    auto count_or_error =
+        file_->Read(static_cast<char*>(view->data()), n, file_offset_);
+    if (!count_or_error) return count_or_error.takeError();
+    view = HostBuffer::CreateFromExternal(std::move(view), 0, *count_or_error);
+  }
+  // The crc is copied rather than viewed, to not allocate another view.
+  char crc[sizeof(uint32_t)];
+  auto crc_count_or_error = file_->Read(crc, sizeof(crc), file_offset_ + n);
+  if (!crc_count_or_error) return crc_count_or_error.takeError();
+
+  if (view->size() < n || *crc_count_or_error < sizeof(crc)) {
+    // Skip the bytes left, so that the next read is at the end of file.
+    file_offset_ += view->size() + *crc_count_or_error;
+    *eof = true;
+    return MakeStringError("end of file");
+  }
+  *masked_crc = DecodeFixed32(crc);
+  file_offset_ += n + sizeof(crc);
+  return std::move(view);
+}
+
+llvm::Expected<RCReference<HostBuffer>>
+TFRecordDatasetIterator::ReadUnverifiedRecordView(uint32_t* masked_crc,
+                                                  bool* eof) {
+  *eof = false;
+  const size_t pos = file_offset_;
+
+  // Read header. It is copied, since it is only decoded. The header is verified
+  // right away, since the length must be valid to find the next record.
+  char header[kHeaderSize];
+  auto count_or_error = file_->Read(header, sizeof(header), pos);
+  if (!count_or_error) return count_or_error.takeError();
+  if (*count_or_error == 0) {
+    *eof = true;
+    return MakeStringError("end of file");
+  }
+  if (*count_or_error < sizeof(header)) {
+    file_offset_ += *count_or_error;
+    return MakeStringError("truncated record at position ", pos);
+  }
+  // The next read starts after the corrupted header, like in chunked mode.
+  file_offset_ += sizeof(header);
+  if (!VerifyChecksum(header, sizeof(uint64_t), header + sizeof(uint64_t))) {
+    return MakeStringError("data corruption at position ", pos);
+  }
+  const uint64_t length = DecodeFixed64(header);
+
+  // Read body.
+  auto body = ReadUnverifiedView(length, masked_crc, eof);
+  if (*eof) {
+    *eof = false;
+    llvm::consumeError(body.takeError());
+    return MakeStringError("truncated record at position ", pos);
+  }
+  return body;
+}
+
+llvm::Expected<RCReference<HostBuffer>> TFRecordDatasetIterator::ReadRecordView(
+    bool* eof) {
+  *eof = false;
+  if (next_record_view_ < record_views_.size()) {
+    return std::move(record_views_[next_record_view_++].body);
+  }
+  record_views_.clear();
+  next_record_view_ = 0;
+
+  // Read a batch of records and verify the checksums of their bodies at once.
+  // The batch ends before the first record that can not be read, which is
+  // read again and reported by the next call.
+  constexpr size_t kRecordViewBatchSize = 32;
+  while (record_views_.size() < kRecordViewBatchSize) {
+    const size_t pos = file_offset_;
+    uint32_t masked_crc;
+    auto body = ReadUnverifiedRecordView(&masked_crc, eof);
+    if (!body || *eof) {
+      if (record_views_.empty()) return body;
+      llvm::consumeError(body.takeError());
+      *eof = false;
+      file_offset_ = pos;
+      break;
+    }
+    record_views_.push_back({pos, std::move(*body), masked_crc});
+  }
+
+  const size_t num_valid = VerifyRecordViews();
+  if (num_valid < record_views_.size()) {
+    const size_t pos = record_views_[num_valid].pos;
+    record_views_.resize(num_valid);
+    if (num_valid == 0) {
+      // The next read starts after the header of the corrupted record.
+      file_offset_ = pos + kHeaderSize;
+      return MakeStringError("data corruption at position ", pos);
+    }
+    file_offset_ = pos;
+  }
+  return std::move(record_views_[next_record_view_++].body);
+}
+
+llvm::Expected<RCReference<HostBuffer>>
+TFRecordDatasetIterator::ReadRecordFromChunk(bool* eof) {
+  *eof = false;
+  if (next_record_view_ < record_views_.size()) {
+    return std::move(record_views_[next_record_view_++].body);
+  }
+  record_views_.clear();
+  next_record_view_ = 0;
+
+  while (true) {
+    // Parse the complete records in the rest of the chunk.
+    size_t min_size = kHeaderSize;
+    while (chunk_size_ - chunk_pos_ >= kHeaderSize) {
+      const char* header =
+          static_cast<const char*>(chunk_->data()) + chunk_pos_;
+      const size_t pos = chunk_offset_ + chunk_pos_;
+      if (!VerifyChecksum(header, sizeof(uint64_t),
+                          header + sizeof(uint64_t))) {
+        // The error is returned after the records before it.
+        if (!record_views_.empty()) break;
+        chunk_pos_ += kHeaderSize;
+        return MakeStringError("data corruption at position ", pos);
+      }
+      const uint64_t length = DecodeFixed64(header);
+      const size_t record_size = kHeaderSize + length + sizeof(uint32_t);
+      if (chunk_size_ - chunk_pos_ < record_size) {
+        min_size = record_size;
+        break;
+      }
+      record_views_.push_back(
+          {pos,
+           HostBuffer::CreateFromExternal(chunk_.CopyRef(),
+                                          chunk_pos_ + kHeaderSize, length),
+           DecodeFixed32(header + kHeaderSize + length)});
+      chunk_pos_ += record_size;
+    }
+    if (!record_views_.empty()) break;
+
+    if (chunk_at_eof_) {
+      if (chunk_pos_ == chunk_size_) {
+        *eof = true;
+        return MakeStringError("end of file");
+      }
+      const size_t pos = chunk_offset_ + chunk_pos_;
+      chunk_pos_ = chunk_size_;
+      return MakeStringError("truncated record at position ", pos);
+    }
+    if (auto error = ReadNextChunk(min_size)) return std::move(error);
+  }
+
+  const size_t num_valid = VerifyRecordViews();
+  if (num_valid < record_views_.size()) {
+    const size_t pos = record_views_[num_valid].pos;
+    record_views_.resize(num_valid);
+    if (num_valid == 0) {
+      // The next read starts after the header of the corrupted record.
+      chunk_pos_ = pos - chunk_offset_ + kHeaderSize;
+      return MakeStringError("data corruption at position ", pos);
+    }
+    chunk_pos_ = pos - chunk_offset_;
+  }
+  return std::move(record_views_[next_record_view_++].body);
+}
+
+llvm::Error TFRecordDatasetIterator::ReadNextChunk(size_t min_size) {
+  // With direct IO, the chunk is read to an aligned position in an aligned
+  // buffer, in a multiple of the alignment. The bytes that are not parsed yet
+  // are copied right before that position, so that file_offset_ stays aligned
+  // and the file is read without staging the bytes.
+  const size_t alignment =
+      parent_dataset_->direct_io_ ? ::tfrt::io::kDirectIOAlignment : 1;
+  const size_t remaining = chunk_size_ - chunk_pos_;
+  const size_t head = llvm::alignTo(remaining, alignment);
+  size_t read_size = llvm::alignTo(
+      std::max(static_cast<size_t>(parent_dataset_->buffer_size_), min_size) -
+          remaining,
+      alignment);
+
+  // Take the chunk read ahead, which starts at file_offset_. If its read
+  // failed, the bytes are read again below, which reports a persistent error.
+  RCReference<HostBuffer> ahead;
+  size_t ahead_count = 0;
+  if (chunk_ahead_) {
+    Await(parent_dataset_->host_, chunk_ahead_count_);
+    if (!chunk_ahead_count_.IsError()) {
+      ahead = std::move(chunk_ahead_);
+      ahead_count = *chunk_ahead_count_;
+    }
+    chunk_ahead_.reset();
+    chunk_ahead_count_.reset();
+  }
+
+  RCReference<HostBuffer> buffer;
+  // The position of the bytes read from file_offset_ in `buffer`.
+  size_t begin;
+  size_t count = 0;
+  bool at_eof = false;
+  if (ahead && head <= chunk_ahead_head_) {
+    // The bytes that are not parsed yet fit before the chunk read ahead, which
+    // is used as is.
+    buffer = std::move(ahead);
+    begin = chunk_ahead_head_;
+    count = ahead_count;
+    at_eof = count < chunk_ahead_size_;
+  } else {
+    if (ahead) read_size = std::max(read_size, chunk_ahead_size_);
+    const size_t size = head + read_size;
+    buffer = HostBuffer::CreateUninitialized(
+        size, std::max(alignof(std::max_align_t), alignment),
+        parent_dataset_->allocator_);
+    if (!buffer) return MakeStringError("failed to allocate ", size, " bytes");
+    begin = head;
+    char* data = static_cast<char*>(buffer->data()) + begin;
+    if (ahead) {
+      std::memcpy(data, static_cast<const char*>(ahead->data()) +
+                            chunk_ahead_head_,
+                  ahead_count);
+      count = ahead_count;
+      at_eof = count < chunk_ahead_size_;
+    }
+    if (!at_eof && count < read_size) {
+      auto count_or_error =
+          file_->Read(data + count, read_size - count, file_offset_ + count);
+      if (!count_or_error) return count_or_error.takeError();
+      count += *count_or_error;
+      at_eof = count < read_size;
+    }
+  }
+
+  if (remaining > 0) {
+    std::memcpy(static_cast<char*>(buffer->data()) + begin - remaining,
+                static_cast<const char*>(chunk_->data()) + chunk_pos_,
+                remaining);
+  }
+  file_offset_ += count;
+  chunk_at_eof_ = at_eof;
+  chunk_offset_ += chunk_pos_;
+  chunk_size_ = remaining + count;
+  chunk_ = begin == remaining ? std::move(buffer)
+                              : HostBuffer::CreateFromExternal(
+                                    std::move(buffer), begin - remaining,
+                                    chunk_size_);
+  chunk_pos_ = 0;
+  ReadChunkAhead();
+  return llvm::Error::success();
+}
+
+void TFRecordDatasetIterator::ReadChunkAhead() {
+  if (chunk_at_eof_) return;
+  const size_t alignment =
+      parent_dataset_->direct_io_ ? ::tfrt::io::kDirectIOAlignment : 1;
+  const size_t buffer_size = parent_dataset_->buffer_size_;
+  const size_t head =
+      llvm::alignTo(std::min(buffer_size, kMaxChunkAheadHead), alignment);
+  const size_t read_size = llvm::alignTo(buffer_size, alignment);
+  auto buffer = HostBuffer::CreateUninitialized(
+      head + read_size, std::max(alignof(std::max_align_t), alignment),
+      parent_dataset_->allocator_);
+  // Without a buffer, the chunk is read when it is needed.
+  if (!buffer) return;
+  chunk_ahead_count_ =
+      file_->ReadAsync(static_cast<char*>(buffer->data()) + head, read_size,
+                       file_offset_, parent_dataset_->host_);
+  chunk_ahead_ = std::move(buffer);
+  chunk_ahead_head_ = head;
+  chunk_ahead_size_ = read_size;
+}
+
+size_t TFRecordDatasetIterator::VerifyRecordViews() const {
+  llvm::SmallVector<crc32c::MaskedBuffer, 32> buffers;
+  buffers.reserve(record_views_.size());
+  for (const auto& record : record_views_) {
+    buffers.push_back({static_cast<const char*>(record.body->data()),
+                       record.body->size(), record.masked_crc});
+  }
+  return crc32c::VerifyMasked(buffers);
+}
+
 llvm::Error TFRecordDatasetIterator::MaybeInitializeStream() {
   if (initialization_error_) {
     return MakeStringError(initialization_error_);
   }
 
-  if (stream_) return llvm::Error::success();
+  if (stream_ || file_) return llvm::Error::success();
 
   auto* fs_registry = ::tfrt::io::FileSystemRegistry::Default();
-  auto* file_system = fs_registry->Lookup("");
+  auto* file_system = fs_registry->LookupForPath(parent_dataset_->path_);
   if (!file_system) {
-    initialization_error_ =
-        MakeStringError("No file system is found for the given scheme");
+    initialization_error_ = MakeStringError(
+        "No file system is found for the scheme of ", parent_dataset_->path_);
     return MakeStringError(initialization_error_);
   }
 
+  if (parent_dataset_->mode_ == TFRecordReadMode::kMapped) {
+    auto error =
+        file_system->NewMappedRandomAccessFile(parent_dataset_->path_, &file_);
+    if (error) initialization_error_ = MakeStringError(error);
+    return error;
+  }
+  if (parent_dataset_->mode_ == TFRecordReadMode::kChunked) {
+    auto error = parent_dataset_->direct_io_
+                     ? file_system->NewDirectRandomAccessFile(
+                           parent_dataset_->path_, parent_dataset_->allocator_,
+                           &file_)
+                     : file_system->NewRandomAccessFile(parent_dataset_->path_,
+                                                        &file_);
+    if (error) initialization_error_ = MakeStringError(error);
+    return error;
+  }
+
   std::unique_ptr<::tfrt::io::RandomAccessFile> file;
   auto error = file_system->NewRandomAccessFile(parent_dataset_->path_, &file);
   if (error) {
@@ -139,10 +501,25 @@ llvm::Error TFRecordDatasetIterator::MaybeInitializeStream() {
   }
 
   stream_ = std::make_unique<::tfrt::io::FileInputStream>(std::move(file));
-  if (parent_dataset_->buffer_size_ > 0) {
+  // The buffered streams read ahead on a blocking work queue thread while the
+  // records of the current chunk are parsed.
+  if (parent_dataset_->compression_) {
+    // The compressed bytes are read in large chunks, so they are not buffered
+    // again.
+    const size_t input_buffer_size = parent_dataset_->buffer_size_ > 0
+                                         ? parent_dataset_->buffer_size_
+                                         : kDecompressedChunkSize;
+    stream_ = std::make_unique<::tfrt::io::ZlibInputStream>(
+        std::move(stream_), *parent_dataset_->compression_, input_buffer_size);
+    stream_ = std::make_unique<::tfrt::io::BufferedInputStream>(
+        std::move(stream_), kDecompressedChunkSize,
+        GetMaxStreamBufferSize(kDecompressedChunkSize),
+        parent_dataset_->allocator_, parent_dataset_->host_);
+  } else if (parent_dataset_->buffer_size_ > 0) {
     stream_ = std::make_unique<::tfrt::io::BufferedInputStream>(
         std::move(stream_), parent_dataset_->buffer_size_,
-        parent_dataset_->allocator_);
+        GetMaxStreamBufferSize(parent_dataset_->buffer_size_),
+        parent_dataset_->allocator_, parent_dataset_->host_);
   }
   return llvm::Error::success();
 }
@@ -20,39 +20,72 @@
 #ifndef TFRT_LIB_DATA_TF_RECORD_DATASET_H_
 #define TFRT_LIB_DATA_TF_RECORD_DATASET_H_
 
+#include <vector>
+
 #include "io.h"
 #include "tfrt/data/dataset.h"
+#include "tfrt/host_context/host_buffer.h"
+#include "tfrt/io/file_system.h"
 #include "tfrt/io/input_stream.h"
+#include "tfrt/io/zlib_input_stream.h"
 #include "tfrt/support/forward_decls.h"
 
 namespace tfrt {
 namespace data {
 
+// Specifies how TFRecordDataset reads records from a file.
+enum class TFRecordReadMode {
+  // Each record is copied into a std::string from a stream, which is buffered
+  // with `buffer_size` bytes. If the file is read more slowly than the records
+  // are parsed, the buffer grows up to a bounded multiple of `buffer_size`.
+  kStream,
+  // The file is mapped into memory and each record is a HostBuffer that
+  // references the record in the mapping, which keeps the mapping alive.
+  kMapped,
+  // The file is read in chunks of `buffer_size` bytes and each record is a
+  // HostBuffer that references the record in its chunk, which keeps the chunk
+  // alive. Record boundaries are parsed in place, so that only records which
+  // span two chunks are copied. The next chunk is read ahead with
+  // RandomAccessFile::ReadAsync() while the current one is parsed.
+  kChunked,
+};
+
 // TFRecordDataset reads TFRecord bytes from a file.
 //
-// TODO(rachelim): Consider using a custom data type to represent the
-// bytes read from a TFRecord file. This will make the code more type safe
-// and allow for future optimizations to use mmap instead of copying bytes
-// from the file onto the heap.
+// If `compression` is set, the file is decompressed while it is read, which is
+// only supported by TFRecordReadMode::kStream. If `direct_io` is set, the file
+// is read with direct IO, bypassing the page cache, which is only supported by
+// TFRecordReadMode::kChunked.
 class TFRecordDataset : public Dataset {
  public:
   explicit TFRecordDataset(std::string path, int64_t buffer_size,
                            int64_t max_prefetch_num, int64_t prefetch_threshold,
-                           HostContext* host)
+                           TFRecordReadMode mode,
+                           llvm::Optional<::tfrt::io::ZlibFormat> compression,
+                           bool direct_io, HostContext* host)
       : path_(std::move(path)),
+        mode_(mode),
+        compression_(compression),
+        direct_io_(direct_io),
         buffer_size_(buffer_size),
         max_prefetch_num_(max_prefetch_num),
         prefetch_threshold_(prefetch_threshold),
         host_(host),
         allocator_(host->allocator()) {
     assert(buffer_size_ >= 0);
+    assert(mode_ != TFRecordReadMode::kChunked || buffer_size_ > 0);
+    assert(mode_ == TFRecordReadMode::kStream || !compression_);
+    assert(mode_ == TFRecordReadMode::kChunked || !direct_io_);
   }
 
   // This class is not copyable or movable.
   TFRecordDataset(const TFRecordDataset&) = delete;
   TFRecordDataset& operator=(const TFRecordDataset&) = delete;
 
-  RCReference<Iterator> MakeIterator(const IteratorContext& context) override;
+  string_view name() const override { return "tf_record"; }
+
+  RCReference<Iterator> MakeIteratorInternal(
+      const IteratorContext& context) override;
 
  private:
   friend class TFRecordDatasetIterator;
@@ -62,6 +95,9 @@ class TFRecordDataset : public Dataset {
   }
 
   const std::string path_;
+  const TFRecordReadMode mode_;
+  const llvm::Optional<::tfrt::io::ZlibFormat> compression_;
+  const bool direct_io_;
   const int64_t buffer_size_;
   const int64_t max_prefetch_num_;
   const int64_t prefetch_threshold_;
@@ -77,6 +113,9 @@ class TFRecordDatasetIterator : public io::PrefetchingIterator {
                                 parent_dataset->prefetch_threshold_, context),
         parent_dataset_(std::move(parent_dataset)) {}
 
+  // Waits for the chunk read ahead, if any, which reads into its buffer.
+  ~TFRecordDatasetIterator() override;
+
   // This class is not copyable or movable.
   TFRecordDatasetIterator(const TFRecordDatasetIterator&) = delete;
   TFRecordDatasetIterator& operator=(const TFRecordDatasetIterator&) = delete;
@@ -87,6 +126,8 @@ class TFRecordDatasetIterator : public io::PrefetchingIterator {
   // the next record.
   IterationResult GetNextElement(const ExecutionContext& exec_ctx) final;
 
+  // Opens the input file on the first call, as a stream, as a mapped file or as
+  // a file that is read in chunks, depending on mode_.
   llvm::Error MaybeInitializeStream();
 
  private:
@@ -111,8 +152,83 @@ class TFRecordDatasetIterator : public io::PrefetchingIterator {
   // return value.
   llvm::Expected<std::string> ReadRecord(bool* eof);
 
+  // Reads n + 4 bytes from file_ at file_offset_ and returns a view of the
+  // first n bytes in file_, whose masked checksum is stored in *masked_crc.
+  // The checksum is not verified. The view is copied only if file_ does not
+  // support views. Otherwise behaves like ReadChecksummed().
+  llvm::Expected<RCReference<HostBuffer>> ReadUnverifiedView(
+      size_t n, uint32_t* masked_crc, bool* eof);
+
+  // Same as ReadRecord(), but returns a view of the record in file_ and does
+  // not verify the checksum of the record body, which is stored in
+  // *masked_crc. Like in chunked mode, a partial header at the end of file is
+  // a truncated record, and a corrupted header is skipped.
+  llvm::Expected<RCReference<HostBuffer>> ReadUnverifiedRecordView(
+      uint32_t* masked_crc, bool* eof);
+
+  // Same as ReadRecord(), but returns a view of the record in file_. Records
+  // are read ahead in batches, whose checksums are verified at once.
+  llvm::Expected<RCReference<HostBuffer>> ReadRecordView(bool* eof);
+
+  // Same as ReadRecord(), but returns a view of the record in the current
+  // chunk. Records are parsed a whole chunk at a time, and their checksums are
+  // verified at once.
+  llvm::Expected<RCReference<HostBuffer>> ReadRecordFromChunk(bool* eof);
+
+  // Reads the next chunk from file_ at file_offset_. The bytes of the current
+  // chunk that are not parsed yet are copied to the beginning of the new one.
+  // The new chunk has at least `min_size` bytes, so that a record that is
+  // larger than buffer_size_ fits. With direct IO, the size that is read is
+  // rounded up to a multiple of the direct IO alignment.
+  //
+  // The chunk read ahead is used if there is one, and the chunk following the
+  // new one is read ahead.
+  llvm::Error ReadNextChunk(size_t min_size);
+
+  // Starts reading the chunk at file_offset_ with ReadAsync(), so that the
+  // read overlaps with the parsing of the current chunk. Does nothing at the
+  // end of file.
+  void ReadChunkAhead();
+
+  // Verifies the checksums of the bodies of record_views_. Returns the index
+  // of the first record whose checksum does not match, or the number of
+  // records if all of them match.
+  size_t VerifyRecordViews() const;
+
+  // A record read ahead by ReadRecordView() or ReadRecordFromChunk(), starting
+  // at file offset `pos`.
+  struct RecordView {
+    size_t pos;
+    RCReference<HostBuffer> body;
+    uint32_t masked_crc;
+  };
+
   RCReference<TFRecordDataset> parent_dataset_;
   std::unique_ptr<::tfrt::io::InputStream> stream_;
+  // The input file if mode_ is kMapped or kChunked, and the offset of the next
+  // record or chunk to read.
+  std::unique_ptr<::tfrt::io::RandomAccessFile> file_;
+  size_t file_offset_ = 0;
+  // The current chunk if mode_ is kChunked. Holds chunk_size_ bytes read from
+  // file offset chunk_offset_, of which the first chunk_pos_ bytes are parsed.
+  RCReference<HostBuffer> chunk_;
+  size_t chunk_offset_ = 0;
+  size_t chunk_size_ = 0;
+  size_t chunk_pos_ = 0;
+  // Whether the last chunk ends at the end of file.
+  bool chunk_at_eof_ = false;
+  // The chunk read ahead from file offset file_offset_ if mode_ is kChunked.
+  // chunk_ahead_size_ bytes are read into chunk_ahead_ after the first
+  // chunk_ahead_head_ bytes, which are reserved for the bytes of the current
+  // chunk that are not parsed yet. chunk_ahead_count_ becomes available with
+  // the number of bytes read.
+  RCReference<HostBuffer> chunk_ahead_;
+  size_t chunk_ahead_head_ = 0;
+  size_t chunk_ahead_size_ = 0;
+  AsyncValueRef<size_t> chunk_ahead_count_;
+  // Verified records read ahead from file_, starting at next_record_view_.
+  std::vector<RecordView> record_views_;
+  size_t next_record_view_ = 0;
   llvm::Error initialization_error_ = llvm::Error::success();
 };
 
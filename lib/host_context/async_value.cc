@@ -21,6 +21,7 @@
 #include "tfrt/host_context/function.h"
 #include "tfrt/support/concurrent_vector.h"
 #include "tfrt/support/string_util.h"
+#include "tfrt/tracing/tracing.h"
 
 namespace tfrt {
 
@@ -65,6 +66,12 @@ const AsyncValue::TypeInfo& AsyncValue::GetTypeInfo() const {
   return (*type_info_table)[type_id_ - 1];
 }
 
+// Records a Debug level flow event for `value`. This links the activities
+// waiting on an AsyncValue to the one making it available.
+static void RecordFlowEvent(const AsyncValue* value, tracing::FlowPhase phase) {
+  tracing::RecordFlowEvent(tracing::TracingLevel::Debug, value, phase);
+}
+
 // This is called when the value is set into the ConcreteAsyncValue buffer, or
 // when the IndirectAsyncValue is forwarded to an available AsyncValue, and we
 // need to change our state and clear out the notifications. The current state
@@ -83,6 +90,10 @@ void AsyncValue::NotifyAvailable(State available_state) {
   assert(old_value.getInt() == State::kUnconstructed ||
          old_value.getInt() == State::kConstructed);
 
+  // Mark the time the value became available if someone is waiting for it.
+  if (old_value.getPointer())
+    RecordFlowEvent(this, tracing::FlowPhase::Step);
+
   RunWaiters(old_value.getPointer());
 }
 
@@ -102,6 +113,9 @@ void AsyncValue::RunWaiters(NotifierListNode* list) {
 // called when the value becomes available.
 void AsyncValue::EnqueueWaiter(llvm::unique_function<void()>&& waiter,
                                WaitersAndState old_value) {
+  // Mark the time a waiter started waiting for the value.
+  RecordFlowEvent(this, tracing::FlowPhase::Step);
+
   // Create the node for our waiter.
   auto* node = new NotifierListNode(std::move(waiter));
   auto old_state = old_value.getInt();
@@ -24,6 +24,7 @@
 #include <cstdint>
 
 #include "tfrt/host_context/host_allocator.h"
+#include "tfrt/metrics/metrics.h"
 
 namespace tfrt {
 
@@ -43,7 +44,12 @@ void AtomicUpdateMax(T const& value, std::atomic<T>* max_value) noexcept {
 class ProfiledAllocator : public HostAllocator {
  public:
   explicit ProfiledAllocator(std::unique_ptr<HostAllocator> allocator)
-      : allocator_(std::move(allocator)) {}
+      : allocator_(std::move(allocator)),
+        allocations_(metrics::NewCounter("/tfrt/allocator/allocations")),
+        allocated_bytes_(
+            metrics::NewCounter("/tfrt/allocator/allocated_bytes")),
+        deallocated_bytes_(
+            metrics::NewCounter("/tfrt/allocator/deallocated_bytes")) {}
 
   ~ProfiledAllocator() override {
     if (print_profile_) {
@@ -58,6 +64,10 @@ class ProfiledAllocator : public HostAllocator {
     AtomicUpdateMax<int64_t>(curr_num_allocations_, &max_num_allocations_);
     AtomicUpdateMax<int64_t>(curr_num_bytes_allocated_,
                              &max_num_bytes_allocated_);
+    if (metrics::IsMetricsEnabled()) {
+      allocations_->Increment();
+      allocated_bytes_->IncrementBy(size);
+    }
 
     return allocator_->AllocateBytes(size, alignment);
   }
@@ -65,6 +75,7 @@ class ProfiledAllocator : public HostAllocator {
   void DeallocateBytes(void* ptr, size_t size) override {
     --curr_num_allocations_;
     curr_num_bytes_allocated_.fetch_sub(size);
+    if (metrics::IsMetricsEnabled()) deallocated_bytes_->IncrementBy(size);
 
     allocator_->DeallocateBytes(ptr, size);
   }
@@ -94,6 +105,13 @@ class ProfiledAllocator : public HostAllocator {
 
  private:
   std::unique_ptr<HostAllocator> allocator_;
+
+  // Exported totals, summed over all profiled allocators. The number of bytes
+  // currently allocated is their difference. Only updated while metrics are
+  // enabled.
+  metrics::Counter* const allocations_;
+  metrics::Counter* const allocated_bytes_;
+  metrics::Counter* const deallocated_bytes_;
 };
 
 class LeakCheckAllocator : public ProfiledAllocator {
@@ -16,35 +16,139 @@
 
 #include "tfrt/io/buffered_input_stream.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <utility>
+
+#include "tfrt/host_context/async_dispatch.h"
+#include "tfrt/support/mutex.h"
+#include "tfrt/support/string_util.h"
+
 namespace tfrt {
 namespace io {
 
-llvm::Expected<size_t> BufferedInputStream::Read(char* buf, size_t max_count) {
-  if (max_count < 0) return MakeStringError("max_count should not be negative");
+// Owns the input stream and the next chunk, which is read by whichever thread
+// claims it first.
+class BufferedInputStream::ReadAhead {
+ public:
+  ReadAhead(std::unique_ptr<InputStream> input_stream, size_t buffer_size,
+            HostAllocator* allocator)
+      : input_stream_(std::move(input_stream)), allocator_(allocator) {
+    Resize(&next_, buffer_size);
+  }
+
+  ~ReadAhead() { Resize(&next_, 0); }
+
+  // Reallocates the buffer of `chunk` unless it already holds `capacity`
+  // bytes.
+  void Resize(Chunk* chunk, size_t capacity) {
+    if (chunk->capacity == capacity) return;
+    if (chunk->data) allocator_->Deallocate(chunk->data, chunk->capacity);
+    chunk->data = capacity > 0 ? allocator_->Allocate<char>(capacity) : nullptr;
+    chunk->capacity = capacity;
+  }
+
+  // Swaps the next chunk into `chunk`, reading it on the calling thread if no
+  // other thread has claimed it. Returns whether the next chunk was not read
+  // yet.
+  bool TakeNextChunk(Chunk* chunk) {
+    bool was_ready = false;
+    if (!next_claimed_.exchange(true)) {
+      ReadChunk(&next_);
+    } else {
+      mutex_lock lock(mu_);
+      was_ready = next_done_;
+      cv_.wait(lock, [this]() TFRT_REQUIRES(mu_) { return next_done_; });
+    }
+    std::swap(*chunk, next_);
+    return !was_ready;
+  }
+
+  // Allows the next chunk to be claimed, and sets the size of its buffer to
+  // `capacity` bytes. It must have been taken before.
+  void ReleaseNextChunk(size_t capacity) {
+    Resize(&next_, capacity);
+    {
+      mutex_lock lock(mu_);
+      next_done_ = false;
+    }
+    next_claimed_.store(false);
+  }
+
+  // Reads the next chunk unless it is already claimed.
+  void MaybeReadNextChunk() {
+    if (next_claimed_.exchange(true)) return;
+    ReadChunk(&next_);
+    mutex_lock lock(mu_);
+    next_done_ = true;
+    cv_.notify_all();
+  }
+
+  // Prevents the next chunk from being read if it is not yet claimed.
+  void Cancel() { next_claimed_.store(true); }
 
-  if (!buffer_limit_) {
-    auto error = buffer_limit_.takeError();
-    buffer_limit_ = 0;
-    return std::move(error);
+ private:
+  void ReadChunk(Chunk* chunk) {
+    chunk->size = 0;
+    chunk->eof = false;
+    chunk->error.clear();
+    auto count_or_error = input_stream_->Read(chunk->data, chunk->capacity);
+    if (!count_or_error) {
+      chunk->error = StrCat(count_or_error.takeError());
+      return;
+    }
+    chunk->size = *count_or_error;
+    chunk->eof = chunk->size == 0;
   }
 
+  const std::unique_ptr<InputStream> input_stream_;
+  HostAllocator* allocator_;
+
+  // The next chunk, which is only accessed by the thread that claimed it.
+  Chunk next_;
+  std::atomic<bool> next_claimed_{false};
+  mutex mu_;
+  condition_variable cv_;
+  bool next_done_ TFRT_GUARDED_BY(mu_) = false;
+};
+
+BufferedInputStream::BufferedInputStream(
+    std::unique_ptr<InputStream> input_stream, size_t buffer_size,
+    size_t max_buffer_size, HostAllocator* allocator, HostContext* host)
+    : read_ahead_(std::make_shared<ReadAhead>(std::move(input_stream),
+                                              buffer_size, allocator)),
+      host_(host),
+      buffer_size_(buffer_size),
+      max_buffer_size_(std::max(buffer_size, max_buffer_size)) {
+  assert(buffer_size_ > 0);
+}
+
+BufferedInputStream::~BufferedInputStream() {
+  // A pending task keeps the input stream alive, but must not read from it.
+  read_ahead_->Cancel();
+  read_ahead_->Resize(&current_, 0);
+}
+
+llvm::Expected<size_t> BufferedInputStream::Read(char* buf, size_t max_count) {
   size_t actual_count = 0;
   while (actual_count < max_count) {
-    if (buffer_pos_ == *buffer_limit_) {
-      buffer_limit_ = input_stream_->Read(buffer_, buffer_size_);
-      buffer_pos_ = 0;
-      if (!buffer_limit_) {
-        auto error = buffer_limit_.takeError();
-        buffer_limit_ = 0;
+    if (current_pos_ == current_.size) {
+      // The stream can be read again after an error.
+      if (!current_.error.empty()) {
+        auto error = MakeStringError(current_.error);
+        current_.error.clear();
         return std::move(error);
       }
-      if (*buffer_limit_ == 0) break;
+      if (current_.eof) break;
+      AdvanceChunk();
+      continue;
     }
-    size_t read_cnt =
-        std::min(*buffer_limit_ - buffer_pos_, max_count - actual_count);
-    std::memcpy(buf + actual_count, buffer_ + buffer_pos_, read_cnt);
-    buffer_pos_ += read_cnt;
-    actual_count += read_cnt;
+    size_t read_count =
+        std::min(current_.size - current_pos_, max_count - actual_count);
+    std::memcpy(buf + actual_count, current_.data + current_pos_, read_count);
+    current_pos_ += read_count;
+    actual_count += read_count;
   }
   stream_pos_ += actual_count;
   return actual_count;
@@ -52,5 +156,25 @@ llvm::Expected<size_t> BufferedInputStream::Read(char* buf, size_t max_count) {
 
 llvm::Expected<size_t> BufferedInputStream::Tell() { return stream_pos_; }
 
+void BufferedInputStream::AdvanceChunk() {
+  const bool waited = read_ahead_->TakeNextChunk(&current_);
+  current_pos_ = 0;
+  if (current_.eof) return;
+
+  // The chunk read ahead was not ready, so read larger chunks.
+  if (next_scheduled_ && waited) {
+    buffer_size_ = std::min(2 * buffer_size_, max_buffer_size_);
+  }
+  read_ahead_->ReleaseNextChunk(buffer_size_);
+  next_scheduled_ = false;
+  // After an error, the next chunk is only read once it is needed.
+  if (!host_ || !current_.error.empty()) return;
+  // If the work queue is full, the next chunk is read by the reading thread.
+  next_scheduled_ =
+      EnqueueBlockingWork(host_, [read_ahead = read_ahead_]() {
+        read_ahead->MaybeReadNextChunk();
+      });
+}
+
 }  // namespace io
 }  // namespace tfrt
@@ -0,0 +1,399 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// This file implements EmulatedRemoteFileSystem. Requests to the emulated
+// store run on a pool of threads, which sleep for the latency and transfer
+// time of each request, and the blocks they read are kept in an LRU cache.
+
+#include "tfrt/io/emulated_remote_file_system.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <list>
+#include <map>
+#include <thread>
+#include <utility>
+
+#include "llvm/ADT/FunctionExtras.h"
+#include "tfrt/support/string_util.h"
+#include "tfrt/support/thread_environment.h"
+
+namespace tfrt {
+namespace io {
+
+namespace {
+
+// A block of an object, which is shorter than the block size if the object
+// ends in it.
+using Block = std::shared_ptr<const std::string>;
+
+// A pool of threads that run the requests to the store.
+class RequestPool {
+ public:
+  explicit RequestPool(int num_threads) {
+    for (int i = 0; i < num_threads; ++i) {
+      threads_.push_back(ThreadingEnvironment::StartThread(
+          "tfrt-emulated-remote", [this] { Run(); }));
+    }
+  }
+
+  ~RequestPool() {
+    {
+      mutex_lock lock(mu_);
+      stopped_ = true;
+    }
+    cv_.notify_all();
+    // Destroying the threads joins them.
+    threads_.clear();
+  }
+
+  // This class is not copyable or movable.
+  RequestPool(const RequestPool&) = delete;
+  RequestPool& operator=(const RequestPool&) = delete;
+
+  void Schedule(llvm::unique_function<void()> work) {
+    {
+      mutex_lock lock(mu_);
+      queue_.push_back(std::move(work));
+    }
+    cv_.notify_one();
+  }
+
+ private:
+  void Run() {
+    while (true) {
+      llvm::unique_function<void()> work;
+      {
+        mutex_lock lock(mu_);
+        cv_.wait(lock, [this]() TFRT_REQUIRES(mu_) {
+          return stopped_ || !queue_.empty();
+        });
+        if (queue_.empty()) return;
+        work = std::move(queue_.front());
+        queue_.pop_front();
+      }
+      work();
+    }
+  }
+
+  mutex mu_;
+  condition_variable cv_;
+  std::deque<llvm::unique_function<void()>> queue_ TFRT_GUARDED_BY(mu_);
+  bool stopped_ TFRT_GUARDED_BY(mu_) = false;
+  std::vector<std::unique_ptr<ThreadingEnvironment::Thread>> threads_;
+};
+
+// An LRU cache of the blocks of objects, which holds up to `capacity` bytes.
+class BlockCache {
+ public:
+  explicit BlockCache(size_t capacity) : capacity_(capacity) {}
+
+  // This class is not copyable or movable.
+  BlockCache(const BlockCache&) = delete;
+  BlockCache& operator=(const BlockCache&) = delete;
+
+  // Returns block `index` of the object at `path`, or null if it is not
+  // cached.
+  Block Lookup(const std::string& path, size_t index) {
+    mutex_lock lock(mu_);
+    auto it = index_.find({path, index});
+    if (it == index_.end()) return nullptr;
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return it->second->block;
+  }
+
+  void Insert(const std::string& path, size_t index, Block block) {
+    if (capacity_ == 0 || block->size() > capacity_) return;
+    mutex_lock lock(mu_);
+    Key key{path, index};
+    if (index_.count(key)) return;
+    size_ += block->size();
+    entries_.push_front({key, std::move(block)});
+    index_[std::move(key)] = entries_.begin();
+    while (size_ > capacity_) {
+      size_ -= entries_.back().block->size();
+      index_.erase(entries_.back().key);
+      entries_.pop_back();
+    }
+  }
+
+ private:
+  using Key = std::pair<std::string, size_t>;
+  struct Entry {
+    Key key;
+    Block block;
+  };
+
+  const size_t capacity_;
+  mutex mu_;
+  // The cached blocks, the most recently used first.
+  std::list<Entry> entries_ TFRT_GUARDED_BY(mu_);
+  std::map<Key, std::list<Entry>::iterator> index_ TFRT_GUARDED_BY(mu_);
+  size_t size_ TFRT_GUARDED_BY(mu_) = 0;
+};
+
+}  // namespace
+
+// The state of an EmulatedRemoteFileSystem, which is shared with its files.
+class EmulatedRemoteStore {
+ public:
+  explicit EmulatedRemoteStore(std::string scheme,
+                               EmulatedRemoteFileSystemOptions options)
+      : prefix_(StrCat(scheme, "://")),
+        options_(std::move(options)),
+        cache_(options_.cache_size),
+        pool_(options_.num_parallel_requests) {
+    assert(options_.block_size > 0);
+    assert(options_.num_parallel_requests > 0);
+  }
+
+  // This class is not copyable or movable.
+  EmulatedRemoteStore(const EmulatedRemoteStore&) = delete;
+  EmulatedRemoteStore& operator=(const EmulatedRemoteStore&) = delete;
+
+  // Returns the local path of the object at `path`, which must have the scheme
+  // of the store.
+  llvm::Expected<std::string> GetLocalPath(string_view path) const {
+    if (!path.startswith(prefix_)) {
+      return MakeStringError("path ", path, " does not start with ", prefix_);
+    }
+    return StrCat(options_.root, "/", path.drop_front(prefix_.size()));
+  }
+
+  // Returns the path of the object whose local path is `local_path`.
+  std::string GetRemotePath(string_view local_path) const {
+    return StrCat(prefix_, local_path.drop_front(options_.root.size() + 1));
+  }
+
+  // Waits for the response to a request that transfers `size` bytes.
+  void SendRequest(size_t size) {
+    ++num_requests_;
+    const int64_t num_in_flight = ++num_in_flight_;
+    int64_t max_in_flight = max_in_flight_;
+    while (num_in_flight > max_in_flight &&
+           !max_in_flight_.compare_exchange_weak(max_in_flight,
+                                                 num_in_flight)) {
+    }
+    auto delay = options_.latency;
+    if (options_.bandwidth > 0) {
+      delay += std::chrono::microseconds(size * 1000000 / options_.bandwidth);
+    }
+    std::this_thread::sleep_for(delay);
+    --num_in_flight_;
+  }
+
+  // Returns block `index` of the object at `path`, which is read from `file`
+  // if it is not cached.
+  llvm::Expected<Block> ReadBlock(const std::string& path,
+                                  const RandomAccessFile& file, size_t index) {
+    if (auto block = cache_.Lookup(path, index)) {
+      ++num_cache_hits_;
+      return block;
+    }
+    auto block = std::make_shared<std::string>(options_.block_size, '\0');
+    auto count = file.Read(&(*block)[0], block->size(),
+                           index * options_.block_size);
+    if (!count) return count.takeError();
+    block->resize(*count);
+    SendRequest(block->size());
+    cache_.Insert(path, index, block);
+    return Block(std::move(block));
+  }
+
+  // Returns whether block `index` of the object at `path` is cached.
+  bool IsCached(const std::string& path, size_t index) {
+    return cache_.Lookup(path, index) != nullptr;
+  }
+
+  size_t block_size() const { return options_.block_size; }
+  RequestPool& pool() { return pool_; }
+  int64_t num_requests() const { return num_requests_; }
+  int64_t num_cache_hits() const { return num_cache_hits_; }
+  int64_t max_in_flight() const { return max_in_flight_; }
+
+ private:
+  const std::string prefix_;
+  const EmulatedRemoteFileSystemOptions options_;
+  std::atomic<int64_t> num_requests_{0};
+  std::atomic<int64_t> num_cache_hits_{0};
+  std::atomic<int64_t> num_in_flight_{0};
+  std::atomic<int64_t> max_in_flight_{0};
+  BlockCache cache_;
+  // Destroyed first, so that no request runs while the members above are
+  // destroyed.
+  RequestPool pool_;
+};
+
+namespace {
+
+// This class is used to read an object of an EmulatedRemoteFileSystem, whose
+// contents are read from a local file.
+class EmulatedRemoteFile : public RandomAccessFile {
+ public:
+  explicit EmulatedRemoteFile(std::string path,
+                              std::unique_ptr<RandomAccessFile> local_file,
+                              std::shared_ptr<EmulatedRemoteStore> store)
+      : path_(std::move(path)),
+        local_file_(std::move(local_file)),
+        store_(std::move(store)) {}
+
+  // This class is not copyable or movable.
+  EmulatedRemoteFile(const EmulatedRemoteFile&) = delete;
+  EmulatedRemoteFile& operator=(const EmulatedRemoteFile&) = delete;
+
+  llvm::Expected<size_t> Read(char* buf, size_t max_count,
+                              size_t offset) const override;
+
+ private:
+  const std::string path_;
+  std::unique_ptr<RandomAccessFile> local_file_;
+  std::shared_ptr<EmulatedRemoteStore> store_;
+};
+
+llvm::Expected<size_t> EmulatedRemoteFile::Read(char* buf, size_t max_count,
+                                                size_t offset) const {
+  if (max_count == 0) return 0;
+  const size_t block_size = store_->block_size();
+  const size_t first_index = offset / block_size;
+  const size_t num_blocks =
+      (offset + max_count - 1) / block_size - first_index + 1;
+
+  // Read the blocks in parallel. A block that is cached, or the only block
+  // that is not, is read on this thread. The error of a block is stored as a
+  // string, so that the results of the blocks after the end of the object do
+  // not need to be checked.
+  struct BlockResult {
+    Block block;
+    std::string error;
+  };
+  std::vector<BlockResult> blocks(num_blocks);
+  auto read_block = [&](size_t i) {
+    auto block = store_->ReadBlock(path_, *local_file_, first_index + i);
+    if (block) {
+      blocks[i].block = std::move(*block);
+    } else {
+      blocks[i].error = StrCat(block.takeError());
+    }
+  };
+  std::vector<size_t> uncached;
+  for (size_t i = 0; i < num_blocks; ++i) {
+    if (!store_->IsCached(path_, first_index + i)) uncached.push_back(i);
+  }
+  mutex mu;
+  condition_variable cv;
+  size_t num_pending = 0;
+  if (uncached.size() > 1) {
+    num_pending = uncached.size();
+    for (size_t i : uncached) {
+      store_->pool().Schedule([&, i] {
+        read_block(i);
+        mutex_lock lock(mu);
+        if (--num_pending == 0) cv.notify_one();
+      });
+    }
+  }
+  for (size_t i = 0; i < num_blocks; ++i) {
+    if (uncached.size() > 1 &&
+        std::binary_search(uncached.begin(), uncached.end(), i)) {
+      continue;
+    }
+    read_block(i);
+  }
+  {
+    mutex_lock lock(mu);
+    cv.wait(lock, [&] { return num_pending == 0; });
+  }
+
+  // Copy the blocks up to the end of the object, which ends in the first
+  // block that is shorter than the block size.
+  size_t count = 0;
+  for (size_t i = 0; i < num_blocks; ++i) {
+    const auto& result = blocks[i];
+    if (!result.error.empty()) return MakeStringError(result.error);
+    const size_t block_offset = i == 0 ? offset % block_size : 0;
+    if (result.block->size() > block_offset) {
+      const size_t n =
+          std::min(result.block->size() - block_offset, max_count - count);
+      std::memcpy(buf + count, result.block->data() + block_offset, n);
+      count += n;
+    }
+    if (result.block->size() < block_size) break;
+  }
+  return count;
+}
+
+}  // namespace
+
+EmulatedRemoteFileSystem::EmulatedRemoteFileSystem(
+    std::string scheme, EmulatedRemoteFileSystemOptions options)
+    : store_(std::make_shared<EmulatedRemoteStore>(std::move(scheme),
+                                                   std::move(options))) {}
+
+EmulatedRemoteFileSystem::~EmulatedRemoteFileSystem() {}
+
+llvm::Error EmulatedRemoteFileSystem::NewRandomAccessFile(
+    const std::string& path, std::unique_ptr<RandomAccessFile>* file) {
+  file->reset();
+  auto local_path = store_->GetLocalPath(path);
+  if (!local_path) return local_path.takeError();
+  auto* local_file_system = FileSystemRegistry::Default()->Lookup("");
+  if (!local_file_system) {
+    return MakeStringError("no file system is registered for local files");
+  }
+  std::unique_ptr<RandomAccessFile> local_file;
+  if (auto error =
+          local_file_system->NewRandomAccessFile(*local_path, &local_file)) {
+    return error;
+  }
+  *file = std::make_unique<EmulatedRemoteFile>(path, std::move(local_file),
+                                               store_);
+  return llvm::Error::success();
+}
+
+llvm::Error EmulatedRemoteFileSystem::GetMatchingPaths(
+    const std::string& pattern, std::vector<std::string>* paths) {
+  paths->clear();
+  auto local_pattern = store_->GetLocalPath(pattern);
+  if (!local_pattern) return local_pattern.takeError();
+  auto* local_file_system = FileSystemRegistry::Default()->Lookup("");
+  if (!local_file_system) {
+    return MakeStringError("no file system is registered for local files");
+  }
+  store_->SendRequest(0);
+  if (auto error =
+          local_file_system->GetMatchingPaths(*local_pattern, paths)) {
+    return error;
+  }
+  for (auto& path : *paths) path = store_->GetRemotePath(path);
+  return llvm::Error::success();
+}
+
+int64_t EmulatedRemoteFileSystem::num_requests() const {
+  return store_->num_requests();
+}
+
+int64_t EmulatedRemoteFileSystem::num_cache_hits() const {
+  return store_->num_cache_hits();
+}
+
+int64_t EmulatedRemoteFileSystem::max_requests_in_flight() const {
+  return store_->max_in_flight();
+}
+
+}  // namespace io
+}  // namespace tfrt
@@ -14,13 +14,47 @@
  * limitations under the License.
  */
 
-// This file implements the FileSystemRegistry class.
+// This file implements the FileSystemRegistry class, the default asynchronous
+// read of RandomAccessFile and the parsing of path schemes.
 
 #include "tfrt/io/file_system.h"
 
+#include "llvm/ADT/StringExtras.h"
+#include "tfrt/host_context/async_dispatch.h"
+
 namespace tfrt {
 namespace io {
 
+string_view GetScheme(string_view path) {
+  // A scheme starts with a letter, followed by letters, digits, '+', '-' or
+  // '.' (RFC 3986), and is separated from the rest of the path by "://".
+  const size_t end = path.find("://");
+  if (end == string_view::npos || end == 0) return {};
+  string_view scheme = path.take_front(end);
+  if (!llvm::isAlpha(scheme.front())) return {};
+  for (char c : scheme) {
+    if (!llvm::isAlnum(c) && c != '+' && c != '-' && c != '.') return {};
+  }
+  return scheme;
+}
+
+AsyncValueRef<size_t> RandomAccessFile::ReadAsync(char* buf, size_t max_count,
+                                                  size_t offset,
+                                                  HostContext* host) const {
+  auto result = MakeUnconstructedAsyncValueRef<size_t>(host);
+  bool enqueued = EnqueueBlockingWork(
+      host, [this, buf, max_count, offset, result = result.CopyRef()] {
+        auto count = Read(buf, max_count, offset);
+        if (count) {
+          result.emplace(*count);
+        } else {
+          result.SetError(count.takeError());
+        }
+      });
+  if (!enqueued) result.SetError("failed to enqueue blocking work to read");
+  return result;
+}
+
 void FileSystemRegistry::Register(const std::string& scheme,
                                   std::unique_ptr<FileSystem> file_system) {
   assert(file_system);
@@ -0,0 +1,436 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// This file implements the IoUringFileSystem class. The ring is set up with
+// raw system calls, so that no dependency on liburing is needed.
+
+#include "io_uring_file_system.h"
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define TFRT_HAS_IO_URING 1
+#else
+#define TFRT_HAS_IO_URING 0
+#endif
+
+#if TFRT_HAS_IO_URING
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <thread>
+#endif
+
+#include "llvm_derived/Support/raw_ostream.h"
+#include "posix_file_system.h"
+#include "tfrt/host_context/async_dispatch.h"
+#include "tfrt/support/mutex.h"
+#include "tfrt/support/thread_annotations.h"
+
+namespace tfrt {
+namespace io {
+
+#if TFRT_HAS_IO_URING
+
+namespace {
+
+// Number of submission queue entries. The kernel sizes the completion queue
+// to twice that.
+constexpr unsigned kRingEntries = 256;
+
+// The user data of the entry which stops the completion thread.
+constexpr uint64_t kShutdownUserData = 0;
+
+int IoUringSetup(unsigned entries, io_uring_params* params) {
+  return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int IoUringEnter(int ring_fd, unsigned to_submit, unsigned min_complete,
+                 unsigned flags) {
+  return static_cast<int>(syscall(__NR_io_uring_enter, ring_fd, to_submit,
+                                  min_complete, flags, nullptr, 0));
+}
+
+template <typename T>
+T* RingPointer(void* ring, uint32_t offset) {
+  return reinterpret_cast<T*>(static_cast<char*>(ring) + offset);
+}
+
+}  // namespace
+
+// A read submitted to the ring. After a short read, it is submitted again for
+// the remaining bytes until `max_count` bytes are read or the file ends.
+struct IoUringRead {
+  const PosixRandomAccessFile* file;
+  char* buf;
+  size_t max_count;
+  size_t offset;
+  size_t actual_count;
+  iovec iov;
+  HostContext* host;
+  AsyncValueRef<size_t> result;
+};
+
+// A submission and completion queue pair shared with the kernel. Reads are
+// submitted by the caller's thread, and their results are set by a dedicated
+// completion thread.
+class IoUring {
+ public:
+  // Returns null if the kernel does not support io_uring.
+  static std::shared_ptr<IoUring> Create(unsigned entries);
+
+  ~IoUring();
+
+  // This class is not copyable or movable.
+  IoUring(const IoUring&) = delete;
+  IoUring& operator=(const IoUring&) = delete;
+
+  // Submits the remaining part of `read`, and takes ownership of it on
+  // success. Returns false if the ring is full or broken.
+  bool Submit(IoUringRead* read) TFRT_EXCLUDES(mu_);
+
+ private:
+  explicit IoUring(int ring_fd) : ring_fd_(ring_fd) {}
+
+  // Maps the queues into memory. Returns false on failure.
+  bool Map(const io_uring_params& params);
+
+  // Adds `entry` to the submission queue and submits it to the kernel.
+  bool SubmitEntry(const io_uring_sqe& entry) TFRT_REQUIRES(mu_);
+
+  // Body of the completion thread.
+  void ReapCompletions() TFRT_EXCLUDES(mu_);
+
+  // Handles the completion of `read` with result `res`, which is the number
+  // of bytes read or a negated errno.
+  void Complete(IoUringRead* read, int res);
+
+  const int ring_fd_;
+
+  void* sq_ring_ = nullptr;
+  size_t sq_ring_size_ = 0;
+  void* cq_ring_ = nullptr;
+  size_t cq_ring_size_ = 0;
+  io_uring_sqe* sqes_ = nullptr;
+  size_t sqes_size_ = 0;
+
+  // Pointers into the queues. The kernel advances sq_head_ and cq_tail_.
+  unsigned* sq_head_ = nullptr;
+  unsigned* sq_tail_ = nullptr;
+  unsigned* sq_mask_ = nullptr;
+  unsigned* sq_array_ = nullptr;
+  unsigned* cq_head_ = nullptr;
+  unsigned* cq_tail_ = nullptr;
+  unsigned* cq_mask_ = nullptr;
+  io_uring_cqe* cqes_ = nullptr;
+  unsigned cq_entries_ = 0;
+
+  // Set when the completion thread stopped because of an error.
+  std::atomic<bool> broken_{false};
+
+  mutex mu_;
+  // The number of reads submitted and not completed yet. It is kept below the
+  // size of the completion queue, so that completions are never dropped.
+  unsigned num_in_flight_ TFRT_GUARDED_BY(mu_) = 0;
+
+  // TODO(tfrt-devs): use alternative to std::thread in google-internal build.
+  std::thread completion_thread_;
+};
+
+std::shared_ptr<IoUring> IoUring::Create(unsigned entries) {
+  io_uring_params params;
+  std::memset(&params, 0, sizeof(params));
+  int ring_fd = IoUringSetup(entries, &params);
+  if (ring_fd < 0) return nullptr;
+
+  std::shared_ptr<IoUring> ring(new IoUring(ring_fd));
+  if (!ring->Map(params)) return nullptr;
+  ring->completion_thread_ =
+      std::thread([ring = ring.get()] { ring->ReapCompletions(); });
+  return ring;
+}
+
+IoUring::~IoUring() {
+  if (completion_thread_.joinable()) {
+    io_uring_sqe entry;
+    std::memset(&entry, 0, sizeof(entry));
+    entry.opcode = IORING_OP_NOP;
+    entry.user_data = kShutdownUserData;
+    bool submitted;
+    {
+      mutex_lock lock(mu_);
+      submitted = SubmitEntry(entry);
+    }
+    if (submitted || broken_.load()) {
+      completion_thread_.join();
+    } else {
+      tfrt::errs() << "failed to stop the io_uring completion thread\n";
+      completion_thread_.detach();
+      return;
+    }
+  }
+  if (sqes_) munmap(sqes_, sqes_size_);
+  if (cq_ring_ && cq_ring_ != sq_ring_) munmap(cq_ring_, cq_ring_size_);
+  if (sq_ring_) munmap(sq_ring_, sq_ring_size_);
+  close(ring_fd_);
+}
+
+bool IoUring::Map(const io_uring_params& params) {
+  sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (single_mmap) {
+    sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+  }
+
+  void* sq_ring = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+  if (sq_ring == MAP_FAILED) return false;
+  sq_ring_ = sq_ring;
+
+  if (single_mmap) {
+    cq_ring_ = sq_ring_;
+  } else {
+    void* cq_ring =
+        mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+    if (cq_ring == MAP_FAILED) return false;
+    cq_ring_ = cq_ring;
+  }
+
+  sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+  void* sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) return false;
+  sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+  sq_head_ = RingPointer<unsigned>(sq_ring_, params.sq_off.head);
+  sq_tail_ = RingPointer<unsigned>(sq_ring_, params.sq_off.tail);
+  sq_mask_ = RingPointer<unsigned>(sq_ring_, params.sq_off.ring_mask);
+  sq_array_ = RingPointer<unsigned>(sq_ring_, params.sq_off.array);
+  cq_head_ = RingPointer<unsigned>(cq_ring_, params.cq_off.head);
+  cq_tail_ = RingPointer<unsigned>(cq_ring_, params.cq_off.tail);
+  cq_mask_ = RingPointer<unsigned>(cq_ring_, params.cq_off.ring_mask);
+  cqes_ = RingPointer<io_uring_cqe>(cq_ring_, params.cq_off.cqes);
+  cq_entries_ = params.cq_entries;
+  return true;
+}
+
+bool IoUring::Submit(IoUringRead* read) {
+  if (broken_.load(std::memory_order_relaxed)) return false;
+
+  size_t remaining = read->max_count - read->actual_count;
+  read->iov.iov_base = read->buf + read->actual_count;
+  // The result of a read is a 32-bit integer.
+  read->iov.iov_len =
+      std::min<size_t>(remaining, std::numeric_limits<int32_t>::max());
+
+  io_uring_sqe entry;
+  std::memset(&entry, 0, sizeof(entry));
+  // IORING_OP_READV is supported by all kernels with io_uring (5.1+).
+  entry.opcode = IORING_OP_READV;
+  entry.fd = read->file->fd();
+  entry.addr = reinterpret_cast<uint64_t>(&read->iov);
+  entry.len = 1;
+  entry.off = read->offset + read->actual_count;
+  entry.user_data = reinterpret_cast<uint64_t>(read);
+
+  mutex_lock lock(mu_);
+  // Leave room for the shutdown entry.
+  if (num_in_flight_ + 1 >= cq_entries_) return false;
+  if (!SubmitEntry(entry)) return false;
+  ++num_in_flight_;
+  return true;
+}
+
+bool IoUring::SubmitEntry(const io_uring_sqe& entry) {
+  // Only this thread (holding mu_) writes the tail. The kernel only consumes
+  // entries in io_uring_enter() calls with to_submit > 0, which are all made
+  // while holding mu_.
+  unsigned tail = *sq_tail_;
+  unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+  if (tail - head > *sq_mask_) return false;
+  unsigned index = tail & *sq_mask_;
+  sqes_[index] = entry;
+  sq_array_[index] = index;
+  __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+
+  while (IoUringEnter(ring_fd_, 1, 0, 0) < 0) {
+    if (errno == EINTR) continue;
+    // Take the entry back if the kernel did not consume it.
+    if (__atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) == tail) {
+      __atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+      return false;
+    }
+    break;
+  }
+  return true;
+}
+
+void IoUring::ReapCompletions() {
+  while (true) {
+    if (IoUringEnter(ring_fd_, 0, 1, IORING_ENTER_GETEVENTS) < 0 &&
+        errno != EINTR) {
+      tfrt::errs() << "failed to wait for io_uring completions due to error: "
+                   << strerror(errno) << "\n";
+      broken_.store(true);
+      return;
+    }
+    unsigned head = *cq_head_;
+    unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head) {
+      const io_uring_cqe& cqe = cqes_[head & *cq_mask_];
+      uint64_t user_data = cqe.user_data;
+      int res = cqe.res;
+      __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+      // Files keep the ring alive, so no read is in flight at shutdown.
+      if (user_data == kShutdownUserData) return;
+      {
+        mutex_lock lock(mu_);
+        --num_in_flight_;
+      }
+      Complete(reinterpret_cast<IoUringRead*>(user_data), res);
+    }
+  }
+}
+
+void IoUring::Complete(IoUringRead* read, int res) {
+  std::unique_ptr<IoUringRead> owned(read);
+  bool retry = res == -EINTR || res == -EAGAIN;
+  if (res < 0 && !retry) {
+    read->result.SetError(StrCat("failed to read file ", read->file->path(),
+                                 " due to error: ", strerror(-res)));
+    return;
+  }
+  if (res > 0) read->actual_count += res;
+
+  if (retry || (res > 0 && read->actual_count < read->max_count)) {
+    if (Submit(read)) {
+      owned.release();
+      return;
+    }
+    // The ring is full. Read the remaining bytes with pread() on a blocking
+    // work queue thread, so that the completion thread keeps reaping.
+    auto result = read->result.CopyRef();
+    bool enqueued =
+        EnqueueBlockingWork(read->host, [read = std::move(owned)] {
+          auto count = read->file->Read(read->buf + read->actual_count,
+                                        read->max_count - read->actual_count,
+                                        read->offset + read->actual_count);
+          if (!count) {
+            read->result.SetError(count.takeError());
+            return;
+          }
+          read->result.emplace(read->actual_count + *count);
+        });
+    if (!enqueued) result.SetError("failed to enqueue blocking work to read");
+    return;
+  }
+  read->result.emplace(read->actual_count);
+}
+
+namespace {
+
+// This class is used to read data from a random access file with pread(), or
+// asynchronously with io_uring.
+class IoUringRandomAccessFile : public PosixRandomAccessFile {
+ public:
+  explicit IoUringRandomAccessFile(int fd, const std::string& path,
+                                   std::shared_ptr<IoUring> ring)
+      : PosixRandomAccessFile(fd, path), ring_(std::move(ring)) {}
+
+  // The result is set on the completion thread of the ring, so continuations
+  // of the returned value should be short or enqueue work.
+  AsyncValueRef<size_t> ReadAsync(char* buf, size_t max_count, size_t offset,
+                                  HostContext* host) const override;
+
+ private:
+  std::shared_ptr<IoUring> ring_;
+};
+
+AsyncValueRef<size_t> IoUringRandomAccessFile::ReadAsync(
+    char* buf, size_t max_count, size_t offset, HostContext* host) const {
+  if (max_count == 0)
+    return MakeAvailableAsyncValueRef<size_t>(host, size_t{0});
+
+  auto result = MakeUnconstructedAsyncValueRef<size_t>(host);
+  auto read = std::make_unique<IoUringRead>();
+  read->file = this;
+  read->buf = buf;
+  read->max_count = max_count;
+  read->offset = offset;
+  read->actual_count = 0;
+  read->host = host;
+  read->result = result.CopyRef();
+  if (!ring_->Submit(read.get())) {
+    // Fall back to pread() on a blocking work queue thread.
+    return PosixRandomAccessFile::ReadAsync(buf, max_count, offset, host);
+  }
+  read.release();
+  return result;
+}
+
+}  // namespace
+
+std::unique_ptr<IoUringFileSystem> IoUringFileSystem::Create() {
+  auto ring = IoUring::Create(kRingEntries);
+  if (!ring) return nullptr;
+  return std::make_unique<IoUringFileSystem>(std::move(ring));
+}
+
+llvm::Error IoUringFileSystem::NewRandomAccessFile(
+    const std::string& path, std::unique_ptr<RandomAccessFile>* file) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    file->reset();
+    return MakeStringError("failed to open file ", path,
+                           " due to error: ", strerror(errno));
+  }
+  *file = std::make_unique<IoUringRandomAccessFile>(fd, path, ring_);
+  return llvm::Error::success();
+}
+
+#else  // TFRT_HAS_IO_URING
+
+class IoUring {};
+
+std::unique_ptr<IoUringFileSystem> IoUringFileSystem::Create() {
+  return nullptr;
+}
+
+llvm::Error IoUringFileSystem::NewRandomAccessFile(
+    const std::string& path, std::unique_ptr<RandomAccessFile>* file) {
+  file->reset();
+  return MakeStringError("io_uring is not supported on this platform");
+}
+
+#endif  // TFRT_HAS_IO_URING
+
+void RegisterIoUringFileSystem(FileSystemRegistry* registry) {
+  if (auto file_system = IoUringFileSystem::Create())
+    registry->Register("", std::move(file_system));
+}
+
+}  // namespace io
+}  // namespace tfrt
@@ -0,0 +1,66 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// This file declares the IoUringFileSystem class.
+
+#ifndef TFRT_LIB_IO_IO_URING_FILE_SYSTEM_H_
+#define TFRT_LIB_IO_IO_URING_FILE_SYSTEM_H_
+
+#include <memory>
+
+#include "posix_file_system.h"
+#include "tfrt/io/file_system.h"
+
+namespace tfrt {
+namespace io {
+
+class IoUring;
+
+// This class is used to manage files in a POSIX file system, which are read
+// asynchronously with Linux io_uring. All files share one ring, whose
+// completions are reaped by a dedicated thread, so that concurrent reads do
+// not occupy a blocking work queue thread each. Synchronous reads use pread().
+class IoUringFileSystem : public PosixFileSystem {
+ public:
+  // Returns null if io_uring is not supported by the platform or the kernel.
+  static std::unique_ptr<IoUringFileSystem> Create();
+
+  explicit IoUringFileSystem(std::shared_ptr<IoUring> ring)
+      : ring_(std::move(ring)) {}
+
+  // This class is not copyable or movable.
+  IoUringFileSystem(const IoUringFileSystem&) = delete;
+  IoUringFileSystem& operator=(const IoUringFileSystem&) = delete;
+
+  llvm::Error NewRandomAccessFile(
+      const std::string& path,
+      std::unique_ptr<RandomAccessFile>* file) override;
+
+  FileSystemPriority GetPriority() override {
+    return FileSystemPriority::kHigh;
+  }
+
+ private:
+  std::shared_ptr<IoUring> ring_;
+};
+
+// Registers IoUringFileSystem for the default scheme if io_uring is available.
+void RegisterIoUringFileSystem(FileSystemRegistry* registry);
+
+}  // namespace io
+}  // namespace tfrt
+
+#endif  // TFRT_LIB_IO_IO_URING_FILE_SYSTEM_H_
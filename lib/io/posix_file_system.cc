@@ -20,36 +20,149 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <glob.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <cstring>
 #include <limits>
 
+#include "io_uring_file_system.h"
+#include "llvm/Support/MathExtras.h"
 #include "llvm_derived/Support/raw_ostream.h"
+#include "tfrt/host_context/host_allocator.h"
 
 namespace tfrt {
 namespace io {
 namespace {
 
-// This class is used to read data from a random access file.
-class PosixRandomAccessFile : public RandomAccessFile {
+// This class is used to read data from a file mapped into memory.
+class MappedRandomAccessFile : public RandomAccessFile {
  public:
-  explicit PosixRandomAccessFile(int fd, const std::string& path)
-      : fd_(fd), path_(path) {}
+  explicit MappedRandomAccessFile(RCReference<HostBuffer> mapping)
+      : mapping_(std::move(mapping)) {}
 
-  ~PosixRandomAccessFile() override;
+  // This class is not copyable or movable.
+  MappedRandomAccessFile(const MappedRandomAccessFile&) = delete;
+  MappedRandomAccessFile& operator=(const MappedRandomAccessFile&) = delete;
+
+  llvm::Expected<size_t> Read(char* buf, size_t max_count,
+                              size_t offset) const override {
+    auto view = ReadView(offset, max_count);
+    if (view->size() > 0) std::memcpy(buf, view->data(), view->size());
+    return view->size();
+  }
+
+  RCReference<HostBuffer> ReadView(size_t offset,
+                                   size_t max_count) const override {
+    offset = std::min(offset, mapping_->size());
+    return HostBuffer::CreateFromExternal(
+        mapping_.CopyRef(), offset,
+        std::min(max_count, mapping_->size() - offset));
+  }
+
+ private:
+  // Owns the mapping, which is unmapped once all views are destroyed.
+  RCReference<HostBuffer> mapping_;
+};
+
+// This class is used to read data from a file opened for direct IO.
+class DirectRandomAccessFile : public PosixRandomAccessFile {
+ public:
+  explicit DirectRandomAccessFile(int fd, const std::string& path,
+                                  HostAllocator* allocator)
+      : PosixRandomAccessFile(fd, path), allocator_(allocator) {}
 
   // This class is not copyable or movable.
-  PosixRandomAccessFile(const PosixRandomAccessFile&) = delete;
-  PosixRandomAccessFile operator=(const PosixRandomAccessFile&) = delete;
+  DirectRandomAccessFile(const DirectRandomAccessFile&) = delete;
+  DirectRandomAccessFile& operator=(const DirectRandomAccessFile&) = delete;
 
   llvm::Expected<size_t> Read(char* buf, size_t max_count,
                               size_t offset) const override;
 
  private:
-  int fd_;
-  const std::string path_;
+  // Reads with pread(), whose buffer, offset and size must be aligned.
+  llvm::Expected<size_t> ReadAligned(char* buf, size_t max_count,
+                                     size_t offset) const;
+
+  HostAllocator* allocator_;
 };
 
+bool IsDirectIOAligned(size_t value) {
+  return value % kDirectIOAlignment == 0;
+}
+
+llvm::Expected<size_t> DirectRandomAccessFile::Read(char* buf,
+                                                    size_t max_count,
+                                                    size_t offset) const {
+  if (IsDirectIOAligned(reinterpret_cast<uintptr_t>(buf)) &&
+      IsDirectIOAligned(offset) && IsDirectIOAligned(max_count)) {
+    return ReadAligned(buf, max_count, offset);
+  }
+
+  // Read the aligned range that contains the requested bytes into a staging
+  // buffer, in parts of at most kMaxStagingSize bytes.
+  constexpr size_t kMaxStagingSize = 1 << 22;
+  const size_t begin = offset - offset % kDirectIOAlignment;
+  const size_t end = llvm::alignTo(offset + max_count, kDirectIOAlignment);
+  const size_t staging_size = std::min(end - begin, kMaxStagingSize);
+  auto* staging = static_cast<char*>(
+      allocator_->AllocateBytes(staging_size, kDirectIOAlignment));
+  if (!staging) {
+    return MakeStringError("failed to allocate ", staging_size, " bytes");
+  }
+
+  size_t actual_count = 0;
+  llvm::Error error = llvm::Error::success();
+  for (size_t pos = begin; pos < end && actual_count < max_count;
+       pos += staging_size) {
+    auto count_or_error =
+        ReadAligned(staging, std::min(staging_size, end - pos), pos);
+    if (!count_or_error) {
+      error = count_or_error.takeError();
+      break;
+    }
+    // Copy the requested bytes of this part.
+    const size_t copy_begin = std::max(pos, offset + actual_count);
+    const size_t copy_end = std::min(pos + *count_or_error, offset + max_count);
+    if (copy_end <= copy_begin) break;
+    std::memcpy(buf + actual_count, staging + (copy_begin - pos),
+                copy_end - copy_begin);
+    actual_count += copy_end - copy_begin;
+    // The file ends in this part.
+    if (*count_or_error < std::min(staging_size, end - pos)) break;
+  }
+  allocator_->DeallocateBytes(staging, staging_size);
+  if (error) return std::move(error);
+  return actual_count;
+}
+
+llvm::Expected<size_t> DirectRandomAccessFile::ReadAligned(
+    char* buf, size_t max_count, size_t offset) const {
+  // The size of each pread() must be aligned, and fit in a 32-bit integer.
+  constexpr size_t kMaxRequestCount = 1 << 30;
+  size_t actual_count = 0;
+  while (actual_count < max_count) {
+    size_t request_count = std::min(max_count - actual_count, kMaxRequestCount);
+    ssize_t read_count = pread(fd(), buf + actual_count, request_count,
+                               offset + actual_count);
+    if (read_count < 0) {
+      if (errno == EINTR || errno == EAGAIN) continue;
+      return MakeStringError("failed to read file ", path(),
+                             " due to error: ", strerror(errno));
+    }
+    actual_count += read_count;
+    // A read of less than the requested count ends at the end of file. The
+    // next read would not be aligned.
+    if (static_cast<size_t>(read_count) < request_count) break;
+  }
+  return actual_count;
+}
+
+}  // namespace
+
 PosixRandomAccessFile::~PosixRandomAccessFile() {
   if (fd_ < 0) return;
   if (close(fd_) < 0) {
@@ -81,7 +194,15 @@ llvm::Expected<size_t> PosixRandomAccessFile::Read(char* buf, size_t max_count,
 
   return actual_count;
 }
-}  // namespace
+
+void PosixRandomAccessFile::HintSequentialAccess() const {
+  // posix_fadvise() is not available on all platforms, notably macs.
+#if defined(POSIX_FADV_SEQUENTIAL)
+  if (fd_ < 0) return;
+  // The advice only affects performance, so errors are ignored.
+  (void)posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+}
 
 llvm::Error PosixFileSystem::NewRandomAccessFile(
     const std::string& path, std::unique_ptr<RandomAccessFile>* file) {
@@ -95,10 +216,97 @@ llvm::Error PosixFileSystem::NewRandomAccessFile(
   return llvm::Error::success();
 }
 
+llvm::Error PosixFileSystem::NewMappedRandomAccessFile(
+    const std::string& path, std::unique_ptr<RandomAccessFile>* file) {
+  file->reset();
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return MakeStringError("failed to open file ", path,
+                           " due to error: ", strerror(errno));
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    auto error = MakeStringError("failed to stat file ", path,
+                                 " due to error: ", strerror(errno));
+    close(fd);
+    return error;
+  }
+  size_t size = st.st_size;
+  // Empty files can not be mapped.
+  void* data = nullptr;
+  if (size > 0) data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  // The mapping stays valid after the file is closed.
+  close(fd);
+  if (data == MAP_FAILED) {
+    return MakeStringError("failed to map file ", path,
+                           " due to error: ", strerror(errno));
+  }
+  auto mapping =
+      HostBuffer::CreateFromExternal(data, size, [](void* ptr, size_t size) {
+        if (size > 0) munmap(ptr, size);
+      });
+  *file = std::make_unique<MappedRandomAccessFile>(std::move(mapping));
+  return llvm::Error::success();
+}
+
+llvm::Error PosixFileSystem::NewDirectRandomAccessFile(
+    const std::string& path, HostAllocator* allocator,
+    std::unique_ptr<RandomAccessFile>* file) {
+#if defined(O_DIRECT)
+  int fd = open(path.c_str(), O_RDONLY | O_DIRECT);
+  // Some file systems, e.g. tmpfs, do not support direct IO.
+  if (fd < 0 && errno == EINVAL) return NewRandomAccessFile(path, file);
+  if (fd < 0) {
+    file->reset();
+    return MakeStringError("failed to open file ", path,
+                           " due to error: ", strerror(errno));
+  }
+  *file = std::make_unique<DirectRandomAccessFile>(fd, path, allocator);
+  return llvm::Error::success();
+#else
+  // Without O_DIRECT, e.g. on macs, reads are not required to be aligned.
+  auto error = NewRandomAccessFile(path, file);
+  if (error) return error;
+#if defined(F_NOCACHE)
+  auto* posix_file = static_cast<PosixRandomAccessFile*>(file->get());
+  (void)fcntl(posix_file->fd(), F_NOCACHE, 1);
+#endif
+  return llvm::Error::success();
+#endif
+}
+
+llvm::Error PosixFileSystem::GetMatchingPaths(
+    const std::string& pattern, std::vector<std::string>* paths) {
+  paths->clear();
+  glob_t matches;
+  // glob() sorts the matching paths.
+  int result = glob(pattern.c_str(), GLOB_ERR, nullptr, &matches);
+  if (result == GLOB_NOMATCH) {
+    globfree(&matches);
+    return llvm::Error::success();
+  }
+  if (result != 0) {
+    globfree(&matches);
+    return MakeStringError(
+        "failed to match pattern ", pattern, " due to error: ",
+        result == GLOB_NOSPACE ? "out of memory" : "read error");
+  }
+  paths->reserve(matches.gl_pathc);
+  for (size_t i = 0; i < matches.gl_pathc; ++i) {
+    paths->push_back(matches.gl_pathv[i]);
+  }
+  globfree(&matches);
+  return llvm::Error::success();
+}
+
 void RegisterFileSystem(FileSystemRegistry* registry) {
   auto file_system = std::make_unique<PosixFileSystem>();
   // The scheme is an empty string to be backward-compatible with TF.
   registry->Register("", std::move(file_system));
+  // Replaces the file system above if io_uring is available. Its files serve
+  // ReadAsync() without a blocking thread per read, and fall back to pread()
+  // on a blocking thread when the ring is full.
+  RegisterIoUringFileSystem(registry);
 }
 
 }  // namespace io
@@ -14,16 +14,46 @@
  * limitations under the License.
  */
 
-// This file declares the PosixFileSystem class.
+// This file declares the PosixFileSystem and PosixRandomAccessFile classes.
 
 #ifndef TFRT_LIB_IO_POSIX_FILE_SYSTEM_H_
 #define TFRT_LIB_IO_POSIX_FILE_SYSTEM_H_
 
+#include <string>
+#include <vector>
+
 #include "tfrt/io/file_system.h"
 
 namespace tfrt {
 namespace io {
 
+// This class is used to read data from a random access file with pread().
+class PosixRandomAccessFile : public RandomAccessFile {
+ public:
+  explicit PosixRandomAccessFile(int fd, const std::string& path)
+      : fd_(fd), path_(path) {}
+
+  ~PosixRandomAccessFile() override;
+
+  // This class is not copyable or movable.
+  PosixRandomAccessFile(const PosixRandomAccessFile&) = delete;
+  PosixRandomAccessFile operator=(const PosixRandomAccessFile&) = delete;
+
+  llvm::Expected<size_t> Read(char* buf, size_t max_count,
+                              size_t offset) const override;
+
+  // Advises the kernel with posix_fadvise(POSIX_FADV_SEQUENTIAL), which
+  // increases its read-ahead window for the file.
+  void HintSequentialAccess() const override;
+
+  int fd() const { return fd_; }
+  const std::string& path() const { return path_; }
+
+ private:
+  int fd_;
+  const std::string path_;
+};
+
 // This class is used to manage files in a POSIX file system.
 class PosixFileSystem : public FileSystem {
  public:
@@ -36,6 +66,19 @@ class PosixFileSystem : public FileSystem {
   llvm::Error NewRandomAccessFile(
       const std::string& path,
       std::unique_ptr<RandomAccessFile>* file) override;
+
+  llvm::Error NewMappedRandomAccessFile(
+      const std::string& path,
+      std::unique_ptr<RandomAccessFile>* file) override;
+
+  // Falls back to NewRandomAccessFile() if the file system of `path` does not
+  // support direct IO.
+  llvm::Error NewDirectRandomAccessFile(
+      const std::string& path, HostAllocator* allocator,
+      std::unique_ptr<RandomAccessFile>* file) override;
+
+  llvm::Error GetMatchingPaths(const std::string& pattern,
+                               std::vector<std::string>* paths) override;
 };
 
 }  // namespace io
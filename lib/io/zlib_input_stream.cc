@@ -0,0 +1,103 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// This file implements the ZlibInputStream class.
+
+#include "tfrt/io/zlib_input_stream.h"
+
+#include <cstring>
+#include <utility>
+
+#include "tfrt/support/string_util.h"
+#include "zlib.h"
+
+namespace tfrt {
+namespace io {
+
+llvm::Optional<ZlibFormat> ParseZlibFormat(string_view compression_type) {
+  if (compression_type == "ZLIB") return ZlibFormat::kZlib;
+  if (compression_type == "GZIP") return ZlibFormat::kGzip;
+  return llvm::None;
+}
+
+ZlibInputStream::ZlibInputStream(std::unique_ptr<InputStream> input_stream,
+                                 ZlibFormat format, size_t input_buffer_size)
+    : input_stream_(std::move(input_stream)),
+      input_buffer_(input_buffer_size),
+      stream_(std::make_unique<z_stream_s>()) {
+  assert(input_buffer_size > 0);
+  std::memset(stream_.get(), 0, sizeof(z_stream_s));
+  // Add 16 to the window bits to decode a gzip header and trailer.
+  int window_bits = format == ZlibFormat::kGzip ? MAX_WBITS + 16 : MAX_WBITS;
+  int result = inflateInit2(stream_.get(), window_bits);
+  if (result != Z_OK) {
+    error_ = StrCat("failed to initialize zlib: ", result);
+    stream_.reset();
+  }
+}
+
+ZlibInputStream::~ZlibInputStream() {
+  if (stream_) inflateEnd(stream_.get());
+}
+
+llvm::Expected<size_t> ZlibInputStream::Read(char* buf, size_t max_count) {
+  if (!error_.empty()) return MakeStringError(error_);
+
+  stream_->next_out = reinterpret_cast<Bytef*>(buf);
+  stream_->avail_out = max_count;
+  while (stream_->avail_out > 0) {
+    if (stream_->avail_in == 0 && !input_eof_) {
+      auto count_or_error =
+          input_stream_->Read(input_buffer_.data(), input_buffer_.size());
+      if (!count_or_error) {
+        error_ = StrCat(count_or_error.takeError());
+        break;
+      }
+      input_eof_ = *count_or_error < input_buffer_.size();
+      stream_->next_in = reinterpret_cast<Bytef*>(input_buffer_.data());
+      stream_->avail_in = *count_or_error;
+    }
+    if (stream_->avail_in == 0) {
+      if (in_member_) error_ = "unexpected end of compressed stream";
+      break;
+    }
+
+    in_member_ = true;
+    int result = inflate(stream_.get(), Z_NO_FLUSH);
+    if (result == Z_STREAM_END) {
+      // Continue with the next gzip member, if any.
+      in_member_ = false;
+      inflateReset(stream_.get());
+    } else if (result != Z_OK) {
+      error_ = stream_->msg
+                   ? StrCat("failed to decompress: ", stream_->msg)
+                   : StrCat("failed to decompress: zlib error ", result);
+      break;
+    }
+  }
+
+  // A short count means the end of the stream, so an error is returned right
+  // away, even if some bytes were decompressed.
+  if (!error_.empty()) return MakeStringError(error_);
+  const size_t count = max_count - stream_->avail_out;
+  stream_pos_ += count;
+  return count;
+}
+
+llvm::Expected<size_t> ZlibInputStream::Tell() { return stream_pos_; }
+
+}  // namespace io
+}  // namespace tfrt
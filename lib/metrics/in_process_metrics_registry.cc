@@ -0,0 +1,268 @@
+// Copyright 2022 The TensorFlow Runtime Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// This file implements the in-process metrics registry.
+
+#include "in_process_metrics_registry.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cctype>
+#include <cmath>
+#include <vector>
+
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace tfrt {
+namespace metrics {
+namespace {
+
+// Number of shards of counters and histograms.
+constexpr int kNumShards = 16;
+
+// Returns the shard updated by the calling thread. Threads are assigned shards
+// round robin when they first update a metric.
+int GetShardIndex() {
+  static std::atomic<int> next_index = {0};
+  thread_local int index =
+      next_index.fetch_add(1, std::memory_order_relaxed) % kNumShards;
+  return index;
+}
+
+// Prometheus metric names may only contain [a-zA-Z0-9_:]. TFRT metric names
+// are paths like "/tfrt/bef_executor/kernels", which are written as
+// "tfrt_bef_executor_kernels".
+std::string SanitizeName(string_view name) {
+  std::string result;
+  for (char c : name) {
+    bool valid = isalnum(static_cast<unsigned char>(c)) || c == '_' || c == ':';
+    if (!valid && (result.empty() || result.back() == '_')) continue;
+    result.push_back(valid ? c : '_');
+  }
+  if (!result.empty() && isdigit(static_cast<unsigned char>(result.front())))
+    result.insert(result.begin(), '_');
+  return result;
+}
+
+void WriteLabelValue(string_view value, raw_ostream& os) {
+  for (char c : value) {
+    if (c == '\\' || c == '"') {
+      os << '\\' << c;
+    } else if (c == '\n') {
+      os << "\\n";
+    } else {
+      os << c;
+    }
+  }
+}
+
+void WriteDouble(double value, raw_ostream& os) {
+  if (std::isinf(value)) {
+    os << (value > 0 ? "+Inf" : "-Inf");
+  } else {
+    os << llvm::format("%.17g", value);
+  }
+}
+
+class StringGauge : public Gauge<std::string>, public InProcessMetric {
+ public:
+  void Set(std::string value) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    value_ = std::move(value);
+  }
+
+  Kind kind() const override { return Kind::kStringGauge; }
+
+  void Write(string_view name, raw_ostream& os) const override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    os << "# TYPE " << name << " gauge\n" << name << "{value=\"";
+    WriteLabelValue(value_, os);
+    os << "\"} 1\n";
+  }
+
+ private:
+  mutable std::mutex mutex_;
+  std::string value_;
+};
+
+class IntGauge : public Gauge<int64_t>, public InProcessMetric {
+ public:
+  void Set(int64_t value) override {
+    value_.store(value, std::memory_order_relaxed);
+  }
+
+  Kind kind() const override { return Kind::kIntGauge; }
+
+  void Write(string_view name, raw_ostream& os) const override {
+    os << "# TYPE " << name << " gauge\n"
+       << name << " " << value_.load(std::memory_order_relaxed) << "\n";
+  }
+
+ private:
+  std::atomic<int64_t> value_ = {0};
+};
+
+class ShardedCounter : public Counter, public InProcessMetric {
+ public:
+  void IncrementBy(int64_t delta) override {
+    assert(delta >= 0 && "Counters are monotonic");
+    shards_[GetShardIndex()].value.fetch_add(delta, std::memory_order_relaxed);
+  }
+
+  Kind kind() const override { return Kind::kCounter; }
+
+  void Write(string_view name, raw_ostream& os) const override {
+    int64_t total = 0;
+    for (const auto& shard : shards_)
+      total += shard.value.load(std::memory_order_relaxed);
+    os << "# TYPE " << name << " counter\n" << name << " " << total << "\n";
+  }
+
+ private:
+  struct alignas(64) Shard {
+    std::atomic<int64_t> value = {0};
+  };
+
+  std::array<Shard, kNumShards> shards_;
+};
+
+class ShardedHistogram : public Histogram, public InProcessMetric {
+ public:
+  explicit ShardedHistogram(const Buckets& buckets)
+      : bounds_(buckets.explicit_bounds()) {
+    for (auto& shard : shards_)
+      shard.counts = std::make_unique<std::atomic<int64_t>[]>(num_buckets());
+  }
+
+  // Bucket 0 is the underflow bucket, bucket i holds values in
+  // [bounds[i - 1], bounds[i]) and the last bucket is the overflow bucket.
+  void Record(double value) override {
+    auto index = std::upper_bound(bounds_.begin(), bounds_.end(), value) -
+                 bounds_.begin();
+    auto& shard = shards_[GetShardIndex()];
+    shard.counts[index].fetch_add(1, std::memory_order_relaxed);
+    // Only the threads sharing this shard contend on the sum.
+    double sum = shard.sum.load(std::memory_order_relaxed);
+    while (!shard.sum.compare_exchange_weak(sum, sum + value,
+                                            std::memory_order_relaxed)) {
+    }
+  }
+
+  Kind kind() const override { return Kind::kHistogram; }
+
+  // Prometheus buckets are cumulative and labeled with their inclusive upper
+  // bound, while ours are half-open. The difference only matters for values
+  // equal to a bound.
+  void Write(string_view name, raw_ostream& os) const override {
+    std::vector<int64_t> counts(num_buckets(), 0);
+    double sum = 0;
+    for (const auto& shard : shards_) {
+      for (size_t i = 0; i < counts.size(); ++i)
+        counts[i] += shard.counts[i].load(std::memory_order_relaxed);
+      sum += shard.sum.load(std::memory_order_relaxed);
+    }
+
+    os << "# TYPE " << name << " histogram\n";
+    int64_t cumulative = 0;
+    for (size_t i = 0; i < counts.size(); ++i) {
+      cumulative += counts[i];
+      os << name << "_bucket{le=\"";
+      WriteDouble(i < bounds_.size() ? bounds_[i] : INFINITY, os);
+      os << "\"} " << cumulative << "\n";
+    }
+    os << name << "_sum ";
+    WriteDouble(sum, os);
+    os << "\n" << name << "_count " << cumulative << "\n";
+  }
+
+ private:
+  size_t num_buckets() const { return bounds_.size() + 1; }
+
+  struct alignas(64) Shard {
+    std::unique_ptr<std::atomic<int64_t>[]> counts;
+    std::atomic<double> sum = {0};
+  };
+
+  const std::vector<double> bounds_;
+  std::array<Shard, kNumShards> shards_;
+};
+
+}  // namespace
+
+template <typename T, typename Factory>
+T* InProcessMetricsRegistry::GetOrCreate(std::string name,
+                                         InProcessMetric::Kind kind,
+                                         Factory&& factory) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto& metric = metrics_[name];
+  if (metric) {
+    assert(metric->kind() == kind && "Metric redefined with different kind");
+    if (metric->kind() == kind) return static_cast<T*>(metric.get());
+    // Keep the original metric exported and leak the new one.
+    return factory().release();
+  }
+  auto new_metric = factory();
+  T* result = new_metric.get();
+  metric = std::move(new_metric);
+  return result;
+}
+
+Gauge<std::string>* InProcessMetricsRegistry::NewStringGauge(std::string name) {
+  return GetOrCreate<StringGauge>(
+      std::move(name), InProcessMetric::Kind::kStringGauge,
+      [] { return std::make_unique<StringGauge>(); });
+}
+
+Gauge<int64_t>* InProcessMetricsRegistry::NewIntGauge(std::string name) {
+  return GetOrCreate<IntGauge>(std::move(name),
+                               InProcessMetric::Kind::kIntGauge,
+                               [] { return std::make_unique<IntGauge>(); });
+}
+
+Counter* InProcessMetricsRegistry::NewCounter(std::string name) {
+  return GetOrCreate<ShardedCounter>(
+      std::move(name), InProcessMetric::Kind::kCounter,
+      [] { return std::make_unique<ShardedCounter>(); });
+}
+
+Histogram* InProcessMetricsRegistry::NewHistogram(std::string name,
+                                                  const Buckets& buckets) {
+  return GetOrCreate<ShardedHistogram>(
+      std::move(name), InProcessMetric::Kind::kHistogram,
+      [&] { return std::make_unique<ShardedHistogram>(buckets); });
+}
+
+void InProcessMetricsRegistry::WriteSnapshot(raw_ostream& os) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<const llvm::StringMapEntry<std::unique_ptr<InProcessMetric>>*>
+      entries;
+  for (const auto& entry : metrics_) entries.push_back(&entry);
+  std::sort(entries.begin(), entries.end(),
+            [](const auto* lhs, const auto* rhs) {
+              return lhs->getKey() < rhs->getKey();
+            });
+  for (const auto* entry : entries)
+    entry->getValue()->Write(SanitizeName(entry->getKey()), os);
+}
+
+InProcessMetricsRegistry& GetInProcessMetricsRegistry() {
+  static auto* registry = new InProcessMetricsRegistry;
+  return *registry;
+}
+
+}  // namespace metrics
+}  // namespace tfrt
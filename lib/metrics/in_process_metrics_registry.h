@@ -0,0 +1,84 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// This file declares the in-process metrics registry, which backs all metrics
+// unless an external registry is registered.
+
+#ifndef TFRT_LIB_METRICS_IN_PROCESS_METRICS_REGISTRY_H_
+#define TFRT_LIB_METRICS_IN_PROCESS_METRICS_REGISTRY_H_
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "llvm/ADT/StringMap.h"
+#include "tfrt/metrics/metrics_registry.h"
+#include "tfrt/support/forward_decls.h"
+
+namespace tfrt {
+namespace metrics {
+
+// A metric owned by the in-process registry.
+class InProcessMetric {
+ public:
+  enum class Kind { kStringGauge, kIntGauge, kCounter, kHistogram };
+
+  virtual ~InProcessMetric() {}
+
+  virtual Kind kind() const = 0;
+
+  // Writes the samples of this metric in the Prometheus text format. `name`
+  // is the sanitized metric name.
+  virtual void Write(string_view name, raw_ostream& os) const = 0;
+};
+
+// Registry that keeps all metric values in process memory.
+//
+// Counters and histograms are sharded: each thread updates the shard selected
+// by a thread-local index, with relaxed atomic operations on cache lines that
+// are rarely shared with other threads. Shards are only summed up when a
+// snapshot is taken.
+//
+// Creating a metric with the name of an existing metric of the same kind
+// returns the existing metric.
+class InProcessMetricsRegistry : public MetricsRegistry {
+ public:
+  Gauge<std::string>* NewStringGauge(std::string name) override;
+  Gauge<int64_t>* NewIntGauge(std::string name) override;
+  Counter* NewCounter(std::string name) override;
+  Histogram* NewHistogram(std::string name, const Buckets& buckets) override;
+
+  // Writes all metrics in the Prometheus text exposition format, sorted by
+  // name.
+  void WriteSnapshot(raw_ostream& os) const;
+
+ private:
+  template <typename T, typename Factory>
+  T* GetOrCreate(std::string name, InProcessMetric::Kind kind,
+                 Factory&& factory);
+
+  mutable std::mutex mutex_;
+  llvm::StringMap<std::unique_ptr<InProcessMetric>> metrics_;
+};
+
+// Returns the process-wide in-process registry.
+InProcessMetricsRegistry& GetInProcessMetricsRegistry();
+
+}  // namespace metrics
+}  // namespace tfrt
+
+#endif  // TFRT_LIB_METRICS_IN_PROCESS_METRICS_REGISTRY_H_
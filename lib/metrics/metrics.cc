@@ -16,39 +16,54 @@
 
 #include "tfrt/metrics/metrics.h"
 
+#include "in_process_metrics_registry.h"
 #include "tfrt/metrics/metrics_registry.h"
 
 namespace tfrt {
 namespace metrics {
 
-// A dummy implementation of the Gauge metric interface.
-template <typename T>
-class DummyGauge : public Gauge<T> {
- public:
-  DummyGauge() {}
-
-  void Set(T value) override {}
-};
-
-// A dummy implementation of the Histogram metric interface.
-class DummyHistogram : public Histogram {
- public:
-  DummyHistogram() {}
-
-  void Record(double value) override {}
-};
+// Metrics are created in the registered external registry, if any. Metric
+// kinds which it does not support, and all metrics if no registry is
+// registered, are created in the in-process registry.
 
 template <>
 Gauge<std::string>* NewGauge(std::string name) {
   if (internal::kMetricsRegistry != nullptr)
     return internal::kMetricsRegistry->NewStringGauge(name);
-  return new DummyGauge<std::string>();
+  return GetInProcessMetricsRegistry().NewStringGauge(name);
+}
+
+template <>
+Gauge<int64_t>* NewGauge(std::string name) {
+  if (internal::kMetricsRegistry != nullptr) {
+    if (auto* gauge = internal::kMetricsRegistry->NewIntGauge(name))
+      return gauge;
+  }
+  return GetInProcessMetricsRegistry().NewIntGauge(name);
+}
+
+Counter* NewCounter(std::string name) {
+  if (internal::kMetricsRegistry != nullptr) {
+    if (auto* counter = internal::kMetricsRegistry->NewCounter(name))
+      return counter;
+  }
+  return GetInProcessMetricsRegistry().NewCounter(name);
 }
 
 Histogram* NewHistogram(std::string name, const Buckets& buckets) {
   if (internal::kMetricsRegistry != nullptr)
     return internal::kMetricsRegistry->NewHistogram(name, buckets);
-  return new DummyHistogram();
+  return GetInProcessMetricsRegistry().NewHistogram(name, buckets);
+}
+
+std::atomic<bool> internal::kMetricsEnabled{false};
+
+void SetMetricsEnabled(bool enabled) {
+  internal::kMetricsEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+void WriteMetricsSnapshot(raw_ostream& os) {
+  GetInProcessMetricsRegistry().WriteSnapshot(os);
 }
 
 }  // namespace metrics
@@ -19,6 +19,8 @@
 #include <cassert>
 #include <mutex>
 
+#include "tfrt/metrics/metrics.h"
+
 namespace tfrt {
 namespace metrics {
 
@@ -34,6 +36,7 @@ void RegisterMetricsRegistry(MetricsRegistry* metrics_registry) {
   assert(metrics_registry);
   assert(internal::kMetricsRegistry == nullptr);
   internal::kMetricsRegistry = metrics_registry;
+  SetMetricsEnabled(true);
 }
 
 }  // namespace metrics
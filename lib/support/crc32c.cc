@@ -18,6 +18,8 @@
 
 #include "tfrt/support/crc32c.h"
 
+#include <algorithm>
+
 #include "tfrt/support/raw_coding.h"
 #include "tfrt/support/string_util.h"
 
@@ -26,6 +28,8 @@ namespace crc32c {
 
 extern bool CanAccelerate();
 extern uint32_t AcceleratedExtend(uint32_t crc, const char *buf, size_t size);
+extern void AcceleratedValues(const char *const *bufs, const size_t *sizes,
+                              size_t count, uint32_t *crcs);
 
 static const uint32_t table0_[256] = {
     0x00000000, 0xf26b8303, 0xe13b70f7, 0x1350f3f4, 0xc79a971f, 0x35f1141c,
@@ -263,5 +267,32 @@ uint32_t Extend(uint32_t crc, const char *buf, size_t size) {
                          : RegularExtend(crc, buf, size);
 }
 
+size_t VerifyMasked(ArrayRef<MaskedBuffer> buffers) {
+  // Verify in batches, so that the crcs fit on the stack.
+  constexpr size_t kBatchSize = 48;
+  const char *bufs[kBatchSize];
+  size_t sizes[kBatchSize];
+  uint32_t crcs[kBatchSize];
+  for (size_t begin = 0; begin < buffers.size(); begin += kBatchSize) {
+    size_t count = std::min(kBatchSize, buffers.size() - begin);
+    if (CanAccelerate()) {
+      for (size_t i = 0; i < count; ++i) {
+        bufs[i] = buffers[begin + i].data;
+        sizes[i] = buffers[begin + i].size;
+      }
+      AcceleratedValues(bufs, sizes, count, crcs);
+    } else {
+      for (size_t i = 0; i < count; ++i) {
+        crcs[i] = RegularExtend(0, buffers[begin + i].data,
+                                buffers[begin + i].size);
+      }
+    }
+    for (size_t i = 0; i < count; ++i) {
+      if (crcs[i] != Unmask(buffers[begin + i].masked_crc)) return begin + i;
+    }
+  }
+  return buffers.size();
+}
+
 }  // namespace crc32c
 }  // namespace tfrt
@@ -15,26 +15,34 @@
 //===- crc32c_accelerate.cc - crc32c Utilities ----------------------------===//
 //
 // This file defines C++ utility functions for crc32c accelerate.
+//
+// The crc32c instruction has a latency of three cycles, but can start one
+// computation per cycle. Large buffers are therefore split into three blocks
+// whose crcs are computed in an interleaved fashion and then combined. The crc
+// of a block is shifted past the following blocks by multiplying it with a
+// power of x modulo the crc32c polynomial, using carry-less multiplication
+// (PCLMUL) if available. Several small buffers are checksummed in the same
+// interleaved fashion by AcceleratedValues().
 
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
-#include "tfrt/support/raw_coding.h"
-
-// SSE4.2 accelerated CRC32c.
+#include <algorithm>
 
-// See if the SSE4.2 crc32c instruction is available.
+// See if the crc32c instruction is available.
 #undef USE_SSE_CRC32C
-#ifdef __SSE4_2__
-#if defined(__x86_64__) && defined(__GNUC__) && \
-    (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 8))
-#define USE_SSE_CRC32C 1
-#elif defined(__x86_64__) && defined(__clang__)
-#if __has_builtin(__builtin_cpu_supports)
+#undef USE_ARM_CRC32C
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+// The SSE4.2 code is compiled with a target attribute, so that it can be
+// selected at runtime without compiling the whole binary with -msse4.2.
+#if defined(__clang__) || __GNUC__ > 4 || \
+    (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)
 #define USE_SSE_CRC32C 1
 #endif
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#define USE_ARM_CRC32C 1
 #endif
-#endif /* __SSE4_2__ */
 
 // This version of Apple clang has a bug:
 // https://llvm.org/bugs/show_bug.cgi?id=25510
@@ -42,60 +50,254 @@
 #undef USE_SSE_CRC32C
 #endif
 
-#ifdef USE_SSE_CRC32C
+#if defined(USE_SSE_CRC32C)
 #include <nmmintrin.h>
+#include <wmmintrin.h>
+#define CRC32C_TARGET __attribute__((target("sse4.2")))
+#elif defined(USE_ARM_CRC32C)
+#include <arm_acle.h>
+#define CRC32C_TARGET
 #endif
 
 namespace tfrt {
 namespace crc32c {
 
-#ifndef USE_SSE_CRC32C
+#if !defined(USE_SSE_CRC32C) && !defined(USE_ARM_CRC32C)
 
 bool CanAccelerate() { return false; }
 uint32_t AcceleratedExtend(uint32_t crc, const char *buf, size_t size) {
   // Should not be called.
   return 0;
 }
+void AcceleratedValues(const char *const *bufs, const size_t *sizes,
+                       size_t count, uint32_t *crcs) {
+  // Should not be called.
+}
 
 #else
 
-// SSE4.2 optimized crc32c computation.
-bool CanAccelerate() { return __builtin_cpu_supports("sse4.2"); }
+namespace {
 
-uint32_t AcceleratedExtend(uint32_t crc, const char *buf, size_t size) {
-  const uint8_t *p = reinterpret_cast<const uint8_t *>(buf);
-  const uint8_t *e = p + size;
-  uint32_t l = crc ^ 0xffffffffu;
-
-  // Advance p until aligned to 8-bytes..
-  // Point x at first 7-byte aligned byte in string.  This might be
-  // just past the end of the string.
-  const uintptr_t pval = reinterpret_cast<uintptr_t>(p);
-  const uint8_t *x = reinterpret_cast<const uint8_t *>(((pval + 7) >> 3) << 3);
-  if (x <= e) {
-    // Process bytes until finished or p is 8-byte aligned
-    while (p != x) {
-      l = _mm_crc32_u8(l, *p);
-      p++;
+// Reflected crc32c (Castagnoli) polynomial.
+constexpr uint32_t kPolynomial = 0x82f63b78u;
+
+// Block sizes of the three interleaved streams. Long blocks amortize the cost
+// of combining the crcs, short blocks are used for the remainder.
+constexpr size_t kLongBlockSize = 4096;
+constexpr size_t kShortBlockSize = 256;
+
+#if defined(USE_SSE_CRC32C)
+
+CRC32C_TARGET inline uint32_t Crc8(uint32_t crc, uint8_t value) {
+  return _mm_crc32_u8(crc, value);
+}
+
+CRC32C_TARGET inline uint32_t Crc64(uint32_t crc, uint64_t value) {
+  return static_cast<uint32_t>(_mm_crc32_u64(crc, value));
+}
+
+bool DetectCrc32c() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("sse4.2");
+}
+
+bool DetectCarrylessMultiply() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("pclmul");
+}
+
+// Returns crc * x^33 * k modulo the polynomial.
+__attribute__((target("sse4.2,pclmul"))) uint32_t MultiplyCarryless(
+    uint32_t crc, uint32_t k) {
+  __m128i product =
+      _mm_clmulepi64_si128(_mm_cvtsi32_si128(static_cast<int>(crc)),
+                           _mm_cvtsi32_si128(static_cast<int>(k)), 0);
+  return Crc64(0, static_cast<uint64_t>(_mm_cvtsi128_si64(product)));
+}
+
+#else  // USE_ARM_CRC32C
+
+inline uint32_t Crc8(uint32_t crc, uint8_t value) {
+  return __crc32cb(crc, value);
+}
+
+inline uint32_t Crc64(uint32_t crc, uint64_t value) {
+  return __crc32cd(crc, value);
+}
+
+// The feature is checked at compile time.
+bool DetectCrc32c() { return true; }
+bool DetectCarrylessMultiply() { return false; }
+uint32_t MultiplyCarryless(uint32_t crc, uint32_t k) {
+  // Should not be called.
+  return 0;
+}
+
+#endif
+
+inline uint64_t Load64(const uint8_t *p) {
+  uint64_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+// Returns a * b modulo the polynomial, where the polynomials are reflected,
+// i.e. x^0 is the most significant bit.
+uint32_t Multiply(uint32_t a, uint32_t b) {
+  uint32_t product = 0;
+  for (uint32_t mask = 1u << 31; mask != 0; mask >>= 1) {
+    if (a & mask) product ^= b;
+    b = (b & 1) ? (b >> 1) ^ kPolynomial : b >> 1;
+  }
+  return product;
+}
+
+// Returns x^n modulo the polynomial.
+uint32_t PowerOfX(uint64_t n) {
+  uint32_t result = 1u << 31;  // x^0
+  uint32_t power = 1u << 30;   // x^1
+  for (; n != 0; n >>= 1) {
+    if (n & 1) result = Multiply(result, power);
+    power = Multiply(power, power);
+  }
+  return result;
+}
+
+// Shifts the crc of a block past `size` bytes of zeros, which is a
+// multiplication with x^(8 * size).
+class Shifter {
+ public:
+  Shifter(size_t size, bool carryless)
+      : carryless_(carryless),
+        // MultiplyCarryless() multiplies with an additional x^33.
+        k_(PowerOfX(8 * size - (carryless ? 33 : 0))) {}
+
+  uint32_t operator()(uint32_t crc) const {
+    return carryless_ ? MultiplyCarryless(crc, k_) : Multiply(crc, k_);
+  }
+
+ private:
+  bool carryless_;
+  uint32_t k_;
+};
+
+struct Shifters {
+  Shifters()
+      : carryless(DetectCarrylessMultiply()),
+        long_block(kLongBlockSize, carryless),
+        long_blocks(2 * kLongBlockSize, carryless),
+        short_block(kShortBlockSize, carryless),
+        short_blocks(2 * kShortBlockSize, carryless) {}
+
+  bool carryless;
+  Shifter long_block, long_blocks, short_block, short_blocks;
+};
+
+const Shifters &GetShifters() {
+  static const Shifters *shifters = new Shifters;
+  return *shifters;
+}
+
+// Extends the (not inverted) crc `l` with three consecutive blocks of
+// `block_size` bytes starting at `p`.
+CRC32C_TARGET inline uint32_t ExtendThreeBlocks(uint32_t l, const uint8_t *p,
+                                                size_t block_size,
+                                                const Shifter &shift_one,
+                                                const Shifter &shift_two) {
+  uint32_t l0 = l, l1 = 0, l2 = 0;
+  const uint8_t *p1 = p + block_size;
+  const uint8_t *p2 = p + 2 * block_size;
+  for (size_t i = 0; i < block_size; i += 8) {
+    l0 = Crc64(l0, Load64(p + i));
+    l1 = Crc64(l1, Load64(p1 + i));
+    l2 = Crc64(l2, Load64(p2 + i));
+  }
+  // The crc is linear, so the crc of the concatenation is the xor of the crcs
+  // of the blocks, each shifted past the blocks following it.
+  return shift_two(l0) ^ shift_one(l1) ^ l2;
+}
+
+// Extends the (not inverted) crc `l` with [p, e).
+CRC32C_TARGET uint32_t ExtendRaw(uint32_t l, const uint8_t *p,
+                                 const uint8_t *e) {
+  // Process bytes until p is 8-byte aligned.
+  while (p != e && (reinterpret_cast<uintptr_t>(p) & 7) != 0) {
+    l = Crc8(l, *p++);
+  }
+
+  if (e - p >= static_cast<ptrdiff_t>(3 * kShortBlockSize)) {
+    const Shifters &shifters = GetShifters();
+    while (e - p >= static_cast<ptrdiff_t>(3 * kLongBlockSize)) {
+      l = ExtendThreeBlocks(l, p, kLongBlockSize, shifters.long_block,
+                            shifters.long_blocks);
+      p += 3 * kLongBlockSize;
+    }
+    while (e - p >= static_cast<ptrdiff_t>(3 * kShortBlockSize)) {
+      l = ExtendThreeBlocks(l, p, kShortBlockSize, shifters.short_block,
+                            shifters.short_blocks);
+      p += 3 * kShortBlockSize;
     }
   }
 
-  // Process bytes 16 at a time
-  uint64_t l64 = l;
-  while ((e - p) >= 16) {
-    l64 = _mm_crc32_u64(l64, *reinterpret_cast<const uint64_t *>(p));
-    l64 = _mm_crc32_u64(l64, *reinterpret_cast<const uint64_t *>(p + 8));
+  // Process bytes 16 at a time.
+  while (e - p >= 16) {
+    l = Crc64(l, Load64(p));
+    l = Crc64(l, Load64(p + 8));
     p += 16;
   }
+  if (e - p >= 8) {
+    l = Crc64(l, Load64(p));
+    p += 8;
+  }
 
   // Process remaining bytes one at a time.
-  l = l64;
   while (p < e) {
-    l = _mm_crc32_u8(l, *p);
-    p++;
+    l = Crc8(l, *p++);
   }
+  return l;
+}
+
+// Computes the crcs of three buffers, interleaving them for their common
+// length.
+CRC32C_TARGET void ValueThree(const char *const *bufs, const size_t *sizes,
+                              uint32_t *crcs) {
+  const uint8_t *p0 = reinterpret_cast<const uint8_t *>(bufs[0]);
+  const uint8_t *p1 = reinterpret_cast<const uint8_t *>(bufs[1]);
+  const uint8_t *p2 = reinterpret_cast<const uint8_t *>(bufs[2]);
+  uint32_t l0 = 0xffffffffu, l1 = 0xffffffffu, l2 = 0xffffffffu;
+  size_t common = std::min({sizes[0], sizes[1], sizes[2]}) & ~size_t{7};
+  for (size_t i = 0; i < common; i += 8) {
+    l0 = Crc64(l0, Load64(p0 + i));
+    l1 = Crc64(l1, Load64(p1 + i));
+    l2 = Crc64(l2, Load64(p2 + i));
+  }
+  crcs[0] = ExtendRaw(l0, p0 + common, p0 + sizes[0]) ^ 0xffffffffu;
+  crcs[1] = ExtendRaw(l1, p1 + common, p1 + sizes[1]) ^ 0xffffffffu;
+  crcs[2] = ExtendRaw(l2, p2 + common, p2 + sizes[2]) ^ 0xffffffffu;
+}
 
-  return l ^ 0xffffffffu;
+}  // namespace
+
+bool CanAccelerate() {
+  static const bool can_accelerate = DetectCrc32c();
+  return can_accelerate;
+}
+
+CRC32C_TARGET uint32_t AcceleratedExtend(uint32_t crc, const char *buf,
+                                         size_t size) {
+  const uint8_t *p = reinterpret_cast<const uint8_t *>(buf);
+  return ExtendRaw(crc ^ 0xffffffffu, p, p + size) ^ 0xffffffffu;
+}
+
+void AcceleratedValues(const char *const *bufs, const size_t *sizes,
+                       size_t count, uint32_t *crcs) {
+  size_t i = 0;
+  for (; i + 3 <= count; i += 3) {
+    ValueThree(bufs + i, sizes + i, crcs + i);
+  }
+  for (; i < count; ++i) {
+    crcs[i] = AcceleratedExtend(0, bufs[i], sizes[i]);
+  }
 }
 
 #endif
@@ -16,6 +16,7 @@
 
 #include "tfrt/tensor/btf_util.h"
 
+#include <cstring>
 #include <iostream>
 
 namespace tfrt {
@@ -71,7 +72,7 @@ Expected<DenseHostTensor> ReadDHTFromBTF(std::istream* stream, uint64_t offset,
   stream->seekg(offset);
   btf::TensorHeader header;
   if (!ReadStream(stream, &header, 1)) {
-    return MakeStringError("failed to read tensor header at offset", offset);
+    return MakeStringError("failed to read tensor header at offset ", offset);
   }
   if (header.layout != btf::TensorLayout::kRMD) {
     return MakeStringError("unexpected tensor layout ", header.layout);
@@ -79,7 +80,7 @@ Expected<DenseHostTensor> ReadDHTFromBTF(std::istream* stream, uint64_t offset,
   llvm::SmallVector<Index, 4> dims;
   dims.resize(header.rank);
   if (!ReadStream(stream, dims.data(), header.rank)) {
-    return MakeStringError("failed to read tensor dims at offset", offset);
+    return MakeStringError("failed to read tensor dims at offset ", offset);
   }
   const TensorMetadata metadata(DType(ToDTypeKind(header.dtype)),
                                 TensorShape(dims));
@@ -93,11 +94,75 @@ Expected<DenseHostTensor> ReadDHTFromBTF(std::istream* stream, uint64_t offset,
   // strategy for reading the file.
   if (!ReadStream(stream, reinterpret_cast<uint8_t*>(dht.data()),
                   dht.DataSizeInBytes())) {
-    return MakeStringError("failed to read tensor data at offset", offset);
+    return MakeStringError("failed to read tensor data at offset ", offset);
   }
   return std::move(dht);
 }
 
+Expected<std::vector<uint64_t>> ReadBTFOffsets(const HostBuffer& buffer) {
+  const auto* data = static_cast<const char*>(buffer.data());
+  uint64_t num_tensors;
+  if (buffer.size() < sizeof(num_tensors)) {
+    return MakeStringError("failed to read num_tensors");
+  }
+  std::memcpy(&num_tensors, data, sizeof(num_tensors));
+  if ((buffer.size() / sizeof(uint64_t)) - 1 < num_tensors) {
+    return MakeStringError("failed to read tensor record offsets");
+  }
+  std::vector<uint64_t> offsets(num_tensors);
+  std::memcpy(offsets.data(), data + sizeof(num_tensors),
+              num_tensors * sizeof(uint64_t));
+  return offsets;
+}
+
+Expected<DenseHostTensor> ReadDHTFromBTF(const RCReference<HostBuffer>& buffer,
+                                         uint64_t offset) {
+  const auto* data = static_cast<const char*>(buffer->data());
+  const size_t size = buffer->size();
+  btf::TensorHeader header;
+  if (offset > size || size - offset < sizeof(header)) {
+    return MakeStringError("failed to read tensor header at offset ", offset);
+  }
+  std::memcpy(&header, data + offset, sizeof(header));
+  offset += sizeof(header);
+  if (header.layout != btf::TensorLayout::kRMD) {
+    return MakeStringError("unexpected tensor layout ", header.layout);
+  }
+  if ((size - offset) / sizeof(Index) < header.rank) {
+    return MakeStringError("failed to read tensor dims at offset ", offset);
+  }
+  llvm::SmallVector<Index, 4> dims;
+  dims.resize(header.rank);
+  std::memcpy(dims.data(), data + offset, header.rank * sizeof(Index));
+  offset += header.rank * sizeof(Index);
+  const TensorMetadata metadata(DType(ToDTypeKind(header.dtype)),
+                                TensorShape(dims));
+  const size_t nbytes =
+      GetHostSize(metadata.dtype) * metadata.shape.GetNumElements();
+  if (size - offset < nbytes) {
+    return MakeStringError("failed to read tensor data at offset ", offset);
+  }
+  return DenseHostTensor(metadata, HostBuffer::CreateFromExternal(
+                                       buffer.CopyRef(), offset, nbytes));
+}
+
+Expected<uint64_t> WriteDHTRecordToBTF(std::ostream* stream,
+                                       const DenseHostTensor& dht) {
+  auto dtype_or = btf::ToTensorDType(dht.dtype());
+  if (!dtype_or) return dtype_or.takeError();
+  btf::TensorHeader header;
+  header.rank = static_cast<uint64_t>(dht.shape().GetRank());
+  header.dtype = *dtype_or;
+  header.layout = btf::TensorLayout::kRMD;
+  if (!WriteStream(stream, &header, 1)) {
+    return MakeStringError("failed to write tensor header");
+  }
+  if (Error e = WriteDHTToBTF(stream, dht)) return std::move(e);
+  const size_t nbytes = dht.DataSizeInBytes();
+  return sizeof(btf::TensorHeader) + dht.shape().GetRank() * sizeof(uint64_t) +
+         nbytes + Pad(nbytes);
+}
+
 Error WriteTensorsToBTF(std::ostream* stream, ArrayRef<const Tensor*> tensors) {
   const uint64_t num_tensors = tensors.size();
   if (!WriteStream(stream, &num_tensors, 1)) {
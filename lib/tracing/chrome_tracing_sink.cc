@@ -12,15 +12,22 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <cstdlib>
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <string>
-#include <thread>
 #include <utility>
+#include <vector>
 
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
 #include "tfrt/support/error_util.h"
 #include "tfrt/tracing/tracing.h"
 
@@ -28,6 +35,18 @@
 // loaded in chrome://tracing. If run as part of a test, a trace.json file
 // is written as undeclared test output. Otherwise it is written to stdout.
 //
+// Each thread records into its own ring buffer, and activity names are interned
+// so that an entry is just a name id and two timestamps. Recording an activity
+// is lock-free and does not allocate if the name is pre-interned or the thread
+// has seen the name before. The ring buffer is allocated when the thread
+// records its first activity and released when the thread exits, once its
+// entries have been written. The ring buffers are drained when tracing is
+// disabled. If a thread records more than kEntriesPerThread activities during
+// one tracing session, the oldest ones are dropped.
+//
+// Flow events are written as chrome flow events bound to the enclosing
+// activity. tools/trace_critical_path reads them to find dependency chains.
+//
 // Usage: replace simple_tracing_sink dependency of bef_executor target with
 // chrome_tracing_sink and run with --enable_tracing.
 
@@ -36,78 +55,266 @@ namespace tracing {
 
 class ChromeTracingSink : public TracingSink {
   using Clock = std::chrono::high_resolution_clock;
-  using Start = std::pair<std::string, Clock::time_point>;
 
+  // Number of activities each thread can hold before dropping the oldest.
+  static constexpr size_t kEntriesPerThread = 1 << 15;
+
+  enum class EntryKind : uint32_t {
+    kComplete,
+    kFlowStart,
+    kFlowStep,
+    kFlowFinish,
+  };
+
+  // For flow events, `name_id` is unused and `end_ns` holds the flow id.
   struct Entry {
-    std::string name;
-    Clock::time_point begin, end;
-    std::thread::id tid;
-    std::unique_ptr<Entry> next;
+    EntryKind kind;
+    uint32_t name_id;
+    int64_t begin_ns, end_ns;
+  };
+
+  // Slot of a ring buffer. Flush() reads slots while the owning thread may
+  // overwrite them, so the fields are atomics accessed with relaxed ordering.
+  // Slots that were overwritten while being read are detected through `head`.
+  struct AtomicEntry {
+    void Store(const Entry& entry) {
+      kind.store(entry.kind, std::memory_order_relaxed);
+      name_id.store(entry.name_id, std::memory_order_relaxed);
+      begin_ns.store(entry.begin_ns, std::memory_order_relaxed);
+      end_ns.store(entry.end_ns, std::memory_order_relaxed);
+    }
+
+    Entry Load() const {
+      return {kind.load(std::memory_order_relaxed),
+              name_id.load(std::memory_order_relaxed),
+              begin_ns.load(std::memory_order_relaxed),
+              end_ns.load(std::memory_order_relaxed)};
+    }
+
+    std::atomic<EntryKind> kind;
+    std::atomic<uint32_t> name_id;
+    std::atomic<int64_t> begin_ns, end_ns;
+  };
+
+  struct Start {
+    uint32_t name_id;
+    int64_t begin_ns;
+  };
+
+  // Activities recorded by a single thread. All members except `entries`,
+  // `head`, `flushed` and `exited` are only accessed by the owning thread.
+  struct ThreadBuffer {
+    explicit ThreadBuffer(int tid) : tid(tid) {}
+
+    const int tid;
+    // Allocated by the owning thread before it publishes its first entry, and
+    // only read by Flush() once `head` is non-zero.
+    std::unique_ptr<AtomicEntry[]> entries;
+    // Total number of entries written. Published by the owning thread.
+    std::atomic<uint64_t> head = {0};
+    // Value of `head` at the time of the last flush. Guarded by `mutex_`.
+    uint64_t flushed = 0;
+    // Whether the owning thread has exited. Guarded by `mutex_`.
+    bool exited = false;
+    // Thread-local cache of interned names.
+    llvm::StringMap<uint32_t> name_ids;
+    llvm::SmallVector<Start, 16> stack;
   };
 
   class Duration {
    public:
-    explicit Duration(const Clock::duration& duration)
-        : ns_(std::chrono::duration_cast<std::chrono::nanoseconds>(duration)) {}
+    explicit Duration(int64_t ns) : ns_(ns) {}
 
     friend std::ostream& operator<<(std::ostream& os,
                                     const Duration& duration) {
       static const double us_per_ns = 1e-3;
       std::array<char, 32> array;
-      snprintf(array.data(), array.size(), "%.3f",
-               duration.ns_.count() * us_per_ns);
+      snprintf(array.data(), array.size(), "%.3f", duration.ns_ * us_per_ns);
       return os << array.data();
     }
 
    private:
-    std::chrono::nanoseconds ns_;
+    int64_t ns_;
   };
 
  public:
-  ~ChromeTracingSink() override { delete head_.exchange(nullptr); }
-
   Error RequestTracing(bool enable) override {
+    enabled_.store(enable, std::memory_order_release);
     if (enable) return Error::success();
-    std::unique_ptr<Entry> head(head_.exchange(nullptr));
     std::ofstream ofs;
     if (const char* dir = std::getenv("TEST_UNDECLARED_OUTPUTS_DIR"))
       ofs.open(dir + std::string("/trace.json"));
-    std::ostream& os = ofs ? ofs : std::cout;
+    std::ostream& os = ofs.is_open() ? ofs : std::cout;
     os << "{\n  \"traceEvents\": [\n";
-    for (; head; head = std::move(head->next)) {
-      os << R"(    {"ph": "X", "name": ")" << head->name;
-      os << R"(", "pid": 0, "tid": )" << head->tid;
-      os << R"(, "ts": )" << Duration(head->begin - start_);
-      os << R"(, "dur": )" << Duration(head->end - head->begin) << "},\n";
-    }
+    Flush(os);
     os << "    {}\n  ],\n  \"displayTimeUnit\": \"ns\"\n}\n";
     return Error::success();
   }
 
   void RecordTracingEvent(TracingSink::NameGenerator name_gen) override {
-    auto now = Clock::now();
-    auto entry = new Entry{name_gen(), now, now, std::this_thread::get_id()};
-    entry->next.reset(head_.exchange(entry));
+    if (!enabled_.load(std::memory_order_relaxed)) return;
+    auto& buffer = GetThreadBuffer();
+    auto now = Now();
+    Append(buffer,
+           {EntryKind::kComplete, Intern(buffer, name_gen()), now, now});
+  }
+
+  void RecordTracingEvent(TracingNameId name_id) override {
+    if (!enabled_.load(std::memory_order_relaxed)) return;
+    auto now = Now();
+    Append(GetThreadBuffer(), {EntryKind::kComplete, name_id.value, now, now});
   }
 
   void PushTracingScope(TracingSink::NameGenerator name_gen) override {
-    stack_.emplace_back(name_gen(), Clock::now());
+    auto& buffer = GetThreadBuffer();
+    buffer.stack.push_back({Intern(buffer, name_gen()), Now()});
+  }
+
+  void PushTracingScope(TracingNameId name_id) override {
+    GetThreadBuffer().stack.push_back({name_id.value, Now()});
   }
 
   void PopTracingScope() override {
-    auto now = Clock::now();
-    auto entry = new Entry{std::move(stack_.back().first), stack_.back().second,
-                           now, std::this_thread::get_id()};
-    entry->next.reset(head_.exchange(entry));
-    stack_.pop_back();
+    auto& buffer = GetThreadBuffer();
+    if (buffer.stack.empty()) return;
+    auto start = buffer.stack.pop_back_val();
+    if (!enabled_.load(std::memory_order_relaxed)) return;
+    Append(buffer,
+           {EntryKind::kComplete, start.name_id, start.begin_ns, Now()});
+  }
+
+  void RecordFlowEvent(uint64_t flow_id, FlowPhase phase) override {
+    if (!enabled_.load(std::memory_order_relaxed)) return;
+    auto kind = phase == FlowPhase::Start  ? EntryKind::kFlowStart
+                : phase == FlowPhase::Step ? EntryKind::kFlowStep
+                                           : EntryKind::kFlowFinish;
+    Append(GetThreadBuffer(), {kind, 0, Now(), static_cast<int64_t>(flow_id)});
+  }
+
+ private:
+  int64_t Now() const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                                start_)
+        .count();
+  }
+
+  // Releases the buffer of a thread when the thread exits.
+  struct ThreadBufferHolder {
+    ~ThreadBufferHolder() {
+      if (buffer) sink->ReleaseThreadBuffer(buffer);
+    }
+
+    ChromeTracingSink* sink = nullptr;
+    ThreadBuffer* buffer = nullptr;
+  };
+
+  ThreadBuffer& GetThreadBuffer() {
+    thread_local ThreadBufferHolder holder;
+    if (holder.buffer) return *holder.buffer;
+    std::lock_guard<std::mutex> lock(mutex_);
+    buffers_.push_back(std::make_unique<ThreadBuffer>(next_tid_++));
+    holder.sink = this;
+    return *(holder.buffer = buffers_.back().get());
+  }
+
+  // Frees `buffer` if all its entries have been written, otherwise the next
+  // Flush() frees it.
+  void ReleaseThreadBuffer(ThreadBuffer* buffer) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    buffer->exited = true;
+    if (buffer->head.load(std::memory_order_relaxed) == buffer->flushed)
+      EraseExitedBuffers();
+  }
+
+  void EraseExitedBuffers() {
+    buffers_.erase(
+        std::remove_if(buffers_.begin(), buffers_.end(),
+                       [](const std::unique_ptr<ThreadBuffer>& buffer) {
+                         return buffer->exited &&
+                                buffer->head.load(std::memory_order_relaxed) ==
+                                    buffer->flushed;
+                       }),
+        buffers_.end());
+  }
+
+  uint32_t Intern(ThreadBuffer& buffer, std::string&& name) {
+    auto it = buffer.name_ids.find(name);
+    if (it != buffer.name_ids.end()) return it->second;
+    return buffer.name_ids[name] = InternTracingName(name).value;
+  }
+
+  static void Append(ThreadBuffer& buffer, const Entry& entry) {
+    if (!buffer.entries)
+      buffer.entries = std::make_unique<AtomicEntry[]>(kEntriesPerThread);
+    auto head = buffer.head.load(std::memory_order_relaxed);
+    // Orders the previous update of `head` before overwriting the slot, so that
+    // Flush() sees the new `head` if it reads any of the new fields.
+    std::atomic_thread_fence(std::memory_order_release);
+    buffer.entries[head % kEntriesPerThread].Store(entry);
+    buffer.head.store(head + 1, std::memory_order_release);
+  }
+
+  // Writes all entries recorded since the last flush. Threads may still be
+  // appending while this runs. Entries that were overwritten while being read
+  // are detected by re-reading `head` afterwards and skipped. Frees the
+  // buffers of exited threads.
+  void Flush(std::ostream& os) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<Entry> entries;
+    for (const auto& buffer : buffers_) {
+      auto end = buffer->head.load(std::memory_order_acquire);
+      auto begin = std::max(buffer->flushed, end < kEntriesPerThread
+                                                 ? uint64_t{0}
+                                                 : end - kEntriesPerThread);
+      entries.clear();
+      for (auto i = begin; i < end; ++i)
+        entries.push_back(buffer->entries[i % kEntriesPerThread].Load());
+      // Pairs with the fence in Append(). The owning thread may be writing the
+      // slot of entry `head` right now.
+      std::atomic_thread_fence(std::memory_order_acquire);
+      auto head = buffer->head.load(std::memory_order_relaxed) + 1;
+      auto valid = head < kEntriesPerThread ? 0 : head - kEntriesPerThread;
+      auto skip = valid > begin ? std::min<uint64_t>(valid - begin, end - begin)
+                                : uint64_t{0};
+      for (auto it = entries.begin() + skip; it != entries.end(); ++it) {
+        if (it->kind != EntryKind::kComplete) {
+          WriteFlowEvent(os, buffer->tid, *it);
+          continue;
+        }
+        auto name = GetTracingName({it->name_id});
+        os << R"(    {"ph": "X", "name": ")";
+        os.write(name.data(), name.size());
+        os << R"(", "pid": 0, "tid": )" << buffer->tid;
+        os << R"(, "ts": )" << Duration(it->begin_ns);
+        os << R"(, "dur": )" << Duration(it->end_ns - it->begin_ns) << "},\n";
+      }
+      buffer->flushed = end;
+    }
+    EraseExitedBuffers();
+  }
+
+  // Writes a flow event bound to the enclosing complete event.
+  static void WriteFlowEvent(std::ostream& os, int tid, const Entry& entry) {
+    const char* phase = entry.kind == EntryKind::kFlowStart  ? "s"
+                        : entry.kind == EntryKind::kFlowStep ? "t"
+                                                             : "f";
+    std::array<char, 32> id;
+    snprintf(id.data(), id.size(), "0x%llx",
+             static_cast<unsigned long long>(entry.end_ns));  // NOLINT
+    os << R"(    {"ph": ")" << phase;
+    os << R"(", "name": "flow", "cat": "flow", "id": ")" << id.data();
+    os << R"(", "pid": 0, "tid": )" << tid;
+    os << R"(, "ts": )" << Duration(entry.begin_ns) << R"(, "bp": "e"},)"
+       << "\n";
   }
 
   const Clock::time_point start_ = Clock::now();
-  static thread_local std::vector<Start> stack_;
-  std::atomic<Entry*> head_ = {nullptr};
-};
+  std::atomic<bool> enabled_ = {false};
 
-thread_local std::vector<ChromeTracingSink::Start> ChromeTracingSink::stack_;
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<ThreadBuffer>> buffers_;
+  int next_tid_ = 0;
+};
 
 static const bool kRegisterTracingSink = []() {
   RegisterTracingSink(new ChromeTracingSink);
@@ -26,6 +26,9 @@ namespace tracing {
 
 class DebugTracingSink : public TracingSink {
  public:
+  using TracingSink::PushTracingScope;
+  using TracingSink::RecordTracingEvent;
+
   Error RequestTracing(bool enable) override { return Error::success(); }
 
   void RecordTracingEvent(NameGenerator gen_name) override {
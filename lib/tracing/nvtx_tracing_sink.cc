@@ -39,6 +39,9 @@ static nvtxDomainHandle_t GetDomain() {
 }
 
 class NvtxTracingSink : public TracingSink {
+  using TracingSink::PushTracingScope;
+  using TracingSink::RecordTracingEvent;
+
   Error RequestTracing(bool enable) override {
     nvtxInitialize(/*reserved=*/nullptr);
     if (nvtxGlobals_v3.nvtxDomainMarkEx_impl_fnptr == nullptr)
@@ -0,0 +1,509 @@
+// Copyright 2022 The TensorFlow Runtime Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "tfrt/support/error_util.h"
+#include "tfrt/tracing/tracing.h"
+
+// This file implements a tracing sink which streams activities to a file in
+// the Perfetto protobuf trace format (https://perfetto.dev). The trace can be
+// loaded in ui.perfetto.dev or processed with the trace_processor tool.
+//
+// Unlike the chrome tracing sink, the trace is written incrementally while
+// tracing is enabled: each thread records into fixed-size chunks, and a writer
+// thread encodes full chunks and appends them to the file. The writer also
+// flushes the entries of partially filled chunks every kFlushInterval, and
+// takes over the chunk of a thread when it exits. At most kMaxChunks chunks
+// are allocated. If the writer falls behind, activities are dropped instead of
+// growing memory. Flow events are emitted as instant events
+// carrying (terminating) flow ids, which Perfetto renders as arrows.
+//
+// The trace is written to the path in the TFRT_PERFETTO_TRACE_PATH environment
+// variable. If that is not set and the sink runs as part of a test, it is
+// written to trace.pftrace in the undeclared test outputs directory.
+//
+// Usage: replace simple_tracing_sink dependency of bef_executor target with
+// perfetto_tracing_sink and run with --enable_tracing.
+
+namespace tfrt {
+namespace tracing {
+
+namespace {
+
+// Minimal protobuf wire format encoder for the subset of the Perfetto trace
+// proto used below.
+class ProtoWriter {
+ public:
+  void AddVarInt(uint32_t field, uint64_t value) {
+    AddTag(field, /*wire_type=*/0);
+    AddRawVarInt(value);
+  }
+
+  void AddFixed64(uint32_t field, uint64_t value) {
+    AddTag(field, /*wire_type=*/1);
+    for (int i = 0; i < 8; ++i, value >>= 8) data_.push_back(value & 0xff);
+  }
+
+  void AddBytes(uint32_t field, llvm::StringRef bytes) {
+    AddTag(field, /*wire_type=*/2);
+    AddRawVarInt(bytes.size());
+    data_.append(bytes.begin(), bytes.end());
+  }
+
+  void AddMessage(uint32_t field, const ProtoWriter& message) {
+    AddBytes(field, message.data_);
+  }
+
+  const std::string& data() const { return data_; }
+  void Clear() { data_.clear(); }
+
+ private:
+  void AddTag(uint32_t field, uint32_t wire_type) {
+    AddRawVarInt(field << 3 | wire_type);
+  }
+
+  void AddRawVarInt(uint64_t value) {
+    for (; value >= 0x80; value >>= 7) data_.push_back((value & 0x7f) | 0x80);
+    data_.push_back(value);
+  }
+
+  std::string data_;
+};
+
+// Field numbers from perfetto/trace/trace_packet.proto and friends.
+namespace proto {
+constexpr uint32_t kTracePacket = 1;  // Trace.packet
+
+constexpr uint32_t kTimestamp = 8;
+constexpr uint32_t kSequenceId = 10;
+constexpr uint32_t kTrackEvent = 11;
+constexpr uint32_t kInternedData = 12;
+constexpr uint32_t kSequenceFlags = 13;
+constexpr uint32_t kTrackDescriptor = 60;
+
+constexpr uint32_t kSeqIncrementalStateCleared = 1;
+constexpr uint32_t kSeqNeedsIncrementalState = 2;
+
+constexpr uint32_t kEventNameIid = 10;
+constexpr uint32_t kEventType = 9;
+constexpr uint32_t kEventTrackUuid = 11;
+constexpr uint32_t kEventFlowIds = 47;
+constexpr uint32_t kEventTerminatingFlowIds = 48;
+
+constexpr uint32_t kTypeSliceBegin = 1;
+constexpr uint32_t kTypeSliceEnd = 2;
+constexpr uint32_t kTypeInstant = 3;
+
+constexpr uint32_t kInternedEventNames = 2;
+constexpr uint32_t kEventNameIidField = 1;
+constexpr uint32_t kEventNameName = 2;
+
+constexpr uint32_t kTrackUuid = 1;
+constexpr uint32_t kTrackThread = 4;
+constexpr uint32_t kThreadPid = 1;
+constexpr uint32_t kThreadTid = 2;
+constexpr uint32_t kThreadName = 5;
+}  // namespace proto
+
+}  // namespace
+
+class PerfettoTracingSink : public TracingSink {
+  using Clock = std::chrono::steady_clock;
+
+  // Number of entries per chunk and maximum number of chunks.
+  static constexpr size_t kChunkSize = 4096;
+  static constexpr size_t kMaxChunks = 256;
+  // Interval at which the writer flushes partially filled chunks.
+  static constexpr std::chrono::milliseconds kFlushInterval{100};
+
+  static constexpr uint32_t kSequenceId = 1;
+  static constexpr int kPid = 1;
+
+  enum class EntryType : uint32_t {
+    kEvent,
+    kPush,
+    kPop,
+    kFlowStep,
+    kFlowFinish,
+  };
+
+  struct Entry {
+    EntryType type;
+    uint32_t name_id;
+    int64_t time_ns;
+    uint64_t flow_id;
+  };
+
+  // Entries of a thread are appended to a chunk without synchronization and
+  // published through `size`. The writer reads entries [flushed, size).
+  struct Chunk {
+    int tid = 0;
+    std::atomic<size_t> size = {0};
+    size_t flushed = 0;
+    Entry entries[kChunkSize];
+  };
+
+  // All members except `chunk` are only accessed by the owning thread.
+  // `chunk` is only changed by the owning thread while holding `mutex_`.
+  struct ThreadBuffer {
+    explicit ThreadBuffer(int tid) : tid(tid) {}
+
+    const int tid;
+    Chunk* chunk = nullptr;
+    llvm::StringMap<uint32_t> name_ids;
+    // The session of each open scope, or 0 if it was opened while tracing was
+    // disabled. A scope is only closed in the session which opened it.
+    llvm::SmallVector<uint32_t, 8> scopes;
+  };
+
+  // Owns the buffer of a thread, and hands it back to the sink when the
+  // thread exits.
+  struct ThreadBufferOwner {
+    ~ThreadBufferOwner() {
+      if (buffer) sink->ReleaseThreadBuffer(std::move(buffer));
+    }
+
+    PerfettoTracingSink* sink = nullptr;
+    std::unique_ptr<ThreadBuffer> buffer;
+  };
+
+ public:
+  Error RequestTracing(bool enable) override {
+    if (enable) return Start();
+    Stop();
+    return Error::success();
+  }
+
+  void RecordTracingEvent(NameGenerator gen_name) override {
+    if (!enabled_.load(std::memory_order_relaxed)) return;
+    auto& buffer = GetThreadBuffer();
+    Append(buffer, {EntryType::kEvent, Intern(buffer, gen_name()), Now(),
+                    /*flow_id=*/0});
+  }
+
+  void RecordTracingEvent(TracingNameId name_id) override {
+    if (!enabled_.load(std::memory_order_relaxed)) return;
+    Append(GetThreadBuffer(),
+           {EntryType::kEvent, name_id.value, Now(), /*flow_id=*/0});
+  }
+
+  void PushTracingScope(NameGenerator gen_name) override {
+    auto& buffer = GetThreadBuffer();
+    buffer.scopes.push_back(GetSession());
+    if (buffer.scopes.back() == 0) return;
+    Append(buffer, {EntryType::kPush, Intern(buffer, gen_name()), Now(),
+                    /*flow_id=*/0});
+  }
+
+  void PushTracingScope(TracingNameId name_id) override {
+    auto& buffer = GetThreadBuffer();
+    buffer.scopes.push_back(GetSession());
+    if (buffer.scopes.back() == 0) return;
+    Append(buffer, {EntryType::kPush, name_id.value, Now(), /*flow_id=*/0});
+  }
+
+  void PopTracingScope() override {
+    auto& buffer = GetThreadBuffer();
+    if (buffer.scopes.empty()) return;
+    auto session = buffer.scopes.pop_back_val();
+    if (session == 0 || session != GetSession()) return;
+    Append(buffer, {EntryType::kPop, 0, Now(), /*flow_id=*/0});
+  }
+
+  void RecordFlowEvent(uint64_t flow_id, FlowPhase phase) override {
+    if (!enabled_.load(std::memory_order_relaxed)) return;
+    auto type = phase == FlowPhase::Finish ? EntryType::kFlowFinish
+                                           : EntryType::kFlowStep;
+    Append(GetThreadBuffer(), {type, 0, Now(), flow_id});
+  }
+
+ private:
+  // Returns the current tracing session, or 0 if tracing is disabled.
+  uint32_t GetSession() const {
+    if (!enabled_.load(std::memory_order_acquire)) return 0;
+    return session_.load(std::memory_order_relaxed);
+  }
+
+  int64_t Now() const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               Clock::now().time_since_epoch())
+        .count();
+  }
+
+  Error Start() {
+    std::string path;
+    if (const char* env = std::getenv("TFRT_PERFETTO_TRACE_PATH"))
+      path = env;
+    else if (const char* dir = std::getenv("TEST_UNDECLARED_OUTPUTS_DIR"))
+      path = dir + std::string("/trace.pftrace");
+    else
+      return MakeStringError("TFRT_PERFETTO_TRACE_PATH is not set");
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    ofs_.open(path, std::ios::binary | std::ios::trunc);
+    if (!ofs_.is_open())
+      return MakeStringError("Failed to open trace file: ", path);
+
+    // Entries recorded while tracing was disabled belong to no session.
+    for (auto* chunk : full_chunks_) ReleaseChunk(chunk);
+    full_chunks_.clear();
+    for (auto* buffer : buffers_) {
+      if (auto* chunk = buffer->chunk) chunk->flushed = chunk->size.load();
+    }
+    described_tracks_.clear();
+    emitted_names_.clear();
+    first_packet_ = true;
+    stop_ = false;
+
+    writer_ = std::thread([this] { WriterLoop(); });
+    session_.fetch_add(1, std::memory_order_relaxed);
+    enabled_.store(true, std::memory_order_release);
+    return Error::success();
+  }
+
+  void Stop() {
+    enabled_.store(false, std::memory_order_release);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_one();
+    if (writer_.joinable()) writer_.join();
+    ofs_.close();
+  }
+
+  // Encodes full chunks as they are handed off by recording threads, and the
+  // new entries of the partially filled chunks of all threads at least every
+  // kFlushInterval. The mutex is not held while encoding, so recording threads
+  // are not blocked.
+  void WriterLoop() {
+    std::vector<Chunk*> chunks, partial_chunks;
+    for (bool stop = false; !stop;) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (auto* chunk : chunks) ReleaseChunk(chunk);
+        chunks.clear();
+        partial_chunks.clear();
+        cv_.wait_for(lock, kFlushInterval,
+                     [&] { return stop_ || !full_chunks_.empty(); });
+        chunks.swap(full_chunks_);
+        stop = stop_;
+        // A partial chunk is only released by this thread, after it has been
+        // handed off as full chunk, so it stays valid without the lock.
+        for (auto* buffer : buffers_)
+          if (buffer->chunk) partial_chunks.push_back(buffer->chunk);
+      }
+      for (auto* chunk : chunks)
+        WriteEntries(*chunk, chunk->size.load(std::memory_order_acquire));
+      for (auto* chunk : partial_chunks)
+        WriteEntries(*chunk, chunk->size.load(std::memory_order_acquire));
+      ofs_.flush();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto* chunk : chunks) ReleaseChunk(chunk);
+  }
+
+  ThreadBuffer& GetThreadBuffer() {
+    thread_local ThreadBufferOwner owner;
+    if (owner.buffer) return *owner.buffer;
+    std::lock_guard<std::mutex> lock(mutex_);
+    owner.sink = this;
+    owner.buffer = std::make_unique<ThreadBuffer>(++num_threads_);
+    buffers_.push_back(owner.buffer.get());
+    return *owner.buffer;
+  }
+
+  // Called when a thread exits. Its partially filled chunk is handed off to
+  // the writer like a full one, so that the chunk is recycled.
+  void ReleaseThreadBuffer(std::unique_ptr<ThreadBuffer> buffer) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    buffers_.erase(llvm::find(buffers_, buffer.get()));
+    if (auto* chunk = buffer->chunk) {
+      full_chunks_.push_back(chunk);
+      cv_.notify_one();
+    }
+  }
+
+  uint32_t Intern(ThreadBuffer& buffer, std::string&& name) {
+    auto it = buffer.name_ids.find(name);
+    if (it != buffer.name_ids.end()) return it->second;
+    return buffer.name_ids[name] = InternTracingName(name).value;
+  }
+
+  void Append(ThreadBuffer& buffer, const Entry& entry) {
+    auto* chunk = buffer.chunk;
+    auto size = chunk ? chunk->size.load(std::memory_order_relaxed) : 0;
+    if (!chunk || size == kChunkSize) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (chunk) {
+        full_chunks_.push_back(chunk);
+        cv_.notify_one();
+      }
+      chunk = buffer.chunk = AcquireChunk(buffer.tid);
+      if (!chunk) return;  // Writer is falling behind, drop the entry.
+      size = 0;
+    }
+    chunk->entries[size] = entry;
+    chunk->size.store(size + 1, std::memory_order_release);
+  }
+
+  Chunk* AcquireChunk(int tid) {
+    Chunk* chunk = nullptr;
+    if (!free_chunks_.empty()) {
+      chunk = free_chunks_.back().release();
+      free_chunks_.pop_back();
+    } else if (num_chunks_ < kMaxChunks) {
+      chunk = new Chunk;
+      ++num_chunks_;
+    } else {
+      return nullptr;
+    }
+    chunk->tid = tid;
+    chunk->size.store(0, std::memory_order_relaxed);
+    chunk->flushed = 0;
+    return chunk;
+  }
+
+  void ReleaseChunk(Chunk* chunk) { free_chunks_.emplace_back(chunk); }
+
+  void WriteEntries(Chunk& chunk, size_t end) {
+    auto track_uuid = chunk.tid;
+    if (described_tracks_.insert(track_uuid).second) {
+      ProtoWriter thread;
+      thread.AddVarInt(proto::kThreadPid, kPid);
+      thread.AddVarInt(proto::kThreadTid, track_uuid);
+      thread.AddBytes(proto::kThreadName,
+                      "tfrt thread " + std::to_string(track_uuid));
+      ProtoWriter track;
+      track.AddVarInt(proto::kTrackUuid, track_uuid);
+      track.AddMessage(proto::kTrackThread, thread);
+      packet_.Clear();
+      packet_.AddMessage(proto::kTrackDescriptor, track);
+      WritePacket();
+    }
+
+    for (size_t i = chunk.flushed; i < end; ++i) {
+      const Entry& entry = chunk.entries[i];
+      ProtoWriter& event = event_;
+      event.Clear();
+      event.AddVarInt(proto::kEventTrackUuid, track_uuid);
+      switch (entry.type) {
+        case EntryType::kEvent:
+          event.AddVarInt(proto::kEventType, proto::kTypeInstant);
+          event.AddVarInt(proto::kEventNameIid, NameIid(entry.name_id));
+          break;
+        case EntryType::kPush:
+          event.AddVarInt(proto::kEventType, proto::kTypeSliceBegin);
+          event.AddVarInt(proto::kEventNameIid, NameIid(entry.name_id));
+          break;
+        case EntryType::kPop:
+          event.AddVarInt(proto::kEventType, proto::kTypeSliceEnd);
+          break;
+        case EntryType::kFlowStep:
+          event.AddVarInt(proto::kEventType, proto::kTypeInstant);
+          event.AddFixed64(proto::kEventFlowIds, entry.flow_id);
+          break;
+        case EntryType::kFlowFinish:
+          event.AddVarInt(proto::kEventType, proto::kTypeInstant);
+          event.AddFixed64(proto::kEventTerminatingFlowIds, entry.flow_id);
+          break;
+      }
+
+      packet_.Clear();
+      packet_.AddVarInt(proto::kTimestamp, entry.time_ns);
+      if (entry.type == EntryType::kEvent || entry.type == EntryType::kPush)
+        MaybeAddInternedName(entry.name_id);
+      packet_.AddMessage(proto::kTrackEvent, event);
+      WritePacket();
+    }
+    chunk.flushed = end;
+  }
+
+  // Returns the interning id of a name, which must not be 0. Computed in 64
+  // bits so that kOverflowTracingNameId does not wrap around to 0.
+  static uint64_t NameIid(uint32_t name_id) { return uint64_t{name_id} + 1; }
+
+  void MaybeAddInternedName(uint32_t name_id) {
+    if (!emitted_names_.insert(name_id).second) return;
+    ProtoWriter name;
+    name.AddVarInt(proto::kEventNameIidField, NameIid(name_id));
+    name.AddBytes(proto::kEventNameName, GetTracingName({name_id}));
+    ProtoWriter interned;
+    interned.AddMessage(proto::kInternedEventNames, name);
+    packet_.AddMessage(proto::kInternedData, interned);
+  }
+
+  void WritePacket() {
+    packet_.AddVarInt(proto::kSequenceId, kSequenceId);
+    packet_.AddVarInt(proto::kSequenceFlags,
+                      first_packet_ ? proto::kSeqIncrementalStateCleared
+                                    : proto::kSeqNeedsIncrementalState);
+    first_packet_ = false;
+    output_.Clear();
+    output_.AddMessage(proto::kTracePacket, packet_);
+    ofs_.write(output_.data().data(), output_.data().size());
+  }
+
+  std::atomic<bool> enabled_ = {false};
+  // Incremented each time tracing is enabled.
+  std::atomic<uint32_t> session_ = {0};
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stop_ = false;
+  std::thread writer_;
+
+  // The buffers of the threads which have not exited, owned by their
+  // ThreadBufferOwner.
+  std::vector<ThreadBuffer*> buffers_;
+  int num_threads_ = 0;
+  std::vector<Chunk*> full_chunks_;
+  std::vector<std::unique_ptr<Chunk>> free_chunks_;
+  size_t num_chunks_ = 0;
+
+  // Writer state, only accessed by the writer thread (or while it is stopped).
+  std::ofstream ofs_;
+  llvm::DenseSet<int> described_tracks_;
+  llvm::DenseSet<uint32_t> emitted_names_;
+  bool first_packet_ = true;
+  ProtoWriter event_;
+  ProtoWriter packet_;
+  ProtoWriter output_;
+};
+
+static const bool kRegisterTracingSink = []() {
+  RegisterTracingSink(new PerfettoTracingSink);
+  return true;
+}();
+
+}  // namespace tracing
+}  // namespace tfrt
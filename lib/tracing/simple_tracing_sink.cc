@@ -97,6 +97,9 @@ class TracingStorage {
 
 class SimpleTracingSink : public TracingSink {
  public:
+  using TracingSink::PushTracingScope;
+  using TracingSink::RecordTracingEvent;
+
   Error RequestTracing(bool enable) override;
   void RecordTracingEvent(NameGenerator gen_name) override;
   void PushTracingScope(NameGenerator gen_name) override;
@@ -18,11 +18,15 @@
 #include "tfrt/tracing/tracing.h"
 
 #include <algorithm>
+#include <array>
 #include <atomic>
 #include <cassert>
+#include <cstdint>
 #include <mutex>
 #include <utility>
+#include <vector>
 
+#include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringSwitch.h"
 #include "llvm/Support/Error.h"
 #include "tfrt/support/error_util.h"
@@ -33,6 +37,14 @@ namespace tracing {
 
 TracingSink::~TracingSink() = default;
 
+void TracingSink::RecordTracingEvent(TracingNameId name_id) {
+  RecordTracingEvent([&] { return GetTracingName(name_id).str(); });
+}
+
+void TracingSink::PushTracingScope(TracingNameId name_id) {
+  PushTracingScope([&] { return GetTracingName(name_id).str(); });
+}
+
 raw_ostream& operator<<(raw_ostream& os, TracingLevel level) {
   switch (level) {
     case TracingLevel::None:
@@ -68,6 +80,103 @@ static std::mutex& GetTracingMutex() {
   return *mutex;
 }
 
+namespace {
+// Append-only table of interned names. Names are stored in chunks which are
+// never moved or freed, so that GetTracingName() can read them without a lock.
+struct NameTable {
+  static constexpr int kChunkBits = 10;
+  static constexpr uint32_t kChunkSize = 1 << kChunkBits;
+  static constexpr uint32_t kMaxChunks = 1024;
+
+  // Guards `ids`, `overflowed` and the writes to `chunks` and `size`.
+  std::mutex mutex;
+  llvm::StringMap<uint32_t> ids;
+  std::array<std::atomic<string_view*>, kMaxChunks> chunks{};
+  // The number of names. Stored with release semantics after a name has been
+  // written to its chunk.
+  std::atomic<uint32_t> size{0};
+  // Whether a name did not fit into the table.
+  bool overflowed = false;
+};
+}  // namespace
+
+static NameTable& GetNameTable() {
+  static auto table = new NameTable;
+  return *table;
+}
+
+TracingNameId InternTracingName(string_view name) {
+  auto& table = GetNameTable();
+  std::lock_guard<std::mutex> lock(table.mutex);
+  auto it = table.ids.find(name);
+  if (it != table.ids.end()) return TracingNameId{it->second};
+
+  auto index = table.size.load(std::memory_order_relaxed);
+  auto chunk_index = index >> NameTable::kChunkBits;
+  if (chunk_index >= NameTable::kMaxChunks) {
+    if (!table.overflowed) {
+      TFRT_LOG(WARNING) << "Too many tracing names, reporting new names as "
+                        << kOverflowTracingName;
+      table.overflowed = true;
+    }
+    return kOverflowTracingNameId;
+  }
+  auto pair = table.ids.try_emplace(name, index);
+  auto* chunk = table.chunks[chunk_index].load(std::memory_order_relaxed);
+  if (chunk == nullptr) {
+    chunk = new string_view[NameTable::kChunkSize];
+    table.chunks[chunk_index].store(chunk, std::memory_order_relaxed);
+  }
+  chunk[index & (NameTable::kChunkSize - 1)] = pair.first->getKey();
+  table.size.store(index + 1, std::memory_order_release);
+  return TracingNameId{index};
+}
+
+string_view GetTracingName(TracingNameId name_id) {
+  if (name_id.value == kOverflowTracingNameId.value)
+    return kOverflowTracingName;
+  auto& table = GetNameTable();
+  // Synchronizes with the release store in InternTracingName(), which makes
+  // the chunk and the name visible.
+  auto size = table.size.load(std::memory_order_acquire);
+  assert(name_id.value < size);
+  (void)size;
+  auto* chunk = table.chunks[name_id.value >> NameTable::kChunkBits].load(
+      std::memory_order_relaxed);
+  return chunk[name_id.value & (NameTable::kChunkSize - 1)];
+}
+
+// The number of slots of the flow id table is 2^kFlowSlotBits.
+constexpr int kFlowSlotBits = 14;
+
+// The id of the last flow started for an address hashing to each slot. The
+// upper 16 bits hold a generation in [1, 0xffff] that is incremented by every
+// Start event for the slot.
+static std::array<std::atomic<uint64_t>, 1 << kFlowSlotBits> flow_ids;
+
+uint64_t GetFlowId(const void* address, FlowPhase phase) {
+  constexpr int kAddressBits = 48;
+  constexpr uint64_t kAddressMask = (uint64_t{1} << kAddressBits) - 1;
+  const uint64_t masked = reinterpret_cast<uintptr_t>(address) & kAddressMask;
+  // Fibonacci hashing of the address without its alignment bits.
+  const size_t index =
+      ((masked >> 4) * 0x9E3779B97F4A7C15ull) >> (64 - kFlowSlotBits);
+  auto& slot = flow_ids[index];
+  auto id = slot.load(std::memory_order_relaxed);
+  if (phase == FlowPhase::Start) {
+    uint64_t new_id;
+    do {
+      uint64_t generation = (id >> kAddressBits) % 0xffff + 1;
+      new_id = generation << kAddressBits | masked;
+    } while (!slot.compare_exchange_weak(id, new_id,
+                                         std::memory_order_relaxed));
+    return new_id;
+  }
+  // If the slot was taken over by the flow of another address, generation 0
+  // does not match any started flow and the event is ignored by readers.
+  return (id & kAddressMask) == masked ? id : masked;
+}
+
 void RegisterTracingSink(TracingSink* tracing_sink) {
   std::lock_guard<std::mutex> lock(GetTracingMutex());
   assert(tracing_sink);
@@ -0,0 +1,93 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Benchmark measuring tfrt_data.batch_dataset.tensor throughput.
+
+#include <string>
+
+#include "benchmark/benchmark.h"
+#include "gtest/gtest.h"
+#include "mlir/IR/MLIRContext.h"
+#include "tfrt/host_context/async_dispatch.h"
+#include "tfrt/init_tfrt_dialects.h"
+#include "tfrt/support/string_util.h"
+#include "tfrt/utils/mlir_runner_util.h"
+
+namespace tfrt {
+namespace testing {
+namespace {
+
+// Each run batches `batch_size` elements, which all alias the same f32 tensor
+// of `element_size` values, and waits for the batch. The per-element map
+// function just forwards the tensor, so the run time is dominated by copying
+// the elements into the batch.
+void BM_BatchDatasetTensor(benchmark::State& state) {
+  auto batch_size = state.range(0);
+  auto element_size = state.range(1);
+  mlir::MLIRContext context;
+  mlir::DialectRegistry registry;
+  RegisterTFRTDialects(registry);
+  context.appendDialectRegistry(registry);
+
+  auto mlir_input = StrCat(R"mlir(
+    func.func @forward(%tensor: !t.tensor, %index: i64) -> !t.tensor {
+      tfrt.return %tensor : !t.tensor
+    }
+
+    func.func @main() -> !t.tensor {
+      %chain = tfrt.new.chain
+      %tensor = tfrt_dht.create_uninitialized_tensor.f32.1 [)mlir",
+                           element_size, R"mlir( : i64]
+      %start = tfrt.constant.i64 0
+      %stop = tfrt.constant.i64 )mlir",
+                           batch_size, R"mlir(
+      %step = tfrt.constant.i64 1
+      %range = tfrt_data.range_dataset %start, %stop, %step {
+        element_type = i64
+      }
+      %elements = tfrt_data.map_dataset %range, %tensor : !t.tensor {
+        function = @forward
+      }
+      %batches = tfrt_data.batch_dataset.tensor %elements, %stop {
+        same_input_metadata = true
+      }
+      %iterator = tfrt_data.make_iterator %batches
+      %chain_out, %batch = tfrt_data.iterator_get_next %iterator, %chain
+        : !t.tensor
+      tfrt.return %batch : !t.tensor
+    })mlir");
+
+  TfrtMlirRunner::Builder builder;
+  EXPECT_EQ(&builder.set_mlir_fn_name("main")
+                 .set_mlir_input(mlir_input)
+                 .set_mlir_context(&context),
+            &builder);
+  auto runner = builder.Compile();
+
+  for (auto _ : state) {
+    Await(runner.Run());
+  }
+  state.SetBytesProcessed(state.iterations() * batch_size * element_size *
+                          sizeof(float));
+}
+BENCHMARK(BM_BatchDatasetTensor)
+    ->ArgNames({"batch_size", "element_size"})
+    ->ArgsProduct({{32, 64, 128, 256, 512, 1024}, {256, 16384, 150528}})
+    ->UseRealTime();
+
+}  // namespace
+}  // namespace testing
+}  // namespace tfrt
@@ -0,0 +1,356 @@
+/*
+ * Copyright 2022 The TensorFlow Runtime Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Benchmark measuring the throughput of reading many small records with
+// TFRecordDataset, and the contention between GetNext() and the prefetching
+// task of the prefetching iterator it is built on.
+
+#include "../../lib/data/io.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "gtest/gtest.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "mlir/IR/MLIRContext.h"
+#include "tfrt/cpp_tests/tf_record_test_util.h"
+#include "tfrt/data/dataset.h"
+#include "tfrt/host_context/async_dispatch.h"
+#include "tfrt/host_context/concurrent_work_queue.h"
+#include "tfrt/host_context/diagnostic.h"
+#include "tfrt/host_context/execution_context.h"
+#include "tfrt/host_context/host_allocator.h"
+#include "tfrt/host_context/host_context.h"
+#include "tfrt/init_tfrt_dialects.h"
+#include "tfrt/io/emulated_remote_file_system.h"
+#include "tfrt/support/string_util.h"
+#include "tfrt/utils/mlir_runner_util.h"
+
+namespace tfrt {
+namespace testing {
+namespace {
+
+// Writes `num_records` records of `record_size` bytes each to `path`.
+void WriteTFRecordFile(const std::string& path, int64_t num_records,
+                       int64_t record_size) {
+  std::string record = data::MakeRecord(std::string(record_size, 'x'));
+  std::ofstream file(path, std::ios::binary);
+  for (int64_t i = 0; i < num_records; ++i) file << record;
+}
+
+// Evicts the pages of the file at `path` from the page cache, if supported.
+void EvictFromPageCache(const std::string& path) {
+#if defined(POSIX_FADV_DONTNEED)
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) return;
+  (void)fdatasync(fd);
+  (void)posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+  close(fd);
+#endif
+}
+
+// Returns the number of bytes of the file at `path` in the page cache.
+int64_t GetPageCacheResidentBytes(const std::string& path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) return 0;
+  const off_t size = lseek(fd, 0, SEEK_END);
+  void* addr =
+      size > 0 ? mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0) : nullptr;
+  close(fd);
+  if (addr == nullptr || addr == MAP_FAILED) return 0;
+
+  const int64_t page_size = sysconf(_SC_PAGESIZE);
+  std::vector<unsigned char> pages((size + page_size - 1) / page_size);
+  int64_t resident_bytes = 0;
+  if (mincore(addr, size, pages.data()) == 0) {
+    for (unsigned char page : pages) resident_bytes += (page & 1) * page_size;
+  }
+  munmap(addr, size);
+  return resident_bytes;
+}
+
+// The scheme of the objects of an emulated remote store, which are the files in
+// the temporary directory. Each request has 20 ms latency and transfers 100 MB
+// per second.
+constexpr char kEmulatedRemoteScheme[] = "emulated";
+
+void RegisterEmulatedRemoteFileSystem() {
+  static bool registered = [] {
+    llvm::SmallString<128> root;
+    llvm::sys::path::system_temp_directory(/*ErasedOnReboot=*/true, root);
+    io::EmulatedRemoteFileSystemOptions options;
+    options.root = root.str().str();
+    options.latency = std::chrono::milliseconds(20);
+    options.bandwidth = 100 << 20;
+    // Smaller than the file, so that each run sends all requests again.
+    options.cache_size = 16 << 20;
+    io::FileSystemRegistry::Default()->Register(
+        kEmulatedRemoteScheme, std::make_unique<io::EmulatedRemoteFileSystem>(
+                                   kEmulatedRemoteScheme, std::move(options)));
+    return true;
+  }();
+  (void)registered;
+}
+
+// Each run reads all records of a file with `dataset_op` and counts them. With
+// small records the run time is dominated by the per-record overhead of the
+// reader and the prefetching iterator rather than by the file reads.
+//
+// If `cold_cache` is true, the file is evicted from the page cache before each
+// run, so that each run reads the file from the device, and the number of
+// bytes of the file that are cached after the runs is reported. If `remote` is
+// true, the file is read from the emulated remote store.
+void RunTFRecordDatasetBenchmark(benchmark::State& state,
+                                 string_view dataset_op,
+                                 string_view record_type,
+                                 bool cold_cache = false, bool remote = false) {
+  constexpr int64_t kNumRecords = 100000;
+  auto record_size = state.range(0);
+
+  llvm::SmallString<128> path;
+  ASSERT_FALSE(
+      llvm::sys::fs::createTemporaryFile("tf_record_benchmark", "", path));
+  WriteTFRecordFile(path.str().str(), kNumRecords, record_size);
+  std::string dataset_path = path.str().str();
+  if (remote) {
+    RegisterEmulatedRemoteFileSystem();
+    dataset_path = StrCat(kEmulatedRemoteScheme,
+                          "://", llvm::sys::path::filename(path));
+  }
+
+  mlir::MLIRContext context;
+  mlir::DialectRegistry registry;
+  RegisterTFRTDialects(registry);
+  context.appendDialectRegistry(registry);
+
+  auto mlir_input = StrCat(R"mlir(
+    func.func @count(%record: )mlir",
+                           record_type, R"mlir(, %count: i64) -> i64 {
+      %one = tfrt.constant.i64 1
+      %result = tfrt.add.i64 %count, %one
+      tfrt.return %result : i64
+    }
+
+    func.func @main() -> i64 {
+      %path = "tfrt_test.get_string"() { value = ")mlir",
+                           dataset_path, R"mlir(" } : () -> !tfrt.string
+      %zero = tfrt.constant.i64 0
+      %dataset = )mlir",
+                           dataset_op, R"mlir(
+      %iterator = tfrt_data.make_iterator %dataset
+      %count = tfrt_data.enumerate.iterator %iterator, %zero
+        { function = @count } : i64
+      tfrt.return %count : i64
+    })mlir");
+
+  TfrtMlirRunner::Builder builder;
+  EXPECT_EQ(&builder.set_mlir_fn_name("main")
+                 .set_mlir_input(mlir_input)
+                 .set_mlir_context(&context),
+            &builder);
+  auto runner = builder.Compile();
+
+  for (auto _ : state) {
+    if (cold_cache) {
+      state.PauseTiming();
+      EvictFromPageCache(path.str().str());
+      state.ResumeTiming();
+    }
+    Await(runner.Run());
+  }
+  state.SetItemsProcessed(state.iterations() * kNumRecords);
+  state.SetBytesProcessed(state.iterations() * kNumRecords * record_size);
+  if (cold_cache) {
+    state.counters["cached_bytes"] =
+        GetPageCacheResidentBytes(path.str().str());
+  }
+
+  llvm::sys::fs::remove(path);
+}
+
+// Copies each record into a string through a buffered stream.
+void BM_TFRecordDatasetSmallRecords(benchmark::State& state) {
+  RunTFRecordDatasetBenchmark(state, "tfrt_data.tf_record_dataset %path",
+                              "!tfrt.string");
+}
+BENCHMARK(BM_TFRecordDatasetSmallRecords)
+    ->ArgName("record_size")
+    ->RangeMultiplier(8)
+    ->Range(8, 4096)
+    ->UseRealTime();
+
+// Returns views of the records in a memory-mapped file.
+void BM_TFRecordDatasetMappedSmallRecords(benchmark::State& state) {
+  RunTFRecordDatasetBenchmark(
+      state, "tfrt_data.tf_record_dataset.host_buffer %path",
+      "!ht.host_buffer");
+}
+BENCHMARK(BM_TFRecordDatasetMappedSmallRecords)
+    ->ArgName("record_size")
+    ->RangeMultiplier(8)
+    ->Range(8, 4096)
+    ->UseRealTime();
+
+// Returns views of the records in chunks of 4 MB.
+void BM_TFRecordDatasetChunkedSmallRecords(benchmark::State& state) {
+  RunTFRecordDatasetBenchmark(state,
+                              "tfrt_data.tf_record_dataset.chunked %path "
+                              "{ chunk_size = 4194304 : i64 }",
+                              "!ht.host_buffer");
+}
+BENCHMARK(BM_TFRecordDatasetChunkedSmallRecords)
+    ->ArgName("record_size")
+    ->RangeMultiplier(8)
+    ->Range(8, 4096)
+    ->UseRealTime();
+
+// Reads chunks of 4 MB from a file that is not in the page cache, through the
+// page cache or with direct IO.
+void BM_TFRecordDatasetChunkedColdCache(benchmark::State& state) {
+  RunTFRecordDatasetBenchmark(state,
+                              "tfrt_data.tf_record_dataset.chunked %path "
+                              "{ chunk_size = 4194304 : i64 }",
+                              "!ht.host_buffer", /*cold_cache=*/true);
+}
+BENCHMARK(BM_TFRecordDatasetChunkedColdCache)
+    ->ArgName("record_size")
+    ->Arg(4096)
+    ->UseRealTime();
+
+void BM_TFRecordDatasetChunkedDirectIO(benchmark::State& state) {
+  RunTFRecordDatasetBenchmark(
+      state,
+      "tfrt_data.tf_record_dataset.chunked %path "
+      "{ chunk_size = 4194304 : i64, direct_io = true }",
+      "!ht.host_buffer", /*cold_cache=*/true);
+}
+BENCHMARK(BM_TFRecordDatasetChunkedDirectIO)
+    ->ArgName("record_size")
+    ->Arg(4096)
+    ->UseRealTime();
+
+// Reads a file from a store with high latency, through a buffered stream or in
+// chunks of 4 MB. Each read sends requests for 1 MB blocks in parallel.
+void BM_TFRecordDatasetEmulatedRemote(benchmark::State& state) {
+  RunTFRecordDatasetBenchmark(state, "tfrt_data.tf_record_dataset %path",
+                              "!tfrt.string", /*cold_cache=*/false,
+                              /*remote=*/true);
+}
+BENCHMARK(BM_TFRecordDatasetEmulatedRemote)
+    ->ArgName("record_size")
+    ->Arg(512)
+    ->UseRealTime();
+
+void BM_TFRecordDatasetChunkedEmulatedRemote(benchmark::State& state) {
+  RunTFRecordDatasetBenchmark(state,
+                              "tfrt_data.tf_record_dataset.chunked %path "
+                              "{ chunk_size = 4194304 : i64 }",
+                              "!ht.host_buffer", /*cold_cache=*/false,
+                              /*remote=*/true);
+}
+BENCHMARK(BM_TFRecordDatasetChunkedEmulatedRemote)
+    ->ArgName("record_size")
+    ->Arg(512)
+    ->UseRealTime();
+
+// Reads the integers [0, num_elements) from a source that costs almost
+// nothing, so that the prefetching task and GetNext() mostly contend on the
+// prefetch buffer.
+class RangeIterator : public data::io::PrefetchingIterator {
+ public:
+  RangeIterator(int64_t num_elements, data::io::PrefetchBufferAccess access,
+                HostContext* host)
+      : data::io::PrefetchingIterator(/*max_prefetch_num=*/64,
+                                      /*prefetch_threshold=*/32,
+                                      data::IteratorContext(), access),
+        num_elements_(num_elements),
+        host_(host) {}
+
+ protected:
+  data::IterationResult GetNextElement(
+      const ExecutionContext& exec_ctx) override {
+    if (next_ == num_elements_) return data::IterationResult::Eof(host_, 1);
+    return data::IterationResult::Values(
+        {MakeAvailableAsyncValueRef<int64_t>(host_, next_++)}, host_);
+  }
+
+ private:
+  void Destroy() override {
+    data::internal::DestroyImpl<RangeIterator>(this, host_->allocator());
+  }
+
+  const int64_t num_elements_;
+  HostContext* host_;
+  int64_t next_ = 0;
+};
+
+// Each benchmark thread reads all elements of its own iterator, while the
+// blocking threads of a shared host run the prefetching tasks of the
+// iterators.
+void RunPrefetchingIteratorBenchmark(benchmark::State& state,
+                                     data::io::PrefetchBufferAccess access) {
+  constexpr int64_t kNumElements = 100000;
+  static HostContext* host =
+      new HostContext([](const DecodedDiagnostic&) {}, CreateMallocAllocator(),
+                      CreateMultiThreadedWorkQueue(4, 4));
+  auto request_ctx =
+      RequestContextBuilder(host, /*resource_context=*/nullptr).build();
+  ASSERT_FALSE(!request_ctx);
+  ExecutionContext exec_ctx(std::move(*request_ctx));
+
+  for (auto _ : state) {
+    auto iterator =
+        TakeRef(host->Construct<RangeIterator>(kNumElements, access, host));
+    int64_t count = 0;
+    while (true) {
+      auto result = iterator->GetNext(exec_ctx);
+      if (!result.eof.IsAvailable()) host->Await({result.eof.CopyRCRef()});
+      if (result.eof.IsError() || result.eof.get()) break;
+      ++count;
+    }
+    benchmark::DoNotOptimize(count);
+  }
+  state.SetItemsProcessed(state.iterations() * kNumElements);
+}
+
+// Pops prefetched elements without taking the lock.
+void BM_PrefetchingIteratorLockFree(benchmark::State& state) {
+  RunPrefetchingIteratorBenchmark(state,
+                                  data::io::PrefetchBufferAccess::kLockFree);
+}
+BENCHMARK(BM_PrefetchingIteratorLockFree)->ThreadRange(1, 4)->UseRealTime();
+
+// Pops prefetched elements while holding the lock of the prefetching task.
+void BM_PrefetchingIteratorLocked(benchmark::State& state) {
+  RunPrefetchingIteratorBenchmark(state,
+                                  data::io::PrefetchBufferAccess::kLocked);
+}
+BENCHMARK(BM_PrefetchingIteratorLocked)->ThreadRange(1, 4)->UseRealTime();
+
+}  // namespace
+}  // namespace testing
+}  // namespace tfrt
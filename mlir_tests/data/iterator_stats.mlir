@@ -0,0 +1,77 @@
+// Copyright 2022 The TensorFlow Runtime Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// RUN: bef_executor %s.bef | FileCheck %s
+// RUN: tfrt_opt %s | tfrt_opt
+
+// CHECK-LABEL: --- Running 'range_stats'
+func.func @range_stats() -> !tfrt.chain {
+  %ch0 = tfrt.new.chain
+  %start = tfrt.constant.i64 0
+  %stop = tfrt.constant.i64 5
+  %step = tfrt.constant.i64 1
+  %range = tfrt_data.range_dataset %start, %stop, %step { element_type = i64 }
+  %iterator = tfrt_data.make_iterator_with_stats %range
+
+  %ch1, %v0 = tfrt_data.iterator_get_next %iterator, %ch0 : i64
+  %ch2, %v1 = tfrt_data.iterator_get_next %iterator, %ch1 : i64
+  %ch3, %v2 = tfrt_data.iterator_get_next %iterator, %ch2 : i64
+
+  // The range elements are available when they are returned, so their input
+  // latency is zero.
+  // CHECK: iterator: elements=0 bytes=0 input_latency_ms=0.000 input_requests=3
+  // CHECK-NEXT:   range: elements=3 bytes=0
+  %ch4 = tfrt_data.print_iterator_stats %iterator, %ch3
+
+  tfrt.return %ch4 : !tfrt.chain
+}
+
+// CHECK-LABEL: --- Running 'nested_stats'
+func.func @nested_stats() -> !tfrt.chain {
+  %ch0 = tfrt.new.chain
+  %start = tfrt.constant.i64 0
+  %stop = tfrt.constant.i64 3
+  %step = tfrt.constant.i64 1
+  %count = tfrt.constant.i64 2
+  %range = tfrt_data.range_dataset %start, %stop, %step { element_type = i64 }
+  %repeat = tfrt_data.repeat_dataset %range, %count
+  %iterator = tfrt_data.make_iterator_with_stats %repeat
+
+  %ch1, %v0 = tfrt_data.iterator_get_next %iterator, %ch0 : i64
+  %ch2, %v1 = tfrt_data.iterator_get_next %iterator, %ch1 : i64
+
+  // The statistics of each iterator are nested under those of its consumer.
+  // CHECK: iterator: elements=0 bytes=0
+  // CHECK-NEXT:   repeat: elements={{[0-9]+}} bytes=0
+  // CHECK-NEXT:     range: elements={{[0-9]+}} bytes=0
+  %ch3 = tfrt_data.print_iterator_stats %iterator, %ch2
+
+  tfrt.return %ch3 : !tfrt.chain
+}
+
+// CHECK-LABEL: --- Running 'no_stats'
+func.func @no_stats() -> !tfrt.chain {
+  %ch0 = tfrt.new.chain
+  %start = tfrt.constant.i64 0
+  %stop = tfrt.constant.i64 3
+  %step = tfrt.constant.i64 1
+  %range = tfrt_data.range_dataset %start, %stop, %step { element_type = i64 }
+  %iterator = tfrt_data.make_iterator %range
+
+  // Iterators created without statistics print nothing.
+  // CHECK-NOT: elements=
+  %ch1 = tfrt_data.print_iterator_stats %iterator, %ch0
+
+  tfrt.return %ch1 : !tfrt.chain
+}
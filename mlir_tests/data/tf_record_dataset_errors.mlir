@@ -0,0 +1,43 @@
+// Copyright 2022 The TensorFlow Runtime Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// RUN: tfrt_opt -split-input-file -verify-diagnostics %s
+
+func.func @supported_compression_types(%path : !tfrt.string) {
+  %zlib = tfrt_data.tf_record_dataset %path { compression_type = "ZLIB" }
+  %gzip = tfrt_data.tf_record_dataset %path { compression_type = "GZIP" }
+  %none = tfrt_data.tf_record_dataset %path { compression_type = "" }
+  tfrt.return
+}
+
+// -----
+
+func.func @unsupported_compression_type(%path : !tfrt.string) {
+  // expected-error @+1 {{'tfrt_data.tf_record_dataset' op unsupported compression_type: SNAPPY}}
+  %dataset = tfrt_data.tf_record_dataset %path { compression_type = "SNAPPY" }
+  tfrt.return
+}
+
+// -----
+
+func.func @sharded_unsupported_compression_type(%pattern : !tfrt.string) {
+  // expected-error @+1 {{'tfrt_data.sharded_tf_record_dataset' op unsupported compression_type: gzip}}
+  %dataset = tfrt_data.sharded_tf_record_dataset %pattern {
+    compression_type = "gzip",
+    num_parallel_reads = 1 : i64,
+    num_shards = 1 : i64,
+    shard_index = 0 : i64
+  }
+  tfrt.return
+}
@@ -14,6 +14,7 @@
 #include "tfrt/host_context/async_value.h"
 #include "tfrt/host_context/concurrent_work_queue.h"
 #include "tfrt/host_context/task_function.h"
+#include "tfrt/metrics/metrics.h"
 #include "tfrt/support/latch.h"
 #include "tfrt/support/ref_count.h"
 #include "tfrt/support/string_util.h"
@@ -48,6 +49,12 @@ class MultiThreadedWorkQueue : public ConcurrentWorkQueue {
   std::unique_ptr<internal::QuiescingState> quiescing_state_;
   internal::NonBlockingWorkQueue<ThreadingEnvironment> non_blocking_work_queue_;
   internal::BlockingWorkQueue<ThreadingEnvironment> blocking_work_queue_;
+
+  // Metrics shared by all multi-threaded work queues. Only updated while
+  // metrics are enabled.
+  metrics::Counter* const tasks_added_;
+  metrics::Counter* const blocking_tasks_added_;
+  metrics::Counter* const blocking_tasks_rejected_;
 };
 
 MultiThreadedWorkQueue::MultiThreadedWorkQueue(int num_threads,
@@ -56,7 +63,12 @@ MultiThreadedWorkQueue::MultiThreadedWorkQueue(int num_threads,
       num_blocking_threads_(num_blocking_threads),
       quiescing_state_(std::make_unique<internal::QuiescingState>()),
       non_blocking_work_queue_(quiescing_state_.get(), num_threads),
-      blocking_work_queue_(quiescing_state_.get(), num_blocking_threads) {}
+      blocking_work_queue_(quiescing_state_.get(), num_blocking_threads),
+      tasks_added_(metrics::NewCounter("/tfrt/work_queue/tasks_added")),
+      blocking_tasks_added_(
+          metrics::NewCounter("/tfrt/work_queue/blocking_tasks_added")),
+      blocking_tasks_rejected_(
+          metrics::NewCounter("/tfrt/work_queue/blocking_tasks_rejected")) {}
 
 MultiThreadedWorkQueue::~MultiThreadedWorkQueue() {
   // Pending tasks in the underlying queues might submit new tasks to each other
@@ -65,16 +77,18 @@ MultiThreadedWorkQueue::~MultiThreadedWorkQueue() {
 }
 
 void MultiThreadedWorkQueue::AddTask(TaskFunction task) {
+  if (metrics::IsMetricsEnabled()) tasks_added_->Increment();
   non_blocking_work_queue_.AddTask(std::move(task));
 }
 
 Optional<TaskFunction> MultiThreadedWorkQueue::AddBlockingTask(
     TaskFunction task, bool allow_queuing) {
-  if (allow_queuing) {
-    return blocking_work_queue_.EnqueueBlockingTask(std::move(task));
-  } else {
-    return blocking_work_queue_.RunBlockingTask(std::move(task));
-  }
+  Optional<TaskFunction> rejected =
+      allow_queuing ? blocking_work_queue_.EnqueueBlockingTask(std::move(task))
+                    : blocking_work_queue_.RunBlockingTask(std::move(task));
+  if (metrics::IsMetricsEnabled())
+    (rejected ? blocking_tasks_rejected_ : blocking_tasks_added_)->Increment();
+  return rejected;
 }
 
 void MultiThreadedWorkQueue::Quiesce() {
@@ -0,0 +1,326 @@
+// Copyright 2022 The TensorFlow Runtime Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+//===- Trace Critical Path Analyzer ---------------------------------------===//
+//
+// This file reads a chrome trace written by the chrome tracing sink and
+// reports the longest dependency chain of each request.
+//
+// Activities are connected through flow events: a flow starts in the kernel
+// producing an AsyncValue, and finishes in each kernel consuming it (see
+// RecordFlowEvent() in tfrt/tracing/tracing.h). The flow id is derived from the
+// AsyncValue address and a generation counter (see GetFlowId()). Each flow
+// event is attributed to the innermost activity enclosing it on the same
+// thread. Flow steps (e.g. when the AsyncValue became available) are recorded
+// on both the producer and the consumer side and are ignored.
+//
+// Requests share no AsyncValues, so each connected component of the resulting
+// dependency graph is reported as one request. The length of a chain is the
+// sum of the durations of its activities plus the time each activity waited
+// for its predecessor to finish.
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace {
+
+llvm::cl::opt<std::string> cl_input_filename(  // NOLINT
+    llvm::cl::Positional, llvm::cl::desc("<trace.json>"), llvm::cl::Required);
+
+llvm::cl::opt<int> cl_max_requests(  // NOLINT
+    "max_requests", llvm::cl::desc("Maximum number of requests to report"),
+    llvm::cl::init(10));
+
+// A complete ("X") event. Times are in microseconds.
+struct Activity {
+  std::string name;
+  int64_t tid;
+  double begin, end;
+};
+
+// A flow ("s", "t" or "f") event.
+struct FlowEvent {
+  char phase;
+  double ts;
+  int activity;  // Index into activities, or -1 if not enclosed by any.
+};
+
+struct Edge {
+  int from, to;
+};
+
+class Trace {
+ public:
+  llvm::Error Parse(const llvm::json::Value& json) {
+    const auto* object = json.getAsObject();
+    const auto* events = object ? object->getArray("traceEvents") : nullptr;
+    if (!events)
+      return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                     "Missing traceEvents array");
+
+    struct PendingFlow {
+      std::string id;
+      FlowEvent event;
+      int64_t tid;
+    };
+    std::vector<PendingFlow> flows;
+
+    for (const auto& value : *events) {
+      const auto* event = value.getAsObject();
+      if (!event) continue;
+      auto phase = event->getString("ph");
+      auto tid = event->getInteger("tid");
+      auto ts = event->getNumber("ts");
+      if (!phase || !tid || !ts) continue;
+
+      if (*phase == "X") {
+        auto name = event->getString("name");
+        auto dur = event->getNumber("dur");
+        activities_.push_back(Activity{name ? name->str() : std::string(),
+                                       *tid, *ts, *ts + dur.getValueOr(0)});
+      } else if (*phase == "s" || *phase == "t" || *phase == "f") {
+        auto id = event->getString("id");
+        if (!id) continue;
+        flows.push_back(
+            PendingFlow{id->str(), {phase->front(), *ts, -1}, *tid});
+      }
+    }
+
+    IndexActivities();
+    for (auto& flow : flows) {
+      flow.event.activity = FindEnclosingActivity(flow.tid, flow.event.ts);
+      flows_[flow.id].push_back(flow.event);
+    }
+    return llvm::Error::success();
+  }
+
+  // Builds the edges from the producing to the consuming activities. Flow ids
+  // carry a generation that changes when an AsyncValue address is reused (see
+  // tracing::GetFlowId()). The generation wraps around in long traces, so a
+  // start event still resets the flow.
+  std::vector<Edge> GetEdges() {
+    std::vector<Edge> edges;
+    for (auto& entry : flows_) {
+      auto& events = entry.second;
+      llvm::stable_sort(events, [](const FlowEvent& lhs, const FlowEvent& rhs) {
+        return lhs.ts < rhs.ts;
+      });
+      int producer = -1;
+      for (const auto& event : events) {
+        if (event.phase == 's') producer = event.activity;
+        if (event.phase != 'f' || producer < 0 || event.activity < 0) continue;
+        if (producer == event.activity) continue;
+        // Guard against cycles from imprecise attribution.
+        if (activities_[producer].begin >= activities_[event.activity].begin)
+          continue;
+        edges.push_back({producer, event.activity});
+      }
+    }
+    return edges;
+  }
+
+  const std::vector<Activity>& activities() const { return activities_; }
+
+ private:
+  void IndexActivities() {
+    std::vector<int> order(activities_.size());
+    std::iota(order.begin(), order.end(), 0);
+    // Sort by begin time, outer activities first.
+    llvm::stable_sort(order, [&](int lhs, int rhs) {
+      const auto &a = activities_[lhs], &b = activities_[rhs];
+      if (a.begin != b.begin) return a.begin < b.begin;
+      return a.end > b.end;
+    });
+    for (int index : order) by_thread_[activities_[index].tid].push_back(index);
+  }
+
+  // Returns the innermost activity on thread `tid` containing `ts`, which is
+  // the containing one that started last.
+  int FindEnclosingActivity(int64_t tid, double ts) const {
+    auto it = by_thread_.find(tid);
+    if (it == by_thread_.end()) return -1;
+    const auto& indices = it->second;
+    auto upper = std::upper_bound(
+        indices.begin(), indices.end(), ts,
+        [&](double ts, int index) { return ts < activities_[index].begin; });
+    while (upper != indices.begin()) {
+      int index = *--upper;
+      if (activities_[index].end >= ts) return index;
+    }
+    return -1;
+  }
+
+  std::vector<Activity> activities_;
+  llvm::DenseMap<int64_t, std::vector<int>> by_thread_;
+  llvm::StringMap<std::vector<FlowEvent>> flows_;
+};
+
+// Longest dependency chain of one request.
+struct CriticalPath {
+  double length = 0;
+  double wait = 0;
+  std::vector<int> activities;  // In execution order.
+};
+
+class CriticalPathAnalyzer {
+ public:
+  CriticalPathAnalyzer(const std::vector<Activity>& activities,
+                       const std::vector<Edge>& edges)
+      : activities_(activities), preds_(activities.size()) {
+    parents_.resize(activities.size());
+    std::iota(parents_.begin(), parents_.end(), 0);
+    in_graph_.resize(activities.size());
+    for (const auto& edge : edges) {
+      preds_[edge.to].push_back(edge.from);
+      Union(edge.from, edge.to);
+      in_graph_[edge.from] = in_graph_[edge.to] = true;
+    }
+  }
+
+  // Returns the critical path of each request, longest first.
+  std::vector<CriticalPath> Analyze() {
+    size_t size = activities_.size();
+    std::vector<double> length(size, 0), wait(size, 0);
+    std::vector<int> best_pred(size, -1);
+
+    // Edges always point to activities that begin later, so processing in
+    // order of begin time visits predecessors first.
+    std::vector<int> order(size);
+    std::iota(order.begin(), order.end(), 0);
+    llvm::stable_sort(order, [&](int lhs, int rhs) {
+      return activities_[lhs].begin < activities_[rhs].begin;
+    });
+
+    llvm::DenseMap<int, int> best_by_request;
+    for (int index : order) {
+      if (!in_graph_[index]) continue;
+      const Activity& activity = activities_[index];
+      for (int pred : preds_[index]) {
+        double gap = std::max(0.0, activity.begin - activities_[pred].end);
+        if (length[pred] + gap > length[index]) {
+          length[index] = length[pred] + gap;
+          wait[index] = wait[pred] + gap;
+          best_pred[index] = pred;
+        }
+      }
+      length[index] += activity.end - activity.begin;
+
+      auto pair = best_by_request.try_emplace(Find(index), index);
+      if (length[index] > length[pair.first->second])
+        pair.first->second = index;
+    }
+
+    std::vector<CriticalPath> paths;
+    for (const auto& entry : best_by_request) {
+      CriticalPath path;
+      path.length = length[entry.second];
+      path.wait = wait[entry.second];
+      for (int index = entry.second; index >= 0; index = best_pred[index])
+        path.activities.push_back(index);
+      std::reverse(path.activities.begin(), path.activities.end());
+      paths.push_back(std::move(path));
+    }
+    llvm::sort(paths, [](const CriticalPath& lhs, const CriticalPath& rhs) {
+      return lhs.length > rhs.length;
+    });
+    return paths;
+  }
+
+ private:
+  int Find(int index) {
+    while (parents_[index] != index)
+      index = parents_[index] = parents_[parents_[index]];
+    return index;
+  }
+
+  void Union(int lhs, int rhs) { parents_[Find(lhs)] = Find(rhs); }
+
+  const std::vector<Activity>& activities_;
+  std::vector<std::vector<int>> preds_;
+  std::vector<int> parents_;
+  std::vector<bool> in_graph_;
+};
+
+void PrintCriticalPath(llvm::raw_ostream& os, int request,
+                       const CriticalPath& path,
+                       const std::vector<Activity>& activities) {
+  os << llvm::formatv(
+      "Request {0}: {1:f3} us over {2} activities ({3:f3} us waiting)\n",
+      request, path.length, path.activities.size(), path.wait);
+  os << llvm::formatv("  {0,14} {1,12} {2,12} {3,6}  {4}\n", "ts (us)",
+                      "dur (us)", "wait (us)", "tid", "name");
+  const Activity* prev = nullptr;
+  for (int index : path.activities) {
+    const Activity& activity = activities[index];
+    double wait = prev ? std::max(0.0, activity.begin - prev->end) : 0.0;
+    os << llvm::formatv("  {0,14:f3} {1,12:f3} {2,12:f3} {3,6}  {4}\n",
+                        activity.begin, activity.end - activity.begin, wait,
+                        activity.tid, activity.name);
+    prev = &activity;
+  }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  llvm::cl::ParseCommandLineOptions(argc, argv,
+                                    "Trace critical path analyzer\n");
+
+  auto buffer = llvm::MemoryBuffer::getFileOrSTDIN(cl_input_filename);
+  if (!buffer) {
+    llvm::errs() << "Cannot open " << cl_input_filename << ": "
+                 << buffer.getError().message() << "\n";
+    return 1;
+  }
+
+  auto json = llvm::json::parse((*buffer)->getBuffer());
+  if (!json) {
+    llvm::errs() << "Cannot parse trace: " << llvm::toString(json.takeError())
+                 << "\n";
+    return 1;
+  }
+
+  Trace trace;
+  if (auto error = trace.Parse(*json)) {
+    llvm::errs() << "Invalid trace: " << llvm::toString(std::move(error))
+                 << "\n";
+    return 1;
+  }
+
+  auto paths =
+      CriticalPathAnalyzer(trace.activities(), trace.GetEdges()).Analyze();
+  if (paths.empty()) {
+    llvm::outs() << "No flow events found. Trace with --tracing_level=debug "
+                    "and TFRT_MAX_TRACING_LEVEL=Debug.\n";
+    return 0;
+  }
+
+  int num_requests = std::min<int>(paths.size(), cl_max_requests);
+  for (int i = 0; i < num_requests; ++i)
+    PrintCriticalPath(llvm::outs(), i, paths[i], trace.activities());
+  return 0;
+}
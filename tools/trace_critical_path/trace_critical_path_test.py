@@ -0,0 +1,103 @@
+# Copyright 2022 The TensorFlow Runtime Authors
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+"""Tests the trace_critical_path tool"""
+
+import json
+import os
+import subprocess
+import tempfile
+import unittest
+
+
+def _activity(name, tid, ts, dur):
+  return {'ph': 'X', 'name': name, 'pid': 0, 'tid': tid, 'ts': ts, 'dur': dur}
+
+
+def _flow(phase, flow_id, tid, ts):
+  return {
+      'ph': phase,
+      'name': 'flow',
+      'cat': 'flow',
+      'id': flow_id,
+      'pid': 0,
+      'tid': tid,
+      'ts': ts,
+      'bp': 'e'
+  }
+
+
+# The value produced by 'produce' is consumed on two threads. Its address is
+# then reused by the value produced by 'reuse', with the next generation in the
+# upper 16 bits of the flow id. The two flows belong to different requests.
+TRACE = {
+    'traceEvents': [
+        _activity('produce', 1, 0, 10),
+        _flow('s', '0x1000000001000', 1, 9),
+        _activity('consume', 2, 15, 5),
+        _flow('t', '0x1000000001000', 2, 15.5),
+        _flow('f', '0x1000000001000', 2, 16),
+        _activity('consume_later', 1, 30, 10),
+        _flow('f', '0x1000000001000', 1, 31),
+        _activity('reuse', 3, 100, 2),
+        _flow('s', '0x2000000001000', 3, 101),
+        _activity('reuse_consume', 3, 110, 1),
+        _flow('f', '0x2000000001000', 3, 110.5),
+    ]
+}
+
+REQUEST_0 = (
+    'Request 0: 40.000 us over 2 activities (20.000 us waiting)\n'
+    '         ts (us)     dur (us)    wait (us)    tid  name\n'
+    '           0.000       10.000        0.000      1  produce\n'
+    '          30.000       10.000       20.000      1  consume_later\n'
+)
+
+REQUEST_1 = (
+    'Request 1: 11.000 us over 2 activities (8.000 us waiting)\n'
+    '         ts (us)     dur (us)    wait (us)    tid  name\n'
+    '         100.000        2.000        0.000      3  reuse\n'
+    '         110.000        1.000        8.000      3  reuse_consume\n'
+)
+
+
+class TraceCriticalPathTest(unittest.TestCase):
+
+  def setUp(self):
+    super().setUp()
+    trace_fd, self.trace_path = tempfile.mkstemp('.json')
+    with open(trace_fd, 'w') as trace_file:
+      json.dump(TRACE, trace_file)
+
+  def tearDown(self):
+    os.remove(self.trace_path)
+    super().tearDown()
+
+  def _run(self, *args):
+    result = subprocess.run(
+        ['third_party/tf_runtime/tools/trace_critical_path', self.trace_path] +
+        list(args),
+        stdout=subprocess.PIPE,
+        stderr=subprocess.PIPE)
+    self.assertEqual(result.stderr.decode('utf-8'), '')
+    return result.stdout.decode('utf-8')
+
+  def test_prints_critical_path_per_request(self):
+    self.assertEqual(self._run(), REQUEST_0 + REQUEST_1)
+
+  def test_max_requests(self):
+    self.assertEqual(self._run('--max_requests=1'), REQUEST_0)
+
+
+if __name__ == '__main__':
+  unittest.main()